@@ -36,6 +36,8 @@
 int input_channels, output_channels, pcm_output_channels, spdif_channels, view_spdif_playback, card_number;
 int card_is_dmx6fire = FALSE, tall_equal_mixer_ht = 0;
 char *profiles_file_name, *default_profile;
+/* the control device, profiles are captured and restored through it */
+char *ctl_name;
 
 ice1712_eeprom_t card_eeprom;
 snd_ctl_t *ctl;
@@ -1584,7 +1586,7 @@ int restore_active_profile(const gint profile_number)
 {
 	gint res;
 
-	res = save_restore(ALSACTL_OP_RESTORE, profile_number, card_number, profiles_file_name, NULL);
+	res = save_restore(ALSACTL_OP_RESTORE, profile_number, card_number, ctl_name, profiles_file_name, NULL);
 
 	return res;
 }
@@ -1597,7 +1599,7 @@ int save_active_profile(GtkWidget *save_button)
 	if (!gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON (save_button)))
 		return EXIT_SUCCESS;
 	if ((index = index_active_profile()) >= 0) {
-		res = save_restore(ALSACTL_OP_STORE, index + 1, card_number, profiles_file_name, \
+		res = save_restore(ALSACTL_OP_STORE, index + 1, card_number, ctl_name, profiles_file_name, \
 			gtk_editable_get_text(GTK_EDITABLE (profiles_toggle_buttons[index].entry)));
 	} else {
 		fprintf(stderr, "No active profile found.\n");
@@ -1958,10 +1960,14 @@ int main(int argc, char **argv)
 		switch (c) {
 		case 'D':
 			name = optarg;
-			card_number = atoi(strchr(name, ':') + sizeof(char));
-			if (card_number < 0 || card_number >= MAX_CARD_NUMBERS) {
-				fprintf(stderr, "envy24control: invalid card number %d\n", card_number);
-				exit(1);
+			/* other devices (plugins, card ids) are numbered from the card info */
+			card_number = -1;
+			if (sscanf(name, "hw:%d%c", &i, tmpname) == 1) {
+				if (i < 0 || i >= MAX_CARD_NUMBERS) {
+					fprintf(stderr, "envy24control: invalid card number %d\n", i);
+					exit(1);
+				}
+				card_number = i;
 			}
 			break;
 		case 'c':
@@ -2078,7 +2084,13 @@ int main(int argc, char **argv)
 			fprintf(stderr, "invalid card type (driver is %s)\n", snd_ctl_card_info_get_driver(hw_info));
 			exit(EXIT_FAILURE);
 		}
+		if (card_number < 0) {
+			card_number = snd_ctl_card_info_get_card(hw_info);
+			if (card_number < 0 || card_number >= MAX_CARD_NUMBERS)
+				card_number = 0;
+		}
 	}
+	ctl_name = name;
 
 	snd_ctl_elem_value_set_interface(val, SND_CTL_ELEM_IFACE_CARD);
 	snd_ctl_elem_value_set_name(val, "ICE1712 EEPROM");
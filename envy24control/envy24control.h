@@ -46,18 +46,9 @@
 
 /* max number of cards for alsa */
 #define MAX_CARD_NUMBERS	8
-/* max number of HW input/output channels (analog lines)
- * the number of available HW input/output channels is defined
- * at 'adcs/dacs' in the driver
- */
-/* max number of HW input channels (analog lines) */
-#define MAX_INPUT_CHANNELS	8
-/* max number of HW output channels (analog lines) */
-#define MAX_OUTPUT_CHANNELS	8
-/* max number of spdif input/output channels */
-#define MAX_SPDIF_CHANNELS	2
-/* max number of PCM output channels */
-#define MAX_PCM_OUTPUT_CHANNELS	8
+
+/* channel maxima and the toolkit independent control model */
+#include "envy24model.h"
 
 typedef struct {
 	unsigned int subvendor;	/* PCI[2c-2f] */
@@ -0,0 +1,433 @@
+/*****************************************************************************
+   envy24ctld.c - headless envy24 control daemon
+   Copyright (C) 2026 by the ALSA project
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License
+   as published by the Free Software Foundation; either version 2
+   of the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+/*
+ * Serves the envy24 mixer, patchbay, clock and peak meters to any number
+ * of local clients over a UNIX socket, without a display.  A single
+ * poll() loop multiplexes the listening socket, the control handle and
+ * all clients; control events are pushed to subscribed clients.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <getopt.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <alsa/asoundlib.h>
+
+#include "envy24model.h"
+#include "envy24ctld.h"
+
+/* FIXME: hardcoded max number of cards, as in envy24control */
+#define MAX_CARD_NUMBERS	8
+#define DEFAULT_MAX_CLIENTS	64
+#define MESSAGE_MAX	(sizeof(struct envy24ctld_header) + \
+			 ENVY24CTLD_MAX_VALUES * sizeof(int32_t))
+
+struct client {
+	int fd;
+	unsigned int events;		/* subscribed event classes */
+	size_t used;			/* bytes in buffer */
+	unsigned char buffer[MESSAGE_MAX];
+};
+
+static snd_ctl_t *ctl;
+static struct client *clients;
+static int clients_count;
+static int max_clients = DEFAULT_MAX_CLIENTS;
+static volatile sig_atomic_t quit;
+
+static void usage(void)
+{
+	fprintf(stderr, "usage: envy24ctld [-c card#] [-D control-name] [-s socket] [-m max-clients] [-n]\n");
+	fprintf(stderr, "\t-c, --card\tAlsa card number to control\n");
+	fprintf(stderr, "\t-D, --device\tcontrol-name\n");
+	fprintf(stderr, "\t-s, --socket\tpath of the listening socket (default /tmp/envy24ctld-<card#>)\n");
+	fprintf(stderr, "\t-m, --max_clients\tnumber of simultaneous clients (default %i)\n", DEFAULT_MAX_CLIENTS);
+	fprintf(stderr, "\t-n, --nodaemon\tdo not detach from the terminal\n");
+}
+
+static void signal_handler(int sig)
+{
+	quit = 1;
+}
+
+static int open_control(const char *name, int *card)
+{
+	snd_ctl_card_info_t *hw_info;
+	static char cardname[16];
+	int err;
+
+	snd_ctl_card_info_alloca(&hw_info);
+	if (! name) {
+		/* probe cards */
+		for (*card = 0; *card < MAX_CARD_NUMBERS; (*card)++) {
+			sprintf(cardname, "hw:%d", *card);
+			if (snd_ctl_open(&ctl, cardname, SND_CTL_NONBLOCK) < 0)
+				continue;
+			if (snd_ctl_card_info(ctl, hw_info) < 0 ||
+			    strcmp(snd_ctl_card_info_get_driver(hw_info), "ICE1712")) {
+				snd_ctl_close(ctl);
+				continue;
+			}
+			return 0;
+		}
+		fprintf(stderr, "No ICE1712 cards found\n");
+		return -ENODEV;
+	}
+	if ((err = snd_ctl_open(&ctl, name, SND_CTL_NONBLOCK)) < 0) {
+		fprintf(stderr, "snd_ctl_open: %s\n", snd_strerror(err));
+		return err;
+	}
+	if ((err = snd_ctl_card_info(ctl, hw_info)) < 0) {
+		fprintf(stderr, "snd_ctl_card_info: %s\n", snd_strerror(err));
+		snd_ctl_close(ctl);
+		return err;
+	}
+	*card = snd_ctl_card_info_get_card(hw_info);
+	return 0;
+}
+
+static int open_socket(const char *path)
+{
+	struct sockaddr_un addr;
+	int fd;
+
+	if (strlen(path) >= sizeof(addr.sun_path)) {
+		fprintf(stderr, "socket path too long: %s\n", path);
+		return -ENAMETOOLONG;
+	}
+	if ((fd = socket(PF_UNIX, SOCK_STREAM, 0)) < 0) {
+		perror("socket");
+		return -errno;
+	}
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, path);
+	unlink(path);
+	if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+	    listen(fd, 16) < 0 ||
+	    fcntl(fd, F_SETFL, O_NONBLOCK) < 0) {
+		perror(path);
+		close(fd);
+		return -errno;
+	}
+	return fd;
+}
+
+static void client_close(int idx)
+{
+	close(clients[idx].fd);
+	clients[idx] = clients[--clients_count];
+}
+
+/*
+ * Messages are tiny compared to the socket buffer, so a client which
+ * cannot take one without blocking is not reading at all; it is dropped
+ * rather than allowed to stall everybody else.
+ */
+static int client_send(struct client *client, int op, int arg,
+		       const int *values, int count)
+{
+	unsigned char buffer[MESSAGE_MAX];
+	struct envy24ctld_header *hdr = (struct envy24ctld_header *)buffer;
+	int32_t *data = (int32_t *)(hdr + 1);
+	size_t size;
+	ssize_t res;
+	int i;
+
+	hdr->op = op;
+	hdr->count = count;
+	hdr->arg = arg;
+	for (i = 0; i < count; i++)
+		data[i] = values[i];
+	size = sizeof(*hdr) + count * sizeof(int32_t);
+	do {
+		res = send(client->fd, buffer, size, MSG_DONTWAIT | MSG_NOSIGNAL);
+	} while (res < 0 && errno == EINTR);
+	return res == (ssize_t)size ? 0 : -EPIPE;
+}
+
+static int client_request(struct client *client,
+			  const struct envy24ctld_header *hdr,
+			  const int32_t *data)
+{
+	int values[ENVY24CTLD_MAX_VALUES];
+	int count = 0, err;
+
+	switch (hdr->op) {
+	case ENVY24CTLD_GET_VOLUME:
+		err = envy24_volume_get(ctl, hdr->arg, &values[0], &values[1]);
+		count = 2;
+		break;
+	case ENVY24CTLD_SET_VOLUME:
+		err = hdr->count != 2 ? -EINVAL :
+		      envy24_volume_set(ctl, hdr->arg, data[0], data[1]);
+		break;
+	case ENVY24CTLD_GET_SWITCH:
+		err = envy24_switch_get(ctl, hdr->arg, &values[0], &values[1]);
+		count = 2;
+		break;
+	case ENVY24CTLD_SET_SWITCH:
+		err = hdr->count != 2 ? -EINVAL :
+		      envy24_switch_set(ctl, hdr->arg, data[0], data[1]);
+		break;
+	case ENVY24CTLD_GET_ROUTE:
+		err = values[0] = envy24_route_get(ctl, hdr->arg);
+		count = 1;
+		break;
+	case ENVY24CTLD_SET_ROUTE:
+		err = hdr->count != 1 ? -EINVAL :
+		      envy24_route_set(ctl, hdr->arg, data[0]);
+		break;
+	case ENVY24CTLD_GET_CLOCK:
+		err = values[0] = envy24_clock_get(ctl);
+		count = 1;
+		break;
+	case ENVY24CTLD_SET_CLOCK:
+		err = hdr->count != 1 ? -EINVAL : envy24_clock_set(ctl, data[0]);
+		break;
+	case ENVY24CTLD_GET_METERS:
+		err = count = envy24_peaks_read(ctl, values, ENVY24_PEAKS);
+		break;
+	case ENVY24CTLD_SUBSCRIBE:
+		client->events = hdr->arg;
+		err = 0;
+		break;
+	default:
+		err = -EINVAL;
+		break;
+	}
+	if (err < 0)
+		count = 0;
+	else
+		err = 0;
+	return client_send(client, hdr->op, err, values, count);
+}
+
+static int client_input(struct client *client)
+{
+	const struct envy24ctld_header *hdr;
+	size_t size;
+	ssize_t res;
+
+	res = recv(client->fd, client->buffer + client->used,
+		   sizeof(client->buffer) - client->used, MSG_DONTWAIT);
+	if (res < 0)
+		return errno == EINTR || errno == EAGAIN ? 0 : -errno;
+	if (res == 0)
+		return -EPIPE;
+	client->used += res;
+	/* serve every complete message in the buffer */
+	for (;;) {
+		hdr = (const struct envy24ctld_header *)client->buffer;
+		if (client->used < sizeof(*hdr))
+			return 0;
+		if (hdr->count > ENVY24CTLD_MAX_VALUES)
+			return -EINVAL;
+		size = sizeof(*hdr) + hdr->count * sizeof(int32_t);
+		if (client->used < size)
+			return 0;
+		if (client_request(client, hdr, (const int32_t *)(hdr + 1)) < 0)
+			return -EPIPE;
+		client->used -= size;
+		memmove(client->buffer, client->buffer + size, client->used);
+	}
+}
+
+static void accept_clients(int listen_fd)
+{
+	struct client *client;
+	int fd;
+
+	while ((fd = accept(listen_fd, NULL, NULL)) >= 0) {
+		if (clients_count >= max_clients) {
+			close(fd);
+			continue;
+		}
+		client = &clients[clients_count++];
+		client->fd = fd;
+		client->events = 0;
+		client->used = 0;
+	}
+}
+
+static void broadcast_events(void)
+{
+	snd_ctl_event_t *ev;
+	int idx, class, stream;
+
+	snd_ctl_event_alloca(&ev);
+	while (snd_ctl_read(ctl, ev) > 0) {
+		if (snd_ctl_event_get_type(ev) != SND_CTL_EVENT_ELEM)
+			continue;
+		if (! (snd_ctl_event_elem_get_mask(ev) &
+		       (SND_CTL_EVENT_MASK_VALUE | SND_CTL_EVENT_MASK_INFO)))
+			continue;
+		class = envy24_event_decode(snd_ctl_event_elem_get_interface(ev),
+					    snd_ctl_event_elem_get_name(ev),
+					    snd_ctl_event_elem_get_index(ev),
+					    &stream);
+		if (class == ENVY24_EVENT_NONE)
+			continue;
+		for (idx = 0; idx < clients_count; ) {
+			if ((clients[idx].events & (1U << class)) &&
+			    client_send(&clients[idx], ENVY24CTLD_EVENT, stream, &class, 1) < 0) {
+				client_close(idx);
+				continue;
+			}
+			idx++;
+		}
+	}
+}
+
+static int serve(int listen_fd)
+{
+	struct pollfd *pfds;
+	int ctl_count, count, idx, err;
+	unsigned short revents;
+
+	ctl_count = snd_ctl_poll_descriptors_count(ctl);
+	if (ctl_count < 0)
+		return ctl_count;
+	pfds = malloc((1 + ctl_count + max_clients) * sizeof(*pfds));
+	clients = malloc(max_clients * sizeof(*clients));
+	if (! pfds || ! clients) {
+		free(pfds);
+		free(clients);
+		return -ENOMEM;
+	}
+	while (! quit) {
+		pfds[0].fd = listen_fd;
+		pfds[0].events = POLLIN;
+		snd_ctl_poll_descriptors(ctl, pfds + 1, ctl_count);
+		for (idx = 0; idx < clients_count; idx++) {
+			pfds[1 + ctl_count + idx].fd = clients[idx].fd;
+			pfds[1 + ctl_count + idx].events = POLLIN;
+		}
+		count = clients_count;
+		if (poll(pfds, 1 + ctl_count + count, -1) < 0) {
+			if (errno == EINTR)
+				continue;
+			err = -errno;
+			goto __end;
+		}
+		/* clients first, so that indexes match the poll array */
+		for (idx = count - 1; idx >= 0; idx--) {
+			if (! pfds[1 + ctl_count + idx].revents)
+				continue;
+			if (client_input(&clients[idx]) < 0)
+				client_close(idx);
+		}
+		if (snd_ctl_poll_descriptors_revents(ctl, pfds + 1, ctl_count, &revents) >= 0 &&
+		    (revents & POLLIN))
+			broadcast_events();
+		if (pfds[0].revents & POLLIN)
+			accept_clients(listen_fd);
+	}
+	err = 0;
+      __end:
+	while (clients_count > 0)
+		client_close(clients_count - 1);
+	free(clients);
+	free(pfds);
+	return err;
+}
+
+int main(int argc, char **argv)
+{
+	static struct option long_options[] = {
+		{"device", 1, 0, 'D'},
+		{"card", 1, 0, 'c'},
+		{"socket", 1, 0, 's'},
+		{"max_clients", 1, 0, 'm'},
+		{"nodaemon", 0, 0, 'n'},
+		{ NULL }
+	};
+	char cardname[16], socket_path[sizeof(((struct sockaddr_un *)0)->sun_path)];
+	const char *name = NULL, *path = NULL;
+	int c, card, listen_fd, err, nodaemon = 0;
+
+	while ((c = getopt_long(argc, argv, "D:c:s:m:n", long_options, NULL)) != -1) {
+		switch (c) {
+		case 'D':
+			name = optarg;
+			break;
+		case 'c':
+			card = atoi(optarg);
+			if (card < 0 || card >= MAX_CARD_NUMBERS) {
+				fprintf(stderr, "envy24ctld: invalid card number %d\n", card);
+				exit(EXIT_FAILURE);
+			}
+			sprintf(cardname, "hw:%d", card);
+			name = cardname;
+			break;
+		case 's':
+			path = optarg;
+			break;
+		case 'm':
+			max_clients = atoi(optarg);
+			if (max_clients < 1) {
+				fprintf(stderr, "envy24ctld: invalid number of clients %d\n", max_clients);
+				exit(EXIT_FAILURE);
+			}
+			break;
+		case 'n':
+			nodaemon = 1;
+			break;
+		default:
+			usage();
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	if (open_control(name, &card) < 0)
+		exit(EXIT_FAILURE);
+	if ((err = snd_ctl_subscribe_events(ctl, 1)) < 0) {
+		fprintf(stderr, "snd_ctl_subscribe_events: %s\n", snd_strerror(err));
+		exit(EXIT_FAILURE);
+	}
+	if (! path) {
+		snprintf(socket_path, sizeof(socket_path), ENVY24CTLD_SOCKET, card);
+		path = socket_path;
+	}
+	if ((listen_fd = open_socket(path)) < 0)
+		exit(EXIT_FAILURE);
+
+	if (! nodaemon && daemon(0, 0) < 0) {
+		perror("daemon");
+		exit(EXIT_FAILURE);
+	}
+	signal(SIGINT, signal_handler);
+	signal(SIGTERM, signal_handler);
+	signal(SIGPIPE, SIG_IGN);
+
+	err = serve(listen_fd);
+
+	close(listen_fd);
+	unlink(path);
+	snd_ctl_close(ctl);
+	return err < 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,75 @@
+/*****************************************************************************
+   envy24ctld.h - wire protocol of the envy24 control daemon
+   Copyright (C) 2026 by the ALSA project
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License
+   as published by the Free Software Foundation; either version 2
+   of the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#ifndef __ENVY24CTLD_H
+#define __ENVY24CTLD_H
+
+#include <stdint.h>
+
+/*
+ * Every message is a fixed header followed by count 32-bit values, all
+ * in host byte order (the socket is local).  Each request gets exactly
+ * one reply carrying the same op; arg of a reply is 0 or -errno.
+ * Events are only sent to subscribed clients and may be interleaved
+ * with replies, they always use ENVY24CTLD_EVENT as op.
+ *
+ *   request             arg          values          reply values
+ *   GET_VOLUME          stream       -               left, right
+ *   SET_VOLUME          stream       left, right     -
+ *   GET_SWITCH          stream       -               left, right
+ *   SET_SWITCH          stream       left, right     -
+ *   GET_ROUTE           stream       -               source
+ *   SET_ROUTE           stream       source          -
+ *   GET_CLOCK           -            -               rate
+ *   SET_CLOCK           -            rate            -
+ *   GET_METERS          -            -               ENVY24_PEAKS levels
+ *   SUBSCRIBE           event mask   -               -
+ *
+ *   EVENT               stream       class
+ *
+ * Streams, route sources, clock rates and event classes are the ones of
+ * envy24model.h; a negative left/right in SET_* keeps that channel.  The
+ * SUBSCRIBE mask has bit (1 << class) set for every wanted class, 0
+ * cancels the subscription.
+ */
+
+#define ENVY24CTLD_SOCKET	"/tmp/envy24ctld-%i"
+
+#define ENVY24CTLD_GET_VOLUME	1
+#define ENVY24CTLD_SET_VOLUME	2
+#define ENVY24CTLD_GET_SWITCH	3
+#define ENVY24CTLD_SET_SWITCH	4
+#define ENVY24CTLD_GET_ROUTE	5
+#define ENVY24CTLD_SET_ROUTE	6
+#define ENVY24CTLD_GET_CLOCK	7
+#define ENVY24CTLD_SET_CLOCK	8
+#define ENVY24CTLD_GET_METERS	9
+#define ENVY24CTLD_SUBSCRIBE	10
+#define ENVY24CTLD_EVENT	11
+
+/* upper limit of values in one message */
+#define ENVY24CTLD_MAX_VALUES	32
+
+struct envy24ctld_header {
+	uint16_t op;
+	uint16_t count;		/* number of int32_t values that follow */
+	int32_t arg;		/* stream or mask; status in replies */
+};
+
+#endif /* __ENVY24CTLD_H */
@@ -0,0 +1,466 @@
+/*****************************************************************************
+   envy24model.c - toolkit independent access to the envy24 controls
+   Copyright (C) 2026 by the ALSA project
+   Element access moved here from mixer.c, patchbay.c, hardware.c and
+   volume.c, Copyright (C) 2000 by Jaroslav Kysela <perex@perex.cz>
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License
+   as published by the Free Software Foundation; either version 2
+   of the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+/*
+ * Everything in here talks to the driver only; no widget or toolkit
+ * state is touched, so both the GTK front end and envy24ctld share it.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include "envy24model.h"
+
+#define MULTI_PLAYBACK_SWITCH		"Multi Playback Switch"
+#define MULTI_PLAYBACK_VOLUME		"Multi Playback Volume"
+
+#define HW_MULTI_CAPTURE_SWITCH		"H/W Multi Capture Switch"
+#define IEC958_MULTI_CAPTURE_SWITCH	"IEC958 Multi Capture Switch"
+
+#define HW_MULTI_CAPTURE_VOLUME		"H/W Multi Capture Volume"
+#define IEC958_MULTI_CAPTURE_VOLUME	"IEC958 Multi Capture Volume"
+
+#define SPDIF_PLAYBACK_ROUTE_NAME	"IEC958 Playback Route"
+#define ANALOG_PLAYBACK_ROUTE_NAME	"H/W Playback Route"
+
+#define INTERNAL_CLOCK_NAME		"Multi Track Internal Clock"
+#define INTERNAL_CLOCK_DEFAULT_NAME	"Multi Track Internal Clock Default"
+#define WORD_CLOCK_SYNC_NAME		"Word Clock Sync"
+#define WORD_CLOCK_STATUS_NAME		"Word Clock Status"
+
+#define DAC_VOLUME_NAME			"DAC Volume"
+#define ADC_VOLUME_NAME			"ADC Volume"
+#define IPGA_VOLUME_NAME		"IPGA Analog Capture Volume"
+#define DAC_SENSE_NAME			"Output Sensitivity Switch"
+#define ADC_SENSE_NAME			"Input Sensitivity Switch"
+
+#define MULTI_TRACK_PEAK_NAME		"Multi Track Peak"
+
+/* the peak meter moved from MIXER to PCM in newer drivers */
+static snd_ctl_elem_iface_t peaks_iface = SND_CTL_ELEM_IFACE_PCM;
+
+static int stream_valid(int stream)
+{
+	return stream >= 1 && stream <= ENVY24_MIXER_STREAMS;
+}
+
+static void stream_elem(snd_ctl_elem_value_t *val, int stream, int volume)
+{
+	const char *name;
+
+	if (stream <= MAX_PCM_OUTPUT_CHANNELS + MAX_SPDIF_CHANNELS)
+		name = volume ? MULTI_PLAYBACK_VOLUME : MULTI_PLAYBACK_SWITCH;
+	else if (stream <= MAX_PCM_OUTPUT_CHANNELS + MAX_SPDIF_CHANNELS + MAX_INPUT_CHANNELS)
+		name = volume ? HW_MULTI_CAPTURE_VOLUME : HW_MULTI_CAPTURE_SWITCH;
+	else
+		name = volume ? IEC958_MULTI_CAPTURE_VOLUME : IEC958_MULTI_CAPTURE_SWITCH;
+	snd_ctl_elem_value_set_interface(val, SND_CTL_ELEM_IFACE_MIXER);
+	snd_ctl_elem_value_set_name(val, name);
+	snd_ctl_elem_value_set_index(val, stream <= 18 ? (stream - 1) % 10 : (stream - 1) % 18);
+}
+
+static void route_elem(snd_ctl_elem_value_t *val, int stream)
+{
+	snd_ctl_elem_value_set_interface(val, SND_CTL_ELEM_IFACE_MIXER);
+	if (stream > MAX_OUTPUT_CHANNELS) {
+		snd_ctl_elem_value_set_name(val, SPDIF_PLAYBACK_ROUTE_NAME);
+		snd_ctl_elem_value_set_index(val, stream - MAX_OUTPUT_CHANNELS - 1);
+	} else {
+		snd_ctl_elem_value_set_name(val, ANALOG_PLAYBACK_ROUTE_NAME);
+		snd_ctl_elem_value_set_index(val, stream - 1);
+	}
+}
+
+static int stereo_get(snd_ctl_t *ctl, int stream, int volume, int *left, int *right)
+{
+	snd_ctl_elem_value_t *val;
+	int err;
+
+	if (!stream_valid(stream))
+		return -EINVAL;
+	snd_ctl_elem_value_alloca(&val);
+	stream_elem(val, stream, volume);
+	if ((err = snd_ctl_elem_read(ctl, val)) < 0)
+		return err;
+	if (volume) {
+		*left = snd_ctl_elem_value_get_integer(val, 0);
+		*right = snd_ctl_elem_value_get_integer(val, 1);
+	} else {
+		*left = snd_ctl_elem_value_get_boolean(val, 0);
+		*right = snd_ctl_elem_value_get_boolean(val, 1);
+	}
+	return 0;
+}
+
+/*
+ * A negative left/right keeps that channel; the element is written only
+ * when a channel really changes.  Returns 1 after a write, 0 when nothing
+ * had to be done, or a negative error code.
+ */
+static int stereo_set(snd_ctl_t *ctl, int stream, int volume, int left, int right)
+{
+	snd_ctl_elem_value_t *val;
+	int err, ch, v[2], changed = 0;
+
+	if (!stream_valid(stream))
+		return -EINVAL;
+	snd_ctl_elem_value_alloca(&val);
+	stream_elem(val, stream, volume);
+	if ((err = snd_ctl_elem_read(ctl, val)) < 0)
+		return err;
+	v[0] = left;
+	v[1] = right;
+	for (ch = 0; ch < 2; ch++) {
+		if (v[ch] < 0)
+			continue;
+		if (volume) {
+			if (snd_ctl_elem_value_get_integer(val, ch) == v[ch])
+				continue;
+			snd_ctl_elem_value_set_integer(val, ch, v[ch]);
+		} else {
+			if (snd_ctl_elem_value_get_boolean(val, ch) == !!v[ch])
+				continue;
+			snd_ctl_elem_value_set_boolean(val, ch, !!v[ch]);
+		}
+		changed = 1;
+	}
+	if (!changed)
+		return 0;
+	if ((err = snd_ctl_elem_write(ctl, val)) < 0)
+		return err;
+	return 1;
+}
+
+int envy24_volume_get(snd_ctl_t *ctl, int stream, int *left, int *right)
+{
+	return stereo_get(ctl, stream, 1, left, right);
+}
+
+int envy24_volume_set(snd_ctl_t *ctl, int stream, int left, int right)
+{
+	return stereo_set(ctl, stream, 1, left, right);
+}
+
+int envy24_switch_get(snd_ctl_t *ctl, int stream, int *left, int *right)
+{
+	return stereo_get(ctl, stream, 0, left, right);
+}
+
+int envy24_switch_set(snd_ctl_t *ctl, int stream, int left, int right)
+{
+	return stereo_set(ctl, stream, 0, left, right);
+}
+
+/* returns the route source (ENVY24_ROUTE_*) of an output or an error */
+int envy24_route_get(snd_ctl_t *ctl, int stream)
+{
+	snd_ctl_elem_value_t *val;
+	int err;
+
+	if (stream < 1 || stream > ENVY24_ROUTE_STREAMS)
+		return -EINVAL;
+	snd_ctl_elem_value_alloca(&val);
+	route_elem(val, stream);
+	if ((err = snd_ctl_elem_read(ctl, val)) < 0)
+		return err;
+	return snd_ctl_elem_value_get_enumerated(val, 0);
+}
+
+int envy24_route_set(snd_ctl_t *ctl, int stream, int source)
+{
+	snd_ctl_elem_value_t *val;
+
+	if (stream < 1 || stream > ENVY24_ROUTE_STREAMS)
+		return -EINVAL;
+	if (source < 0 || source > ENVY24_ROUTE_MIXER)
+		return -EINVAL;
+	snd_ctl_elem_value_alloca(&val);
+	route_elem(val, stream);
+	snd_ctl_elem_value_set_enumerated(val, 0, source);
+	return snd_ctl_elem_write(ctl, val);
+}
+
+static void mixer_elem(snd_ctl_elem_value_t *val, const char *name, int index)
+{
+	snd_ctl_elem_value_set_interface(val, SND_CTL_ELEM_IFACE_MIXER);
+	snd_ctl_elem_value_set_name(val, name);
+	snd_ctl_elem_value_set_index(val, index);
+}
+
+static int enumerated_get(snd_ctl_t *ctl, const char *name, int index)
+{
+	snd_ctl_elem_value_t *val;
+	int err;
+
+	snd_ctl_elem_value_alloca(&val);
+	mixer_elem(val, name, index);
+	if ((err = snd_ctl_elem_read(ctl, val)) < 0)
+		return err;
+	return snd_ctl_elem_value_get_enumerated(val, 0);
+}
+
+static int enumerated_set(snd_ctl_t *ctl, const char *name, int index, int item)
+{
+	snd_ctl_elem_value_t *val;
+
+	snd_ctl_elem_value_alloca(&val);
+	mixer_elem(val, name, index);
+	snd_ctl_elem_value_set_enumerated(val, 0, item);
+	return snd_ctl_elem_write(ctl, val);
+}
+
+static int boolean_get(snd_ctl_t *ctl, const char *name)
+{
+	snd_ctl_elem_value_t *val;
+	int err;
+
+	snd_ctl_elem_value_alloca(&val);
+	mixer_elem(val, name, 0);
+	if ((err = snd_ctl_elem_read(ctl, val)) < 0)
+		return err;
+	return snd_ctl_elem_value_get_boolean(val, 0);
+}
+
+/* returns the "Multi Track Internal Clock" enumeration value */
+int envy24_clock_get(snd_ctl_t *ctl)
+{
+	return enumerated_get(ctl, INTERNAL_CLOCK_NAME, 0);
+}
+
+int envy24_clock_set(snd_ctl_t *ctl, int rate)
+{
+	if (rate < 0 || rate > ENVY24_CLOCK_EXTERNAL)
+		return -EINVAL;
+	return enumerated_set(ctl, INTERNAL_CLOCK_NAME, 0, rate);
+}
+
+/* rate the card falls back to when no stream is running */
+int envy24_clock_default_get(snd_ctl_t *ctl)
+{
+	return enumerated_get(ctl, INTERNAL_CLOCK_DEFAULT_NAME, 0);
+}
+
+/*
+ * With an external clock, 1 selects the word clock input and 0 the
+ * S/PDIF input.  Only the Delta 1010 and 1010LT have the element.
+ */
+int envy24_word_clock_get(snd_ctl_t *ctl)
+{
+	return boolean_get(ctl, WORD_CLOCK_SYNC_NAME);
+}
+
+int envy24_word_clock_set(snd_ctl_t *ctl, int on)
+{
+	snd_ctl_elem_value_t *val;
+
+	snd_ctl_elem_value_alloca(&val);
+	mixer_elem(val, WORD_CLOCK_SYNC_NAME, 0);
+	snd_ctl_elem_value_set_boolean(val, 0, on ? 1 : 0);
+	return snd_ctl_elem_write(ctl, val);
+}
+
+/* 1 if a word clock signal is present, the driver reports "no signal" */
+int envy24_word_clock_locked(snd_ctl_t *ctl)
+{
+	int err;
+
+	if ((err = boolean_get(ctl, WORD_CLOCK_STATUS_NAME)) < 0)
+		return err;
+	return !err;
+}
+
+static const char *analog_name(int type)
+{
+	switch (type) {
+	case ENVY24_ANALOG_DAC:
+		return DAC_VOLUME_NAME;
+	case ENVY24_ANALOG_ADC:
+		return ADC_VOLUME_NAME;
+	case ENVY24_ANALOG_IPGA:
+		return IPGA_VOLUME_NAME;
+	}
+	return NULL;
+}
+
+/* returns the maximum of an analog converter volume, or an error if it is missing */
+int envy24_analog_max(snd_ctl_t *ctl, int type, int idx)
+{
+	snd_ctl_elem_info_t *info;
+	int err;
+
+	if (analog_name(type) == NULL)
+		return -EINVAL;
+	snd_ctl_elem_info_alloca(&info);
+	snd_ctl_elem_info_set_interface(info, SND_CTL_ELEM_IFACE_MIXER);
+	snd_ctl_elem_info_set_name(info, analog_name(type));
+	snd_ctl_elem_info_set_index(info, idx);
+	if ((err = snd_ctl_elem_info(ctl, info)) < 0)
+		return err;
+	return snd_ctl_elem_info_get_max(info);
+}
+
+int envy24_analog_get(snd_ctl_t *ctl, int type, int idx)
+{
+	snd_ctl_elem_value_t *val;
+	int err;
+
+	if (analog_name(type) == NULL)
+		return -EINVAL;
+	snd_ctl_elem_value_alloca(&val);
+	mixer_elem(val, analog_name(type), idx);
+	if ((err = snd_ctl_elem_read(ctl, val)) < 0)
+		return err;
+	return snd_ctl_elem_value_get_integer(val, 0);
+}
+
+int envy24_analog_set(snd_ctl_t *ctl, int type, int idx, int value)
+{
+	snd_ctl_elem_value_t *val;
+
+	if (analog_name(type) == NULL)
+		return -EINVAL;
+	snd_ctl_elem_value_alloca(&val);
+	mixer_elem(val, analog_name(type), idx);
+	snd_ctl_elem_value_set_integer(val, 0, value);
+	return snd_ctl_elem_write(ctl, val);
+}
+
+static const char *sense_name(int type)
+{
+	return type == ENVY24_SENSE_DAC ? DAC_SENSE_NAME : ADC_SENSE_NAME;
+}
+
+/* returns the number of sensitivity settings, or an error if the switch is missing */
+int envy24_sense_items(snd_ctl_t *ctl, int type, int idx)
+{
+	snd_ctl_elem_info_t *info;
+	int err;
+
+	snd_ctl_elem_info_alloca(&info);
+	snd_ctl_elem_info_set_interface(info, SND_CTL_ELEM_IFACE_MIXER);
+	snd_ctl_elem_info_set_name(info, sense_name(type));
+	snd_ctl_elem_info_set_index(info, idx);
+	if ((err = snd_ctl_elem_info(ctl, info)) < 0)
+		return err;
+	return snd_ctl_elem_info_get_items(info);
+}
+
+int envy24_sense_item_name(snd_ctl_t *ctl, int type, int item, char *name, size_t size)
+{
+	snd_ctl_elem_info_t *info;
+	int err;
+
+	snd_ctl_elem_info_alloca(&info);
+	snd_ctl_elem_info_set_interface(info, SND_CTL_ELEM_IFACE_MIXER);
+	snd_ctl_elem_info_set_name(info, sense_name(type));
+	snd_ctl_elem_info_set_item(info, item);
+	if ((err = snd_ctl_elem_info(ctl, info)) < 0)
+		return err;
+	snprintf(name, size, "%s", snd_ctl_elem_info_get_item_name(info));
+	return 0;
+}
+
+int envy24_sense_get(snd_ctl_t *ctl, int type, int idx)
+{
+	return enumerated_get(ctl, sense_name(type), idx);
+}
+
+int envy24_sense_set(snd_ctl_t *ctl, int type, int idx, int state)
+{
+	return enumerated_set(ctl, sense_name(type), idx, state);
+}
+
+/*
+ * Reads up to count peak levels (ENVY24_PEAKS at most) with a single
+ * element read; returns the number of levels stored.
+ */
+int envy24_peaks_read(snd_ctl_t *ctl, int *levels, int count)
+{
+	snd_ctl_elem_value_t *val;
+	int err, idx;
+
+	if (count > ENVY24_PEAKS)
+		count = ENVY24_PEAKS;
+	snd_ctl_elem_value_alloca(&val);
+	snd_ctl_elem_value_set_interface(val, peaks_iface);
+	snd_ctl_elem_value_set_name(val, MULTI_TRACK_PEAK_NAME);
+	if ((err = snd_ctl_elem_read(ctl, val)) < 0) {
+		if (peaks_iface != SND_CTL_ELEM_IFACE_PCM)
+			return err;
+		/* older ALSA driver, using MIXER type */
+		peaks_iface = SND_CTL_ELEM_IFACE_MIXER;
+		snd_ctl_elem_value_set_interface(val, peaks_iface);
+		if ((err = snd_ctl_elem_read(ctl, val)) < 0)
+			return err;
+	}
+	for (idx = 0; idx < count; idx++)
+		levels[idx] = snd_ctl_elem_value_get_integer(val, idx);
+	return count;
+}
+
+/*
+ * Maps a control event to the class of model state it affects.  *stream
+ * gets the mixer or route stream number (0 for the clock).
+ */
+int envy24_event_decode(snd_ctl_elem_iface_t iface, const char *name,
+			int index, int *stream)
+{
+	*stream = 0;
+	if (iface != SND_CTL_ELEM_IFACE_MIXER)
+		return ENVY24_EVENT_NONE;
+	if (!strcmp(name, MULTI_PLAYBACK_VOLUME)) {
+		*stream = index + 1;
+		return ENVY24_EVENT_VOLUME;
+	}
+	if (!strcmp(name, HW_MULTI_CAPTURE_VOLUME)) {
+		*stream = index + 11;
+		return ENVY24_EVENT_VOLUME;
+	}
+	if (!strcmp(name, IEC958_MULTI_CAPTURE_VOLUME)) {
+		*stream = index + 19;
+		return ENVY24_EVENT_VOLUME;
+	}
+	if (!strcmp(name, MULTI_PLAYBACK_SWITCH)) {
+		*stream = index + 1;
+		return ENVY24_EVENT_SWITCH;
+	}
+	if (!strcmp(name, HW_MULTI_CAPTURE_SWITCH)) {
+		*stream = index + 11;
+		return ENVY24_EVENT_SWITCH;
+	}
+	if (!strcmp(name, IEC958_MULTI_CAPTURE_SWITCH)) {
+		*stream = index + 19;
+		return ENVY24_EVENT_SWITCH;
+	}
+	if (!strcmp(name, ANALOG_PLAYBACK_ROUTE_NAME)) {
+		*stream = index + 1;
+		return ENVY24_EVENT_ROUTE;
+	}
+	if (!strcmp(name, SPDIF_PLAYBACK_ROUTE_NAME)) {
+		*stream = index + MAX_OUTPUT_CHANNELS + 1;
+		return ENVY24_EVENT_ROUTE;
+	}
+	if (!strcmp(name, INTERNAL_CLOCK_NAME) ||
+	    !strcmp(name, INTERNAL_CLOCK_DEFAULT_NAME) ||
+	    !strcmp(name, WORD_CLOCK_SYNC_NAME))
+		return ENVY24_EVENT_CLOCK;
+	return ENVY24_EVENT_NONE;
+}
@@ -0,0 +1,96 @@
+/*****************************************************************************
+   envy24model.h - toolkit independent access to the envy24 controls
+   Copyright (C) 2026 by the ALSA project
+   Element access moved here from mixer.c, patchbay.c, hardware.c and
+   volume.c, Copyright (C) 2000 by Jaroslav Kysela <perex@perex.cz>
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License
+   as published by the Free Software Foundation; either version 2
+   of the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+#ifndef __ENVY24MODEL_H
+#define __ENVY24MODEL_H
+
+#include <alsa/asoundlib.h>
+
+/* max number of HW input/output channels (analog lines)
+ * the number of available HW input/output channels is defined
+ * at 'adcs/dacs' in the driver
+ */
+/* max number of HW input channels (analog lines) */
+#define MAX_INPUT_CHANNELS	8
+/* max number of HW output channels (analog lines) */
+#define MAX_OUTPUT_CHANNELS	8
+/* max number of spdif input/output channels */
+#define MAX_SPDIF_CHANNELS	2
+/* max number of PCM output channels */
+#define MAX_PCM_OUTPUT_CHANNELS	8
+
+/* mixer streams are numbered from 1:
+ *  1-8 PCM out, 9-10 S/PDIF out, 11-18 H/W in, 19-20 S/PDIF in
+ */
+#define ENVY24_MIXER_STREAMS	(MAX_PCM_OUTPUT_CHANNELS + MAX_SPDIF_CHANNELS + \
+				 MAX_INPUT_CHANNELS + MAX_SPDIF_CHANNELS)
+/* routed outputs are numbered from 1: 1-8 H/W out, 9-10 S/PDIF out */
+#define ENVY24_ROUTE_STREAMS	(MAX_OUTPUT_CHANNELS + MAX_SPDIF_CHANNELS)
+/* peak meters: one per mixer stream plus the digital mixer L/R */
+#define ENVY24_PEAKS		(ENVY24_MIXER_STREAMS + 2)
+
+/* route sources as enumerated by the driver */
+#define ENVY24_ROUTE_PCM	0
+#define ENVY24_ROUTE_ANALOG	1	/* 1-8 */
+#define ENVY24_ROUTE_SPDIF	(MAX_INPUT_CHANNELS + 1)	/* 9-10 */
+#define ENVY24_ROUTE_MIXER	(MAX_INPUT_CHANNELS + MAX_SPDIF_CHANNELS + 1)
+
+/* internal clock enumeration value meaning "external" (S/PDIF, word clock) */
+#define ENVY24_CLOCK_EXTERNAL	13
+
+/* analog converter volumes and sensitivity switches, not on every model */
+#define ENVY24_ANALOG_DAC	0
+#define ENVY24_ANALOG_ADC	1
+#define ENVY24_ANALOG_IPGA	2
+#define ENVY24_SENSE_DAC	0
+#define ENVY24_SENSE_ADC	1
+
+/* control classes reported by envy24_event_decode() */
+#define ENVY24_EVENT_NONE	0
+#define ENVY24_EVENT_VOLUME	1
+#define ENVY24_EVENT_SWITCH	2
+#define ENVY24_EVENT_ROUTE	3
+#define ENVY24_EVENT_CLOCK	4
+
+int envy24_volume_get(snd_ctl_t *ctl, int stream, int *left, int *right);
+int envy24_volume_set(snd_ctl_t *ctl, int stream, int left, int right);
+int envy24_switch_get(snd_ctl_t *ctl, int stream, int *left, int *right);
+int envy24_switch_set(snd_ctl_t *ctl, int stream, int left, int right);
+int envy24_route_get(snd_ctl_t *ctl, int stream);
+int envy24_route_set(snd_ctl_t *ctl, int stream, int source);
+int envy24_clock_get(snd_ctl_t *ctl);
+int envy24_clock_set(snd_ctl_t *ctl, int rate);
+int envy24_clock_default_get(snd_ctl_t *ctl);
+int envy24_word_clock_get(snd_ctl_t *ctl);
+int envy24_word_clock_set(snd_ctl_t *ctl, int on);
+int envy24_word_clock_locked(snd_ctl_t *ctl);
+int envy24_analog_max(snd_ctl_t *ctl, int type, int idx);
+int envy24_analog_get(snd_ctl_t *ctl, int type, int idx);
+int envy24_analog_set(snd_ctl_t *ctl, int type, int idx, int value);
+int envy24_sense_items(snd_ctl_t *ctl, int type, int idx);
+int envy24_sense_item_name(snd_ctl_t *ctl, int type, int item, char *name, size_t size);
+int envy24_sense_get(snd_ctl_t *ctl, int type, int idx);
+int envy24_sense_set(snd_ctl_t *ctl, int type, int idx, int state);
+int envy24_peaks_read(snd_ctl_t *ctl, int *levels, int count);
+int envy24_event_decode(snd_ctl_elem_iface_t iface, const char *name,
+			int index, int *stream);
+
+#endif /* __ENVY24MODEL_H */
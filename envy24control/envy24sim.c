@@ -0,0 +1,660 @@
+/*****************************************************************************
+   envy24sim.c - simulated ICE1712 control plugin
+   Copyright (C) 2026 by the ALSA project
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License
+   as published by the Free Software Foundation; either version 2
+   of the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+/*
+ * An external ctl plugin which looks like a Delta 1010 to envy24control,
+ * envy24ctld and any other ctl client, so that they can be run without
+ * the hardware.  Add to ~/.asoundrc
+ *
+ *	ctl.envy24sim {
+ *		type envy24sim
+ *		# subvendor 0x121430d6	# EEPROM subvendor id to report
+ *	}
+ *
+ * and use "-D envy24sim".  All handles a process opens on the same
+ * device share one card, like handles of a real card do, so the profiles
+ * of envy24control see the mixer state; every process gets its own card.
+ * Writes raise value events on all subscribed handles of the card like
+ * the driver does, and the peak meters produce a synthetic signal scaled
+ * by the mixer volume and mute of each stream.  Like alsa-lib itself, the
+ * handles of one card must not be used from different threads at once.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <alsa/asoundlib.h>
+#include <alsa/control_external.h>
+
+#include "envy24model.h"
+
+#define ICE1712_SUBDEVICE_DELTA1010	0x121430d6
+
+#define ICE1712_EEPROM_SIZE	32
+#define PEAK_MAX		255
+#define VOLUME_MAX		96
+
+static const char * const route_texts[] = {
+	"PCM Out",
+	"H/W In 0", "H/W In 1", "H/W In 2", "H/W In 3",
+	"H/W In 4", "H/W In 5", "H/W In 6", "H/W In 7",
+	"IEC958 In L", "IEC958 In R",
+	"Digital Mixer",
+};
+
+static const char * const clock_texts[] = {
+	"8000", "9600", "11025", "12000", "16000", "22050", "24000",
+	"32000", "44100", "48000", "64000", "88200", "96000",
+	"IEC958 Input",
+};
+
+struct sim_template {
+	snd_ctl_elem_iface_t iface;
+	const char *name;
+	unsigned int indexes;
+	int type;
+	unsigned int access;
+	unsigned int count;
+	long max;			/* integer max or number of items */
+	const char * const *texts;
+	long init;
+};
+
+#define RW	SND_CTL_EXT_ACCESS_READWRITE
+#define RO	(SND_CTL_EXT_ACCESS_READ | SND_CTL_EXT_ACCESS_VOLATILE)
+
+static const struct sim_template templates[] = {
+	{ SND_CTL_ELEM_IFACE_CARD, "ICE1712 EEPROM", 1,
+	  SND_CTL_ELEM_TYPE_BYTES, SND_CTL_EXT_ACCESS_READ, ICE1712_EEPROM_SIZE, 0, NULL, 0 },
+	{ SND_CTL_ELEM_IFACE_MIXER, "Multi Playback Switch", MAX_PCM_OUTPUT_CHANNELS + MAX_SPDIF_CHANNELS,
+	  SND_CTL_ELEM_TYPE_BOOLEAN, RW, 2, 1, NULL, 1 },
+	{ SND_CTL_ELEM_IFACE_MIXER, "Multi Playback Volume", MAX_PCM_OUTPUT_CHANNELS + MAX_SPDIF_CHANNELS,
+	  SND_CTL_ELEM_TYPE_INTEGER, RW, 2, VOLUME_MAX, NULL, VOLUME_MAX },
+	{ SND_CTL_ELEM_IFACE_MIXER, "H/W Multi Capture Switch", MAX_INPUT_CHANNELS,
+	  SND_CTL_ELEM_TYPE_BOOLEAN, RW, 2, 1, NULL, 1 },
+	{ SND_CTL_ELEM_IFACE_MIXER, "H/W Multi Capture Volume", MAX_INPUT_CHANNELS,
+	  SND_CTL_ELEM_TYPE_INTEGER, RW, 2, VOLUME_MAX, NULL, VOLUME_MAX },
+	{ SND_CTL_ELEM_IFACE_MIXER, "IEC958 Multi Capture Switch", MAX_SPDIF_CHANNELS,
+	  SND_CTL_ELEM_TYPE_BOOLEAN, RW, 2, 1, NULL, 1 },
+	{ SND_CTL_ELEM_IFACE_MIXER, "IEC958 Multi Capture Volume", MAX_SPDIF_CHANNELS,
+	  SND_CTL_ELEM_TYPE_INTEGER, RW, 2, VOLUME_MAX, NULL, VOLUME_MAX },
+	{ SND_CTL_ELEM_IFACE_MIXER, "H/W Playback Route", MAX_OUTPUT_CHANNELS,
+	  SND_CTL_ELEM_TYPE_ENUMERATED, RW, 1, 12, route_texts, ENVY24_ROUTE_PCM },
+	{ SND_CTL_ELEM_IFACE_MIXER, "IEC958 Playback Route", MAX_SPDIF_CHANNELS,
+	  SND_CTL_ELEM_TYPE_ENUMERATED, RW, 1, 12, route_texts, ENVY24_ROUTE_PCM },
+	{ SND_CTL_ELEM_IFACE_MIXER, "Multi Track Internal Clock", 1,
+	  SND_CTL_ELEM_TYPE_ENUMERATED, RW, 1, 14, clock_texts, 8 },
+	{ SND_CTL_ELEM_IFACE_MIXER, "Multi Track Internal Clock Default", 1,
+	  SND_CTL_ELEM_TYPE_ENUMERATED, RW, 1, 13, clock_texts, 8 },
+	{ SND_CTL_ELEM_IFACE_MIXER, "Multi Track Rate Locking", 1,
+	  SND_CTL_ELEM_TYPE_BOOLEAN, RW, 1, 1, NULL, 0 },
+	{ SND_CTL_ELEM_IFACE_MIXER, "Multi Track Rate Reset", 1,
+	  SND_CTL_ELEM_TYPE_BOOLEAN, RW, 1, 1, NULL, 1 },
+	{ SND_CTL_ELEM_IFACE_MIXER, "Multi Track Volume Rate", 1,
+	  SND_CTL_ELEM_TYPE_INTEGER, RW, 1, 255, NULL, 0 },
+	{ SND_CTL_ELEM_IFACE_MIXER, "Word Clock Sync", 1,
+	  SND_CTL_ELEM_TYPE_BOOLEAN, RW, 1, 1, NULL, 0 },
+	{ SND_CTL_ELEM_IFACE_MIXER, "Word Clock Status", 1,
+	  SND_CTL_ELEM_TYPE_BOOLEAN, RO, 1, 1, NULL, 1 },	/* no signal */
+	{ SND_CTL_ELEM_IFACE_MIXER, "IEC958 Input Optical", 1,
+	  SND_CTL_ELEM_TYPE_BOOLEAN, RW, 1, 1, NULL, 0 },
+	{ SND_CTL_ELEM_IFACE_PCM, "IEC958 Playback Default", 1,
+	  SND_CTL_ELEM_TYPE_IEC958, RW, 1, 0, NULL, 0 },
+	{ SND_CTL_ELEM_IFACE_PCM, "Multi Track Peak", 1,
+	  SND_CTL_ELEM_TYPE_INTEGER, RO, ENVY24_PEAKS, PEAK_MAX, NULL, 0 },
+};
+
+struct sim_elem {
+	const struct sim_template *tmpl;
+	unsigned int index;
+	long value[2];
+	unsigned char bytes[sizeof(snd_aes_iec958_t)];
+};
+
+struct envy24sim;
+
+/* the simulated card, shared by all handles of the device in a process */
+struct sim_card {
+	char *name;
+	unsigned int subvendor;
+	struct sim_elem *elems;
+	unsigned int count;
+	int volume_key[ENVY24_MIXER_STREAMS];
+	int switch_key[ENVY24_MIXER_STREAMS];
+	int peak_key;
+	struct envy24sim *handles;
+	struct sim_card *next;
+};
+
+struct envy24sim {
+	snd_ctl_ext_t ext;
+	struct sim_card *card;
+	unsigned char *pending;		/* value events not read yet, per element */
+	unsigned int cursor;		/* where read_event continues */
+	int fds[2];			/* wakes up poll() on pending events */
+	struct envy24sim *next;		/* next handle of the card */
+};
+
+static struct sim_card *sim_cards;
+
+static int sim_lookup(struct sim_card *sim, snd_ctl_elem_iface_t iface,
+		      const char *name, unsigned int index)
+{
+	unsigned int key;
+
+	for (key = 0; key < sim->count; key++) {
+		if (sim->elems[key].tmpl->iface == iface &&
+		    sim->elems[key].index == index &&
+		    !strcmp(sim->elems[key].tmpl->name, name))
+			return key;
+	}
+	return -ENOENT;
+}
+
+/* maps a mixer stream (0-based) to its element name and index */
+static void sim_stream_elem(int stream, int volume, const char **name, unsigned int *index)
+{
+	if (stream < MAX_PCM_OUTPUT_CHANNELS + MAX_SPDIF_CHANNELS) {
+		*name = volume ? "Multi Playback Volume" : "Multi Playback Switch";
+		*index = stream;
+	} else if (stream < MAX_PCM_OUTPUT_CHANNELS + MAX_SPDIF_CHANNELS + MAX_INPUT_CHANNELS) {
+		*name = volume ? "H/W Multi Capture Volume" : "H/W Multi Capture Switch";
+		*index = stream - MAX_PCM_OUTPUT_CHANNELS - MAX_SPDIF_CHANNELS;
+	} else {
+		*name = volume ? "IEC958 Multi Capture Volume" : "IEC958 Multi Capture Switch";
+		*index = stream - MAX_PCM_OUTPUT_CHANNELS - MAX_SPDIF_CHANNELS - MAX_INPUT_CHANNELS;
+	}
+}
+
+static int sim_build(struct sim_card *sim)
+{
+	const struct sim_template *tmpl;
+	struct sim_elem *elem;
+	const char *name;
+	unsigned int t, idx, count = 0;
+	int stream;
+
+	for (t = 0; t < sizeof(templates) / sizeof(templates[0]); t++)
+		count += templates[t].indexes;
+	sim->elems = calloc(count, sizeof(*sim->elems));
+	if (! sim->elems)
+		return -ENOMEM;
+	elem = sim->elems;
+	for (t = 0; t < sizeof(templates) / sizeof(templates[0]); t++) {
+		tmpl = &templates[t];
+		for (idx = 0; idx < tmpl->indexes; idx++, elem++) {
+			elem->tmpl = tmpl;
+			elem->index = idx;
+			elem->value[0] = elem->value[1] = tmpl->init;
+		}
+	}
+	sim->count = count;
+
+	/* EEPROM image: just enough for envy24control to pick the model */
+	idx = sim_lookup(sim, SND_CTL_ELEM_IFACE_CARD, "ICE1712 EEPROM", 0);
+	memcpy(sim->elems[idx].bytes, &sim->subvendor, sizeof(sim->subvendor));
+	sim->elems[idx].bytes[4] = ICE1712_EEPROM_SIZE;
+	sim->elems[idx].bytes[5] = 1;
+
+	for (stream = 0; stream < ENVY24_MIXER_STREAMS; stream++) {
+		sim_stream_elem(stream, 1, &name, &idx);
+		sim->volume_key[stream] = sim_lookup(sim, SND_CTL_ELEM_IFACE_MIXER, name, idx);
+		sim_stream_elem(stream, 0, &name, &idx);
+		sim->switch_key[stream] = sim_lookup(sim, SND_CTL_ELEM_IFACE_MIXER, name, idx);
+	}
+	sim->peak_key = sim_lookup(sim, SND_CTL_ELEM_IFACE_PCM, "Multi Track Peak", 0);
+	return 0;
+}
+
+static void sim_changed(struct envy24sim *writer, unsigned int key)
+{
+	struct envy24sim *sim;
+	char c = 0;
+
+	for (sim = writer->card->handles; sim; sim = sim->next) {
+		if (! sim->ext.subscribed || sim->pending[key])
+			continue;
+		sim->pending[key] = 1;
+		if (write(sim->fds[1], &c, 1) < 0)
+			SNDERR("envy24sim: cannot queue event: %s", strerror(errno));
+	}
+}
+
+static struct sim_card *sim_card_get(const char *name, unsigned int subvendor)
+{
+	struct sim_card *card;
+
+	for (card = sim_cards; card; card = card->next) {
+		if (! strcmp(card->name, name) && card->subvendor == subvendor)
+			return card;
+	}
+	card = calloc(1, sizeof(*card));
+	if (! card)
+		return NULL;
+	card->subvendor = subvendor;
+	card->name = strdup(name);
+	if (! card->name || sim_build(card) < 0) {
+		free(card->name);
+		free(card);
+		return NULL;
+	}
+	card->next = sim_cards;
+	sim_cards = card;
+	return card;
+}
+
+/* the card goes away with its last handle */
+static void sim_card_detach(struct envy24sim *sim)
+{
+	struct sim_card *card = sim->card, **pcard;
+	struct envy24sim **psim;
+
+	for (psim = &card->handles; *psim; psim = &(*psim)->next) {
+		if (*psim == sim) {
+			*psim = sim->next;
+			break;
+		}
+	}
+	if (card->handles)
+		return;
+	for (pcard = &sim_cards; *pcard; pcard = &(*pcard)->next) {
+		if (*pcard == card) {
+			*pcard = card->next;
+			break;
+		}
+	}
+	free(card->elems);
+	free(card->name);
+	free(card);
+}
+
+/*
+ * Synthetic signal: a triangle wave with a different phase per stream,
+ * scaled by the stream volume and silenced by its mute.
+ */
+static long sim_peak(struct sim_card *sim, int stream, int channel, unsigned long ms)
+{
+	const struct sim_elem *vol = &sim->elems[sim->volume_key[stream]];
+	const struct sim_elem *sw = &sim->elems[sim->switch_key[stream]];
+	unsigned long t = (ms / 4 + stream * 37 + channel * 11) % (2 * (PEAK_MAX + 1));
+	long level = t <= PEAK_MAX ? (long)t : (long)(2 * PEAK_MAX + 1 - t);
+
+	if (! sw->value[channel])
+		return 0;
+	return level * vol->value[channel] / VOLUME_MAX;
+}
+
+static void sim_read_peaks(struct sim_card *sim, long *value)
+{
+	struct timespec now;
+	unsigned long ms;
+	int stream;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	ms = now.tv_sec * 1000UL + now.tv_nsec / 1000000;
+	value[ENVY24_MIXER_STREAMS] = value[ENVY24_MIXER_STREAMS + 1] = 0;
+	for (stream = 0; stream < ENVY24_MIXER_STREAMS; stream++) {
+		value[stream] = sim_peak(sim, stream, 0, ms);
+		/* the digital mixer sees the loudest stream of each side */
+		if (value[stream] > value[ENVY24_MIXER_STREAMS])
+			value[ENVY24_MIXER_STREAMS] = value[stream];
+		if (sim_peak(sim, stream, 1, ms) > value[ENVY24_MIXER_STREAMS + 1])
+			value[ENVY24_MIXER_STREAMS + 1] = sim_peak(sim, stream, 1, ms);
+	}
+}
+
+static void envy24sim_close(snd_ctl_ext_t *ext)
+{
+	struct envy24sim *sim = ext->private_data;
+
+	sim_card_detach(sim);
+	close(sim->fds[0]);
+	close(sim->fds[1]);
+	free(sim->pending);
+	free(sim);
+}
+
+static int envy24sim_elem_count(snd_ctl_ext_t *ext)
+{
+	struct envy24sim *sim = ext->private_data;
+
+	return sim->card->count;
+}
+
+static int envy24sim_elem_list(snd_ctl_ext_t *ext, unsigned int offset,
+			       snd_ctl_elem_id_t *id)
+{
+	struct envy24sim *sim = ext->private_data;
+
+	if (offset >= sim->card->count)
+		return -EINVAL;
+	snd_ctl_elem_id_set_interface(id, sim->card->elems[offset].tmpl->iface);
+	snd_ctl_elem_id_set_name(id, sim->card->elems[offset].tmpl->name);
+	snd_ctl_elem_id_set_index(id, sim->card->elems[offset].index);
+	return 0;
+}
+
+static snd_ctl_ext_key_t envy24sim_find_elem(snd_ctl_ext_t *ext,
+					     const snd_ctl_elem_id_t *id)
+{
+	struct envy24sim *sim = ext->private_data;
+	unsigned int numid = snd_ctl_elem_id_get_numid(id);
+	int key;
+
+	if (numid > 0 && numid <= sim->card->count)
+		return numid - 1;
+	key = sim_lookup(sim->card, snd_ctl_elem_id_get_interface(id),
+			 snd_ctl_elem_id_get_name(id),
+			 snd_ctl_elem_id_get_index(id));
+	return key < 0 ? SND_CTL_EXT_KEY_NOT_FOUND : (snd_ctl_ext_key_t)key;
+}
+
+static int envy24sim_get_attribute(snd_ctl_ext_t *ext, snd_ctl_ext_key_t key,
+				   int *type, unsigned int *acc,
+				   unsigned int *count)
+{
+	struct envy24sim *sim = ext->private_data;
+
+	if (key >= sim->card->count)
+		return -EINVAL;
+	*type = sim->card->elems[key].tmpl->type;
+	*acc = sim->card->elems[key].tmpl->access;
+	*count = sim->card->elems[key].tmpl->count;
+	return 0;
+}
+
+static int envy24sim_get_integer_info(snd_ctl_ext_t *ext, snd_ctl_ext_key_t key,
+				      long *imin, long *imax, long *istep)
+{
+	struct envy24sim *sim = ext->private_data;
+
+	if (key >= sim->card->count)
+		return -EINVAL;
+	*imin = 0;
+	*imax = sim->card->elems[key].tmpl->max;
+	*istep = 1;
+	return 0;
+}
+
+static int envy24sim_get_enumerated_info(snd_ctl_ext_t *ext, snd_ctl_ext_key_t key,
+					 unsigned int *items)
+{
+	struct envy24sim *sim = ext->private_data;
+
+	if (key >= sim->card->count || ! sim->card->elems[key].tmpl->texts)
+		return -EINVAL;
+	*items = sim->card->elems[key].tmpl->max;
+	return 0;
+}
+
+static int envy24sim_get_enumerated_name(snd_ctl_ext_t *ext, snd_ctl_ext_key_t key,
+					 unsigned int item, char *name,
+					 size_t name_max_len)
+{
+	struct envy24sim *sim = ext->private_data;
+
+	if (key >= sim->card->count || ! sim->card->elems[key].tmpl->texts ||
+	    item >= (unsigned int)sim->card->elems[key].tmpl->max)
+		return -EINVAL;
+	snprintf(name, name_max_len, "%s", sim->card->elems[key].tmpl->texts[item]);
+	return 0;
+}
+
+static int envy24sim_read_integer(snd_ctl_ext_t *ext, snd_ctl_ext_key_t key,
+				  long *value)
+{
+	struct envy24sim *sim = ext->private_data;
+
+	if (key >= sim->card->count)
+		return -EINVAL;
+	if ((int)key == sim->card->peak_key) {
+		sim_read_peaks(sim->card, value);
+		return 0;
+	}
+	memcpy(value, sim->card->elems[key].value,
+	       sim->card->elems[key].tmpl->count * sizeof(long));
+	return 0;
+}
+
+static int envy24sim_read_enumerated(snd_ctl_ext_t *ext, snd_ctl_ext_key_t key,
+				     unsigned int *items)
+{
+	struct envy24sim *sim = ext->private_data;
+
+	if (key >= sim->card->count)
+		return -EINVAL;
+	items[0] = sim->card->elems[key].value[0];
+	return 0;
+}
+
+static int envy24sim_read_bytes(snd_ctl_ext_t *ext, snd_ctl_ext_key_t key,
+				unsigned char *data, size_t max_bytes)
+{
+	struct envy24sim *sim = ext->private_data;
+
+	if (key >= sim->card->count)
+		return -EINVAL;
+	if (max_bytes > sim->card->elems[key].tmpl->count)
+		max_bytes = sim->card->elems[key].tmpl->count;
+	memcpy(data, sim->card->elems[key].bytes, max_bytes);
+	return 0;
+}
+
+static int envy24sim_read_iec958(snd_ctl_ext_t *ext, snd_ctl_ext_key_t key,
+				 snd_aes_iec958_t *iec958)
+{
+	struct envy24sim *sim = ext->private_data;
+
+	if (key >= sim->card->count)
+		return -EINVAL;
+	memcpy(iec958, sim->card->elems[key].bytes, sizeof(*iec958));
+	return 0;
+}
+
+static int envy24sim_write_integer(snd_ctl_ext_t *ext, snd_ctl_ext_key_t key,
+				   long *value)
+{
+	struct envy24sim *sim = ext->private_data;
+	struct sim_elem *elem;
+	unsigned int i;
+
+	if (key >= sim->card->count)
+		return -EINVAL;
+	elem = &sim->card->elems[key];
+	if (! (elem->tmpl->access & SND_CTL_EXT_ACCESS_WRITE))
+		return -EPERM;
+	for (i = 0; i < elem->tmpl->count; i++) {
+		if (value[i] < 0 || value[i] > elem->tmpl->max)
+			return -EINVAL;
+	}
+	if (! memcmp(elem->value, value, elem->tmpl->count * sizeof(long)))
+		return 0;
+	memcpy(elem->value, value, elem->tmpl->count * sizeof(long));
+	sim_changed(sim, key);
+	return 1;
+}
+
+static int envy24sim_write_enumerated(snd_ctl_ext_t *ext, snd_ctl_ext_key_t key,
+				      unsigned int *items)
+{
+	struct envy24sim *sim = ext->private_data;
+	struct sim_elem *elem;
+
+	if (key >= sim->card->count)
+		return -EINVAL;
+	elem = &sim->card->elems[key];
+	if (items[0] >= (unsigned int)elem->tmpl->max)
+		return -EINVAL;
+	if (elem->value[0] == (long)items[0])
+		return 0;
+	elem->value[0] = items[0];
+	sim_changed(sim, key);
+	return 1;
+}
+
+static int envy24sim_write_iec958(snd_ctl_ext_t *ext, snd_ctl_ext_key_t key,
+				  snd_aes_iec958_t *iec958)
+{
+	struct envy24sim *sim = ext->private_data;
+
+	if (key >= sim->card->count)
+		return -EINVAL;
+	if (! memcmp(sim->card->elems[key].bytes, iec958, sizeof(*iec958)))
+		return 0;
+	memcpy(sim->card->elems[key].bytes, iec958, sizeof(*iec958));
+	sim_changed(sim, key);
+	return 1;
+}
+
+static void envy24sim_subscribe_events(snd_ctl_ext_t *ext, int subscribe)
+{
+	struct envy24sim *sim = ext->private_data;
+	char c;
+
+	ext->subscribed = !!subscribe;
+	if (subscribe)
+		return;
+	memset(sim->pending, 0, sim->card->count);
+	while (read(sim->fds[0], &c, 1) > 0)
+		;
+}
+
+static int envy24sim_read_event(snd_ctl_ext_t *ext, snd_ctl_elem_id_t *id,
+				unsigned int *event_mask)
+{
+	struct envy24sim *sim = ext->private_data;
+	unsigned int n, key;
+	char c;
+
+	for (n = 0; n < sim->card->count; n++) {
+		key = (sim->cursor + n) % sim->card->count;
+		if (! sim->pending[key])
+			continue;
+		sim->pending[key] = 0;
+		sim->cursor = key + 1;
+		if (read(sim->fds[0], &c, 1) < 0 && errno != EAGAIN)
+			return -errno;
+		snd_ctl_elem_id_set_numid(id, key + 1);
+		envy24sim_elem_list(ext, key, id);
+		*event_mask = SND_CTL_EVENT_MASK_VALUE;
+		return 1;
+	}
+	return -EAGAIN;
+}
+
+static const snd_ctl_ext_callback_t envy24sim_callback = {
+	.close = envy24sim_close,
+	.elem_count = envy24sim_elem_count,
+	.elem_list = envy24sim_elem_list,
+	.find_elem = envy24sim_find_elem,
+	.get_attribute = envy24sim_get_attribute,
+	.get_integer_info = envy24sim_get_integer_info,
+	.get_enumerated_info = envy24sim_get_enumerated_info,
+	.get_enumerated_name = envy24sim_get_enumerated_name,
+	.read_integer = envy24sim_read_integer,
+	.read_enumerated = envy24sim_read_enumerated,
+	.read_bytes = envy24sim_read_bytes,
+	.read_iec958 = envy24sim_read_iec958,
+	.write_integer = envy24sim_write_integer,
+	.write_enumerated = envy24sim_write_enumerated,
+	.write_iec958 = envy24sim_write_iec958,
+	.subscribe_events = envy24sim_subscribe_events,
+	.read_event = envy24sim_read_event,
+};
+
+SND_CTL_PLUGIN_DEFINE_FUNC(envy24sim)
+{
+	snd_config_iterator_t i, next;
+	struct envy24sim *sim;
+	long subvendor = ICE1712_SUBDEVICE_DELTA1010;
+	int err;
+
+	snd_config_for_each(i, next, conf) {
+		snd_config_t *n = snd_config_iterator_entry(i);
+		const char *id;
+		if (snd_config_get_id(n, &id) < 0)
+			continue;
+		if (strcmp(id, "comment") == 0 || strcmp(id, "type") == 0 ||
+		    strcmp(id, "hint") == 0)
+			continue;
+		if (strcmp(id, "subvendor") == 0) {
+			if (snd_config_get_integer(n, &subvendor) < 0) {
+				SNDERR("Invalid value for %s", id);
+				return -EINVAL;
+			}
+			continue;
+		}
+		SNDERR("Unknown field %s", id);
+		return -EINVAL;
+	}
+
+	sim = calloc(1, sizeof(*sim));
+	if (! sim)
+		return -ENOMEM;
+	if (pipe(sim->fds) < 0) {
+		err = -errno;
+		free(sim);
+		return err;
+	}
+	fcntl(sim->fds[0], F_SETFL, O_NONBLOCK);
+	fcntl(sim->fds[1], F_SETFL, O_NONBLOCK);
+	sim->card = sim_card_get(name, subvendor);
+	if (! sim->card) {
+		err = -ENOMEM;
+		goto __error;
+	}
+	sim->pending = calloc(sim->card->count, 1);
+	if (! sim->pending) {
+		err = -ENOMEM;
+		goto __error;
+	}
+	sim->next = sim->card->handles;
+	sim->card->handles = sim;
+
+	sim->ext.version = SND_CTL_EXT_VERSION;
+	sim->ext.card_idx = 0;
+	strcpy(sim->ext.id, "Envy24Sim");
+	strcpy(sim->ext.driver, "ICE1712");
+	strcpy(sim->ext.name, "Envy24 simulator");
+	strcpy(sim->ext.longname, "Simulated ICE1712 Envy24 card");
+	strcpy(sim->ext.mixername, "ICE1712 simulator");
+	sim->ext.poll_fd = sim->fds[0];
+	sim->ext.callback = &envy24sim_callback;
+	sim->ext.private_data = sim;
+
+	if ((err = snd_ctl_ext_create(&sim->ext, name, mode)) < 0)
+		goto __error;
+	*handlep = sim->ext.handle;
+	return 0;
+
+      __error:
+	if (sim->card)
+		sim_card_detach(sim);
+	close(sim->fds[0]);
+	close(sim->fds[1]);
+	free(sim->pending);
+	free(sim);
+	return err;
+}
+
+SND_CTL_PLUGIN_SYMBOL(envy24sim);
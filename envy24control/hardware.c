@@ -19,9 +19,6 @@
 
 #include "envy24control.h"
 
-static snd_ctl_elem_value_t *internal_clock;
-static snd_ctl_elem_value_t *internal_clock_default;
-static snd_ctl_elem_value_t *word_clock_sync;
 static snd_ctl_elem_value_t *rate_locking;
 static snd_ctl_elem_value_t *rate_reset;
 static snd_ctl_elem_value_t *volume_rate;
@@ -49,21 +46,33 @@ static void label_set(GtkWidget* widget, const char* str)
 		gtk_label_set_text(GTK_LABEL(widget), str);
 }
 
+static int has_word_clock(void)
+{
+	return card_eeprom.subvendor == ICE1712_SUBDEVICE_DELTA1010 ||
+	       card_eeprom.subvendor == ICE1712_SUBDEVICE_DELTA1010LT;
+}
+
+static void clock_read(int *clock, int *clock_default, int *word_clock)
+{
+	if ((*clock = envy24_clock_get(ctl)) < 0)
+		g_print("Unable to read Internal Clock state: %s\n", snd_strerror(*clock));
+	if ((*clock_default = envy24_clock_default_get(ctl)) < 0)
+		g_print("Unable to read Internal Clock Default state: %s\n", snd_strerror(*clock_default));
+	*word_clock = 0;
+	if (has_word_clock() && (*word_clock = envy24_word_clock_get(ctl)) < 0) {
+		g_print("Unable to read word clock sync selection: %s\n", snd_strerror(*word_clock));
+		*word_clock = 0;
+	}
+}
+
 void master_clock_update(void)
 {
-	int err, rate, need_default_update;
+	int rate, need_default_update;
+	int clock, clock_default, word_clock;
 	
-	if ((err = snd_ctl_elem_read(ctl, internal_clock)) < 0)
-		g_print("Unable to read Internal Clock state: %s\n", snd_strerror(err));
-	if ((err = snd_ctl_elem_read(ctl, internal_clock_default)) < 0)
-		g_print("Unable to read Internal Clock Default state: %s\n", snd_strerror(err));
-	if (card_eeprom.subvendor == ICE1712_SUBDEVICE_DELTA1010 ||
-	    card_eeprom.subvendor == ICE1712_SUBDEVICE_DELTA1010LT) {
-		if ((err = snd_ctl_elem_read(ctl, word_clock_sync)) < 0)
-			g_print("Unable to read word clock sync selection: %s\n", snd_strerror(err));
-	}
-	if (snd_ctl_elem_value_get_enumerated(internal_clock, 0) == 13) {
-		if (snd_ctl_elem_value_get_boolean(word_clock_sync, 0)) {
+	clock_read(&clock, &clock_default, &word_clock);
+	if (clock == ENVY24_CLOCK_EXTERNAL) {
+		if (word_clock) {
 			toggle_set(hw_master_clock_word_radio, TRUE);
 		} else {
 			toggle_set(hw_master_clock_spdif_radio, TRUE);
@@ -72,9 +81,9 @@ void master_clock_update(void)
 //		toggle_set(hw_master_clock_xtal_radio, TRUE);
 		need_default_update = !is_update_needed() ? 1 : 0;
 		if (need_default_update) {
-			rate = snd_ctl_elem_value_get_enumerated(internal_clock_default, 0);
+			rate = clock_default;
 		} else {
-			rate = snd_ctl_elem_value_get_enumerated(internal_clock, 0);
+			rate = clock;
 		}
 		switch (rate) {
 		case 5: toggle_set(hw_master_clock_xtal_22050, TRUE); break;
@@ -96,11 +105,9 @@ static void master_clock_word_select(int on)
 {
 	int err;
 
-	if (card_eeprom.subvendor != ICE1712_SUBDEVICE_DELTA1010 &&
-	    card_eeprom.subvendor != ICE1712_SUBDEVICE_DELTA1010LT)
+	if (!has_word_clock())
 		return;
-	snd_ctl_elem_value_set_boolean(word_clock_sync, 0, on ? 1 : 0);
-	if ((err = snd_ctl_elem_write(ctl, word_clock_sync)) < 0)
+	if ((err = envy24_word_clock_set(ctl, on)) < 0)
 		g_print("Unable to write word clock sync selection: %s\n", snd_strerror(err));
 }
 
@@ -109,8 +116,7 @@ static void internal_clock_set(int xrate)
 	int err;
 
 	master_clock_word_select(0);
-	snd_ctl_elem_value_set_enumerated(internal_clock, 0, xrate);
-	if ((err = snd_ctl_elem_write(ctl, internal_clock)) < 0)
+	if ((err = envy24_clock_set(ctl, xrate)) < 0)
 		g_print("Unable to write internal clock rate: %s\n", snd_strerror(err));
 }
 
@@ -133,9 +139,9 @@ void internal_clock_toggled(GtkWidget *togglebutton, gpointer data)
 	} else if (!strcmp(what, "96000")) {
 		internal_clock_set(12);
 	} else if (!strcmp(what, "SPDIF")) {
-		internal_clock_set(13);
+		internal_clock_set(ENVY24_CLOCK_EXTERNAL);
 	} else if (!strcmp(what, "WordClock")) {
-		internal_clock_set(13); // 13 should be considered '!internal'
+		internal_clock_set(ENVY24_CLOCK_EXTERNAL);
 		master_clock_word_select(1);
 	} else {
 		g_print("internal_clock_toggled: %s ???\n", what);
@@ -167,45 +173,35 @@ static inline int is_update_needed(void)
 
 gint master_clock_status_timeout_callback(gpointer data)
 {
-	snd_ctl_elem_value_t *sw;
-	int err;
+	int locked;
 	
-	if (card_eeprom.subvendor != ICE1712_SUBDEVICE_DELTA1010 && card_eeprom.subvendor != ICE1712_SUBDEVICE_DELTA1010LT)
+	if (!has_word_clock())
 		return FALSE;
-	snd_ctl_elem_value_alloca(&sw);
-	snd_ctl_elem_value_set_interface(sw, SND_CTL_ELEM_IFACE_MIXER);
-	snd_ctl_elem_value_set_name(sw, "Word Clock Status");
-	if ((err = snd_ctl_elem_read(ctl, sw)) < 0)
-		g_print("Unable to determine word clock status: %s\n", snd_strerror(err));
-	label_set(hw_master_clock_status_label,
-		  snd_ctl_elem_value_get_boolean(sw, 0) ? "No signal" : "Locked");
+	if ((locked = envy24_word_clock_locked(ctl)) < 0) {
+		g_print("Unable to determine word clock status: %s\n", snd_strerror(locked));
+		return TRUE;
+	}
+	label_set(hw_master_clock_status_label, locked ? "Locked" : "No signal");
 	return TRUE;
 }
 
 gint internal_clock_status_timeout_callback(gpointer data)
 {
-	int err, rate, need_update;
+	int rate, need_update;
+	int clock, clock_default, word_clock;
 	char *label;
 	
-	if ((err = snd_ctl_elem_read(ctl, internal_clock)) < 0)
-		g_print("Unable to read Internal Clock state: %s\n", snd_strerror(err));
-	if ((err = snd_ctl_elem_read(ctl, internal_clock_default)) < 0)
-		g_print("Unable to read Internal Clock Default state: %s\n", snd_strerror(err));
-	if (card_eeprom.subvendor == ICE1712_SUBDEVICE_DELTA1010 ||
-	    card_eeprom.subvendor == ICE1712_SUBDEVICE_DELTA1010LT) {
-		if ((err = snd_ctl_elem_read(ctl, word_clock_sync)) < 0)
-			g_print("Unable to read word clock sync selection: %s\n", snd_strerror(err));
-	}
+	clock_read(&clock, &clock_default, &word_clock);
 	need_update = is_update_needed() ? 1 : 0;
-	if (snd_ctl_elem_value_get_enumerated(internal_clock, 0) == 13) {
-		if (snd_ctl_elem_value_get_boolean(word_clock_sync, 0)) {
+	if (clock == ENVY24_CLOCK_EXTERNAL) {
+		if (word_clock) {
 			label = "Word Clock";
 		} else {
 			label = "S/PDIF";
 		}
 	} else {
 //		toggle_set(hw_master_clock_xtal_radio, TRUE);
-		rate = snd_ctl_elem_value_get_enumerated(internal_clock, 0);
+		rate = clock;
 //		g_print("Rate: %d need_update: %d\n", rate, need_update); // for debug
 		switch (rate) {
 		case 0: label = "8000"; break;
@@ -239,7 +235,7 @@ gint internal_clock_status_timeout_callback(gpointer data)
 			    break;
 		}
 		if (!need_update) {	//default clock need update
-			rate = snd_ctl_elem_value_get_enumerated(internal_clock_default, 0);
+			rate = clock_default;
 			switch (rate) {
 			case 5: toggle_set(hw_master_clock_xtal_22050, TRUE); break;
 			case 7: toggle_set(hw_master_clock_xtal_32000, TRUE); break;
@@ -748,10 +744,7 @@ void phono_input_toggled(GtkWidget *togglebutton, gpointer data)
 
 void hardware_init(void)
 {
-	if (snd_ctl_elem_value_malloc(&internal_clock) < 0 ||
-	    snd_ctl_elem_value_malloc(&internal_clock_default) < 0 ||
-	    snd_ctl_elem_value_malloc(&word_clock_sync) < 0 ||
-	    snd_ctl_elem_value_malloc(&rate_locking) < 0 ||
+	if (snd_ctl_elem_value_malloc(&rate_locking) < 0 ||
 	    snd_ctl_elem_value_malloc(&rate_reset) < 0 ||
 	    snd_ctl_elem_value_malloc(&volume_rate) < 0 ||
 	    snd_ctl_elem_value_malloc(&spdif_input) < 0 ||
@@ -764,15 +757,6 @@ void hardware_init(void)
 		exit(1);
 	}
 
-	snd_ctl_elem_value_set_interface(internal_clock, SND_CTL_ELEM_IFACE_MIXER);
-	snd_ctl_elem_value_set_name(internal_clock, "Multi Track Internal Clock");
-
-	snd_ctl_elem_value_set_interface(internal_clock_default, SND_CTL_ELEM_IFACE_MIXER);
-	snd_ctl_elem_value_set_name(internal_clock_default, "Multi Track Internal Clock Default");
-
-	snd_ctl_elem_value_set_interface(word_clock_sync, SND_CTL_ELEM_IFACE_MIXER);
-	snd_ctl_elem_value_set_name(word_clock_sync, "Word Clock Sync");
-
 	snd_ctl_elem_value_set_interface(rate_locking, SND_CTL_ELEM_IFACE_MIXER);
 	snd_ctl_elem_value_set_name(rate_locking, "Multi Track Rate Locking");
 
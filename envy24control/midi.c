@@ -92,6 +92,9 @@ static const int slider2midi_enh[97] = {
   127,
 };
 
+/* minimum time between two feedback messages for the same controller */
+#define MIDI_FEEDBACK_INTERVAL 20 /* ms */
+
 static const int *midi2slider, *slider2midi;
 static snd_seq_t *seq=0;
 static int client, clientId, port, ch;
@@ -99,6 +102,15 @@ static char *portname=0, *appname=0;
 static int maxstreams=0;
 static int currentvalue[128];
 
+/* incoming controller values not yet applied to the mixer, -1 if none */
+static int pendingin[128];
+static guint pendingin_source=0;
+
+/* outgoing feedback values not yet sent, -1 if none */
+static int pendingout[128];
+static gint64 lastsent[128];
+static guint pendingout_source=0;
+
 void midi_maxstreams(int m)
 {
   maxstreams=m*2;
@@ -110,6 +122,11 @@ int midi_close()
   if(seq)
     i=snd_seq_close(seq);
 
+  if(pendingin_source)
+    g_source_remove(pendingin_source), pendingin_source=0;
+  if(pendingout_source)
+    g_source_remove(pendingout_source), pendingout_source=0;
+
   seq=0;
   client=port=0;
   if(portname)
@@ -120,23 +137,64 @@ int midi_close()
   return i;
 }
 
-static void do_controller(int c, int v)
+/*
+ * send all pending feedback values whose controller was not sent within the
+ * last MIDI_FEEDBACK_INTERVAL and drain the output once for all of them.
+ * runs as timeout as long as feedback is pending.
+ */
+static gboolean flush_feedback(gpointer data)
 {
   snd_seq_event_t ev;
+  gint64 now=g_get_monotonic_time();
+  int c, sent=0, waiting=0;
+
+  if(!seq)
+    {
+      pendingout_source=0;
+      return FALSE;
+    }
+
+  for(c=0; c!=128; ++c)
+    {
+      if(pendingout[c] < 0)
+	continue;
+      if(now - lastsent[c] < MIDI_FEEDBACK_INTERVAL*1000)
+	{
+	  waiting=1;
+	  continue;
+	}
+#if 0
+      fprintf(stderr, "flush_feedback(%i,%i)\n",c,pendingout[c]);
+#endif
+      snd_seq_ev_clear(&ev);
+      snd_seq_ev_set_source(&ev, port);
+      snd_seq_ev_set_subs(&ev);
+      snd_seq_ev_set_direct(&ev);
+      snd_seq_ev_set_controller(&ev,ch,c,pendingout[c]);
+      snd_seq_event_output(seq, &ev);
+      lastsent[c]=now;
+      pendingout[c]=-1;
+      sent=1;
+    }
+  if(sent)
+    snd_seq_drain_output(seq);
+
+  if(!waiting)
+    pendingout_source=0;
+  return waiting;
+}
+
+static void do_controller(int c, int v)
+{
   if(!seq) return;
   if(currentvalue[c]==v) return;
 #if 0
   fprintf(stderr, "do_controller(%i,%i)\n",c,v);
 #endif
-  snd_seq_ev_clear(&ev);
-  snd_seq_ev_set_source(&ev, port);
-  snd_seq_ev_set_subs(&ev);
-  snd_seq_ev_set_direct(&ev);
-  snd_seq_ev_set_controller(&ev,ch,c,v);
-  snd_seq_event_output(seq, &ev);
-  snd_seq_drain_output(seq);
-
   currentvalue[c]=v;
+  pendingout[c]=v;
+  if(!pendingout_source)
+    pendingout_source=g_timeout_add(MIDI_FEEDBACK_INTERVAL, flush_feedback, NULL);
 }
 
 int midi_controller(int c, int v)
@@ -177,7 +235,12 @@ int midi_init(char *appname, int channel, int midi_enhanced)
     return 0;
 
   for(npfd=0; npfd!=128; ++npfd)
-    currentvalue[npfd]=-1;
+    {
+      currentvalue[npfd]=-1;
+      pendingin[npfd]=-1;
+      pendingout[npfd]=-1;
+      lastsent[npfd]=0;
+    }
 
   ch=channel;
   if(midi_enhanced)
@@ -243,13 +306,50 @@ int midi_init(char *appname, int channel, int midi_enhanced)
 void mixer_adjust(GtkAdjustment *adj, gpointer data);
 void mixer_set_mute(int stream, int left, int right);
 
-gboolean midi_process(GIOChannel *gio, GIOCondition condition, gpointer data)
+/*
+ * apply the latest value of every controller received since the last call.
+ * a fader sweep delivers many values for the same controller between two
+ * main loop iterations, only the last one is written to the mixer.
+ */
+static gboolean apply_controllers(gpointer data)
 {
-  snd_seq_event_t *ev;
   static GtkAdjustment *adj=0;
+  int c, v;
+
+  pendingin_source=0;
   if(!adj)
     adj=(GtkAdjustment*) gtk_adjustment_new(0, 0, 96, 1, 1, 10);
 
+  for(c=0; c!=128; ++c)
+    {
+      if(pendingin[c] < 0)
+	continue;
+      v=pendingin[c];
+      pendingin[c]=-1;
+      if(c < maxstreams)
+	{
+	  long data=((c/2+1)<<16)|(c&1);
+	  gtk_adjustment_set_value(adj, midi2slider[v]);
+	  mixer_adjust(adj, (gpointer)data);
+	}
+      else if(c < maxstreams*2)
+	{
+	  int b=c-maxstreams;
+	  int left=-1, right=-1;
+	  if(b&1)
+	    right=v;
+	  else
+	    left=v;
+	  mixer_set_mute(b/2+1, left, right);
+	}
+    }
+  return FALSE;
+}
+
+gboolean midi_process(GIOChannel *gio, GIOCondition condition, gpointer data)
+{
+  snd_seq_event_t *ev;
+
   do
     {
       snd_seq_event_input(seq, &ev);
@@ -261,25 +361,14 @@ gboolean midi_process(GIOChannel *gio, GIOCondition condition, gpointer data)
 	  fprintf(stderr, "Channel %02d: Controller %03d: Value:%d\n",
 		  ev->data.control.channel, ev->data.control.param, ev->data.control.value);
 #endif
-	  if(ev->data.control.channel == ch)
+	  if(ev->data.control.channel == ch && ev->data.control.param < 128)
 	    {
 	      currentvalue[ev->data.control.param]=ev->data.control.value;
-	      if(ev->data.control.param < maxstreams)
-		{
-		  int stream=ev->data.control.param;
-		  long data=((stream/2+1)<<16)|(stream&1);
-		  gtk_adjustment_set_value(adj, midi2slider[ev->data.control.value]);
-		  mixer_adjust(adj, (gpointer)data);
-		}
-	      else if(ev->data.control.param < maxstreams*2)
+	      if(ev->data.control.param < maxstreams*2)
 		{
-		  int b=ev->data.control.param-maxstreams;
-		  int left=-1, right=-1;
-		  if(b&1)
-		    right=ev->data.control.value;
-		  else
-		    left=ev->data.control.value;
-		  mixer_set_mute(b/2+1, left, right);
+		  pendingin[ev->data.control.param]=ev->data.control.value;
+		  if(!pendingin_source)
+		    pendingin_source=g_idle_add(apply_controllers, NULL);
 		}
 	    }
 	  break;
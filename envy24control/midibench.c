@@ -0,0 +1,290 @@
+/*****************************************************************************
+   midibench.c - replay a MIDI controller stream through the MIDI code
+   of envy24control and report its throughput
+   Copyright (C) 2026 by the ALSA project
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License
+   as published by the Free Software Foundation; either version 2
+   of the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+/*
+ * midi.c is linked as it is, the mixer functions it calls are replaced
+ * by counters which echo every change back like mixer.c does.  The stream
+ * is sent through the sequencer to the port midi_init() created and the
+ * default main context is iterated between bursts, so the coalescing of
+ * input and the rate limited feedback run exactly as in envy24control.
+ *
+ * The stream is either recorded with "aseqdump -p <port> > file" or has
+ * one "<controller> <value>" pair per line; without a file fader sweeps
+ * over all streams are generated.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <alsa/asoundlib.h>
+#include <gtk/gtk.h>
+#include "midi.h"
+
+#define BENCH_STREAMS	20	/* streams of a Delta 1010 mixer */
+#define BENCH_SWEEPS	200
+
+struct cc {
+	int controller;
+	int value;
+};
+
+static struct cc *stream;
+static int stream_count, stream_size;
+
+static unsigned long volume_writes, mute_writes, feedback_events;
+
+/* what set_volume1() and set_switch1() of mixer.c do, minus the card */
+void mixer_adjust(GtkAdjustment *adj, gpointer data)
+{
+	int stream = (long)data >> 16;
+	int button = (long)data & 1;
+
+	volume_writes++;
+	midi_controller((stream - 1) * 2 + button, 96 - gtk_adjustment_get_value(adj));
+}
+
+void mixer_set_mute(int stream, int left, int right)
+{
+	mute_writes++;
+	if (left >= 0)
+		midi_button((stream - 1) * 2, left);
+	if (right >= 0)
+		midi_button((stream - 1) * 2 + 1, right);
+}
+
+static int stream_add(int controller, int value)
+{
+	struct cc *n;
+
+	if (controller < 0 || controller > 127 || value < 0 || value > 127)
+		return 0;
+	if (stream_count == stream_size) {
+		stream_size = stream_size ? stream_size * 2 : 1024;
+		if ((n = realloc(stream, stream_size * sizeof(*stream))) == NULL)
+			return -ENOMEM;
+		stream = n;
+	}
+	stream[stream_count].controller = controller;
+	stream[stream_count].value = value;
+	stream_count++;
+	return 0;
+}
+
+static int stream_read(const char *name)
+{
+	FILE *f;
+	char line[256];
+	int channel, controller, value;
+	const char *p;
+	int err = 0;
+
+	if ((f = fopen(name, "r")) == NULL) {
+		fprintf(stderr, "midibench: cannot open %s: %s\n", name, strerror(errno));
+		return -errno;
+	}
+	while (err >= 0 && fgets(line, sizeof(line), f)) {
+		/* aseqdump: " 20:0   Control change   0, controller 7, value 64" */
+		if ((p = strstr(line, "Control change")) != NULL) {
+			if (sscanf(p, "Control change %d, controller %d, value %d", &channel, &controller, &value) == 3)
+				err = stream_add(controller, value);
+		} else if (sscanf(line, "%d %d", &controller, &value) == 2)
+			err = stream_add(controller, value);
+	}
+	fclose(f);
+	if (err >= 0 && stream_count == 0) {
+		fprintf(stderr, "midibench: no controller events in %s\n", name);
+		err = -EINVAL;
+	}
+	return err;
+}
+
+/* every fader moved from top to bottom and back in steps of one */
+static int stream_generate(int sweeps)
+{
+	int s, v, c, err = 0;
+
+	for (s = 0; s < sweeps && err >= 0; s++)
+		for (v = 0; v < 256 && err >= 0; v++)
+			for (c = 0; c < BENCH_STREAMS * 2 && err >= 0; c++)
+				err = stream_add(c, v < 128 ? 127 - v : v - 128);
+	return err;
+}
+
+/* the port midi_init() created is the first port of the client named like the application */
+static int find_port(snd_seq_t *seq, const char *name, snd_seq_addr_t *addr)
+{
+	snd_seq_client_info_t *cinfo;
+	snd_seq_port_info_t *pinfo;
+
+	snd_seq_client_info_alloca(&cinfo);
+	snd_seq_port_info_alloca(&pinfo);
+	snd_seq_client_info_set_client(cinfo, -1);
+	while (snd_seq_query_next_client(seq, cinfo) >= 0) {
+		if (strcmp(snd_seq_client_info_get_name(cinfo), name))
+			continue;
+		snd_seq_port_info_set_client(pinfo, snd_seq_client_info_get_client(cinfo));
+		snd_seq_port_info_set_port(pinfo, -1);
+		if (snd_seq_query_next_port(seq, pinfo) < 0)
+			break;
+		*addr = *snd_seq_port_info_get_addr(pinfo);
+		return 0;
+	}
+	return -ENOENT;
+}
+
+static void read_feedback(snd_seq_t *seq)
+{
+	snd_seq_event_t *ev;
+
+	while (snd_seq_event_input(seq, &ev) >= 0 && ev) {
+		if (ev->type == SND_SEQ_EVENT_CONTROLLER)
+			feedback_events++;
+		snd_seq_free_event(ev);
+	}
+}
+
+static gboolean stop_loop(gpointer data)
+{
+	*(int *)data = 1;
+	return FALSE;
+}
+
+static void usage(void)
+{
+	fprintf(stderr,
+		"usage: midibench [options] [stream]\n"
+		"  -b, --burst=N       events sent between two main loop iterations (32)\n"
+		"  -c, --channel=N     MIDI channel (1)\n"
+		"  -e, --enhanced      use the enhanced slider mapping\n"
+		"  -s, --sweeps=N      generated fader sweeps without a stream (%d)\n",
+		BENCH_SWEEPS);
+}
+
+int main(int argc, char **argv)
+{
+	static const struct option long_options[] = {
+		{"burst", 1, NULL, 'b'},
+		{"channel", 1, NULL, 'c'},
+		{"enhanced", 0, NULL, 'e'},
+		{"sweeps", 1, NULL, 's'},
+		{NULL, 0, NULL, 0}
+	};
+	snd_seq_t *seq;
+	snd_seq_event_t ev;
+	snd_seq_addr_t addr;
+	GIOChannel *gio;
+	gint64 start, end;
+	int burst = 32, channel = 0, enhanced = 0, sweeps = BENCH_SWEEPS;
+	int fd, port, i, c, done;
+	double secs;
+
+	while ((c = getopt_long(argc, argv, "b:c:es:", long_options, NULL)) != -1) {
+		switch (c) {
+		case 'b':
+			burst = atoi(optarg);
+			break;
+		case 'c':
+			channel = atoi(optarg) - 1;
+			break;
+		case 'e':
+			enhanced = 1;
+			break;
+		case 's':
+			sweeps = atoi(optarg);
+			break;
+		default:
+			usage();
+			return 1;
+		}
+	}
+	if (burst < 1 || channel < 0 || channel > 15 || sweeps < 1) {
+		usage();
+		return 1;
+	}
+	if ((optind < argc ? stream_read(argv[optind]) : stream_generate(sweeps)) < 0)
+		return 1;
+
+	midi_maxstreams(BENCH_STREAMS);
+	if ((fd = midi_init("midibench", channel, enhanced)) < 0)
+		return 1;
+	gio = g_io_channel_unix_new(fd);
+	g_io_add_watch(gio, G_IO_IN, midi_process, NULL);
+	g_io_channel_unref(gio);
+
+	if (snd_seq_open(&seq, "default", SND_SEQ_OPEN_DUPLEX, SND_SEQ_NONBLOCK) < 0) {
+		fprintf(stderr, "midibench: cannot open the sequencer\n");
+		return 1;
+	}
+	snd_seq_set_client_name(seq, "midibench player");
+	port = snd_seq_create_simple_port(seq, "player",
+					  SND_SEQ_PORT_CAP_READ | SND_SEQ_PORT_CAP_SUBS_READ |
+					  SND_SEQ_PORT_CAP_WRITE | SND_SEQ_PORT_CAP_SUBS_WRITE,
+					  SND_SEQ_PORT_TYPE_APPLICATION);
+	if (port < 0 || find_port(seq, "midibench", &addr) < 0 ||
+	    snd_seq_connect_to(seq, port, addr.client, addr.port) < 0 ||
+	    snd_seq_connect_from(seq, port, addr.client, addr.port) < 0) {
+		fprintf(stderr, "midibench: cannot connect to the mixer port\n");
+		return 1;
+	}
+	/* the subscription makes midi.c send its current values, drop them */
+	while (g_main_context_iteration(NULL, FALSE))
+		;
+	read_feedback(seq);
+	feedback_events = 0;
+
+	start = g_get_monotonic_time();
+	for (i = 0; i < stream_count; i++) {
+		snd_seq_ev_clear(&ev);
+		snd_seq_ev_set_source(&ev, port);
+		snd_seq_ev_set_subs(&ev);
+		snd_seq_ev_set_direct(&ev);
+		snd_seq_ev_set_controller(&ev, channel, stream[i].controller, stream[i].value);
+		while (snd_seq_event_output_direct(seq, &ev) == -EAGAIN) {
+			g_main_context_iteration(NULL, FALSE);
+			read_feedback(seq);
+		}
+		if ((i + 1) % burst == 0 || i + 1 == stream_count) {
+			while (g_main_context_iteration(NULL, FALSE))
+				;
+			read_feedback(seq);
+		}
+	}
+	/* the last values are applied now, their feedback is rate limited */
+	end = g_get_monotonic_time();
+	done = 0;
+	g_timeout_add(200, stop_loop, &done);
+	while (!done) {
+		g_main_context_iteration(NULL, TRUE);
+		read_feedback(seq);
+	}
+
+	secs = (end - start) / 1e6;
+	printf("events:        %d in %.3f s, %.0f events/s\n", stream_count, secs, stream_count / secs);
+	printf("mixer writes:  %lu volume, %lu mute (%.1f events per write)\n",
+	       volume_writes, mute_writes,
+	       volume_writes + mute_writes ? (double)stream_count / (volume_writes + mute_writes) : 0.0);
+	printf("feedback:      %lu events sent back\n", feedback_events);
+
+	snd_seq_close(seq);
+	midi_close();
+	free(stream);
+	return 0;
+}
@@ -21,15 +21,6 @@
 #include "midi.h"
 #include "config.h"
 
-#define	MULTI_PLAYBACK_SWITCH		"Multi Playback Switch"
-#define MULTI_PLAYBACK_VOLUME		"Multi Playback Volume"
-
-#define HW_MULTI_CAPTURE_SWITCH		"H/W Multi Capture Switch"
-#define IEC958_MULTI_CAPTURE_SWITCH	"IEC958 Multi Capture Switch"
-
-#define HW_MULTI_CAPTURE_VOLUME		"H/W Multi Capture Volume"
-#define IEC958_MULTI_CAPTURE_VOLUME	"IEC958 Multi Capture Volume"
-
 #define toggle_set(widget, state) \
 	gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(widget), state);
 
@@ -50,16 +41,11 @@ void mixer_update_stream(int stream, int vol_flag, int sw_flag)
 		return;
 
 	if (vol_flag) {
-		snd_ctl_elem_value_t *vol;
 		int v[2];
-		snd_ctl_elem_value_alloca(&vol);
-		snd_ctl_elem_value_set_interface(vol, SND_CTL_ELEM_IFACE_MIXER);
-		snd_ctl_elem_value_set_name(vol, stream <= 10 ? MULTI_PLAYBACK_VOLUME : (stream <= 18 ? HW_MULTI_CAPTURE_VOLUME : IEC958_MULTI_CAPTURE_VOLUME));
-		snd_ctl_elem_value_set_index(vol, stream <= 18 ? (stream - 1) % 10 : (stream - 1) % 18 );
-		if ((err = snd_ctl_elem_read(ctl, vol)) < 0)
+		if ((err = envy24_volume_get(ctl, stream, &v[0], &v[1])) < 0) {
 			g_print("Unable to read multi playback volume: %s\n", snd_strerror(err));
-		v[0] = snd_ctl_elem_value_get_integer(vol, 0);
-		v[1] = snd_ctl_elem_value_get_integer(vol, 1);
+			v[0] = v[1] = 0;
+		}
 		if (v[0] != v[1])
 			toggle_set(mixer_stereo_toggle[stream-1], FALSE);
 		gtk_adjustment_set_value(GTK_ADJUSTMENT(mixer_adj[stream-1][0]), 96 - v[0]);
@@ -68,16 +54,11 @@ void mixer_update_stream(int stream, int vol_flag, int sw_flag)
 		midi_controller((stream-1)*2+1, v[1]);
 	}
 	if (sw_flag) {
-		snd_ctl_elem_value_t *sw;
 		int v[2];
-		snd_ctl_elem_value_alloca(&sw);
-		snd_ctl_elem_value_set_interface(sw, SND_CTL_ELEM_IFACE_MIXER);
-		snd_ctl_elem_value_set_name(sw, stream <= 10 ? MULTI_PLAYBACK_SWITCH : (stream <= 18 ? HW_MULTI_CAPTURE_SWITCH : IEC958_MULTI_CAPTURE_SWITCH));
-		snd_ctl_elem_value_set_index(sw, stream <= 18 ? (stream - 1) % 10 : (stream - 1) % 18 );
-		if ((err = snd_ctl_elem_read(ctl, sw)) < 0)
+		if ((err = envy24_switch_get(ctl, stream, &v[0], &v[1])) < 0) {
 			g_print("Unable to read multi playback switch: %s\n", snd_strerror(err));
-		v[0] = snd_ctl_elem_value_get_boolean(sw, 0);
-		v[1] = snd_ctl_elem_value_get_boolean(sw, 1);
+			v[0] = v[1] = 0;
+		}
 		if (v[0] != v[1])
 			toggle_set(mixer_stereo_toggle[stream-1], FALSE);
 		toggle_set(mixer_mute_toggle[stream-1][0], !v[0] ? TRUE : FALSE);
@@ -89,30 +70,18 @@ void mixer_update_stream(int stream, int vol_flag, int sw_flag)
 
 static void set_switch1(int stream, int left, int right)
 {
-	snd_ctl_elem_value_t *sw;
-	int err, changed = 0;
-	
-	snd_ctl_elem_value_alloca(&sw);
-	snd_ctl_elem_value_set_interface(sw, SND_CTL_ELEM_IFACE_MIXER);
-	snd_ctl_elem_value_set_name(sw, stream <= 10 ? MULTI_PLAYBACK_SWITCH : (stream <= 18 ? HW_MULTI_CAPTURE_SWITCH : IEC958_MULTI_CAPTURE_SWITCH));
-	snd_ctl_elem_value_set_index(sw, stream <= 18 ? (stream - 1) % 10 : (stream - 1) % 18 );
-	if ((err = snd_ctl_elem_read(ctl, sw)) < 0)
+	int err, v[2];
+
+	if ((err = envy24_switch_get(ctl, stream, &v[0], &v[1])) < 0) {
 		g_print("Unable to read multi switch: %s\n", snd_strerror(err));
-	if (left >= 0 && left != snd_ctl_elem_value_get_boolean(sw, 0)) {
-		snd_ctl_elem_value_set_boolean(sw, 0, left);
-		changed = 1;
-		midi_button((stream-1)*2, left);
+		return;
 	}
-	if (right >= 0 && right != snd_ctl_elem_value_get_boolean(sw, 1)) {
-		snd_ctl_elem_value_set_boolean(sw, 1, right);
-		changed = 1;
+	if (left >= 0 && left != v[0])
+		midi_button((stream-1)*2, left);
+	if (right >= 0 && right != v[1])
 		midi_button((stream-1)*2+1, right);
-	}
-	if (changed) {
-		err = snd_ctl_elem_write(ctl, sw);
-		if (err < 0)
-			g_print("Unable to write multi switch: %s\n", snd_strerror(err));
-	}
+	if ((err = envy24_switch_set(ctl, stream, left, right)) < 0)
+		g_print("Unable to write multi switch: %s\n", snd_strerror(err));
 }
 
 void mixer_toggled_mute(GtkWidget *togglebutton, gpointer data)
@@ -148,30 +117,14 @@ void mixer_set_mute(int stream, int left, int right)
 
 static void set_volume1(int stream, int left, int right)
 {
-	snd_ctl_elem_value_t *vol;
-	int change = 0;
 	int err;
-	
-	snd_ctl_elem_value_alloca(&vol);
-	snd_ctl_elem_value_set_interface(vol, SND_CTL_ELEM_IFACE_MIXER);
-	snd_ctl_elem_value_set_name(vol, stream <= 10 ? MULTI_PLAYBACK_VOLUME : (stream <= 18 ? HW_MULTI_CAPTURE_VOLUME : IEC958_MULTI_CAPTURE_VOLUME));
-	snd_ctl_elem_value_set_index(vol, stream <= 18 ? (stream - 1) % 10 : (stream - 1) % 18 );
-	if ((err = snd_ctl_elem_read(ctl, vol)) < 0)
-		g_print("Unable to read multi volume: %s\n", snd_strerror(err));
-	if (left >= 0) {
-		change |= (snd_ctl_elem_value_get_integer(vol, 0) != left);
-		snd_ctl_elem_value_set_integer(vol, 0, left);
+
+	if (left >= 0)
 		midi_controller((stream-1)*2, left);
-	}
-	if (right >= 0) {
-		change |= (snd_ctl_elem_value_get_integer(vol, 1) != right);
-		snd_ctl_elem_value_set_integer(vol, 1, right);
+	if (right >= 0)
 		midi_controller((stream-1)*2+1, right);
-	}
-	if (change) {
-		if ((err = snd_ctl_elem_write(ctl, vol)) < 0 && err != -EBUSY)
-			g_print("Unable to write multi volume: %s\n", snd_strerror(err));
-	}
+	if ((err = envy24_volume_set(ctl, stream, left, right)) < 0 && err != -EBUSY)
+		g_print("Unable to write multi volume: %s\n", snd_strerror(err));
 }
 
 void mixer_adjust(GtkAdjustment *adj, gpointer data)
@@ -198,19 +151,14 @@ void mixer_init(void)
 {
 	int i;
 	int nb_active_channels;
-	snd_ctl_elem_value_t *val;
+	int v[2];
 
 	midi_maxstreams(sizeof(stream_is_active)/sizeof(stream_is_active[0]));
 
-	snd_ctl_elem_value_alloca(&val);
-	snd_ctl_elem_value_set_interface(val, SND_CTL_ELEM_IFACE_MIXER);
 	memset (stream_is_active, 0, (MAX_PCM_OUTPUT_CHANNELS + MAX_SPDIF_CHANNELS + MAX_INPUT_CHANNELS + MAX_SPDIF_CHANNELS) * sizeof(int));
-	snd_ctl_elem_value_set_name(val, MULTI_PLAYBACK_SWITCH);
 	nb_active_channels = 0;
 	for (i = 0; i < pcm_output_channels; i++) {
-		snd_ctl_elem_value_set_numid(val, 0);
-		snd_ctl_elem_value_set_index(val, i);
-		if (snd_ctl_elem_read(ctl, val) < 0)
+		if (envy24_switch_get(ctl, i + 1, &v[0], &v[1]) < 0)
 			continue;
 
 		stream_is_active[i] = 1;
@@ -218,31 +166,23 @@ void mixer_init(void)
 	}
 	pcm_output_channels = nb_active_channels;
 	for (i = MAX_PCM_OUTPUT_CHANNELS; i < MAX_PCM_OUTPUT_CHANNELS + spdif_channels; i++) {
-		snd_ctl_elem_value_set_numid(val, 0);
-		snd_ctl_elem_value_set_index(val, i);
- 		if (snd_ctl_elem_read(ctl, val) < 0)
+ 		if (envy24_switch_get(ctl, i + 1, &v[0], &v[1]) < 0)
 			continue;
 		stream_is_active[i] = 1;
 	}
-	snd_ctl_elem_value_set_name(val, HW_MULTI_CAPTURE_SWITCH);
 	nb_active_channels = 0;
-	for (i = 0; i < input_channels; i++) {
-		snd_ctl_elem_value_set_numid(val, 0);
-		snd_ctl_elem_value_set_index(val, i);
-		if (snd_ctl_elem_read(ctl, val) < 0)
+	for (i = MAX_PCM_OUTPUT_CHANNELS + MAX_SPDIF_CHANNELS; i < MAX_PCM_OUTPUT_CHANNELS + MAX_SPDIF_CHANNELS + input_channels; i++) {
+		if (envy24_switch_get(ctl, i + 1, &v[0], &v[1]) < 0)
 			continue;
 
-		stream_is_active[i + MAX_PCM_OUTPUT_CHANNELS + MAX_SPDIF_CHANNELS] = 1;
+		stream_is_active[i] = 1;
 		nb_active_channels++;
 	}
 	input_channels = nb_active_channels;
-	snd_ctl_elem_value_set_name(val, IEC958_MULTI_CAPTURE_SWITCH);
-	for (i = 0; i < spdif_channels; i++) {
-		snd_ctl_elem_value_set_numid(val, 0);
-		snd_ctl_elem_value_set_index(val, i);
- 		if (snd_ctl_elem_read(ctl, val) < 0)
+	for (i = MAX_PCM_OUTPUT_CHANNELS + MAX_SPDIF_CHANNELS + MAX_INPUT_CHANNELS; i < MAX_PCM_OUTPUT_CHANNELS + MAX_SPDIF_CHANNELS + MAX_INPUT_CHANNELS + spdif_channels; i++) {
+ 		if (envy24_switch_get(ctl, i + 1, &v[0], &v[1]) < 0)
 			continue;
-		stream_is_active[i + MAX_PCM_OUTPUT_CHANNELS + MAX_SPDIF_CHANNELS + MAX_INPUT_CHANNELS] = 1;
+		stream_is_active[i] = 1;
 	}
 }
 
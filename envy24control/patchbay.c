@@ -19,9 +19,6 @@
 
 #include "envy24control.h"
 
-#define SPDIF_PLAYBACK_ROUTE_NAME	"IEC958 Playback Route"
-#define ANALOG_PLAYBACK_ROUTE_NAME	"H/W Playback Route"
-
 #define toggle_set(widget, state) \
 	gtk_check_button_set_active(GTK_CHECK_BUTTON(widget), state);
 
@@ -35,32 +32,21 @@ static int is_active(GtkWidget *widget)
 
 static int get_toggle_index(int stream)
 {
-	int err, out;
-	snd_ctl_elem_value_t *val;
+	int out;
 
-	stream--;
-	if (stream < 0 || stream > 9) {
+	if (stream < 1 || stream > ENVY24_ROUTE_STREAMS) {
 		g_print("get_toggle_index (1)\n");
 		return 0;
 	}
-	snd_ctl_elem_value_alloca(&val);
-	snd_ctl_elem_value_set_interface(val, SND_CTL_ELEM_IFACE_MIXER);
-	if (stream >= MAX_OUTPUT_CHANNELS) {
-		snd_ctl_elem_value_set_name(val, SPDIF_PLAYBACK_ROUTE_NAME);
-		snd_ctl_elem_value_set_index(val, stream - MAX_OUTPUT_CHANNELS);
-	} else {
-		snd_ctl_elem_value_set_name(val, ANALOG_PLAYBACK_ROUTE_NAME);
-		snd_ctl_elem_value_set_index(val, stream);
-	}
-	if ((err = snd_ctl_elem_read(ctl, val)) < 0)
+	if ((out = envy24_route_get(ctl, stream)) < 0)
 		return 0;
-	out = snd_ctl_elem_value_get_enumerated(val, 0);
-	if (out >= MAX_INPUT_CHANNELS + MAX_SPDIF_CHANNELS + 1) {
+	stream--;
+	if (out >= ENVY24_ROUTE_MIXER) {
 		if (stream >= MAX_PCM_OUTPUT_CHANNELS || stream < MAX_SPDIF_CHANNELS)
 			return 1; /* digital mixer */
-	} else if (out >= MAX_INPUT_CHANNELS + 1)
-		return out - (MAX_INPUT_CHANNELS + 1) + 2; /* spdif left (=2) / right (=3) */
-	else if (out >= 1)
+	} else if (out >= ENVY24_ROUTE_SPDIF)
+		return out - ENVY24_ROUTE_SPDIF + 2; /* spdif left (=2) / right (=3) */
+	else if (out >= ENVY24_ROUTE_ANALOG)
 		return out + spdif_channels + 1; /* analog (4-) */
 
 	return 0; /* pcm */
@@ -81,36 +67,23 @@ void patchbay_update(void)
 static void set_routes(int stream, int idx)
 {
 	int err;
-	unsigned int out;
-	snd_ctl_elem_value_t *val;
+	int out;
 
-	stream--;
-	if (stream < 0 || stream > 9) {
+	if (stream < 1 || stream > ENVY24_ROUTE_STREAMS) {
 		g_print("set_routes (1)\n");
 		return;
 	}
-	if (! stream_active[stream])
+	if (! stream_active[stream - 1])
 		return;
-	out = 0;
+	out = ENVY24_ROUTE_PCM;
 	if (idx == 1)
-		out = MAX_INPUT_CHANNELS + MAX_SPDIF_CHANNELS + 1;
+		out = ENVY24_ROUTE_MIXER;
 	else if (idx == 2 || idx == 3)	/* S/PDIF left & right */
 		out = idx + 7; /* 9-10 */
 	else if (idx >= 4) /* analog */
 		out = idx - 3; /* 1-8 */
 
-	snd_ctl_elem_value_alloca(&val);
-	snd_ctl_elem_value_set_interface(val, SND_CTL_ELEM_IFACE_MIXER);
-	if (stream >= MAX_OUTPUT_CHANNELS) {
-		snd_ctl_elem_value_set_name(val, SPDIF_PLAYBACK_ROUTE_NAME);
-		snd_ctl_elem_value_set_index(val, stream - MAX_OUTPUT_CHANNELS);
-	} else {
-		snd_ctl_elem_value_set_name(val, ANALOG_PLAYBACK_ROUTE_NAME);
-		snd_ctl_elem_value_set_index(val, stream);
-	}
-
-	snd_ctl_elem_value_set_enumerated(val, 0, out);
-	if ((err = snd_ctl_elem_write(ctl, val)) < 0)
+	if ((err = envy24_route_set(ctl, stream, out)) < 0)
 		g_print("Multi track route write error: %s\n", snd_strerror(err));
 }
 
@@ -132,29 +105,20 @@ void patchbay_init(void)
 {
 	int i;
 	int nb_active_channels;
-	snd_ctl_elem_value_t *val;
 
-	snd_ctl_elem_value_alloca(&val);
-	snd_ctl_elem_value_set_interface(val, SND_CTL_ELEM_IFACE_MIXER);
-	snd_ctl_elem_value_set_name(val, ANALOG_PLAYBACK_ROUTE_NAME);
 	memset (stream_active, 0, (MAX_OUTPUT_CHANNELS + MAX_SPDIF_CHANNELS) * sizeof(int));
 	nb_active_channels = 0;
 	for (i = 0; i < output_channels; i++) {
-		snd_ctl_elem_value_set_numid(val, 0);
-		snd_ctl_elem_value_set_index(val, i);
-		if (snd_ctl_elem_read(ctl, val) < 0)
+		if (envy24_route_get(ctl, i + 1) < 0)
 			continue;
 
 		stream_active[i] = 1;
 		nb_active_channels++;
 	}
 	output_channels = nb_active_channels;
-	snd_ctl_elem_value_set_name(val, SPDIF_PLAYBACK_ROUTE_NAME);
 	nb_active_channels = 0;
 	for (i = 0; i < spdif_channels; i++) {
-		snd_ctl_elem_value_set_numid(val, 0);
-		snd_ctl_elem_value_set_index(val, i);
- 		if (snd_ctl_elem_read(ctl, val) < 0)
+ 		if (envy24_route_get(ctl, i + MAX_OUTPUT_CHANNELS + 1) < 0)
 			continue;
 		stream_active[i + MAX_OUTPUT_CHANNELS] = 1;
 		nb_active_channels++;
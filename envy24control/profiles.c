@@ -1,6 +1,6 @@
 /*
  *  Advanced Linux Sound Architecture part of envy24control
- *  handle profiles for envy24control using alsactl
+ *  handle profiles for envy24control
  * 
  *  Copyright (c) by Dirk Kalis <dirk.kalis@t-online.de>
  *
@@ -25,9 +25,6 @@
 #include "envy24control.h"
 #undef __PROFILES_C__
 
-/* include string search function */
-#include "strstr_icase_blank.c"
-
 /* include forking process function */
 #include "new_process.c"
 
@@ -92,90 +89,6 @@ int which_cfgfile(char ** const cfgfile)
 	return res;
 }
 
-int get_file_size(const char * const filename)
-{
-	struct stat file_status;
-
-	if (filename_without_tilde != filename) {
-		strncpy(filename_without_tilde, filename, MAX_FILE_NAME_LENGTH);
-	}
-	filename_without_tilde[MAX_FILE_NAME_LENGTH - 1] = '\0';
-	subst_tilde_in_filename(filename_without_tilde);
-	if (stat(filename_without_tilde, &file_status) < 0) {
-		fprintf(stderr, "Cannot find file '%s'.\n", filename);
-		return -errno;
-	}
-
-	return (int)file_status.st_size;
-}
-
-int read_profiles_in_buffer(const char * const cfgfile, void * const buffer, const size_t max_length)
-{
-	int res;
-	int inputFile;
-
-	if ((inputFile = open(cfgfile, O_RDONLY)) < 0) {
-		fprintf(stderr, "warning: can't open profiles file '%s' for reading.\n", cfgfile);
-		return -errno;
-	}
-	res = read(inputFile, buffer, max_length);
-	close(inputFile);
-	*(char *)(buffer + max_length - 1) = '\0';
-	if (res == max_length) {
-		fprintf(stderr, "warning: profiles file '%s' has maximum size reached.\n", cfgfile);
-		fprintf(stderr, "\tThe defined value for MAX_PROFILE_SIZE must be increased in 'profiles.h'.\n");
-		fprintf(stderr, "\tThen you must recompile the '%s' tool.\n", PROGRAM_NAME);
-		fprintf(stderr, "\tThe current value is %d.\n", MAX_PROFILE_SIZE);
-	}
-
-	return res;
-}
-
-/*
- * write buffer with max_length to cfgfile
- * with introduction if with_intro != 0
- */
-int write_profiles_from_buffer(const char * const cfgfile, const void * const buffer, const size_t max_length, const int with_intro)
-{
-	int res, length;
-	time_t date_time[MAX_NUM_STR_LENGTH];
-	char introduction_part[MAX_SEARCH_FIELD_LENGTH];
-	int outputFile;
-
-	if ((outputFile = open(cfgfile, O_WRONLY | O_CREAT | O_TRUNC | 0400000 /* O_NOFOLLOW */, FILE_CREA_MODE)) < 0) {
-		fprintf(stderr, "warning: can't open profiles file '%s' for writing.\n", cfgfile);
-		return -errno;
-	}
-	length = max_length > strlen(buffer) ? strlen(buffer) : max_length;
-	time(date_time);
-	snprintf(introduction_part, MAX_SEARCH_FIELD_LENGTH, "%s'%s'%s%s%s'%s'%s%s%s%s%s%s%s%s%s\n", \
-							"#\n" \
-				   			"# This file is automatically generated by ", PROGRAM_NAME, " at ", \
-											(char *) asctime(localtime(date_time)), \
-							"# Do not edit this file manually. This file will be permanently overwritten.\n" \
-							"# Use ", PROGRAM_NAME, " to modify and store settings.\n" \
-							"#\n" \
-							"# File-Structure:\n" \
-							"# ", PROFILE_HEADER_TEMPL, "\t\t- profile header\n" \
-							"#\t", CARD_HEADER_TEMPL, "\t- card header\n" \
-							"#\t", PROFILE_NAME_TEMPL, "\t\t- profile name - optional\n" \
-							"#\t\t***********************************\n" \
-							"#\t\t***** ALSA code for this card *****\n" \
-							"#\t\t***********************************\n" \
-							"#\t", CARD_FOOTER_TEMPL, "\t- card footer\n" \
-							"#\n");
-
-	introduction_part[MAX_SEARCH_FIELD_LENGTH - 1] = '\0';
-	if (with_intro)
-		res = write(outputFile, introduction_part, strlen(introduction_part));
-	res = write(outputFile, buffer, length);
-	close(outputFile);
-	if (res < 0) {
-		fprintf(stderr, "warning: can't write profiles file '%s'.\n", cfgfile);
-	}
-
-	return res;
-}
 
 int create_dir_from_filename(const char * const filename)
 {
@@ -227,397 +140,472 @@ int compose_search_string(char * const search_string, const char * const templ,
 	return res;
 }
 
-/* search backwards first newline - start of line is position after newline */
-int get_start_of_line(const char * const buffer, const int offset)
-{
-	int begin_of_line;
 
-	for (begin_of_line = offset; begin_of_line >= 0; begin_of_line--)
-	{
-		if (buffer[begin_of_line] == '\n')
-			break;
-	}
-	begin_of_line++;
+/*
+ * growing text buffer used to compose card settings and profiles files
+ */
+struct profile_text {
+	char *data;
+	size_t length;
+	size_t size;
+};
 
-	return begin_of_line;
-}
+/*
+ * one card section of a profile
+ * settings point into the buffer of the store or to fresh captured settings
+ */
+struct profile_section {
+	int profile_number;
+	int card_number;
+	char name[PROFILE_NAME_FIELD_LENGTH];
+	const char *settings;
+	size_t settings_length;
+};
 
 /*
- * search tokens sequential for the furthest token backwards from section_end
- * tokens should be specified from nearest token to the furthest
+ * profiles file parsed in one pass into an index of card sections
+ * the index is reused as long as the file is unchanged on disk
  */
-int get_begin_of_section(const char * const buffer, char * const section_tokens, const char * const token_sep, const int section_end)
+struct profile_store {
+	char filename[MAX_FILE_NAME_LENGTH];
+	struct stat status;
+	char *buffer;
+	size_t length;
+	struct profile_section *sections;
+	int count;
+	int allocated;
+};
+
+enum {
+	PROFILE_LINE_SETTINGS,
+	PROFILE_LINE_COMMENT,
+	PROFILE_LINE_PROFILE,
+	PROFILE_LINE_CARD,
+	PROFILE_LINE_FOOTER,
+	PROFILE_LINE_NAME
+};
+
+static struct profile_store store;
+
+static int text_reserve(struct profile_text * const text, const size_t length)
 {
-	char *search_token;
-	int pos_start_of_section, pos_end_of_section, pos_end_of_search;
+	size_t size;
+	char *data;
 
-	search_token = strtok(section_tokens, token_sep);
+	if (text->length + length + 1 <= text->size)
+		return EXIT_SUCCESS;
+	size = text->size ? text->size : MAX_SEARCH_FIELD_LENGTH;
+	while (size < text->length + length + 1)
+		size *= 2;
+	if ((data = realloc(text->data, size)) == NULL)
+		return -ENOBUFS;
+	text->data = data;
+	text->size = size;
+	return EXIT_SUCCESS;
+}
 
-	pos_end_of_search = section_end;
-	do
-	{
-		pos_start_of_section = 0;
-		pos_end_of_section = 0;
-		while ((pos_start_of_section = strstr_icase_blank(buffer + pos_end_of_section, search_token)) < pos_end_of_search - pos_end_of_section)
-		{
-			if (pos_start_of_section < 0)
-				break;
-			pos_end_of_section += pos_start_of_section;
-			pos_end_of_section++;
-		}
-		pos_end_of_section--;
-		pos_start_of_section = pos_end_of_section;
-		pos_end_of_search = pos_end_of_section;
-		if (pos_start_of_section < 0) {
-			pos_start_of_section = NOTFOUND;
-			// fprintf(stderr, "Begin of section for '%s' can't be found\n", search_token);
-			return pos_start_of_section;
-		}
-	} while ((search_token = strtok(NULL, token_sep)) != NULL);
+static int text_append(struct profile_text * const text, const char * const data, const size_t length)
+{
+	int res;
 
-	return pos_start_of_section;
+	if ((res = text_reserve(text, length)) < 0)
+		return res;
+	memcpy(text->data + text->length, data, length);
+	text->length += length;
+	text->data[text->length] = '\0';
+	return EXIT_SUCCESS;
 }
 
-/*
- * search tokens sequential for the nearest token from section_begin
- * tokens should be specified from furthest token to the nearest
- */
-int get_end_of_section(const char * const buffer, char * const section_tokens, const char * const token_sep, const int section_begin)
+static int text_printf(struct profile_text * const text, const char * const format, ...)
 {
-	char *search_token;
-	int pos_end_of_section, pos_end_of_search;
-
-	search_token = strtok(section_tokens, token_sep);
+	va_list args;
+	int length, res;
 
-	pos_end_of_section = strlen(buffer);
-	do
-	{
-		pos_end_of_search = strstr_icase_blank(buffer + section_begin, search_token);
-		if (!((pos_end_of_search < 0) || (pos_end_of_search > pos_end_of_section))) {
-			pos_end_of_section = pos_end_of_search;
-		}
-	} while ((search_token = strtok(NULL, token_sep)) != NULL);
+	va_start(args, format);
+	length = vsnprintf(NULL, 0, format, args);
+	va_end(args);
+	if (length < 0)
+		return -EINVAL;
+	if ((res = text_reserve(text, length)) < 0)
+		return res;
+	va_start(args, format);
+	vsnprintf(text->data + text->length, length + 1, format, args);
+	va_end(args);
+	text->length += length;
+	return EXIT_SUCCESS;
+}
 
-	return pos_end_of_section == strlen(buffer) ? pos_end_of_section : pos_end_of_section + section_begin;
+static void text_free(struct profile_text * const text)
+{
+	free(text->data);
+	text->data = NULL;
+	text->length = 0;
+	text->size = 0;
 }
 
-int get_profile_begin(const char * const buffer, const int profile_number)
+/* compose header from template and number and append it as own line */
+static int text_append_header(struct profile_text * const text, const char * const templ, const int number)
 {
-	char header[MAX_SEARCH_FIELD_LENGTH], profile_or_card_number_as_str[MAX_NUM_STR_LENGTH];
-	char place_holder;
-
-	/* compose profile header */
-	place_holder = PLACE_HOLDER_NUM;
-	snprintf(profile_or_card_number_as_str, MAX_NUM_STR_LENGTH, "%d", profile_number);
-	profile_or_card_number_as_str[MAX_NUM_STR_LENGTH - 1] = '\0';
-	compose_search_string(header, PROFILE_HEADER_TEMPL, profile_or_card_number_as_str, place_holder, MAX_SEARCH_FIELD_LENGTH);
+	char header[MAX_SEARCH_FIELD_LENGTH], number_as_str[MAX_NUM_STR_LENGTH];
+
+	snprintf(number_as_str, MAX_NUM_STR_LENGTH, "%d", number);
+	number_as_str[MAX_NUM_STR_LENGTH - 1] = '\0';
+	compose_search_string(header, templ, number_as_str, PLACE_HOLDER_NUM, MAX_SEARCH_FIELD_LENGTH);
 	header[MAX_SEARCH_FIELD_LENGTH - 1] = '\0';
-	return strstr_icase_blank(buffer, header);
+	return text_printf(text, "%s\n", header);
 }
 
-int get_profile_end(const char * const buffer, const int profile_number)
+static int text_append_introduction(struct profile_text * const text)
 {
-	char header[MAX_SEARCH_FIELD_LENGTH];
-	char place_holder;
-	int pos_profile_begin;
-
-	if ((pos_profile_begin = get_profile_begin(buffer, profile_number)) < 0)
-		return pos_profile_begin;
-	place_holder = PLACE_HOLDER_NUM;
-	strncpy(header, PROFILE_HEADER_TEMPL, MAX_SEARCH_FIELD_LENGTH);
-	header[MAX_SEARCH_FIELD_LENGTH - 1] = '\0';
-	*strchr(header, place_holder) = '\0';
-	return get_end_of_section(buffer, header, TOKEN_SEP, pos_profile_begin + sizeof(char));
+	time_t date_time;
+
+	time(&date_time);
+	return text_printf(text, "%s'%s'%s%s%s'%s'%s%s%s%s%s%s%s%s%s\n", \
+							"#\n" \
+				   			"# This file is automatically generated by ", PROGRAM_NAME, " at ", \
+											(char *) asctime(localtime(&date_time)), \
+							"# Do not edit this file manually. This file will be permanently overwritten.\n" \
+							"# Use ", PROGRAM_NAME, " to modify and store settings.\n" \
+							"#\n" \
+							"# File-Structure:\n" \
+							"# ", PROFILE_HEADER_TEMPL, "\t\t- profile header\n" \
+							"#\t", CARD_HEADER_TEMPL, "\t- card header\n" \
+							"#\t", PROFILE_NAME_TEMPL, "\t\t- profile name - optional\n" \
+							"#\t\t***********************************\n" \
+							"#\t\t***** ALSA code for this card *****\n" \
+							"#\t\t***********************************\n" \
+							"#\t", CARD_FOOTER_TEMPL, "\t- card footer\n" \
+							"#\n");
 }
 
-int get_card_begin(const char * const buffer, const int profile_number, const int card_number)
+/*
+ * classify one line of the profiles file
+ * headers are compared ignoring case and number of blanks like strstr_icase_blank
+ */
+static int classify_line(const char * const line, const size_t length, int * const number, char * const name)
 {
-	char header[MAX_SEARCH_FIELD_LENGTH], profile_or_card_number_as_str[MAX_NUM_STR_LENGTH];
-	char place_holder;
-	int pos_profile_begin, pos_profile_end, pos_card_begin;
-
-	if ((pos_profile_begin = get_profile_begin(buffer, profile_number)) < 0)
-		return pos_profile_begin;
-	pos_profile_end = get_profile_end(buffer, profile_number);
-
-	/* compose card header */
-	place_holder = PLACE_HOLDER_NUM;
-	snprintf(profile_or_card_number_as_str, MAX_NUM_STR_LENGTH, "%d", card_number);
-	profile_or_card_number_as_str[MAX_NUM_STR_LENGTH - 1] = '\0';
-	compose_search_string(header, CARD_HEADER_TEMPL, profile_or_card_number_as_str, place_holder, MAX_SEARCH_FIELD_LENGTH);
-	header[MAX_SEARCH_FIELD_LENGTH - 1] = '\0';
-	if ((pos_card_begin = strstr_icase_blank(buffer + pos_profile_begin, header)) < 0)
-		return pos_card_begin;
-	if ((pos_card_begin += pos_profile_begin) > pos_profile_end)
-		return NOTFOUND;
-	return pos_card_begin;
+	char normalized[MAX_SEARCH_FIELD_LENGTH];
+	const char *name_begin, *name_end;
+	size_t i, j;
+	char last;
+
+	for (i = 0, j = 0; (i < length) && (j < sizeof(normalized) - 1); i++)
+	{
+		if (isspace((unsigned char)line[i])) {
+			if ((j > 0) && (normalized[j - 1] != SEP_CHAR))
+				normalized[j++] = SEP_CHAR;
+			continue;
+		}
+		normalized[j++] = (char)toupper((unsigned char)line[i]);
+	}
+	normalized[j] = '\0';
+
+	if ((j == 0) || (normalized[0] == '#'))
+		return PROFILE_LINE_COMMENT;
+	if ((sscanf(normalized, "[ PROFILE %d %c", number, &last) == 2) && (last == ']'))
+		return PROFILE_LINE_PROFILE;
+	if ((sscanf(normalized, "< CARD %d %c", number, &last) == 2) && (last == '>'))
+		return PROFILE_LINE_CARD;
+	if ((sscanf(normalized, "< /CARD %d %c", number, &last) == 2) && (last == '>'))
+		return PROFILE_LINE_FOOTER;
+	if (normalized[0] == '{' && (name_begin = memchr(line, '/', length)) != NULL) {
+		name_begin++;
+		for (name_end = line + length; name_end > name_begin; name_end--)
+		{
+			if (name_end[-1] == '/')
+				break;
+		}
+		if (name_end > name_begin) {
+			j = name_end - 1 - name_begin;
+			if (j > MAX_PROFILE_NAME_LENGTH)
+				j = MAX_PROFILE_NAME_LENGTH;
+			memcpy(name, name_begin, j);
+			name[j] = '\0';
+			return PROFILE_LINE_NAME;
+		}
+	}
+	return PROFILE_LINE_SETTINGS;
 }
 
-int get_card_end(const char * const buffer, const int profile_number, const int card_number)
+static void store_clear(struct profile_store * const store)
 {
-	char header[MAX_SEARCH_FIELD_LENGTH], profile_or_card_number_as_str[MAX_NUM_STR_LENGTH];
-	char place_holder;
-	int pos_card_begin;
-
-	if ((pos_card_begin = get_card_begin(buffer, profile_number, card_number)) < 0)
-		return pos_card_begin;
-	/* searching "[ profile | < card | < /card # >" */
-	/* add "[ profile |" to search_field */
-	place_holder = PLACE_HOLDER_NUM;
-	snprintf(profile_or_card_number_as_str, MAX_NUM_STR_LENGTH, "%d", card_number);
-	profile_or_card_number_as_str[MAX_NUM_STR_LENGTH - 1] = '\0';
-	strncpy(header, PROFILE_HEADER_TEMPL, MAX_SEARCH_FIELD_LENGTH);
-	*strchr(header, place_holder) = '\0';
-	strncpy(header + strlen(header), TOKEN_SEP, MAX_SEARCH_FIELD_LENGTH - strlen(header));
-	header[MAX_SEARCH_FIELD_LENGTH - 1] = '\0';
-	/* add "< card |" to header */
-	strncpy(header + strlen(header), CARD_HEADER_TEMPL, MAX_SEARCH_FIELD_LENGTH - strlen(header));
-	*strchr(header, place_holder) = '\0';
-	strncpy(header + strlen(header), TOKEN_SEP, MAX_SEARCH_FIELD_LENGTH - strlen(header));
-	header[MAX_SEARCH_FIELD_LENGTH - 1] = '\0';
-	/* add "< /card # >" to header */
-	compose_search_string(header + strlen(header), CARD_FOOTER_TEMPL, profile_or_card_number_as_str, place_holder, MAX_SEARCH_FIELD_LENGTH - strlen(header));
-	header[MAX_SEARCH_FIELD_LENGTH - 1] = '\0';
-	return get_end_of_section(buffer, header, TOKEN_SEP, pos_card_begin + sizeof(char));
+	free(store->buffer);
+	free(store->sections);
+	memset(store, 0, sizeof(*store));
 }
 
-int get_pos_for_next_card(const char * const buffer, const int profile_number, const int card_number)
+static struct profile_section *store_add_section(struct profile_store * const store)
 {
-	char header[MAX_SEARCH_FIELD_LENGTH], profile_or_card_number_as_str[MAX_NUM_STR_LENGTH];
-	char place_holder;
-	int pos_next_card;
-
-	if ((pos_next_card = get_card_end(buffer, profile_number, card_number)) < 0)
-		return pos_next_card;
-	/* add "< /card # >" to header */
-	place_holder = PLACE_HOLDER_NUM;
-	snprintf(profile_or_card_number_as_str, MAX_NUM_STR_LENGTH, "%d", card_number);
-	profile_or_card_number_as_str[MAX_NUM_STR_LENGTH - 1] = '\0';
-	compose_search_string(header, CARD_FOOTER_TEMPL, profile_or_card_number_as_str, place_holder, MAX_SEARCH_FIELD_LENGTH);
-	header[MAX_SEARCH_FIELD_LENGTH - 1] = '\0';
-	if (strstr_icase_blank(buffer + pos_next_card, header) == 0) {
-		while((buffer[pos_next_card] != '\n') && (buffer[pos_next_card] != '\0'))
-			pos_next_card++;
-		if (buffer[pos_next_card] == '\n')
-			pos_next_card++;
+	struct profile_section *sections;
+	int allocated;
+
+	if (store->count >= store->allocated) {
+		allocated = store->allocated ? store->allocated * 2 : MAX_PROFILES * 2;
+		if ((sections = realloc(store->sections, allocated * sizeof(*sections))) == NULL)
+			return NULL;
+		store->sections = sections;
+		store->allocated = allocated;
 	}
-	return pos_next_card;
+	sections = &store->sections[store->count++];
+	memset(sections, 0, sizeof(*sections));
+	return sections;
 }
 
-int get_number_from_header(const char * const header_string)
+static struct profile_section *store_find_section(const struct profile_store * const store, const int profile_number, const int card_number)
 {
-	char string[MAX_SEARCH_FIELD_LENGTH];
-	char number_string[MAX_NUM_STR_LENGTH];
-	char *pos_number;
-
-	strncpy(string, header_string, MAX_SEARCH_FIELD_LENGTH);
-	string[MAX_SEARCH_FIELD_LENGTH - 1] = '\0';
+	int idx;
 
-	if ((pos_number = strpbrk(string, "0123456789")) == NULL) {
-		return -EINVAL;
-	} else {
-		strncpy(number_string, pos_number, MAX_NUM_STR_LENGTH);
-		number_string[MAX_NUM_STR_LENGTH - 1] = '\0';
+	for (idx = 0; idx < store->count; idx++)
+	{
+		if ((store->sections[idx].profile_number == profile_number) &&
+		    (store->sections[idx].card_number == card_number))
+			return &store->sections[idx];
 	}
-
-	return atoi(number_string);
+	return NULL;
 }
 
-char *get_profile_name_from_header(const char * const header_string)
+static void section_close(struct profile_section * const section, const char * const end)
 {
-	char string[MAX_SEARCH_FIELD_LENGTH];
-	char header_templ[MAX_SEARCH_FIELD_LENGTH];
-	char left_name_border;
-
-	memset(profile_name, '\0', PROFILE_NAME_FIELD_LENGTH);
-	strncpy(string, header_string, MAX_SEARCH_FIELD_LENGTH);
-	string[MAX_SEARCH_FIELD_LENGTH - 1] = '\0';
-	strncpy(header_templ, PROFILE_NAME_TEMPL, MAX_SEARCH_FIELD_LENGTH);
-	header_templ[MAX_SEARCH_FIELD_LENGTH - 1] = '\0';
-	string[strstr_icase_blank(string, strchr(header_templ, PLACE_HOLDER_STR) + sizeof(char))] = '\0';
-	left_name_border = *(strchr(header_templ, PLACE_HOLDER_STR) - sizeof(char));
-	strncpy(profile_name, strchr(string + sizeof(char), left_name_border) + sizeof(char), PROFILE_NAME_FIELD_LENGTH);
-	profile_name[PROFILE_NAME_FIELD_LENGTH - 1] = '\0';
-
-	return profile_name;
+	if (section != NULL)
+		section->settings_length = end - section->settings;
 }
 
-/* search max card number in profile */
-int get_max_card_number_in_profile(const char * const buffer, const int profile_number)
+/*
+ * build the index of card sections in one pass over the buffer
+ * if a card occurs twice in one profile the first section is used
+ */
+static int store_parse(struct profile_store * const store)
 {
-	char header[MAX_SEARCH_FIELD_LENGTH];
-	char place_holder;
-	int pos_card_next, pos_profile_end, pos_card_begin, card_number, card_number_max;
-
-	place_holder = PLACE_HOLDER_NUM;
-	card_number_max = NOTFOUND;
-	strncpy(header, CARD_HEADER_TEMPL, MAX_SEARCH_FIELD_LENGTH);
-	header[MAX_SEARCH_FIELD_LENGTH - 1] = '\0';
-	*strchr(header, place_holder) = '\0';
-	pos_card_next = get_profile_begin(buffer, profile_number);
-	pos_profile_end = get_profile_end(buffer, profile_number);
-	while ((pos_card_begin = strstr_icase_blank(buffer + pos_card_next, header)) >= 0)
+	struct profile_section *section = NULL;
+	const char *line, *next, *end;
+	char name[PROFILE_NAME_FIELD_LENGTH];
+	int profile_number = NOTFOUND, number;
+
+	store->count = 0;
+	end = store->buffer + store->length;
+	for (line = store->buffer; line < end; line = next)
 	{
-		if ((pos_card_begin += pos_card_next) > pos_profile_end)
+		if ((next = memchr(line, '\n', end - line)) == NULL)
+			next = end;
+		else
+			next++;
+		switch (classify_line(line, next - line, &number, name)) {
+		case PROFILE_LINE_PROFILE:
+			section_close(section, line);
+			section = NULL;
+			profile_number = number;
+			break;
+		case PROFILE_LINE_CARD:
+			section_close(section, line);
+			section = NULL;
+			if ((profile_number < 1) || (profile_number > MAX_PROFILES) ||
+			    (store_find_section(store, profile_number, number) != NULL))
+				break;
+			if ((section = store_add_section(store)) == NULL)
+				return -ENOBUFS;
+			section->profile_number = profile_number;
+			section->card_number = number;
+			section->settings = next;
+			break;
+		case PROFILE_LINE_NAME:
+			if (section != NULL) {
+				strncpy(section->name, name, PROFILE_NAME_FIELD_LENGTH);
+				section->name[PROFILE_NAME_FIELD_LENGTH - 1] = '\0';
+				section->settings = next;
+			}
+			break;
+		case PROFILE_LINE_FOOTER:
+			section_close(section, line);
+			section = NULL;
 			break;
-		pos_card_next = pos_card_begin + sizeof(char);
-		card_number = get_number_from_header(buffer + pos_card_begin);
-		if (card_number > card_number_max)
-			card_number_max = card_number;
+		default:
+			break;
+		}
 	}
-	return card_number_max;
+	section_close(section, end);
+	return EXIT_SUCCESS;
 }
 
-int get_pos_name_header_from_card(const char * const buffer, const int profile_number, const int card_number)
+/*
+ * bring the index up to date with the profiles file
+ * the file is only read and parsed again if it was changed on disk
+ * a missing file gives an empty store and -ENOENT
+ */
+static int store_load(struct profile_store * const store, const char * const cfgfile)
 {
-	char header[MAX_SEARCH_FIELD_LENGTH];
-	char place_holder;
-	int pos_card_begin, pos_card_end, pos_name_header;
-
-	if ((pos_card_begin = get_card_begin(buffer, profile_number, card_number)) < 0)
-		return pos_card_begin;
-	pos_card_end = get_card_end(buffer, profile_number, card_number);
-	place_holder = PLACE_HOLDER_STR;
-	strncpy(header, PROFILE_NAME_TEMPL, MAX_SEARCH_FIELD_LENGTH);
-	*strchr(header, place_holder) = '\0';
-	header[MAX_SEARCH_FIELD_LENGTH - 1] = '\0';
-	if ((pos_name_header = strstr_icase_blank(buffer + pos_card_begin, header)) >= 0) {
-		if ((pos_name_header += pos_card_begin) < pos_card_end) {
-			return pos_name_header;
-		}
+	struct stat file_status;
+	char *buffer;
+	size_t length;
+	ssize_t res;
+	int inputFile;
+
+	if (stat(cfgfile, &file_status) < 0) {
+		res = -errno;
+		store_clear(store);
+		return res;
 	}
-	return NOTFOUND;
-}
+	if ((store->buffer != NULL) && !strcmp(store->filename, cfgfile) &&
+	    (file_status.st_dev == store->status.st_dev) &&
+	    (file_status.st_ino == store->status.st_ino) &&
+	    (file_status.st_size == store->status.st_size) &&
+	    (file_status.st_mtime == store->status.st_mtime))
+		return EXIT_SUCCESS;
 
-int get_begin_of_alsa_section(const char * const buffer, const int profile_number, const int card_number)
-{
-	char search_string[MAX_SEARCH_FIELD_LENGTH];
-	int card_section_begin, card_section_end;
-	int begin_of_alsa_section, pos_after_alsa_section;
-
-	if ((card_section_begin = get_card_begin(buffer, profile_number, card_number)) < 0)
-		return card_section_begin;
-	card_section_end = get_card_end(buffer, profile_number, card_number);
-	strncpy(search_string, PROFILE_NAME_TEMPL, MAX_SEARCH_FIELD_LENGTH);
-	search_string[MAX_SEARCH_FIELD_LENGTH -1] = '\0';
-	*strchr(search_string, PLACE_HOLDER_STR) = '\0';
-
-	pos_after_alsa_section = get_start_of_line(buffer, card_section_end);
-
-	begin_of_alsa_section = strstr_icase_blank(buffer + card_section_begin, search_string);
-	begin_of_alsa_section = begin_of_alsa_section < 0 ? card_section_begin : begin_of_alsa_section + card_section_begin;
-	if (begin_of_alsa_section > pos_after_alsa_section)
-		begin_of_alsa_section = card_section_begin;
-	while (begin_of_alsa_section < pos_after_alsa_section)
+	if ((inputFile = open(cfgfile, O_RDONLY)) < 0) {
+		fprintf(stderr, "warning: can't open profiles file '%s' for reading.\n", cfgfile);
+		return -errno;
+	}
+	if ((buffer = malloc(file_status.st_size + 1)) == NULL) {
+		close(inputFile);
+		fprintf(stderr, "Cannot allocate memory for reading profiles.\n");
+		return -ENOBUFS;
+	}
+	for (length = 0; length < (size_t)file_status.st_size; length += res)
 	{
-		if (buffer[begin_of_alsa_section] == '\n') {
-			begin_of_alsa_section++;
+		if ((res = read(inputFile, buffer + length, file_status.st_size - length)) < 0) {
+			if (errno == EINTR) {
+				res = 0;
+				continue;
+			}
 			break;
 		}
-		begin_of_alsa_section++;
+		if (res == 0)
+			break;
 	}
-
-	if (begin_of_alsa_section >= pos_after_alsa_section)
-		begin_of_alsa_section = NOTFOUND;
-
-	return begin_of_alsa_section;
+	close(inputFile);
+	buffer[length] = '\0';
+
+	store_clear(store);
+	store->buffer = buffer;
+	store->length = length;
+	store->status = file_status;
+	strncpy(store->filename, cfgfile, MAX_FILE_NAME_LENGTH);
+	store->filename[MAX_FILE_NAME_LENGTH - 1] = '\0';
+	if ((res = store_parse(store)) < 0) {
+		fprintf(stderr, "Cannot allocate memory for reading profiles.\n");
+		store_clear(store);
+	}
+	return res;
 }
 
-int reorganize_profiles(char * const buffer, const int max_length)
+static int write_buffer_to_file(const char * const filename, const char * const buffer, const size_t length)
 {
-	int profile_number, card_number, card_number_max;
-	int res;
-	int pos_profile_begin, pos_card_begin, pos_card_end, pos_name_header;
-	int pos_alsa_section_begin, pos_after_alsa_section;
-	char header[MAX_SEARCH_FIELD_LENGTH];
-	void *buffer_copy = NULL;
-	char profile_or_card_number_as_str[MAX_NUM_STR_LENGTH];
-	char place_holder;
-
-	if ((buffer_copy = malloc(max_length)) == NULL) {
-		res = -ENOBUFS;
-		profile_number = res;
-		fprintf(stderr, "Cannot allocate memory for reorganize profiles.\n");
-		return res;
+	size_t written;
+	ssize_t res;
+	int outputFile;
+
+	if ((outputFile = open(filename, O_WRONLY | O_CREAT | O_TRUNC | O_NOFOLLOW, FILE_CREA_MODE)) < 0) {
+		fprintf(stderr, "warning: can't open file '%s' for writing.\n", filename);
+		return -errno;
 	}
-	memset(buffer_copy, '\0', max_length);
-	for (profile_number = 1; profile_number <= MAX_PROFILES; profile_number++)
+	for (written = 0; written < length; written += res)
 	{
-		if ((pos_profile_begin = get_profile_begin(buffer, profile_number)) < 0)
-			continue;
-		/* write profile header */
-		place_holder = PLACE_HOLDER_NUM;
-		snprintf(profile_or_card_number_as_str, MAX_NUM_STR_LENGTH, "%d", profile_number);
-		profile_or_card_number_as_str[MAX_NUM_STR_LENGTH - 1] = '\0';
-		compose_search_string(header, PROFILE_HEADER_TEMPL, profile_or_card_number_as_str, place_holder, MAX_SEARCH_FIELD_LENGTH);
-		header[MAX_SEARCH_FIELD_LENGTH - 1] = '\0';
-		snprintf(buffer_copy + strlen(buffer_copy), max_length - strlen(buffer_copy), "%s\n", header);
-		/* search max card number in profile */
-		card_number_max = get_max_card_number_in_profile(buffer, profile_number);
-		for (card_number = 0; card_number <= card_number_max; card_number++)
-		{
-			if ((pos_card_begin = get_card_begin(buffer, profile_number, card_number)) < 0)
+		if ((res = write(outputFile, buffer + written, length - written)) < 0) {
+			if (errno == EINTR) {
+				res = 0;
 				continue;
-			/* write card header */
-			place_holder = PLACE_HOLDER_NUM;
-			snprintf(profile_or_card_number_as_str, MAX_NUM_STR_LENGTH, "%d", card_number);
-			profile_or_card_number_as_str[MAX_NUM_STR_LENGTH - 1] = '\0';
-			compose_search_string(header, CARD_HEADER_TEMPL, profile_or_card_number_as_str, place_holder, MAX_SEARCH_FIELD_LENGTH);
-			header[MAX_SEARCH_FIELD_LENGTH - 1] = '\0';
-			snprintf(buffer_copy + strlen(buffer_copy), max_length - strlen(buffer_copy), "%s\n", header);
-			pos_card_end = get_card_end(buffer, profile_number, card_number);
-			/* write profile name */
-			place_holder = PLACE_HOLDER_STR;
-			if ((pos_name_header = get_pos_name_header_from_card(buffer, profile_number, card_number)) >= 0) {
-				compose_search_string(header, PROFILE_NAME_TEMPL, get_profile_name_from_header(buffer + pos_name_header), place_holder, \
-						MAX_SEARCH_FIELD_LENGTH);
-				snprintf(buffer_copy + strlen(buffer_copy), max_length - strlen(buffer_copy), "%s\n", header);
-			}
-			/* copy alsa section if exists */
-			if ((pos_alsa_section_begin = get_begin_of_alsa_section(buffer, profile_number, card_number)) >= 0) {
-				pos_after_alsa_section = get_start_of_line(buffer, pos_card_end);
-				strncpy(buffer_copy + strlen(buffer_copy), buffer + pos_alsa_section_begin, pos_after_alsa_section - pos_alsa_section_begin);
 			}
-			/* write card footer */
-			place_holder = PLACE_HOLDER_NUM;
-			snprintf(profile_or_card_number_as_str, MAX_NUM_STR_LENGTH, "%d", card_number);
-			profile_or_card_number_as_str[MAX_NUM_STR_LENGTH - 1] = '\0';
-			compose_search_string(header, CARD_FOOTER_TEMPL, profile_or_card_number_as_str, place_holder, MAX_SEARCH_FIELD_LENGTH);
-			header[MAX_SEARCH_FIELD_LENGTH - 1] = '\0';
-			snprintf(buffer_copy + strlen(buffer_copy), max_length - strlen(buffer_copy), "%s\n", header);
+			res = -errno;
+			close(outputFile);
+			fprintf(stderr, "warning: can't write file '%s'.\n", filename);
+			return res;
 		}
 	}
-	memset(buffer, '\0', max_length);
-	strncpy(buffer, buffer_copy, max_length);
-	buffer[max_length - 1] = '\0';
-	free(buffer_copy);
-	buffer_copy = NULL;
+	if (fsync(outputFile) < 0 || close(outputFile) < 0) {
+		fprintf(stderr, "warning: can't write file '%s'.\n", filename);
+		return -errno;
+	}
 	return EXIT_SUCCESS;
 }
 
-int delete_card_from_profile(char * const buffer, const int profile_number, const int card_number, const int max_length)
+static int section_compare(const void *a, const void *b)
 {
-	int pos_card_begin, pos_next_card;
-	char *buffer_copy = NULL;
+	const struct profile_section *section_a = a, *section_b = b;
 
-	if ((pos_card_begin = get_card_begin(buffer, profile_number, card_number)) < 0)
-		return pos_card_begin;
-	if ((buffer_copy = malloc(max_length)) == NULL) {
-		fprintf(stderr, "Cannot allocate memory for reading profiles.\n");
-		fprintf(stderr, "Cannot delete card '%d' from profile '%d'.\n", card_number, profile_number);
-		return -ENOBUFS;
+	if (section_a->profile_number != section_b->profile_number)
+		return section_a->profile_number - section_b->profile_number;
+	return section_a->card_number - section_b->card_number;
+}
+
+/*
+ * write all sections ordered by profile and card number to a temporary file
+ * and rename it over the profiles file, so no reader sees a half written file
+ * the written text becomes the buffer of the new index
+ * on failure the index is dropped and will be read again from disk
+ */
+static int store_write(struct profile_store * const store, const char * const cfgfile)
+{
+	struct profile_text text = { NULL, 0, 0 };
+	struct profile_section *section;
+	struct stat file_status;
+	char tmpfile[MAX_FILE_NAME_LENGTH];
+	int idx, profile_number, res;
+
+	if ((lstat(cfgfile, &file_status) == 0) && S_ISLNK(file_status.st_mode)) {
+		fprintf(stderr, "Profiles file '%s' must not be a link.\n", cfgfile);
+		return -EPERM;
 	}
-	memset(buffer_copy, '\0', max_length);
-	pos_next_card = get_pos_for_next_card(buffer, profile_number, card_number);
-	strncpy(buffer_copy, buffer, pos_card_begin);
-	strncpy(buffer_copy + pos_card_begin, buffer + pos_next_card, max_length - pos_card_begin);
-	buffer_copy[max_length - 1] = '\0';
-	memset(buffer, '\0', max_length);
-	strncpy(buffer, buffer_copy, max_length);
-	buffer[max_length - 1] = '\0';
-	free(buffer_copy);
-	buffer_copy = NULL;
-	return EXIT_SUCCESS;
+	qsort(store->sections, store->count, sizeof(*store->sections), section_compare);
+	res = text_append_introduction(&text);
+	for (idx = 0, profile_number = NOTFOUND; (idx < store->count) && (res >= 0); idx++)
+	{
+		section = &store->sections[idx];
+		if (section->profile_number != profile_number) {
+			profile_number = section->profile_number;
+			if ((res = text_append_header(&text, PROFILE_HEADER_TEMPL, profile_number)) < 0)
+				break;
+		}
+		if ((res = text_append_header(&text, CARD_HEADER_TEMPL, section->card_number)) < 0)
+			break;
+		if (section->name[0] != '\0') {
+			char header[MAX_SEARCH_FIELD_LENGTH];
+
+			compose_search_string(header, PROFILE_NAME_TEMPL, section->name, PLACE_HOLDER_STR, MAX_SEARCH_FIELD_LENGTH);
+			header[MAX_SEARCH_FIELD_LENGTH - 1] = '\0';
+			if ((res = text_printf(&text, "%s\n", header)) < 0)
+				break;
+		}
+		if ((res = text_append(&text, section->settings, section->settings_length)) < 0)
+			break;
+		if ((section->settings_length > 0) && (section->settings[section->settings_length - 1] != '\n'))
+			if ((res = text_append(&text, "\n", 1)) < 0)
+				break;
+		res = text_append_header(&text, CARD_FOOTER_TEMPL, section->card_number);
+	}
+	if (res < 0) {
+		fprintf(stderr, "Cannot allocate memory for writing profiles.\n");
+		text_free(&text);
+		store_clear(store);
+		return res;
+	}
+
+	snprintf(tmpfile, MAX_FILE_NAME_LENGTH, "%s%s", cfgfile, PROFILES_TMP_SUFFIX);
+	if ((res = write_buffer_to_file(tmpfile, text.data, text.length)) < 0) {
+		unlink(tmpfile);
+		text_free(&text);
+		store_clear(store);
+		return res;
+	}
+	if (rename(tmpfile, cfgfile) < 0) {
+		res = -errno;
+		fprintf(stderr, "warning: can't replace profiles file '%s'.\n", cfgfile);
+		unlink(tmpfile);
+		text_free(&text);
+		store_clear(store);
+		return res;
+	}
+
+	/* sections point into the old buffer until the written text is indexed */
+	free(store->buffer);
+	store->buffer = text.data;
+	store->length = text.length;
+	if (stat(cfgfile, &store->status) < 0)
+		memset(&store->status, 0, sizeof(store->status));
+	strncpy(store->filename, cfgfile, MAX_FILE_NAME_LENGTH);
+	store->filename[MAX_FILE_NAME_LENGTH - 1] = '\0';
+	if ((res = store_parse(store)) < 0)
+		store_clear(store);
+	return res;
 }
 
 int save_restore_alsactl_settings(char * const tmpfile, const int card_number, char * const operation)
@@ -650,262 +638,430 @@ void compose_tmpfile_name(char * const tmpfile, const char * const cfgfile)
 	strncpy(tmpfile + strlen(tmpfile), "_alsactl_tmp", MAX_FILE_NAME_LENGTH - strlen(tmpfile) - 1);
 	tmpfile[MAX_FILE_NAME_LENGTH - 1] = '\0';
 }
+/*
+ * settings stored by alsactl begin with "state.<card id>"
+ * all other settings are written by ctl_capture_settings
+ */
+static int settings_are_native(const char * const settings, const size_t length)
+{
+	const char *line, *next, *end;
+
+	end = settings + length;
+	for (line = settings; line < end; line = next)
+	{
+		if ((next = memchr(line, '\n', end - line)) == NULL)
+			next = end;
+		else
+			next++;
+		while ((line < next) && isspace((unsigned char)*line))
+			line++;
+		if ((line == next) || (*line == '#'))
+			continue;
+		return strncmp(line, ALSACTL_STATE_KEYWORD, strlen(ALSACTL_STATE_KEYWORD)) != 0;
+	}
+	return 1;
+}
 
 /*
- * restore card settings
- * if profile_number < 0 profile_name must be given
- * if booth is given profile_number will be used profile_name will be ignored
+ * the control handle is opened once and kept for following profile switches
+ * ctl_name is the control device of the card, "hw:<card_number>" if NULL
  */
-int restore_profile(const int profile_number, const int card_number, const char * profile_name, char * cfgfile)
+static int ctl_open_card(snd_ctl_t ** const handle, const int card_number, const char * const ctl_name)
 {
-	int res, max_length;
-	int begin_of_alsa_section, pos_after_alsa_section, profile_nr;
-	char *buffer = NULL;
-	char tmpfile[MAX_FILE_NAME_LENGTH];
-	int get_profile_number(const char * const profile_name_given, const int card_number, char * cfgfile);
+	static snd_ctl_t *card_handle = NULL;
+	static char card_handle_name[MAX_FILE_NAME_LENGTH];
+	char name[MAX_FILE_NAME_LENGTH];
+	int res;
 
-	if ((profile_number < 0) && (profile_name == NULL)) {
-		fprintf(stderr, "Without profile number - profile name for card '%d' must given.\n", card_number);
-		return -EINVAL;
+	if (ctl_name != NULL)
+		snprintf(name, sizeof(name), "%s", ctl_name);
+	else
+		snprintf(name, sizeof(name), "hw:%d", card_number);
+	if ((card_handle != NULL) && !strcmp(card_handle_name, name)) {
+		*handle = card_handle;
+		return EXIT_SUCCESS;
 	}
-	if ((max_length = get_file_size(cfgfile)) < 0) {
-		fprintf(stderr, "Cannot get file size from '%s'.\n", cfgfile);
-		return max_length;
+	if (card_handle != NULL) {
+		snd_ctl_close(card_handle);
+		card_handle = NULL;
 	}
-	max_length++;
-	if ((buffer = malloc(max_length)) == NULL) {
-		fprintf(stderr, "Cannot allocate memory for reading profiles.\n");
-		fprintf(stderr, "Cannot read settings for card '%d' in profile '%d'.\n", card_number, profile_number);
-		return -ENOBUFS;
+	if ((res = snd_ctl_open(&card_handle, name, 0)) < 0) {
+		fprintf(stderr, "Cannot open control interface '%s' for card '%d': %s\n", name, card_number, snd_strerror(res));
+		card_handle = NULL;
+		return res;
 	}
-	memset(buffer, '\0', max_length);
-	if ((res = read_profiles_in_buffer(cfgfile, buffer, max_length)) <= 0) {
-		if (profile_number < 0) {
-			fprintf(stderr, "Cannot read settings for card '%d' in profile '%s'.\n", card_number, profile_name);
-		} else {
-			fprintf(stderr, "Cannot read settings for card '%d' in profile '%d'.\n", card_number, profile_number);
-		}
-		free(buffer);
-		buffer = NULL;
+	strcpy(card_handle_name, name);
+	*handle = card_handle;
+	return EXIT_SUCCESS;
+}
+
+static int ctl_format_value(struct profile_text * const text, snd_ctl_elem_info_t * const info, snd_ctl_elem_value_t * const value)
+{
+	const unsigned char *bytes;
+	snd_aes_iec958_t iec958;
+	unsigned int idx, count;
+	int res = EXIT_SUCCESS;
+
+	count = snd_ctl_elem_info_get_count(info);
+	switch (snd_ctl_elem_info_get_type(info)) {
+	case SND_CTL_ELEM_TYPE_BOOLEAN:
+		for (idx = 0; (idx < count) && (res >= 0); idx++)
+			res = text_printf(text, "%s%d", idx ? "," : "", snd_ctl_elem_value_get_boolean(value, idx));
+		break;
+	case SND_CTL_ELEM_TYPE_INTEGER:
+		for (idx = 0; (idx < count) && (res >= 0); idx++)
+			res = text_printf(text, "%s%ld", idx ? "," : "", snd_ctl_elem_value_get_integer(value, idx));
+		break;
+	case SND_CTL_ELEM_TYPE_INTEGER64:
+		for (idx = 0; (idx < count) && (res >= 0); idx++)
+			res = text_printf(text, "%s%lld", idx ? "," : "", snd_ctl_elem_value_get_integer64(value, idx));
+		break;
+	case SND_CTL_ELEM_TYPE_ENUMERATED:
+		for (idx = 0; (idx < count) && (res >= 0); idx++)
+			res = text_printf(text, "%s%u", idx ? "," : "", snd_ctl_elem_value_get_enumerated(value, idx));
+		break;
+	case SND_CTL_ELEM_TYPE_BYTES:
+		bytes = snd_ctl_elem_value_get_bytes(value);
+		for (idx = 0; (idx < count) && (res >= 0); idx++)
+			res = text_printf(text, "%02x", bytes[idx]);
+		break;
+	case SND_CTL_ELEM_TYPE_IEC958:
+		snd_ctl_elem_value_get_iec958(value, &iec958);
+		for (idx = 0; (idx < sizeof(iec958.status)) && (res >= 0); idx++)
+			res = text_printf(text, "%02x", iec958.status[idx]);
+		break;
+	default:
 		return -EINVAL;
 	}
-	profile_nr = profile_number;
-	if (profile_number < 0) {
-		if ((profile_nr = get_profile_number(profile_name, card_number, cfgfile)) < 0) {
-			fprintf(stderr, "Cannot find profile '%s' for card '%d'.\n", profile_name, card_number);
-			free(buffer);
-			buffer = NULL;
-			return profile_nr;
-		}
+	if (res >= 0)
+		res = text_append(text, "\n", 1);
+	return res;
+}
+
+/*
+ * byte values are written as two hex digits per byte without separators,
+ * anything shorter or not hex is refused before sscanf can skip over it
+ */
+static int ctl_check_hex(const char * const values, const size_t count)
+{
+	size_t idx;
+
+	if (strlen(values) < 2 * count)
+		return -EINVAL;
+	for (idx = 0; idx < 2 * count; idx++)
+	{
+		if (!isxdigit((unsigned char)values[idx]))
+			return -EINVAL;
 	}
-	if ((begin_of_alsa_section = get_begin_of_alsa_section(buffer, profile_nr, card_number)) < 0) {
-		fprintf(stderr, "Cannot find alsa section for card '%d' in profile '%d'.\n", card_number, profile_nr);
-		free(buffer);
-		buffer = NULL;
-		return begin_of_alsa_section;
+	return EXIT_SUCCESS;
+}
+
+static int ctl_parse_value(const char *values, snd_ctl_elem_info_t * const info, snd_ctl_elem_value_t * const value)
+{
+	snd_aes_iec958_t iec958;
+	unsigned int idx, count, byte;
+	long long number;
+	char *end;
+
+	count = snd_ctl_elem_info_get_count(info);
+	switch (snd_ctl_elem_info_get_type(info)) {
+	case SND_CTL_ELEM_TYPE_BYTES:
+		if (ctl_check_hex(values, count) < 0)
+			return -EINVAL;
+		for (idx = 0; idx < count; idx++)
+		{
+			sscanf(values + 2 * idx, "%2x", &byte);
+			snd_ctl_elem_value_set_byte(value, idx, byte);
+		}
+		return EXIT_SUCCESS;
+	case SND_CTL_ELEM_TYPE_IEC958:
+		if (ctl_check_hex(values, sizeof(iec958.status)) < 0)
+			return -EINVAL;
+		memset(&iec958, 0, sizeof(iec958));
+		for (idx = 0; idx < sizeof(iec958.status); idx++)
+		{
+			sscanf(values + 2 * idx, "%2x", &byte);
+			iec958.status[idx] = byte;
+		}
+		snd_ctl_elem_value_set_iec958(value, &iec958);
+		return EXIT_SUCCESS;
+	default:
+		break;
 	}
-	pos_after_alsa_section = get_start_of_line(buffer, get_card_end(buffer, profile_nr, card_number));
-	compose_tmpfile_name(tmpfile, cfgfile);
-	if ((res = write_profiles_from_buffer(tmpfile, buffer + begin_of_alsa_section, pos_after_alsa_section - begin_of_alsa_section, 0)) >= 0) {
-		res = save_restore_alsactl_settings(tmpfile, card_number, ALSACTL_OP_RESTORE);
-		unlink(tmpfile);
+	for (idx = 0; idx < count; idx++)
+	{
+		number = strtoll(values, &end, 10);
+		if (end == values)
+			return -EINVAL;
+		switch (snd_ctl_elem_info_get_type(info)) {
+		case SND_CTL_ELEM_TYPE_BOOLEAN:
+			snd_ctl_elem_value_set_boolean(value, idx, number);
+			break;
+		case SND_CTL_ELEM_TYPE_INTEGER:
+			snd_ctl_elem_value_set_integer(value, idx, number);
+			break;
+		case SND_CTL_ELEM_TYPE_INTEGER64:
+			snd_ctl_elem_value_set_integer64(value, idx, number);
+			break;
+		case SND_CTL_ELEM_TYPE_ENUMERATED:
+			snd_ctl_elem_value_set_enumerated(value, idx, number);
+			break;
+		default:
+			return -EINVAL;
+		}
+		values = *end == ',' ? end + 1 : end;
 	}
-	free(buffer);
-	buffer = NULL;
+	return EXIT_SUCCESS;
+}
 
-	if (res > 0)
-		res = EXIT_SUCCESS;
+/*
+ * split one settings line
+ * control <iface> <device> <subdevice> <index> '<name>' = <values>
+ */
+static int ctl_parse_line(char * const line, snd_ctl_elem_id_t * const id, char ** const values)
+{
+	char iface[MAX_NUM_STR_LENGTH];
+	unsigned int device, subdevice, index;
+	char *name, *name_end;
+	int offset = 0, type;
 
-	return res;
+	if ((sscanf(line, " " PROFILE_CONTROL_KEYWORD " %10s %u %u %u '%n", iface, &device, &subdevice, &index, &offset) != 4) ||
+	    (offset == 0))
+		return -EINVAL;
+	name = line + offset;
+	if ((name_end = strstr(name, "' = ")) == NULL)
+		return -EINVAL;
+	*name_end = '\0';
+	*values = name_end + 4;
+	for (type = 0; type <= SND_CTL_ELEM_IFACE_LAST; type++)
+	{
+		if (!strcmp(iface, snd_ctl_elem_iface_name((snd_ctl_elem_iface_t)type)))
+			break;
+	}
+	if (type > SND_CTL_ELEM_IFACE_LAST)
+		return -EINVAL;
+	snd_ctl_elem_id_clear(id);
+	snd_ctl_elem_id_set_interface(id, (snd_ctl_elem_iface_t)type);
+	snd_ctl_elem_id_set_device(id, device);
+	snd_ctl_elem_id_set_subdevice(id, subdevice);
+	snd_ctl_elem_id_set_name(id, name);
+	snd_ctl_elem_id_set_index(id, index);
+	return EXIT_SUCCESS;
 }
 
-int append_alsactl_settings(const char * const tmpfile, char * const buffer_position, const int max_length)
+/*
+ * read all readable and writable controls of the card
+ * and append them as settings lines
+ */
+static int ctl_capture_settings(const int card_number, const char * const ctl_name, struct profile_text * const text)
 {
+	snd_ctl_t *handle;
+	snd_ctl_elem_list_t *list;
+	snd_ctl_elem_id_t *id;
+	snd_ctl_elem_info_t *info;
+	snd_ctl_elem_value_t *value;
+	unsigned int idx, count;
 	int res;
 
-	res = read_profiles_in_buffer(tmpfile, buffer_position, max_length);
-	if (res >= 0)
-		return EXIT_SUCCESS;
+	snd_ctl_elem_list_alloca(&list);
+	snd_ctl_elem_id_alloca(&id);
+	snd_ctl_elem_info_alloca(&info);
+	snd_ctl_elem_value_alloca(&value);
+
+	if ((res = ctl_open_card(&handle, card_number, ctl_name)) < 0)
+		return res;
+	if ((res = snd_ctl_elem_list(handle, list)) < 0)
+		return res;
+	count = snd_ctl_elem_list_get_count(list);
+	if ((res = snd_ctl_elem_list_alloc_space(list, count)) < 0)
+		return res;
+	if ((res = snd_ctl_elem_list(handle, list)) < 0)
+		goto __free;
+	for (idx = 0; (idx < snd_ctl_elem_list_get_used(list)) && (res >= 0); idx++)
+	{
+		snd_ctl_elem_list_get_id(list, idx, id);
+		snd_ctl_elem_info_set_id(info, id);
+		if (snd_ctl_elem_info(handle, info) < 0)
+			continue;
+		if (!snd_ctl_elem_info_is_readable(info) ||
+		    !snd_ctl_elem_info_is_writable(info) ||
+		    snd_ctl_elem_info_is_inactive(info) ||
+		    (snd_ctl_elem_info_get_type(info) == SND_CTL_ELEM_TYPE_NONE))
+			continue;
+		snd_ctl_elem_value_set_id(value, id);
+		if (snd_ctl_elem_read(handle, value) < 0)
+			continue;
+		res = text_printf(text, PROFILE_CONTROL_KEYWORD " %s %u %u %u '%s' = ",
+				  snd_ctl_elem_iface_name(snd_ctl_elem_id_get_interface(id)),
+				  snd_ctl_elem_id_get_device(id),
+				  snd_ctl_elem_id_get_subdevice(id),
+				  snd_ctl_elem_id_get_index(id),
+				  snd_ctl_elem_id_get_name(id));
+		if (res >= 0)
+			res = ctl_format_value(text, info, value);
+	}
+ __free:
+	snd_ctl_elem_list_free_space(list);
 	return res;
 }
 
 /*
- * insert entry for card in profile with alsactl settings
- * if profile_number < 0 no profile header is needed
- * if pos_end < 0 the new entry will be appended
- * if profile_name == NULL the profile name header will not be written
+ * write the controls from settings lines to the card
+ * only controls with a value different from the current one are written,
+ * so switching between similar profiles touches as few controls as possible
+ * controls which can't be found or written are reported and skipped
  */
-int insert_card(char * const buffer, const int profile_number, const int card_number, const char * const profile_name, const int pos_begin, \
-		const int pos_end, char * const tmpfile, const int max_length)
+static int ctl_apply_settings(const int card_number, const char * const ctl_name, const char * const settings, const size_t length)
 {
+	snd_ctl_t *handle;
+	snd_ctl_elem_id_t *id;
+	snd_ctl_elem_info_t *info;
+	snd_ctl_elem_value_t *value, *current;
+	char *copy, *line, *next, *values;
 	int res;
-	char *buffer_copy = NULL;
-	char header[MAX_SEARCH_FIELD_LENGTH];
-	char profile_number_or_card_number_as_str[MAX_NUM_STR_LENGTH];
-	char profile_name_copy[PROFILE_NAME_FIELD_LENGTH];
-	char place_holder;
 
-	if ((res = save_restore_alsactl_settings(tmpfile, card_number, ALSACTL_OP_STORE)) < 0)
+	snd_ctl_elem_id_alloca(&id);
+	snd_ctl_elem_info_alloca(&info);
+	snd_ctl_elem_value_alloca(&value);
+	snd_ctl_elem_value_alloca(&current);
+
+	if ((copy = malloc(length + 1)) == NULL) {
+		fprintf(stderr, "Cannot allocate memory for restoring profiles.\n");
+		return -ENOBUFS;
+	}
+	memcpy(copy, settings, length);
+	copy[length] = '\0';
+	if ((res = ctl_open_card(&handle, card_number, ctl_name)) < 0) {
+		free(copy);
 		return res;
-	if (pos_end >= 0) {
-		if ((buffer_copy = malloc(max_length)) == NULL) {
-			fprintf(stderr, "Cannot allocate memory for reading profiles.\n");
-			fprintf(stderr, "Cannot save settings for card '%d' in profile '%d'.\n", card_number, profile_number);
-			unlink(tmpfile);
-			return -ENOBUFS;
+	}
+	for (line = copy; line != NULL; line = next)
+	{
+		if ((next = strchr(line, '\n')) != NULL)
+			*next++ = '\0';
+		if (ctl_parse_line(line, id, &values) < 0)
+			continue;
+		snd_ctl_elem_info_set_id(info, id);
+		if (snd_ctl_elem_info(handle, info) < 0) {
+			fprintf(stderr, "Cannot find control '%s' on card '%d'.\n", snd_ctl_elem_id_get_name(id), card_number);
+			continue;
+		}
+		if (!snd_ctl_elem_info_is_writable(info) || snd_ctl_elem_info_is_inactive(info))
+			continue;
+		snd_ctl_elem_info_get_id(info, id);
+		snd_ctl_elem_value_clear(current);
+		snd_ctl_elem_value_set_id(current, id);
+		if (snd_ctl_elem_read(handle, current) < 0)
+			snd_ctl_elem_value_clear(current);
+		snd_ctl_elem_value_copy(value, current);
+		snd_ctl_elem_value_set_id(value, id);
+		if (ctl_parse_value(values, info, value) < 0) {
+			fprintf(stderr, "Invalid value for control '%s' in profile.\n", snd_ctl_elem_id_get_name(id));
+			continue;
+		}
+		if (snd_ctl_elem_value_compare(value, current) == 0)
+			continue;
+		if ((res = snd_ctl_elem_write(handle, value)) < 0)
+			fprintf(stderr, "Cannot write control '%s': %s\n", snd_ctl_elem_id_get_name(id), snd_strerror(res));
+	}
+	free(copy);
+
+	return EXIT_SUCCESS;
+}
+
+/*
+ * restore card settings
+ * if profile_number < 0 profile_name must be given
+ * if booth is given profile_number will be used profile_name will be ignored
+ */
+int restore_profile(const int profile_number, const int card_number, const char * const ctl_name, const char * profile_name, char * cfgfile)
+{
+	int res, profile_nr;
+	struct profile_section *section;
+	char tmpfile[MAX_FILE_NAME_LENGTH];
+	int get_profile_number(const char * const profile_name_given, const int card_number, char * cfgfile);
+
+	if ((profile_number < 0) && (profile_name == NULL)) {
+		fprintf(stderr, "Without profile number - profile name for card '%d' must given.\n", card_number);
+		return -EINVAL;
+	}
+	profile_nr = profile_number;
+	if (profile_number < 0) {
+		if ((profile_nr = get_profile_number(profile_name, card_number, cfgfile)) < 0) {
+			fprintf(stderr, "Cannot find profile '%s' for card '%d'.\n", profile_name, card_number);
+			return profile_nr;
 		}
-		memset(buffer_copy, '\0', max_length);
-		strncpy(buffer_copy, buffer, max_length);
-		buffer_copy[max_length - 1] = '\0';
-		memset(buffer + pos_begin, '\0', max_length - pos_begin);
 	}
-	if (profile_number > 0) {
-		place_holder = PLACE_HOLDER_NUM;
-		snprintf(profile_number_or_card_number_as_str, MAX_NUM_STR_LENGTH, "%d", profile_number);
-		profile_number_or_card_number_as_str[MAX_NUM_STR_LENGTH - 1] = '\0';
-		compose_search_string(header, PROFILE_HEADER_TEMPL, profile_number_or_card_number_as_str, place_holder, MAX_SEARCH_FIELD_LENGTH);
-		header[MAX_SEARCH_FIELD_LENGTH - 1] = '\0';
-		snprintf(buffer + strlen(buffer), max_length - strlen(buffer), "%s\n", header);
-		buffer[max_length - 1] = '\0';
+	if ((res = store_load(&store, cfgfile)) < 0) {
+		fprintf(stderr, "Cannot read settings for card '%d' in profile '%d'.\n", card_number, profile_nr);
+		return res;
 	}
-	/* compose card header */
-	place_holder = PLACE_HOLDER_NUM;
-	snprintf(profile_number_or_card_number_as_str, MAX_NUM_STR_LENGTH, "%d", card_number);
-	profile_number_or_card_number_as_str[MAX_NUM_STR_LENGTH - 1] = '\0';
-	compose_search_string(header, CARD_HEADER_TEMPL, profile_number_or_card_number_as_str, place_holder, MAX_SEARCH_FIELD_LENGTH);
-	header[MAX_SEARCH_FIELD_LENGTH - 1] = '\0';
-	snprintf(buffer + strlen(buffer), max_length - strlen(buffer), "%s\n", header);
-	buffer[max_length - 1] = '\0';
-	/* compose profile name header if needed */
-	if (profile_name != NULL) {
-		strncpy(profile_name_copy, profile_name, PROFILE_NAME_FIELD_LENGTH);
-		profile_name_copy[PROFILE_NAME_FIELD_LENGTH - 1] = '\0';
-		place_holder = PLACE_HOLDER_STR;
-		compose_search_string(header, PROFILE_NAME_TEMPL, profile_name_copy, place_holder, MAX_SEARCH_FIELD_LENGTH);
-		header[MAX_SEARCH_FIELD_LENGTH - 1] = '\0';
-		snprintf(buffer + strlen(buffer), max_length - strlen(buffer), "%s\n", header);
-		buffer[max_length - 1] = '\0';
+	if ((section = store_find_section(&store, profile_nr, card_number)) == NULL) {
+		fprintf(stderr, "Cannot find alsa section for card '%d' in profile '%d'.\n", card_number, profile_nr);
+		return NOTFOUND;
 	}
-	res = append_alsactl_settings(tmpfile, buffer + strlen(buffer), max_length - strlen(buffer));
-	buffer[max_length - 1] = '\0';
-	unlink(tmpfile);
-	/* compose card footer */
-	place_holder = PLACE_HOLDER_NUM;
-	snprintf(profile_number_or_card_number_as_str, MAX_NUM_STR_LENGTH, "%d", card_number);
-	profile_number_or_card_number_as_str[MAX_NUM_STR_LENGTH - 1] = '\0';
-	compose_search_string(header, CARD_FOOTER_TEMPL, profile_number_or_card_number_as_str, place_holder, MAX_SEARCH_FIELD_LENGTH);
-	header[MAX_SEARCH_FIELD_LENGTH - 1] = '\0';
-	snprintf(buffer + strlen(buffer), max_length - strlen(buffer), "%s\n", header);
-	buffer[max_length - 1] = '\0';
-	if (pos_end >= 0) {
-		strncpy(buffer + strlen(buffer), buffer_copy + pos_end, max_length - strlen(buffer));
-		free(buffer_copy);
-		buffer_copy = NULL;
+	if (settings_are_native(section->settings, section->settings_length))
+		return ctl_apply_settings(card_number, ctl_name, section->settings, section->settings_length);
+
+	/* settings stored by former versions are restored by alsactl */
+	compose_tmpfile_name(tmpfile, cfgfile);
+	if ((res = write_buffer_to_file(tmpfile, section->settings, section->settings_length)) >= 0) {
+		res = save_restore_alsactl_settings(tmpfile, card_number, ALSACTL_OP_RESTORE);
+		unlink(tmpfile);
 	}
-	if (res >= 0)
+
+	if (res > 0)
 		res = EXIT_SUCCESS;
-		
+
 	return res;
 }
 
-int save_profile(const int profile_number, const int card_number, const char * const profile_name, char *cfgfile)
+/*
+ * capture the card settings and replace the section of the card in the profile
+ * if profile_name == NULL the stored profile name will be kept
+ */
+int save_profile(const int profile_number, const int card_number, const char * const ctl_name, const char * const profile_name, char *cfgfile)
 {
-	int res, profile_begin, profile_end, profile_nr;
-	int card_begin, pos_next_card, card_nr, card_number_max;
-	const int no_profile_header = -1;
-	const int append = -1;
-	char *buffer = NULL;
-	char tmpfile[MAX_FILE_NAME_LENGTH];
-	int max_length;
+	struct profile_text settings = { NULL, 0, 0 };
+	struct profile_section *section;
+	int res;
 
-	if ((max_length = get_file_size(cfgfile)) < 0) {
+	if ((res = store_load(&store, cfgfile)) == -ENOENT) {
 		fprintf(stderr, "This operation will create a new profiles file '%s'.\n", cfgfile);
-		max_length = 0;
-	}
-	max_length += MAX_PROFILE_SIZE;
-	if ((buffer = malloc(max_length)) == NULL) {
-		fprintf(stderr, "Cannot allocate memory for reading profiles.\n");
+	} else if (res < 0) {
 		fprintf(stderr, "Cannot save settings for card '%d' in profile '%d'.\n", card_number, profile_number);
-		return -ENOBUFS;
+		return res;
 	}
-	memset(buffer, '\0', max_length);
-	compose_tmpfile_name(tmpfile, cfgfile);
-	/* file found */
-	if ((res = open(cfgfile, O_RDONLY | 0400000 /* NOFOLLOW */)) >= 0) {
-		close(res);
-		res = read_profiles_in_buffer(cfgfile, buffer, max_length);
-		if (res > 0)
-			res = reorganize_profiles(buffer, max_length);
+	if ((res = ctl_capture_settings(card_number, ctl_name, &settings)) < 0) {
+		fprintf(stderr, "Cannot store profile '%d' for card '%d'.\n", profile_number, card_number);
+		text_free(&settings);
+		return res;
 	}
-	res = strlen(buffer);
-	if (res > 0) {
-		if ((profile_begin = get_profile_begin(buffer, profile_number)) < 0) {
-			if (profile_number < MAX_PROFILES) {
-				for (profile_nr = 1; profile_nr <= MAX_PROFILES; profile_nr++)
-				{
-					if (profile_nr > profile_number) {
-						if ((profile_begin = get_profile_begin(buffer, profile_nr)) >= 0)
-							break;
-					}
-				}
-				if (profile_begin < 0)
-					profile_begin = strlen(buffer);
-			} else {
-				profile_begin = strlen(buffer);
-			}
-			if (profile_begin < strlen(buffer)) {
-				res = insert_card(buffer, profile_number, card_number, profile_name, profile_begin, profile_begin, tmpfile, max_length);
-			} else {
-				res = insert_card(buffer, profile_number, card_number, profile_name, profile_begin, append, tmpfile, max_length);
-			}
-		} else {
-			if ((card_begin = get_card_begin(buffer, profile_number, card_number)) < 0) {
-				card_number_max = get_max_card_number_in_profile(buffer, profile_number);
-				profile_end = get_profile_end(buffer, profile_number);
-				if (card_number_max > card_number) {
-					for (card_nr = 0; card_nr <= card_number_max; card_nr++)
-					{
-						if (card_nr > card_number) {
-							if ((card_begin = get_card_begin(buffer, profile_number, card_number)) >= 0)
-								break;
-						}
-					}
-					if (card_begin < 0)
-						card_begin = profile_end;
-				} else {
-					card_begin = profile_end;
-				}
-				if (card_begin < strlen(buffer)) {
-					res = insert_card(buffer, no_profile_header, card_number, profile_name, card_begin, card_begin, tmpfile, max_length);
-				} else {
-					res = insert_card(buffer, no_profile_header, card_number, profile_name, strlen(buffer), append, tmpfile, max_length);
-				}
-			} else {
-				pos_next_card = get_pos_for_next_card(buffer, profile_number, card_number);
-				res = insert_card(buffer, no_profile_header, card_number, profile_name, card_begin, pos_next_card, tmpfile, max_length);
-			}
+	if ((section = store_find_section(&store, profile_number, card_number)) == NULL) {
+		if ((section = store_add_section(&store)) == NULL) {
+			fprintf(stderr, "Cannot allocate memory for reading profiles.\n");
+			fprintf(stderr, "Cannot save settings for card '%d' in profile '%d'.\n", card_number, profile_number);
+			text_free(&settings);
+			return -ENOBUFS;
 		}
-	} else {
-		res = insert_card(buffer, profile_number, card_number, profile_name, 0, -1, tmpfile, max_length);
+		section->profile_number = profile_number;
+		section->card_number = card_number;
 	}
-	if (res < 0) {
-		fprintf(stderr, "Cannot store profile '%d' for card '%d'.\n", profile_number, card_number);
-	} else {
-		res = write_profiles_from_buffer(cfgfile, buffer, max_length, 1);
+	if (profile_name != NULL) {
+		strncpy(section->name, profile_name, PROFILE_NAME_FIELD_LENGTH);
+		section->name[PROFILE_NAME_FIELD_LENGTH - 1] = '\0';
 	}
-	free(buffer);
-	buffer = NULL;
-
-	if (res > 0)
-		res = EXIT_SUCCESS;
+	section->settings = settings.data != NULL ? settings.data : "";
+	section->settings_length = settings.length;
+	res = store_write(&store, cfgfile);
+	text_free(&settings);
 
 	return res;
 }
 
 int delete_card(const int card_number, char * cfgfile)
 {
-	int res, profile_number, max_length;
-	void *buffer = NULL;
+	int res, idx, count;
 
 	if (cfgfile == NULL)
 		cfgfile = DEFAULT_PROFILERC;
@@ -913,56 +1069,29 @@ int delete_card(const int card_number, char * cfgfile)
 	filename_without_tilde[MAX_FILE_NAME_LENGTH - 1] = '\0';
 	subst_tilde_in_filename(filename_without_tilde);
 	cfgfile = filename_without_tilde;
-	if ((res = open(cfgfile, O_RDWR | 0400000 /* O_NOFOLLOW */, FILE_CREA_MODE)) < 0) {
+	if ((res = store_load(&store, cfgfile)) < 0) {
 		fprintf(stderr, "Cannot open configuration file '%s' for writing.\n", cfgfile);
 		fprintf(stderr, "Cannot save settings for card '%d'.\n", card_number);
-		return -errno;
+		return res;
 	}
-	close(res);
-	if (res >= 0) {
-		if ((max_length = get_file_size(cfgfile)) < 0) {
-			fprintf(stderr, "Cannot get file size for '%s'.\n", cfgfile);
-			return max_length;
-		}
-		max_length++;
-		if ((buffer = malloc(max_length)) == NULL) {
-			fprintf(stderr, "Cannot allocate memory for reading profiles.\n");
-			fprintf(stderr, "Cannot delete card '%d'.\n", card_number);
-			return -ENOBUFS;
-		}
-		memset(buffer, '\0', max_length);
-		res = read_profiles_in_buffer(cfgfile, buffer, max_length);
-		if (res > 0) {
-			for (profile_number = 1; profile_number <= MAX_PROFILES; profile_number++)
-				delete_card_from_profile(buffer, profile_number, card_number, max_length);
-			res = EXIT_SUCCESS;
-		} else {
-			res = NOTFOUND;
-		}
-		res = write_profiles_from_buffer(cfgfile, buffer, max_length, 1);
-		free(buffer);
-		buffer = NULL;
-	} else {
-		res = NOTFOUND;
+	for (idx = 0, count = 0; idx < store.count; idx++)
+	{
+		if (store.sections[idx].card_number != card_number)
+			store.sections[count++] = store.sections[idx];
 	}
-	return res;
+	store.count = count;
+
+	return store_write(&store, cfgfile);
 }
 
 /*
- * First search profile name. if profile name is found look that this profile
- * name is from the specified card number.
- * if not search next occurence from given profile name.
+ * search the profile with the given name for the specified card number
+ * with equal names the least profile number is returned
  */
 int get_profile_number(const char * const profile_name_given, const int card_number, char * cfgfile)
 {
-	int res, pos_name, pos_name_offset, pos_begin, pos_end, found;
-	int profile_number, pos_profile;
-	void *buffer = NULL;
-	char search_field[MAX_SEARCH_FIELD_LENGTH];
-	char header_templ[MAX_SEARCH_FIELD_LENGTH];
-	char profile_or_card_number_as_str[MAX_NUM_STR_LENGTH];
-	char place_holder;
-	int max_length;
+	int res, idx, profile_number;
+	struct profile_section *section;
 
 	if (strlen(profile_name_given) == 0) {
 		fprintf(stderr, "Profile name for card '%d' must be given.\n", card_number);
@@ -973,113 +1102,25 @@ int get_profile_number(const char * const profile_name_given, const int card_num
 	profile_name[PROFILE_NAME_FIELD_LENGTH - 1] = '\0';
 	if (cfgfile == NULL)
 		cfgfile = DEFAULT_PROFILERC;
-	res = which_cfgfile(&cfgfile);
-	if (res < 0) {
-		profile_number = res;
-	} else {
-		if ((max_length = get_file_size(cfgfile)) < 0) {
-			fprintf(stderr, "Cannot get file size from '%s'.\n", cfgfile);
-			return max_length;
-		}
-		max_length++;
-		if ((buffer = malloc(max_length)) == NULL) {
-			res = -ENOBUFS;
-			profile_number = res;
-			fprintf(stderr, "Cannot allocate memory for reading profiles.\n");
-			return profile_number;
-		}
-		memset(buffer, '\0', max_length);
-		res = read_profiles_in_buffer(cfgfile, buffer, max_length);
-		if (res > 0) {
-			/* insert profile name in PROFILE_NAME_TEMPL */
-			place_holder = PLACE_HOLDER_STR;
-			compose_search_string(search_field, PROFILE_NAME_TEMPL, profile_name, place_holder, MAX_SEARCH_FIELD_LENGTH);
-			pos_name = 0;
-			pos_name_offset = 0;
-			pos_begin = NOTFOUND;
-			found = 0;
-			while ((pos_name = strstr_icase_blank(buffer + pos_name_offset, search_field)) >= 0)
-			{
-				pos_name += pos_name_offset;
-				/* search begin of section for the given card
-				   from profile name pointer backward */
-				/* insert card number in CARD_HEADER_TEMPL */
-				place_holder = PLACE_HOLDER_NUM;
-				snprintf(profile_or_card_number_as_str, MAX_NUM_STR_LENGTH, "%d", card_number);
-				profile_or_card_number_as_str[MAX_NUM_STR_LENGTH - 1] = '\0';
-				compose_search_string(search_field, CARD_HEADER_TEMPL, profile_or_card_number_as_str, place_holder, MAX_SEARCH_FIELD_LENGTH);
-				search_field[MAX_SEARCH_FIELD_LENGTH - 1] = '\0';
-				if ((pos_begin = get_begin_of_section(buffer, search_field, TOKEN_SEP, pos_name)) < 0)
-					break;
-				/* searching "[ profile | < card | < /card # >" */
-				/* add "[ profile |" to search_field */
-				strncpy(header_templ, PROFILE_HEADER_TEMPL, MAX_SEARCH_FIELD_LENGTH);
-				*strchr(header_templ, place_holder) = '\0';
-				strncpy(search_field, header_templ, MAX_SEARCH_FIELD_LENGTH);
-				strncpy(search_field + strlen(search_field), TOKEN_SEP, MAX_SEARCH_FIELD_LENGTH - strlen(search_field));
-				/* add "< card |" to search_field */
-				strncpy(header_templ, CARD_HEADER_TEMPL, MAX_SEARCH_FIELD_LENGTH);
-				*strchr(header_templ, place_holder) = '\0';
-				strncpy(search_field + strlen(search_field), header_templ, MAX_SEARCH_FIELD_LENGTH - strlen(search_field));
-				strncpy(search_field + strlen(search_field), TOKEN_SEP, MAX_SEARCH_FIELD_LENGTH - strlen(search_field));
-				search_field[MAX_SEARCH_FIELD_LENGTH - 1] = '\0';
-				/* add "< card # >" to search_field */
-				compose_search_string(header_templ, CARD_FOOTER_TEMPL, profile_or_card_number_as_str, place_holder, MAX_SEARCH_FIELD_LENGTH);
-				header_templ[MAX_SEARCH_FIELD_LENGTH - 1] = '\0';
-				strncpy(search_field + strlen(search_field), header_templ, MAX_SEARCH_FIELD_LENGTH - strlen(search_field));
-				search_field[MAX_SEARCH_FIELD_LENGTH - 1] = '\0';
-				pos_end = get_end_of_section(buffer, search_field, TOKEN_SEP, pos_begin + sizeof(char));
-				if ((pos_name > pos_begin) && (pos_name < pos_end) && (pos_begin >= 0) && (pos_end >= 0)) {
-					found = 1;
-					break;
-				}
-				pos_name_offset = pos_name + sizeof(char);
-				place_holder = PLACE_HOLDER_STR;
-				compose_search_string(search_field, PROFILE_NAME_TEMPL, profile_name, place_holder, MAX_SEARCH_FIELD_LENGTH);
-			}
-			if (found) {
-				place_holder = PLACE_HOLDER_NUM;
-				strncpy(search_field, PROFILE_HEADER_TEMPL, MAX_SEARCH_FIELD_LENGTH);
-				search_field[MAX_SEARCH_FIELD_LENGTH - 1] = '\0';
-				*strchr(search_field, place_holder) = '\0';
-				if ((pos_profile = get_begin_of_section(buffer, search_field, TOKEN_SEP, pos_begin)) < 0) {
-					profile_number = NOTFOUND;
-				} else {
-					profile_number = get_number_from_header(buffer + pos_profile);
-					/* check profile header syntax */
-					if (get_profile_begin(buffer, profile_number) != pos_profile) {
-						profile_number = -EINVAL;
-						/* only the profile line */
-						strncpy(search_field, buffer + pos_profile, MAX_SEARCH_FIELD_LENGTH);
-						search_field[MAX_SEARCH_FIELD_LENGTH - 1] = '\0';
-						*strchr(search_field, '\n') = '\0';
-						fprintf(stderr, "profile header '%s' has incorrect syntax.\n", search_field);
-						fprintf(stderr, "profile header syntax is '%s'\n" \
-									"by replacing place holder '%c' with profile number.\n", \
-									PROFILE_HEADER_TEMPL, PLACE_HOLDER_NUM);
-						/* check profile number */
-					} else if (profile_number < 1 || profile_number > MAX_PROFILES) {
-						fprintf(stderr, "profile number '%d' is incorrect. the profile number will be in [1 ... %d].\n", \
-									profile_number, MAX_PROFILES);
-						profile_number = -EINVAL;
-					}
-				}
-			} else {
-				profile_number = NOTFOUND;
-			}
-		} else {
-			profile_number = NOTFOUND;
-		}
-		free(buffer);
-		buffer = NULL;
+	if ((res = which_cfgfile(&cfgfile)) < 0)
+		return res;
+	if ((res = store_load(&store, cfgfile)) < 0)
+		return NOTFOUND;
+	profile_number = NOTFOUND;
+	for (idx = 0; idx < store.count; idx++)
+	{
+		section = &store.sections[idx];
+		if ((section->card_number != card_number) || strcasecmp(section->name, profile_name))
+			continue;
+		if ((profile_number < 0) || (section->profile_number < profile_number))
+			profile_number = section->profile_number;
 	}
 	return profile_number;
 }
 
 char *get_profile_name(const int profile_number, const int card_number, char * cfgfile)
 {
-	int res, max_length;
-	void *buffer = NULL;
+	struct profile_section *section;
 
 	if (profile_number < 1 || profile_number > MAX_PROFILES) {
 		fprintf(stderr, "profile number '%d' is incorrect. the profile number will be in [1 ... %d].\n", \
@@ -1088,41 +1129,25 @@ char *get_profile_name(const int profile_number, const int card_number, char * c
 	}
 	if (cfgfile == NULL)
 		cfgfile = DEFAULT_PROFILERC;
-	res = which_cfgfile(&cfgfile);
-	if (res < 0) {
-		snprintf(profile_name, PROFILE_NAME_FIELD_LENGTH, "%d", profile_number);
-	} else {
-		if ((max_length = get_file_size(cfgfile)) < 0) {
-			fprintf(stderr, "Cannot get file size from '%s'.\n", cfgfile);
-			snprintf(profile_name, PROFILE_NAME_FIELD_LENGTH, "%d", profile_number);
-			return profile_name;
-		}
-		max_length++;
-		if ((buffer = malloc(max_length)) == NULL) {
-			res = -ENOBUFS;
-			snprintf(profile_name, PROFILE_NAME_FIELD_LENGTH, "%d", profile_number);
-			fprintf(stderr, "Cannot allocate memory for reading profiles.\n");
-			return profile_name;
-		}
-		memset(buffer, '\0', max_length);
-		memset(profile_name, '\0', PROFILE_NAME_FIELD_LENGTH);
-		res = read_profiles_in_buffer(cfgfile, buffer, max_length);
-		if (res > 0) {
-			if ((res = get_pos_name_header_from_card(buffer, profile_number, card_number)) >= 0) {
-				get_profile_name_from_header(buffer + (res * sizeof(char)));
-				profile_name[PROFILE_NAME_FIELD_LENGTH - 1] = '\0';
-			}
-		}
-		free(buffer);
-		buffer = NULL;
-		if (strlen(profile_name) == 0) {
-			snprintf(profile_name, PROFILE_NAME_FIELD_LENGTH, "%d", profile_number);
+	memset(profile_name, '\0', PROFILE_NAME_FIELD_LENGTH);
+	if ((which_cfgfile(&cfgfile) >= 0) && (store_load(&store, cfgfile) >= 0)) {
+		if ((section = store_find_section(&store, profile_number, card_number)) != NULL) {
+			strncpy(profile_name, section->name, PROFILE_NAME_FIELD_LENGTH);
+			profile_name[PROFILE_NAME_FIELD_LENGTH - 1] = '\0';
 		}
 	}
+	if (strlen(profile_name) == 0) {
+		snprintf(profile_name, PROFILE_NAME_FIELD_LENGTH, "%d", profile_number);
+	}
 	return profile_name;
 }
 
-int save_restore(const char * const operation, const int profile_number, const int card_number, char * cfgfile, const char * const profile_name)
+/*
+ * ctl_name is the control device the settings are captured from and
+ * restored to, NULL for "hw:<card_number>"
+ * profiles are stored under card_number
+ */
+int save_restore(const char * const operation, const int profile_number, const int card_number, const char * const ctl_name, char * cfgfile, const char * const profile_name)
 {
 	int res;
 
@@ -1160,7 +1185,7 @@ int save_restore(const char * const operation, const int profile_number, const i
 			}
 			close(res);
 		}
-		res =  save_profile(profile_number, card_number, profile_name, cfgfile);
+		res =  save_profile(profile_number, card_number, ctl_name, profile_name, cfgfile);
 	} else if (!strcmp(operation, ALSACTL_OP_RESTORE)) {
 		res = which_cfgfile(&cfgfile);
 		if (res < 0) {
@@ -1169,7 +1194,7 @@ int save_restore(const char * const operation, const int profile_number, const i
 			fprintf(stderr, "You can store this settings to profile no. %d in file '%s' by pressing save button.\n",
 						profile_number, cfgfile);
 		} else { 
-			if ((res = restore_profile(profile_number, card_number, profile_name, cfgfile)) < 0) {
+			if ((res = restore_profile(profile_number, card_number, ctl_name, profile_name, cfgfile)) < 0) {
 				fprintf(stderr, "Cannot restore settings for card '%d' in profile '%d'.\n", card_number, profile_number); 
 				fprintf(stderr, "Use current settings.\n");
 			}
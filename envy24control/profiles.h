@@ -9,6 +9,10 @@
 #include <errno.h>
 #include <assert.h>
 #include <time.h>
+#include <ctype.h>
+#include <stdarg.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 #ifndef PROGRAM_NAME
 #define PROGRAM_NAME "envy24control"
@@ -40,12 +44,9 @@
 #define PLACE_HOLDER_NUM '#'
 #define PLACE_HOLDER_STR '$'
 
-/* max 32k for every profile */
-#define MAX_PROFILE_SIZE 32768
 #define MAX_SEARCH_FIELD_LENGTH 1024
 #define MAX_FILE_NAME_LENGTH 1024
 #define MAX_NUM_STR_LENGTH 11
-#define TOKEN_SEP "|"
 #define SEP_CHAR ' '
 
 #ifndef NOTFOUND
@@ -55,6 +56,17 @@
 #define ALSACTL_OP_STORE "store"
 #define ALSACTL_OP_RESTORE "restore"
 
+/* card settings written by alsactl begin with this keyword */
+#define ALSACTL_STATE_KEYWORD "state."
+
+/* card settings written by envy24control - one line for every control
+ * control <iface> <device> <subdevice> <index> '<name>' = <values>
+ */
+#define PROFILE_CONTROL_KEYWORD "control"
+
+/* the profiles file is written to this file and renamed afterwards */
+#define PROFILES_TMP_SUFFIX ".new"
+
 #define DIR_CREA_MODE "0755"	// this must be a string
 #define FILE_CREA_MODE 0644	// this must be a octal number
 
@@ -75,7 +87,7 @@
 #endif
 
 #ifndef __PROFILES_C__
-extern int save_restore(const char * const operation, const int profile_number, const int card_number, char * cfgfile, const char * const profile_name);
+extern int save_restore(const char * const operation, const int profile_number, const int card_number, const char * const ctl_name, char * cfgfile, const char * const profile_name);
 extern char *get_profile_name(const int profile_number, const int card_number, char * cfgfile);
 extern int get_profile_number(const char * const profile_name, const int card_number, char * cfgfile);
 extern int delete_card(const int card_number, char * const cfgfile);
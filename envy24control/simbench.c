@@ -0,0 +1,238 @@
+/*****************************************************************************
+   simbench.c - time the control paths of envy24control against the
+   envy24sim plugin
+   Copyright (C) 2026 by the ALSA project
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License
+   as published by the Free Software Foundation; either version 2
+   of the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+******************************************************************************/
+
+/*
+ * Three numbers are measured on the simulated card (ctl.envy24sim in
+ * ~/.asoundrc, see README):
+ *
+ *   startup	opening the device and reading every control once, which
+ *		is what envy24control and envy24ctld do before the first
+ *		frame or request
+ *   events/s	mixer writes through one handle and the value events read
+ *		back on a second one, the path of a fader moved by another
+ *		client
+ *   profiles	switching between two stored profiles with save_restore(),
+ *		exactly as the profile buttons do
+ *
+ * profiles.c and envy24model.c are linked as they are.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <time.h>
+#include <alsa/asoundlib.h>
+#include "envy24control.h"
+
+#define BENCH_STARTUPS	100
+#define BENCH_WRITES	100000
+#define BENCH_SWITCHES	200
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* open the device and read every element, returns the number of elements */
+static int startup(const char *name)
+{
+	snd_ctl_t *handle;
+	snd_ctl_card_info_t *info;
+	snd_ctl_elem_list_t *list;
+	snd_ctl_elem_value_t *val;
+	unsigned int idx, count;
+	int err;
+
+	snd_ctl_card_info_alloca(&info);
+	snd_ctl_elem_list_alloca(&list);
+	snd_ctl_elem_value_alloca(&val);
+	if ((err = snd_ctl_open(&handle, name, 0)) < 0) {
+		fprintf(stderr, "simbench: cannot open %s: %s\n", name, snd_strerror(err));
+		return err;
+	}
+	if ((err = snd_ctl_card_info(handle, info)) < 0 ||
+	    (err = snd_ctl_elem_list(handle, list)) < 0)
+		goto __close;
+	count = snd_ctl_elem_list_get_count(list);
+	if ((err = snd_ctl_elem_list_alloc_space(list, count)) < 0)
+		goto __close;
+	if ((err = snd_ctl_elem_list(handle, list)) < 0)
+		goto __free;
+	for (idx = 0; idx < count; idx++) {
+		snd_ctl_elem_value_set_numid(val, snd_ctl_elem_list_get_numid(list, idx));
+		if ((err = snd_ctl_elem_read(handle, val)) < 0)
+			goto __free;
+	}
+	err = count;
+      __free:
+	snd_ctl_elem_list_free_space(list);
+      __close:
+	snd_ctl_close(handle);
+	return err;
+}
+
+static int set_all_volumes(snd_ctl_t *handle, int volume)
+{
+	int stream, err;
+
+	for (stream = 1; stream <= ENVY24_MIXER_STREAMS; stream++)
+		if ((err = envy24_volume_set(handle, stream, volume, volume)) < 0)
+			return err;
+	return 0;
+}
+
+static int read_events(snd_ctl_t *handle)
+{
+	snd_ctl_event_t *ev;
+	int count = 0;
+
+	snd_ctl_event_alloca(&ev);
+	while (snd_ctl_read(handle, ev) > 0)
+		count++;
+	return count;
+}
+
+static void usage(void)
+{
+	fprintf(stderr,
+		"usage: simbench [options]\n"
+		"  -D, --device=NAME   control device (envy24sim)\n"
+		"  -c, --card=N        card number the profiles are stored under (0)\n"
+		"  -s, --startups=N    startups to time (%d)\n"
+		"  -w, --writes=N      mixer writes to time (%d)\n"
+		"  -p, --switches=N    profile switches to time (%d)\n",
+		BENCH_STARTUPS, BENCH_WRITES, BENCH_SWITCHES);
+}
+
+int main(int argc, char **argv)
+{
+	static const struct option long_options[] = {
+		{"device", 1, NULL, 'D'},
+		{"card", 1, NULL, 'c'},
+		{"startups", 1, NULL, 's'},
+		{"writes", 1, NULL, 'w'},
+		{"switches", 1, NULL, 'p'},
+		{NULL, 0, NULL, 0}
+	};
+	const char *name = "envy24sim";
+	int card = 0, startups = BENCH_STARTUPS, writes = BENCH_WRITES, switches = BENCH_SWITCHES;
+	char cfgfile[] = "/tmp/simbench-XXXXXX";
+	snd_ctl_t *writer, *reader;
+	double start, t, worst = 0, total;
+	int i, c, fd, elems = 0, events = 0, left, right, res = 1;
+
+	while ((c = getopt_long(argc, argv, "D:c:s:w:p:", long_options, NULL)) != -1) {
+		switch (c) {
+		case 'D':
+			name = optarg;
+			break;
+		case 'c':
+			card = atoi(optarg);
+			break;
+		case 's':
+			startups = atoi(optarg);
+			break;
+		case 'w':
+			writes = atoi(optarg);
+			break;
+		case 'p':
+			switches = atoi(optarg);
+			break;
+		default:
+			usage();
+			return 1;
+		}
+	}
+	if (card < 0 || startups < 1 || writes < 1 || switches < 2) {
+		usage();
+		return 1;
+	}
+
+	start = now();
+	for (i = 0; i < startups; i++)
+		if ((elems = startup(name)) < 0)
+			return 1;
+	t = now() - start;
+	printf("startup:   %.3f ms (%d elements opened and read, %d runs)\n",
+	       t * 1e3 / startups, elems, startups);
+
+	if (snd_ctl_open(&writer, name, 0) < 0 ||
+	    snd_ctl_open(&reader, name, SND_CTL_NONBLOCK) < 0 ||
+	    snd_ctl_subscribe_events(reader, 1) < 0) {
+		fprintf(stderr, "simbench: cannot open %s\n", name);
+		return 1;
+	}
+	start = now();
+	for (i = 0; i < writes; i++) {
+		if (envy24_volume_set(writer, i % ENVY24_MIXER_STREAMS + 1, i % 97, i % 97) < 0) {
+			fprintf(stderr, "simbench: mixer write failed\n");
+			goto __close;
+		}
+		events += read_events(reader);
+	}
+	t = now() - start;
+	printf("events:    %.0f writes/s, %.0f events/s (%d writes, %d events)\n",
+	       writes / t, events / t, writes, events);
+
+	/* two profiles, all volumes down and all volumes up */
+	if ((fd = mkstemp(cfgfile)) < 0) {
+		fprintf(stderr, "simbench: cannot create %s\n", cfgfile);
+		goto __close;
+	}
+	close(fd);
+	unlink(cfgfile);
+	if (set_all_volumes(writer, 0) < 0 ||
+	    save_restore(ALSACTL_OP_STORE, 1, card, name, cfgfile, "down") < 0 ||
+	    set_all_volumes(writer, 96) < 0 ||
+	    save_restore(ALSACTL_OP_STORE, 2, card, name, cfgfile, "up") < 0) {
+		fprintf(stderr, "simbench: cannot store the profiles\n");
+		goto __unlink;
+	}
+	total = 0;
+	for (i = 0; i < switches; i++) {
+		start = now();
+		if (save_restore(ALSACTL_OP_RESTORE, i % 2 + 1, card, name, cfgfile, NULL) < 0)
+			goto __unlink;
+		t = now() - start;
+		total += t;
+		if (t > worst)
+			worst = t;
+		/* the restore has to reach the card the writer sees */
+		if (envy24_volume_get(writer, 1, &left, &right) < 0 ||
+		    left != (i % 2 ? 96 : 0)) {
+			fprintf(stderr, "simbench: profile %d was not applied\n", i % 2 + 1);
+			goto __unlink;
+		}
+	}
+	printf("profiles:  %.3f ms per switch, %.3f ms worst (%d switches)\n",
+	       total * 1e3 / switches, worst * 1e3, switches);
+	res = 0;
+
+      __unlink:
+	unlink(cfgfile);
+      __close:
+	snd_ctl_close(reader);
+	snd_ctl_close(writer);
+	return res;
+}
@@ -25,11 +25,6 @@
 #define toggle_set(widget, state) \
 	gtk_check_button_set_active(GTK_CHECK_BUTTON(widget), state);
 
-#define DAC_VOLUME_NAME	"DAC Volume"
-#define ADC_VOLUME_NAME	"ADC Volume"
-#define IPGA_VOLUME_NAME "IPGA Analog Capture Volume"
-#define DAC_SENSE_NAME	"Output Sensitivity Switch"
-#define ADC_SENSE_NAME	"Input Sensitivity Switch"
 
 static int dac_volumes;
 static int dac_max = 127;
@@ -110,38 +105,26 @@ int envy_analog_volume_available(void)
 
 void dac_volume_update(int idx)
 {
-	snd_ctl_elem_value_t *val;
-	int err;
-	snd_ctl_elem_value_alloca(&val);
-	snd_ctl_elem_value_set_interface(val, SND_CTL_ELEM_IFACE_MIXER);
-	snd_ctl_elem_value_set_name(val, DAC_VOLUME_NAME);
-	snd_ctl_elem_value_set_index(val, idx);
-	if ((err = snd_ctl_elem_read(ctl, val)) < 0) {
-		g_print("Unable to read dac volume: %s\n", snd_strerror(err));
+	int val;
+
+	if ((val = envy24_analog_get(ctl, ENVY24_ANALOG_DAC, idx)) < 0) {
+		g_print("Unable to read dac volume: %s\n", snd_strerror(val));
 		return;
 	}
-	gtk_adjustment_set_value(GTK_ADJUSTMENT(av_dac_volume_adj[idx]),
-				 -snd_ctl_elem_value_get_integer(val, 0));
+	gtk_adjustment_set_value(GTK_ADJUSTMENT(av_dac_volume_adj[idx]), -val);
 }
 
 void adc_volume_update(int idx)
 {
-	snd_ctl_elem_value_t *val;
-	int err;
-	snd_ctl_elem_value_alloca(&val);
-	snd_ctl_elem_value_set_interface(val, SND_CTL_ELEM_IFACE_MIXER);
-	snd_ctl_elem_value_set_name(val, ADC_VOLUME_NAME);
-	snd_ctl_elem_value_set_index(val, idx);
-	if ((err = snd_ctl_elem_read(ctl, val)) < 0) {
-		g_print("Unable to read adc volume: %s\n", snd_strerror(err));
+	int val;
+
+	if ((val = envy24_analog_get(ctl, ENVY24_ANALOG_ADC, idx)) < 0) {
+		g_print("Unable to read adc volume: %s\n", snd_strerror(val));
 		return;
 	}
-	gtk_adjustment_set_value(GTK_ADJUSTMENT(av_adc_volume_adj[idx]),
-				 -snd_ctl_elem_value_get_integer(val, 0));
-	snd_ctl_elem_value_set_name(val, IPGA_VOLUME_NAME);
-	snd_ctl_elem_value_set_index(val, idx);
-	if ((err = snd_ctl_elem_read(ctl, val)) < 0) {
-		g_print("Unable to read ipga volume: %s\n", snd_strerror(err));
+	gtk_adjustment_set_value(GTK_ADJUSTMENT(av_adc_volume_adj[idx]), -val);
+	if ((val = envy24_analog_get(ctl, ENVY24_ANALOG_IPGA, idx)) < 0) {
+		g_print("Unable to read ipga volume: %s\n", snd_strerror(val));
 		return;
 	}
 	if (ipga_volumes > 0)
@@ -151,22 +134,15 @@ void adc_volume_update(int idx)
 
 void ipga_volume_update(int idx)
 {
-	snd_ctl_elem_value_t *val;
-	int err, ipga_vol;
-	snd_ctl_elem_value_alloca(&val);
-	snd_ctl_elem_value_set_interface(val, SND_CTL_ELEM_IFACE_MIXER);
-	snd_ctl_elem_value_set_name(val, IPGA_VOLUME_NAME);
-	snd_ctl_elem_value_set_index(val, idx);
-	if ((err = snd_ctl_elem_read(ctl, val)) < 0) {
-		g_print("Unable to read ipga volume: %s\n", snd_strerror(err));
+	int val, ipga_vol;
+
+	if ((ipga_vol = envy24_analog_get(ctl, ENVY24_ANALOG_IPGA, idx)) < 0) {
+		g_print("Unable to read ipga volume: %s\n", snd_strerror(ipga_vol));
 		return;
 	}
-	gtk_adjustment_set_value(GTK_ADJUSTMENT(av_ipga_volume_adj[idx]),
-				 -(ipga_vol = snd_ctl_elem_value_get_integer(val, 0)));
-	snd_ctl_elem_value_set_name(val, ADC_VOLUME_NAME);
-	snd_ctl_elem_value_set_index(val, idx);
-	if ((err = snd_ctl_elem_read(ctl, val)) < 0) {
-		g_print("Unable to read adc volume: %s\n", snd_strerror(err));
+	gtk_adjustment_set_value(GTK_ADJUSTMENT(av_ipga_volume_adj[idx]), -ipga_vol);
+	if ((val = envy24_analog_get(ctl, ENVY24_ANALOG_ADC, idx)) < 0) {
+		g_print("Unable to read adc volume: %s\n", snd_strerror(val));
 		return;
 	}
 	// set ADC volume to max if IPGA volume greater 0
@@ -177,35 +153,23 @@ void ipga_volume_update(int idx)
 
 void dac_sense_update(int idx)
 {
-	snd_ctl_elem_value_t *val;
-	int err;
 	int state;
-	snd_ctl_elem_value_alloca(&val);
-	snd_ctl_elem_value_set_interface(val, SND_CTL_ELEM_IFACE_MIXER);
-	snd_ctl_elem_value_set_name(val, DAC_SENSE_NAME);
-	snd_ctl_elem_value_set_index(val, idx);
-	if ((err = snd_ctl_elem_read(ctl, val)) < 0) {
-		g_print("Unable to read dac sense: %s\n", snd_strerror(err));
+
+	if ((state = envy24_sense_get(ctl, ENVY24_SENSE_DAC, idx)) < 0) {
+		g_print("Unable to read dac sense: %s\n", snd_strerror(state));
 		return;
 	}
-	state = snd_ctl_elem_value_get_enumerated(val, 0);
 	toggle_set(av_dac_sense_radio[idx][state], TRUE);
 }
 
 void adc_sense_update(int idx)
 {
-	snd_ctl_elem_value_t *val;
-	int err;
 	int state;
-	snd_ctl_elem_value_alloca(&val);
-	snd_ctl_elem_value_set_interface(val, SND_CTL_ELEM_IFACE_MIXER);
-	snd_ctl_elem_value_set_name(val, ADC_SENSE_NAME);
-	snd_ctl_elem_value_set_index(val, idx);
-	if ((err = snd_ctl_elem_read(ctl, val)) < 0) {
-		g_print("Unable to read adc sense: %s\n", snd_strerror(err));
+
+	if ((state = envy24_sense_get(ctl, ENVY24_SENSE_ADC, idx)) < 0) {
+		g_print("Unable to read adc sense: %s\n", snd_strerror(state));
 		return;
 	}
-	state = snd_ctl_elem_value_get_enumerated(val, 0);
 	toggle_set(av_adc_sense_radio[idx][state], TRUE);
 }
 
@@ -216,54 +180,36 @@ void adc_sense_update(int idx)
 void dac_volume_adjust(GtkAdjustment *adj, gpointer data)
 {
 	int idx = (int)(long)data;
-	snd_ctl_elem_value_t *val;
 	int err, ival = -(int)gtk_adjustment_get_value(adj);
 	char text[16];
 
-	snd_ctl_elem_value_alloca(&val);
-	snd_ctl_elem_value_set_interface(val, SND_CTL_ELEM_IFACE_MIXER);
-	snd_ctl_elem_value_set_name(val, DAC_VOLUME_NAME);
-	snd_ctl_elem_value_set_index(val, idx);
-	snd_ctl_elem_value_set_integer(val, 0, ival);
 	sprintf(text, "%03i", ival);
 	gtk_label_set_text(av_dac_volume_label[idx], text);
-	if ((err = snd_ctl_elem_write(ctl, val)) < 0)
+	if ((err = envy24_analog_set(ctl, ENVY24_ANALOG_DAC, idx, ival)) < 0)
 		g_print("Unable to write dac volume: %s\n", snd_strerror(err));
 }
 
 void adc_volume_adjust(GtkAdjustment *adj, gpointer data)
 {
 	int idx = (int)(long)data;
-	snd_ctl_elem_value_t *val;
 	int err, ival = -(int)gtk_adjustment_get_value(adj);
 	char text[16];
 
-	snd_ctl_elem_value_alloca(&val);
-	snd_ctl_elem_value_set_interface(val, SND_CTL_ELEM_IFACE_MIXER);
-	snd_ctl_elem_value_set_name(val, ADC_VOLUME_NAME);
-	snd_ctl_elem_value_set_index(val, idx);
-	snd_ctl_elem_value_set_integer(val, 0, ival);
 	sprintf(text, "%03i", ival);
 	gtk_label_set_text(av_adc_volume_label[idx], text);
-	if ((err = snd_ctl_elem_write(ctl, val)) < 0)
+	if ((err = envy24_analog_set(ctl, ENVY24_ANALOG_ADC, idx, ival)) < 0)
 		g_print("Unable to write adc volume: %s\n", snd_strerror(err));
 }
 
 void ipga_volume_adjust(GtkAdjustment *adj, gpointer data)
 {
 	int idx = (int)(long)data;
-	snd_ctl_elem_value_t *val;
 	int err, ival = -(int)gtk_adjustment_get_value(adj);
 	char text[16];
 
-	snd_ctl_elem_value_alloca(&val);
-	snd_ctl_elem_value_set_interface(val, SND_CTL_ELEM_IFACE_MIXER);
-	snd_ctl_elem_value_set_name(val, IPGA_VOLUME_NAME);
-	snd_ctl_elem_value_set_index(val, idx);
-	snd_ctl_elem_value_set_integer(val, 0, ival);
 	sprintf(text, "%03i", ival);
 	gtk_label_set_text(av_ipga_volume_label[idx], text);
-	if ((err = snd_ctl_elem_write(ctl, val)) < 0)
+	if ((err = envy24_analog_set(ctl, ENVY24_ANALOG_IPGA, idx, ival)) < 0)
 		g_print("Unable to write ipga volume: %s\n", snd_strerror(err));
 }
 
@@ -271,15 +217,9 @@ void dac_sense_toggled(GtkWidget *togglebutton, gpointer data)
 {
 	int idx = (long)data >> 8;
 	int state = (long)data & 0xff;
-	snd_ctl_elem_value_t *val;
 	int err;
 
-	snd_ctl_elem_value_alloca(&val);
-	snd_ctl_elem_value_set_interface(val, SND_CTL_ELEM_IFACE_MIXER);
-	snd_ctl_elem_value_set_name(val, DAC_SENSE_NAME);
-	snd_ctl_elem_value_set_index(val, idx);
-	snd_ctl_elem_value_set_enumerated(val, 0, state);
-	if ((err = snd_ctl_elem_write(ctl, val)) < 0)
+	if ((err = envy24_sense_set(ctl, ENVY24_SENSE_DAC, idx, state)) < 0)
 		g_print("Unable to write dac sense: %s\n", snd_strerror(err));
 }
 
@@ -287,101 +227,71 @@ void adc_sense_toggled(GtkWidget *togglebutton, gpointer data)
 {
 	int idx = (long)data >> 8;
 	int state = (long)data & 0xff;
-	snd_ctl_elem_value_t *val;
 	int err;
 
-	snd_ctl_elem_value_alloca(&val);
-	snd_ctl_elem_value_set_interface(val, SND_CTL_ELEM_IFACE_MIXER);
-	snd_ctl_elem_value_set_name(val, ADC_SENSE_NAME);
-	snd_ctl_elem_value_set_index(val, idx);
-	snd_ctl_elem_value_set_enumerated(val, 0, state);
-	if ((err = snd_ctl_elem_write(ctl, val)) < 0)
+	if ((err = envy24_sense_set(ctl, ENVY24_SENSE_ADC, idx, state)) < 0)
 		g_print("Unable to write adc sense: %s\n", snd_strerror(err));
 }
 
 /*
  */
 
-void analog_volume_init(void)
+/* number of consecutive indexes of an analog volume, its maximum in *max */
+static int analog_volume_count(int type, int *max)
 {
-	snd_ctl_elem_info_t *info;
-	int i;
+	int i, val;
 
-	snd_ctl_elem_info_alloca(&info);
-
-	snd_ctl_elem_info_set_interface(info, SND_CTL_ELEM_IFACE_MIXER);
 	for (i = 0; i < 10; i++) {
-		snd_ctl_elem_info_set_name(info, DAC_VOLUME_NAME);
-		snd_ctl_elem_info_set_numid(info, 0);
-		snd_ctl_elem_info_set_index(info, i);
-		if (snd_ctl_elem_info(ctl, info) < 0)
+		if ((val = envy24_analog_max(ctl, type, i)) < 0)
 			break;
-		dac_max = snd_ctl_elem_info_get_max(info);
+		if (max)
+			*max = val;
 	}
-	if (i < output_channels - 1)
-		dac_volumes = i;
-	else
-		dac_volumes = output_channels;
+	return i;
+}
 
-	snd_ctl_elem_info_set_name(info, DAC_SENSE_NAME);
-	for (i = 0; i < dac_volumes; i++) {
-		snd_ctl_elem_info_set_numid(info, 0);
-		snd_ctl_elem_info_set_index(info, i);
-		if (snd_ctl_elem_info(ctl, info) < 0)
+/* number of sensitivity switches up to count, their item names in names */
+static int analog_sense_count(int type, int count, int *items, char **names)
+{
+	char name[64];
+	int i;
+
+	for (i = 0; i < count; i++) {
+		if (envy24_sense_items(ctl, type, i) < 0)
 			break;
 	}
-	dac_senses = i;
-	if (dac_senses > 0) {
-		snd_ctl_elem_info_set_numid(info, 0);
-		snd_ctl_elem_info_set_index(info, 0);
-		snd_ctl_elem_info(ctl, info);
-		dac_sense_items = snd_ctl_elem_info_get_items(info);
-		for (i = 0; i < dac_sense_items; i++) {
-			snd_ctl_elem_info_set_item(info, i);
-			snd_ctl_elem_info(ctl, info);
-			dac_sense_name[i] = strdup(snd_ctl_elem_info_get_item_name(info));
+	if (i > 0) {
+		*items = envy24_sense_items(ctl, type, 0);
+		if (*items > 4)
+			*items = 4;
+		for (count = 0; count < *items; count++) {
+			if (envy24_sense_item_name(ctl, type, count, name, sizeof(name)) < 0)
+				name[0] = '\0';
+			names[count] = strdup(name);
 		}
 	}
+	return i;
+}
 
-	for (i = 0; i < 10; i++) {
-		snd_ctl_elem_info_set_name(info, ADC_VOLUME_NAME);
-		snd_ctl_elem_info_set_numid(info, 0);
-		snd_ctl_elem_info_set_index(info, i);
-		if (snd_ctl_elem_info(ctl, info) < 0)
-			break;
-		adc_max = snd_ctl_elem_info_get_max(info);
-	}
+void analog_volume_init(void)
+{
+	int i;
+
+	i = analog_volume_count(ENVY24_ANALOG_DAC, &dac_max);
+	if (i < output_channels - 1)
+		dac_volumes = i;
+	else
+		dac_volumes = output_channels;
+	dac_senses = analog_sense_count(ENVY24_SENSE_DAC, dac_volumes, &dac_sense_items, dac_sense_name);
+
+	i = analog_volume_count(ENVY24_ANALOG_ADC, &adc_max);
 	if (i < input_channels - 1)
 		adc_volumes = i;
 	else
 		adc_volumes = input_channels;
-	snd_ctl_elem_info_set_name(info, ADC_SENSE_NAME);
-	for (i = 0; i < adc_volumes; i++) {
-		snd_ctl_elem_info_set_numid(info, 0);
-		snd_ctl_elem_info_set_index(info, i);
-		if (snd_ctl_elem_info(ctl, info) < 0)
-			break;
-	}
-	adc_senses = i;
-	if (adc_senses > 0) {
-		snd_ctl_elem_info_set_numid(info, 0);
-		snd_ctl_elem_info_set_index(info, 0);
-		snd_ctl_elem_info(ctl, info);
-		adc_sense_items = snd_ctl_elem_info_get_items(info);
-		for (i = 0; i < adc_sense_items; i++) {
-			snd_ctl_elem_info_set_item(info, i);
-			snd_ctl_elem_info(ctl, info);
-			adc_sense_name[i] = strdup(snd_ctl_elem_info_get_item_name(info));
-		}
-	}
+	adc_senses = analog_sense_count(ENVY24_SENSE_ADC, adc_volumes, &adc_sense_items, adc_sense_name);
 
-	for (i = 0; i < 10; i++) {
-		snd_ctl_elem_info_set_name(info, IPGA_VOLUME_NAME);
-		snd_ctl_elem_info_set_numid(info, 0);
-		snd_ctl_elem_info_set_index(info, i);
-		if (snd_ctl_elem_info(ctl, info) < 0)
-			break;
-	}
+	i = analog_volume_count(ENVY24_ANALOG_IPGA, NULL);
 	if (i < input_channels - 1)
 		ipga_volumes = i;
 	else
@@ -39,6 +39,9 @@ struct msg_resp
 	int size;
 };
 
+/* ms without progress after which a transfer fails */
+#define COMM_TIMEOUT 10000
+
 #define COMM_TYPE_LOCAL 0
 #define COMM_TYPE_IP 1
 
@@ -100,5 +100,19 @@
 #define LD10K1_ERR_WRONG_VER -65 /* wrong ld10k1 <=> lo10k1 version */
 
 #define LD10K1_ERR_UNKNOWN_POINT -66 /*  */
+#define LD10K1_ERR_UNKNOWN_OP -67 /* ld10k1 doesn't know requested operation */
+#define LD10K1_ERR_TRANSACTION -68 /* not allowed in this transaction state */
+#define LD10K1_ERR_UNKNOWN_CTL -69 /* patch doesn't have this control */
+#define LD10K1_ERR_CTL_VALUE -70 /* control value out of range */
+#define LD10K1_ERR_REPO_NOT_FOUND -71 /* patch is not in repository */
+#define LD10K1_ERR_REPO_IMAGE -72 /* stored patch is damaged */
+#define LD10K1_ERR_REPO_WRITE -73 /* can't write repository */
+#define LD10K1_ERR_DUMP_OPEN -74 /* can't open dump file */
+#define LD10K1_ERR_DUMP_READ -75 /* can't read dump file */
+#define LD10K1_ERR_DUMP_SIGNATURE -76 /* not a dump or unknown version */
+#define LD10K1_ERR_DUMP_SIZE -77 /* dump size doesn't match its header */
+#define LD10K1_ERR_DUMP_CHECKSUM -78 /* dump is damaged */
+#define LD10K1_ERR_DUMP_TYPE -79 /* dump is for other card type */
+#define LD10K1_ERR_DRIVER_TRAM_SETUP -80 /* can't setup tram */
 
 #endif /* __LD10K1_ERROR_H */
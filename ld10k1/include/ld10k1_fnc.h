@@ -329,6 +329,79 @@ typedef struct {
 	unsigned int chip_type;
 } ld10k1_fnc_dsp_info_t;
 
+typedef struct {
+	unsigned int chip_type;
+	unsigned int fx_count;
+	unsigned int in_count;
+	unsigned int out_count;
+	unsigned int patch_count;
+	unsigned int point_count;
+	/* last change event, see FNC_SUBSCRIBE */
+	unsigned int generation;
+} ld10k1_fnc_dsp_snapshot_t;
+
+#define LD10K1_EVENT_PATCH_ADD 1
+#define LD10K1_EVENT_PATCH_DEL 2
+#define LD10K1_EVENT_PATCH_RENAME 3
+#define LD10K1_EVENT_CONNECTION_ADD 4
+#define LD10K1_EVENT_CONNECTION_DEL 5
+#define LD10K1_EVENT_IO_RENAME 6
+#define LD10K1_EVENT_CTL_VALUE 7
+#define LD10K1_EVENT_DSP_INIT 8
+/* events were lost, client must reload everything */
+#define LD10K1_EVENT_RESYNC 9
+
+#define LD10K1_EVENT_MASK(type) (1 << (type))
+#define LD10K1_EVENT_MASK_ALL 0xFFFFFFFE
+
+typedef struct {
+	unsigned int mask;
+} ld10k1_fnc_subscribe_t;
+
+typedef struct {
+	unsigned int generation;
+	int type;
+	int patch_num;		/* -1 if not patch related */
+	int patch_id;
+	int io_type;		/* CON_IO_* for connections and renamed io */
+	int io;				/* io or control index */
+	int point_id;		/* connection point */
+	unsigned int count;	/* count of values, only this many are sent */
+	unsigned int value[MAX_CTL_GPR_COUNT];
+} ld10k1_fnc_event_t;
+
+/* FNC_CTL_SET carries up to this many values */
+#define LD10K1_CTL_SET_MAX 256
+
+typedef struct {
+	int patch_num;
+	int ctl;			/* control index in patch */
+	unsigned int idx;	/* value index, 0 .. vcount - 1 */
+	unsigned int value;	/* mixer value, min .. max */
+} ld10k1_fnc_ctl_value_t;
+
+/*
+ * Patch repository of ld10k1 keeps uploaded patches by key, which client
+ * computes from content of patch file and options used to transform it.
+ * Known patch is loaded with FNC_REPO_LOAD only, without transfer.
+ */
+typedef struct {
+	unsigned int hash[2];		/* 0, 0 - find by name */
+	char name[MAX_NAME_LEN];
+} ld10k1_fnc_repo_key_t;
+
+typedef struct {
+	ld10k1_fnc_repo_key_t key;
+	char patch_name[MAX_NAME_LEN];	/* empty - name of stored patch */
+	int where;
+} ld10k1_fnc_repo_load_t;
+
+/* same as FNC_PATCH_ADD, patch is stored in repository after load */
+typedef struct {
+	ld10k1_fnc_patch_add_t add;
+	ld10k1_fnc_repo_key_t key;
+} ld10k1_fnc_repo_patch_add_t;
+
 #define FNC_PATCH_ADD 1
 #define FNC_PATCH_DEL 2
 
@@ -371,6 +444,19 @@ typedef struct {
 #define FNC_GET_POINTS_INFO 70
 #define FNC_GET_POINT_INFO 71
 
+#define FNC_GET_DSP_SNAPSHOT 80
+
+#define FNC_TRANSACTION_BEGIN 85
+#define FNC_TRANSACTION_COMMIT 86
+#define FNC_TRANSACTION_ABORT 87
+
+#define FNC_SUBSCRIBE 88
+
+#define FNC_CTL_SET 89
+
+#define FNC_REPO_LOAD 90
+#define FNC_REPO_PATCH_ADD 91
+
 #define FNC_GET_DSP_INFO 97
 
 #define FNC_VERSION 98
@@ -380,6 +466,7 @@ typedef struct {
 #define FNC_ERR 101
 #define FNC_CONTINUE 102
 #define FNC_CLOSE_CONN 103
+#define FNC_EVENT 104
 
 #define FNC_DEBUG 200
 
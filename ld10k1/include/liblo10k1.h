@@ -67,6 +67,10 @@ typedef ld10k1_fnc_dsp_info_t liblo10k1_dsp_info_t;
 
 typedef ld10k1_dsp_point_t liblo10k1_point_info_t;
 
+typedef ld10k1_fnc_event_t liblo10k1_event_t;
+typedef ld10k1_fnc_ctl_value_t liblo10k1_ctl_value_t;
+typedef ld10k1_fnc_repo_key_t liblo10k1_repo_key_t;
+
 typedef comm_param liblo10k1_param;
 
 void liblo10k1_connection_init(liblo10k1_connection_t *conn);
@@ -91,10 +95,14 @@ int liblo10k1_patch_set_instr_count(liblo10k1_dsp_patch_t *p, int count);
 int liblo10k1_patch_load(liblo10k1_connection_t *conn, liblo10k1_dsp_patch_t *patch, int before, int *loaded, int *loaded_id);
 int liblo10k1_patch_unload(liblo10k1_connection_t *conn, int patch_num);
 int liblo10k1_patch_get(liblo10k1_connection_t *conn, int patch_num, liblo10k1_dsp_patch_t **patch);
+int liblo10k1_patch_receive(liblo10k1_connection_t *conn, liblo10k1_dsp_patch_t **patch);
 
 int liblo10k1_debug(liblo10k1_connection_t *conn, int deb, void (*prn_fnc)(char *));
 
 int liblo10k1_dsp_init(liblo10k1_connection_t *conn);
+int liblo10k1_transaction_begin(liblo10k1_connection_t *conn);
+int liblo10k1_transaction_commit(liblo10k1_connection_t *conn);
+int liblo10k1_transaction_abort(liblo10k1_connection_t *conn);
 
 int liblo10k1_find_patch(liblo10k1_connection_t *conn, char *patch_name, int *out);
 int liblo10k1_find_fx(liblo10k1_connection_t *conn, char *fx_name, int *out);
@@ -133,6 +141,16 @@ int liblo10k1_check_version(liblo10k1_connection_t *conn);
 
 int liblo10k1_get_dsp_info(liblo10k1_connection_t *conn, liblo10k1_dsp_info_t *info);
 
+int liblo10k1_subscribe(liblo10k1_connection_t *conn, unsigned int mask, unsigned int *generation);
+int liblo10k1_event_read(liblo10k1_connection_t *conn, liblo10k1_event_t *event, int timeout);
+
+int liblo10k1_ctl_set(liblo10k1_connection_t *conn, liblo10k1_ctl_value_t *values, int count);
+
+void liblo10k1_repo_key_init(liblo10k1_repo_key_t *key, const char *name);
+void liblo10k1_repo_key_add(liblo10k1_repo_key_t *key, const void *data, int size);
+int liblo10k1_repo_load(liblo10k1_connection_t *conn, liblo10k1_repo_key_t *key, char *patch_name, int before, int *loaded, int *loaded_id);
+int liblo10k1_repo_patch_load(liblo10k1_connection_t *conn, liblo10k1_dsp_patch_t *patch, liblo10k1_repo_key_t *key, int before, int *loaded, int *loaded_id);
+
 char *liblo10k1_error_str(int error);
 
 #ifdef __cplusplus
@@ -37,6 +37,46 @@ typedef struct {
 	char reserved[32];
 } liblo10k1_file_header_t;
 
+/*
+ * File version 0.2.0 - all numbers are 32 bit little endian, strings are
+ * stored as they are. Header is followed by parts, every part starts on
+ * 8 byte boundary and contains array of records with same layout as
+ * structures below (without pointers). Parts are found through table of
+ * contents, so file can be mapped to memory and every part used directly.
+ */
+typedef struct {
+	/* asciz string with signature - have to be
+	"LD10K1 NATIVE EFFECT FILE 2    "
+	 01234567890123456789012345678901 */
+	char signature[32];
+	/* LD10K1_FP_INFO_FILE_TYPE_... */
+	unsigned int file_type;
+	/* versions - major << 16 | minor << 8 | subminor */
+	unsigned int file_version;
+	unsigned int minimal_reader_version;
+	unsigned int creater_version;
+	/* whole file size */
+	unsigned int file_size;
+	/* table of contents - toc_count liblo10k1_file_toc_t */
+	unsigned int toc_offset;
+	unsigned int toc_count;
+	/* don't use this */
+	unsigned int reserved;
+} liblo10k1_file_header2_t;
+
+typedef struct {
+	/* LD10K1_FP_... */
+	unsigned int part_id;
+	/* patch index for patch parts, 0 for others */
+	unsigned int index;
+	/* offset from file start, multiple of 8 */
+	unsigned int offset;
+	/* part length in bytes */
+	unsigned int length;
+} liblo10k1_file_toc_t;
+
+/* parts of old files (version 0.1.0), only read */
+
 /* don't use this */
 #define LD10K1_FP_TYPE_RESERVED 0
 /* normal part type, part_length is valid */
@@ -0,0 +1,491 @@
+/*
+ *  EMU10k1 loader benchmark
+ *
+ *  Copyright (c) 2026 by the ALSA project
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+/*
+ * Measures ld10k1 from the client side, through liblo10k1 like lo10k1
+ * and the mixers do.
+ *
+ * load - many clients (processes) connected at once, each sends requests
+ *        as fast as it gets answers. Latency of every request is recorded,
+ *        percentiles over all clients are printed.
+ *
+ * comm - request/response round trips of growing size through comm.c over
+ *        socketpair, to other process which sends data back. ld10k1 is not
+ *        needed, this is transfer cost alone.
+ *
+ * ctl  - one client ramps control values of a loaded patch with
+ *        liblo10k1_ctl_set, like an automation script, first one value
+ *        per request, then all values of the patch in one request.
+ */
+
+#include <getopt.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <alsa/asoundlib.h>
+#include "version.h"
+#include "comm.h"
+#include "ld10k1_fnc.h"
+#include "ld10k1_error.h"
+
+#include "liblo10k1.h"
+
+#define BENCH_CLIENTS 32
+#define BENCH_REQUESTS 1000
+
+static char comm_pipe[256];
+static liblo10k1_param params;
+
+static int opt_clients = BENCH_CLIENTS;
+static int opt_requests = BENCH_REQUESTS;
+static int opt_patch = -1;
+
+static void error(const char *fmt,...)
+{
+	va_list va;
+
+	va_start(va, fmt);
+	fprintf(stderr, "Error: ");
+	vfprintf(stderr, fmt, va);
+	fprintf(stderr, "\n");
+	va_end(va);
+}
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int bench_connect(liblo10k1_connection_t *conn)
+{
+	int err;
+
+	liblo10k1_connection_init(conn);
+	if ((err = liblo10k1_connect(&params, conn))) {
+		error("unable to connect ld10k1");
+		return err;
+	}
+	if ((err = liblo10k1_check_version(conn))) {
+		error("wrong ld10k1 version");
+		liblo10k1_disconnect(conn);
+		return err;
+	}
+	return 0;
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+	double da = *(const double *)a, db = *(const double *)b;
+
+	return da < db ? -1 : da > db;
+}
+
+static double percentile(double *sorted, int count, int p)
+{
+	int idx = (int)((long long)count * p / 100);
+
+	if (idx >= count)
+		idx = count - 1;
+	return sorted[idx];
+}
+
+/* read-only requests a mixer or patch bay sends while it is open */
+static int load_request(liblo10k1_connection_t *conn, int n)
+{
+	liblo10k1_dsp_info_t dsp_info;
+	liblo10k1_patches_info_t *patches;
+	int *points;
+	int count, num, err;
+
+	switch (n % 4) {
+	case 0:
+		return liblo10k1_get_dsp_info(conn, &dsp_info);
+	case 1:
+		if ((err = liblo10k1_get_patches_info(conn, &patches, &count)))
+			return err;
+		free(patches);
+		return 0;
+	case 2:
+		if ((err = liblo10k1_get_points_info(conn, &points, &count)))
+			return err;
+		free(points);
+		return 0;
+	default:
+		return liblo10k1_find_patch(conn, "bench10k1", &num);
+	}
+}
+
+static int load_client(double *lat, int start_fd)
+{
+	liblo10k1_connection_t conn;
+	double t;
+	char c;
+	int i, err;
+
+	if (bench_connect(&conn))
+		return 1;
+	/* all clients are connected before the first request */
+	if (read(start_fd, &c, 1) < 0)
+		return 1;
+	for (i = 0; i < opt_requests; i++) {
+		t = now();
+		if ((err = load_request(&conn, i))) {
+			error("request failed (ld10k1 error:%s)", liblo10k1_error_str(err));
+			liblo10k1_disconnect(&conn);
+			return 1;
+		}
+		lat[i] = now() - t;
+	}
+	liblo10k1_disconnect(&conn);
+	return 0;
+}
+
+static int bench_load(void)
+{
+	double *lat, start, total;
+	int start_pipe[2];
+	int i, status, failed = 0;
+	long count = (long)opt_clients * opt_requests;
+	pid_t pid;
+
+	/* children write latencies here, parent sorts them */
+	lat = mmap(NULL, count * sizeof(double), PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (lat == MAP_FAILED || pipe(start_pipe) < 0) {
+		error("no memory");
+		return 1;
+	}
+
+	for (i = 0; i < opt_clients; i++) {
+		pid = fork();
+		if (pid < 0) {
+			error("fork failed");
+			opt_clients = i;
+			failed = 1;
+			break;
+		}
+		if (pid == 0) {
+			close(start_pipe[1]);
+			_exit(load_client(lat + (long)i * opt_requests, start_pipe[0]));
+		}
+	}
+	close(start_pipe[0]);
+	/* let clients connect, then start them all by closing the pipe */
+	sleep(1);
+	start = now();
+	close(start_pipe[1]);
+	while (wait(&status) > 0)
+		if (!WIFEXITED(status) || WEXITSTATUS(status))
+			failed = 1;
+	total = now() - start;
+	if (failed) {
+		error("some clients failed");
+		munmap(lat, count * sizeof(double));
+		return 1;
+	}
+
+	qsort(lat, count, sizeof(double), cmp_double);
+	printf("clients:   %d x %d requests\n", opt_clients, opt_requests);
+	printf("total:     %.3f s, %.0f requests/s\n", total, count / total);
+	printf("latency:   p50 %.1f us, p90 %.1f us, p99 %.1f us, max %.1f us\n",
+		percentile(lat, count, 50) * 1e6, percentile(lat, count, 90) * 1e6,
+		percentile(lat, count, 99) * 1e6, lat[count - 1] * 1e6);
+	munmap(lat, count * sizeof(double));
+	return 0;
+}
+
+/* other end of comm test, sends every request back as response */
+static int comm_echo(int sock)
+{
+	void *data;
+	int op, size;
+
+	while (1) {
+		if (receive_request(sock, &op, &size) < 0)
+			return 1;
+		if (op == FNC_CLOSE_CONN)
+			return 0;
+		data = NULL;
+		if (size > 0 && !(data = receive_msg_data_malloc(sock, size)))
+			return 1;
+		if (send_response(sock, op, 0, data, size) < 0)
+			return 1;
+		free(data);
+	}
+}
+
+static int bench_comm(void)
+{
+	static const int sizes[] = {16, 1024, 16384, 65536, 262144, 1048576};
+	char *data;
+	double start, t;
+	int sv[2];
+	int i, j, op, size, err = 0, status;
+	pid_t pid;
+
+	if (!(data = calloc(1, sizes[sizeof(sizes) / sizeof(sizes[0]) - 1]))) {
+		error("no memory");
+		return 1;
+	}
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) < 0) {
+		error("socketpair failed");
+		free(data);
+		return 1;
+	}
+	pid = fork();
+	if (pid < 0) {
+		error("fork failed");
+		free(data);
+		return 1;
+	}
+	if (pid == 0) {
+		close(sv[0]);
+		_exit(comm_echo(sv[1]));
+	}
+	close(sv[1]);
+
+	printf("size        round trips   us/round trip      MB/s\n");
+	for (i = 0; i < (int)(sizeof(sizes) / sizeof(sizes[0])) && !err; i++) {
+		start = now();
+		for (j = 0; j < opt_requests; j++) {
+			if ((err = send_request(sv[0], FNC_VERSION, data, sizes[i])) < 0 ||
+			    (err = receive_response(sv[0], &op, &size)) < 0 ||
+			    (err = receive_msg_data(sv[0], data, size)) < 0)
+				break;
+		}
+		t = now() - start;
+		if (err < 0) {
+			error("%d bytes: failed after %d round trips (ld10k1 error:%s)",
+				sizes[i], j, liblo10k1_error_str(err));
+			break;
+		}
+		printf("%-10d  %11d   %13.1f   %7.1f\n", sizes[i], opt_requests,
+			t * 1e6 / opt_requests, 2.0 * sizes[i] * opt_requests / t / 1e6);
+	}
+
+	send_request(sv[0], FNC_CLOSE_CONN, NULL, 0);
+	close(sv[0]);
+	waitpid(pid, &status, 0);
+	free(data);
+	return err < 0;
+}
+
+/* first patch with controls, when none was given */
+static int ctl_find_patch(liblo10k1_connection_t *conn, liblo10k1_dsp_patch_t **patch)
+{
+	liblo10k1_patches_info_t *patches;
+	int i, count, err;
+
+	if (opt_patch >= 0)
+		return liblo10k1_patch_get(conn, opt_patch, patch);
+
+	if ((err = liblo10k1_get_patches_info(conn, &patches, &count)))
+		return err;
+	for (i = 0; i < count; i++) {
+		if ((err = liblo10k1_patch_get(conn, patches[i].patch_num, patch)))
+			break;
+		if ((*patch)->ctl_count > 0) {
+			opt_patch = patches[i].patch_num;
+			break;
+		}
+		liblo10k1_patch_free(*patch);
+		*patch = NULL;
+	}
+	free(patches);
+	if (!err && i == count)
+		err = LD10K1_ERR_UNKNOWN_PATCH_NUM;
+	return err;
+}
+
+/* step of ramp from min to max for every value of patch */
+static int ctl_values(liblo10k1_dsp_patch_t *patch, int step, liblo10k1_ctl_value_t *values)
+{
+	liblo10k1_dsp_ctl_t *ctl;
+	int i, j, count = 0;
+
+	for (i = 0; i < patch->ctl_count; i++) {
+		ctl = &(patch->ctl[i]);
+		for (j = 0; j < ctl->vcount && count < LD10K1_CTL_SET_MAX; j++) {
+			values[count].patch_num = opt_patch;
+			values[count].ctl = i;
+			values[count].idx = j;
+			values[count].value = ctl->min + step % (ctl->max - ctl->min + 1);
+			count++;
+		}
+	}
+	return count;
+}
+
+static int ctl_run(liblo10k1_connection_t *conn, liblo10k1_dsp_patch_t *patch, int batch, double *lat)
+{
+	liblo10k1_ctl_value_t values[LD10K1_CTL_SET_MAX];
+	double start, t;
+	int i, count, err;
+
+	start = now();
+	for (i = 0; i < opt_requests; i++) {
+		count = ctl_values(patch, i, values);
+		t = now();
+		if ((err = liblo10k1_ctl_set(conn, batch ? values : &values[i % count], batch ? count : 1))) {
+			error("ctl set failed (ld10k1 error:%s)", liblo10k1_error_str(err));
+			return 1;
+		}
+		lat[i] = now() - t;
+	}
+	t = now() - start;
+
+	qsort(lat, opt_requests, sizeof(double), cmp_double);
+	printf("%s %.0f requests/s, %.0f values/s, p50 %.1f us, p99 %.1f us\n",
+		batch ? "batch: " : "single:", opt_requests / t,
+		opt_requests * (batch ? count : 1) / t,
+		percentile(lat, opt_requests, 50) * 1e6,
+		percentile(lat, opt_requests, 99) * 1e6);
+	return 0;
+}
+
+static int bench_ctl(void)
+{
+	liblo10k1_connection_t conn;
+	liblo10k1_dsp_patch_t *patch = NULL;
+	liblo10k1_ctl_value_t values[LD10K1_CTL_SET_MAX];
+	double *lat;
+	int err, res = 1;
+
+	if (bench_connect(&conn))
+		return 1;
+	if ((err = ctl_find_patch(&conn, &patch))) {
+		error("no patch with controls (ld10k1 error:%s)", liblo10k1_error_str(err));
+		goto end;
+	}
+	if (!(lat = malloc(opt_requests * sizeof(double)))) {
+		error("no memory");
+		goto end;
+	}
+
+	printf("patch:     %d %s, %d controls, %d values\n", opt_patch, patch->patch_name,
+		patch->ctl_count, ctl_values(patch, 0, values));
+	if (!ctl_run(&conn, patch, 0, lat) && !ctl_run(&conn, patch, 1, lat))
+		res = 0;
+	free(lat);
+end:
+	if (patch)
+		liblo10k1_patch_free(patch);
+	liblo10k1_disconnect(&conn);
+	return res;
+}
+
+static void help(char *command)
+{
+	printf("\n"
+		"bench10k1 - ld10k1 benchmark\n"
+		"(c) 2026 by the ALSA project\n\n"
+		"Usage: %s [parameters] test\n\n"
+		"Tests:\n"
+		"  load                 concurrent clients, request latency percentiles\n"
+		"  comm                 comm.c round trips over socketpair, no ld10k1 needed\n"
+		"  ctl                  control value updates of one patch per second\n\n"
+		"Parameters:\n"
+		"  -h, --help           this help\n"
+		"  -p, --pipe_name      connect to this, default = /tmp/.ld10k1_port\n"
+		"  -c, --clients        number of clients (%d)\n"
+		"  -n, --requests       requests per client, round trips per size (%d)\n"
+		"  -w, --where          patch for ctl, default is first one with controls\n",
+		command, BENCH_CLIENTS, BENCH_REQUESTS);
+}
+
+int main(int argc, char *argv[])
+{
+	int c;
+	int opt_help = 0;
+	char *test;
+
+	static struct option long_options[] = {
+				   {"help", 0, 0, 'h'},
+				   {"pipe_name", 1, 0, 'p'},
+				   {"clients", 1, 0, 'c'},
+				   {"requests", 1, 0, 'n'},
+				   {"where", 1, 0, 'w'},
+				   {0, 0, 0, 0}
+               };
+
+	strcpy(comm_pipe, "/tmp/.ld10k1_port");
+
+	int option_index = 0;
+	while ((c = getopt_long(argc, argv, "hp:c:n:w:",
+	        long_options, &option_index)) != EOF) {
+		switch (c) {
+		case 'h':
+			opt_help = 1;
+			break;
+		case 'p':
+			strncpy(comm_pipe, optarg, sizeof(comm_pipe) - 1);
+			break;
+		case 'c':
+			opt_clients = atoi(optarg);
+			break;
+		case 'n':
+			opt_requests = atoi(optarg);
+			break;
+		case 'w':
+			opt_patch = atoi(optarg);
+			break;
+		default:
+			opt_help = 1;
+			break;
+		}
+	}
+
+	if (opt_help || optind != argc - 1 || opt_clients < 1 || opt_requests < 1) {
+		help(argv[0]);
+		return opt_help ? 0 : 1;
+	}
+	test = argv[optind];
+
+	params.type = COMM_TYPE_LOCAL;
+	params.name = comm_pipe;
+	params.server = 0;
+	params.port = 0;
+	params.wfc = 0;
+
+	if (!strcmp(test, "load"))
+		return bench_load();
+	if (!strcmp(test, "comm"))
+		return bench_comm();
+	if (!strcmp(test, "ctl"))
+		return bench_ctl();
+	error("unknown test %s", test);
+	return 1;
+}
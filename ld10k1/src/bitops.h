@@ -53,4 +53,26 @@ static inline int test_bit(unsigned int nr, unsigned long * addr)
 	return ((mask & *addr) != 0);
 }
 
+/* returns first set bit not below nr, size if there is none */
+static inline unsigned int find_next_bit(unsigned long * addr, unsigned int size, unsigned int nr)
+{
+	unsigned int bits = sizeof(unsigned long) * 8;
+	unsigned long word;
+
+	while (nr < size) {
+		word = addr[nr / bits] >> (nr % bits);
+		if (!word) {
+			/* skip whole clean word */
+			nr = (nr / bits + 1) * bits;
+			continue;
+		}
+		while (!(word & 1)) {
+			word >>= 1;
+			nr++;
+		}
+		return nr < size ? nr : size;
+	}
+	return size;
+}
+
 #endif /* _PZ_GENERIC_BITOPS_H */
@@ -25,6 +25,8 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <poll.h>
+#include <sys/uio.h>
 #include <sys/socket.h>
 #include <sys/un.h>
 #include <sys/stat.h>
@@ -178,75 +180,112 @@ int free_comm(int conn_num)
 	return 0;
 }
 
-#define MAX_ATEMPT 5
+/*
+ * Waits until conn_num is ready for events; a peer which does not move
+ * any data for COMM_TIMEOUT ms is an error.
+ */
+static int wait_comm(int conn_num, short events)
+{
+	struct pollfd pfd;
+	int res;
+
+	pfd.fd = conn_num;
+	pfd.events = events;
+	pfd.revents = 0;
+	do {
+		res = poll(&pfd, 1, COMM_TIMEOUT);
+	} while (res < 0 && errno == EINTR);
+	if (res <= 0)
+		return -1;
+	return 0;
+}
 
 int read_all(int conn_num, void *data, int data_size)
 {
 	int offset = 0;
 	int how_much = data_size;
-	int atempt = 0;
 	int readed = 0;
 	
-	while (atempt < MAX_ATEMPT && how_much > 0)	{
+	while (how_much > 0)	{
+		if (wait_comm(conn_num, POLLIN) < 0)
+			return LD10K1_ERR_COMM_READ;
 		readed = read(conn_num, ((char *)data) + offset, how_much);
-		if (readed < 0)
+		if (readed < 0) {
+			if (errno == EINTR || errno == EAGAIN)
+				continue;
+			return LD10K1_ERR_COMM_READ;
+		}
+		if (readed == 0)
+			/* connection closed */
 			return LD10K1_ERR_COMM_READ;
 		offset += readed;
 		how_much -= readed;
-		atempt++;
-		if (how_much > 0)
-			usleep(10000);
 	}
 	
-	if (how_much > 0)
-		return LD10K1_ERR_COMM_READ;
-	else
-		return data_size;
+	return data_size;
 }
 
-int write_all(int conn_num, void *data, int data_size)
+/* writes all iovecs, iov is modified */
+static int writev_all(int conn_num, struct iovec *iov, int iovcnt)
 {
-	int offset = 0;
-	int how_much = data_size;
-	int atempt = 0;
-	int writed = 0;
-	
-	while (atempt < MAX_ATEMPT && how_much > 0)	{
-		writed = write(conn_num, ((char *)data) + offset, how_much);
-		if (writed < 0)
+	ssize_t writed;
+	int total = 0;
+
+	while (iovcnt > 0) {
+		if (iov->iov_len == 0) {
+			iov++;
+			iovcnt--;
+			continue;
+		}
+		if (wait_comm(conn_num, POLLOUT) < 0)
 			return LD10K1_ERR_COMM_WRITE;
-		offset += writed;
-		how_much -= writed;
-		atempt++;
-		if (how_much > 0)
-			usleep(50000);
+		writed = writev(conn_num, iov, iovcnt);
+		if (writed < 0) {
+			if (errno == EINTR || errno == EAGAIN)
+				continue;
+			return LD10K1_ERR_COMM_WRITE;
+		}
+		total += writed;
+		/* skip what was written */
+		while (iovcnt > 0 && (size_t)writed >= iov->iov_len) {
+			writed -= iov->iov_len;
+			iov++;
+			iovcnt--;
+		}
+		if (iovcnt > 0) {
+			iov->iov_base = (char *)iov->iov_base + writed;
+			iov->iov_len -= writed;
+		}
 	}
-	
-	if (how_much > 0)
-		return LD10K1_ERR_COMM_WRITE;
-	else
-		return data_size;
+	return total;
+}
+
+int write_all(int conn_num, void *data, int data_size)
+{
+	struct iovec iov;
+
+	iov.iov_base = data;
+	iov.iov_len = data_size;
+	return writev_all(conn_num, &iov, 1);
 }
 
 int send_request(int conn_num, int op, void *data, int data_size)
 {
 	int nbytes;
 	struct msg_req header;
+	struct iovec iov[2];
 
 	header.op = op;
 	header.size = data_size;
 
-	/* header */
-	nbytes = write_all(conn_num, &header, sizeof(header));
+	/* header and data in one go */
+	iov[0].iov_base = &header;
+	iov[0].iov_len = sizeof(header);
+	iov[1].iov_base = data;
+	iov[1].iov_len = data_size > 0 ? data_size : 0;
+	nbytes = writev_all(conn_num, iov, 2);
 	if (nbytes < 0)
 		return nbytes;
-
-	if (data_size > 0) {
-		/* data */
-		nbytes = write_all(conn_num, data, data_size);
-		if (nbytes < 0)
-			return nbytes;
-	}
 	return 0;
 }
 
@@ -254,22 +293,20 @@ int send_response(int conn_num, int op, int err, void *data, int data_size)
 {
 	int nbytes;
 	struct msg_resp header;
+	struct iovec iov[2];
 
 	header.op = op;
 	header.err = err;
 	header.size = data_size;
 
-	/* header */
-	nbytes = write_all(conn_num, &header, sizeof(header));
+	/* header and data in one go */
+	iov[0].iov_base = &header;
+	iov[0].iov_len = sizeof(header);
+	iov[1].iov_base = data;
+	iov[1].iov_len = data_size > 0 ? data_size : 0;
+	nbytes = writev_all(conn_num, iov, 2);
 	if (nbytes < 0)
 		return nbytes;
-
-	if (data_size > 0) {
-		/* data */
-		nbytes = write_all(conn_num, data, data_size);
-		if (nbytes < 0)
-			return nbytes;
-	}
 	return 0;
 }
 
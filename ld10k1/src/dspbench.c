@@ -0,0 +1,829 @@
+/*
+ *  EMU10k1 loader DSP manager benchmark
+ *
+ *  Copyright (c) 2026 by the ALSA project
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+/*
+ * Runs the DSP manager of ld10k1 (ld10k1_fnc.c) in process on a simulated
+ * card. It is built with DEBUG_DRIVER, so everything down to the code
+ * structure for the driver is done, only the ioctl is not sent. Patches
+ * are synthetic: every dyn is written first and read after all writes,
+ * so dyns can't share gprs and the optimizer keeps the code.
+ *
+ * fill  - loads patches until there is no free register, then times
+ *         load and unload of one more patch on the full DSP.
+ *
+ * check - random loads and unloads, every load is replayed on the state
+ *         before it with the allocators of ld10k1 before free bitmaps
+ *         (linear scans, copied below) and the registers picked have to
+ *         be the same.
+ *
+ * reverse - loads patches each in front of all loaded ones and the same
+ *         patches appended, prints time and count of instructions the
+ *         driver would get.
+ *
+ * lookup - loads a chain of patches, each output connected to input of
+ *         next one, and times patch find by name, control find and point
+ *         find by id as the chain grows.
+ */
+
+#include <getopt.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <alsa/asoundlib.h>
+#include <alsa/sound/emu10k1.h>
+#include "ld10k1.h"
+#include "ld10k1_fnc.h"
+#include "ld10k1_fnc_int.h"
+#include "ld10k1_error.h"
+
+#define BENCH_LOADS 1000
+#define BENCH_SEED 1
+#define BENCH_PATCHES 50
+#define BENCH_ROUNDS 20
+#define BENCH_LOOKUPS 1000000
+
+/* registers of one synthetic patch */
+typedef struct {
+	unsigned int sta_count;
+	unsigned int const_count;
+	unsigned int dyn_count;
+	unsigned int ctl_count;
+	unsigned int ctl_gpr_count;
+} bench_shape_t;
+
+/* ld10k1_driver.c talks to this, with DEBUG_DRIVER only for version and info */
+LD10K1_CARD_STATE snd_hwdep_t *handle;
+
+static ld10k1_dsp_mgr_t dsp_mgr;
+
+static int opt_live = 0;
+static int opt_loads = BENCH_LOADS;
+static unsigned int opt_seed = BENCH_SEED;
+static int opt_patches = BENCH_PATCHES;
+static int opt_rounds = BENCH_ROUNDS;
+static int opt_lookups = BENCH_LOOKUPS;
+
+void error(const char *fmt,...)
+{
+	va_list va;
+
+	va_start(va, fmt);
+	fprintf(stderr, "Error: ");
+	vfprintf(stderr, fmt, va);
+	fprintf(stderr, "\n");
+	va_end(va);
+}
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int bench_init(void)
+{
+	memset(&dsp_mgr, 0, sizeof(dsp_mgr));
+	dsp_mgr.audigy = !opt_live;
+	if (ld10k1_dsp_mgr_init(&dsp_mgr)) {
+		error("unable to init dsp manager");
+		return 1;
+	}
+	ld10k1_dsp_mgr_init_id_gen(&dsp_mgr);
+	return 0;
+}
+
+/*
+ * Half of constants are shared between patches, like 0.5 or 1.0 are,
+ * and values repeat in bigger patches too.
+ */
+static unsigned int bench_const_val(unsigned int i, unsigned int unique)
+{
+	if (i % 2 == 0)
+		return 0x10000000 + i % 4;
+	return unique * 0x100 + i % 6 + 1;
+}
+
+static ld10k1_patch_t *bench_patch(const char *name, bench_shape_t *shape, unsigned int unique)
+{
+	ld10k1_patch_t *patch;
+	unsigned int i, j, k;
+	unsigned int instr_count = shape->dyn_count * 2;
+
+	if (!(patch = ld10k1_dsp_mgr_patch_new()))
+		return NULL;
+	if (!ld10k1_dsp_mgr_name_new(&(patch->patch_name), name) ||
+		!ld10k1_dsp_mgr_patch_in_new(patch, 1) ||
+		!ld10k1_dsp_mgr_patch_out_new(patch, 1) ||
+		!ld10k1_dsp_mgr_patch_sta_new(patch, shape->sta_count) ||
+		!ld10k1_dsp_mgr_patch_const_new(patch, shape->const_count) ||
+		!ld10k1_dsp_mgr_patch_dyn_new(patch, shape->dyn_count) ||
+		!ld10k1_dsp_mgr_patch_ctl_new(patch, shape->ctl_count) ||
+		!ld10k1_dsp_mgr_patch_instr_new(patch, instr_count))
+		goto err;
+
+	for (i = 0; i < shape->sta_count; i++)
+		patch->stas[i].const_val = i;
+	for (i = 0; i < shape->const_count; i++)
+		patch->consts[i].const_val = bench_const_val(i, unique);
+
+	for (i = 0; i < shape->ctl_count; i++) {
+		if (i == 0)
+			snprintf(patch->ctl[i].name, sizeof(patch->ctl[i].name), "%s Volume", name);
+		else
+			snprintf(patch->ctl[i].name, sizeof(patch->ctl[i].name), "%s Volume %u", name, i);
+		patch->ctl[i].index = -1;
+		patch->ctl[i].want_index = -1;
+		patch->ctl[i].count = shape->ctl_gpr_count;
+		patch->ctl[i].vcount = shape->ctl_gpr_count;
+		patch->ctl[i].min = 0;
+		patch->ctl[i].max = 100;
+		for (j = 0; j < shape->ctl_gpr_count; j++)
+			patch->ctl[i].value[j] = 100;
+	}
+
+	/* dyn = in + sta * const for all dyns, then out = dyn + ctl * const */
+	for (i = 0, k = 0; i < shape->dyn_count; i++, k++) {
+		patch->instr[k].op_code = iMAC0;
+		patch->instr[k].arg[0] = EMU10K1_PREG_DYN(i);
+		patch->instr[k].arg[1] = EMU10K1_PREG_IN(0);
+		patch->instr[k].arg[2] = EMU10K1_PREG_STA(i % shape->sta_count);
+		patch->instr[k].arg[3] = EMU10K1_PREG_CONST(i % shape->const_count);
+	}
+	for (i = 0; i < shape->dyn_count; i++, k++) {
+		patch->instr[k].op_code = iMAC0;
+		patch->instr[k].arg[0] = EMU10K1_PREG_OUT(0);
+		patch->instr[k].arg[1] = EMU10K1_PREG_DYN(i);
+		patch->instr[k].arg[2] = EMU10K1_PREG_CTL(i % shape->ctl_count, i % shape->ctl_gpr_count);
+		patch->instr[k].arg[3] = EMU10K1_PREG_CONST((i + 1) % shape->const_count);
+	}
+	for (k = 0; k < instr_count; k++) {
+		patch->instr[k].used = 1;
+		patch->instr[k].modified = 1;
+		for (j = 0; j < 4; j++)
+			if (!patch->instr[k].arg[j])
+				goto err;
+	}
+	return patch;
+err:
+	ld10k1_dsp_mgr_patch_free(patch);
+	return NULL;
+}
+
+static int bench_load(ld10k1_patch_t *patch, int before, int *loaded)
+{
+	int err;
+
+	if ((err = ld10k1_patch_fnc_check_patch(&dsp_mgr, patch)) < 0 ||
+		(err = ld10k1_dsp_mgr_patch_load(&dsp_mgr, patch, before, loaded)) < 0)
+		ld10k1_dsp_mgr_patch_free(patch);
+	return err;
+}
+
+static int bench_unload(int idx)
+{
+	ld10k1_fnc_patch_del_t del;
+
+	del.where = idx;
+	return ld10k1_patch_fnc_del(&dsp_mgr, &del);
+}
+
+static int bench_full(int err)
+{
+	return err == LD10K1_ERR_NOT_FREE_REG || err == LD10K1_ERR_NOT_FREE_INSTR ||
+		err == LD10K1_ERR_MAX_PATCH_COUNT;
+}
+
+static void bench_usage(void)
+{
+	unsigned int i, gprs = 0, consts = 0;
+
+	for (i = 0; i < dsp_mgr.regs_max_count; i++)
+		if (dsp_mgr.regs[i].used)
+			gprs++;
+	for (i = 0; i < dsp_mgr.consts_max_count; i++)
+		if (dsp_mgr.consts[i].used)
+			consts++;
+	printf("dsp:       %d patches, %u/%u gprs, %u constants, %u/%u instructions used\n",
+		dsp_mgr.patch_count, gprs, dsp_mgr.regs_max_count, consts,
+		dsp_mgr.instr_count - dsp_mgr.instr_free, dsp_mgr.instr_count);
+}
+
+static int bench_fill(void)
+{
+	bench_shape_t shape = {4, 6, 4, 1, 2};
+	ld10k1_patch_t *patch;
+	char name[MAX_NAME_LEN];
+	double start, t, load_time = 0, unload_time = 0, first = 0;
+	int loaded[2], last = -1;
+	int i, err;
+
+	if (bench_init())
+		return 1;
+
+	for (i = 0; ; i++) {
+		snprintf(name, sizeof(name), "fill %d", i);
+		if (!(patch = bench_patch(name, &shape, i))) {
+			error("no memory");
+			return 1;
+		}
+		start = now();
+		err = bench_load(patch, dsp_mgr.patch_count, loaded);
+		t = now() - start;
+		if (bench_full(err))
+			break;
+		if (err < 0) {
+			error("load of %s failed (ld10k1 error:%d)", name, err);
+			return 1;
+		}
+		if (i == 0)
+			first = t;
+		last = loaded[0];
+	}
+	bench_usage();
+	if (last < 0) {
+		error("no patch fits");
+		return 1;
+	}
+
+	/* room for exactly one more */
+	if ((err = bench_unload(last)) < 0) {
+		error("unload failed (ld10k1 error:%d)", err);
+		return 1;
+	}
+	for (i = 0; i < opt_loads; i++) {
+		if (!(patch = bench_patch("probe", &shape, 100000 + i))) {
+			error("no memory");
+			return 1;
+		}
+		start = now();
+		err = bench_load(patch, dsp_mgr.patch_count, loaded);
+		load_time += now() - start;
+		if (err < 0) {
+			error("load on full dsp failed (ld10k1 error:%d)", err);
+			return 1;
+		}
+		start = now();
+		err = bench_unload(loaded[0]);
+		unload_time += now() - start;
+		if (err < 0) {
+			error("unload failed (ld10k1 error:%d)", err);
+			return 1;
+		}
+	}
+	printf("empty:     %.1f us first load\n", first * 1e6);
+	printf("full:      %.1f us per load, %.1f us per unload (%d loads)\n",
+		load_time * 1e6 / opt_loads, unload_time * 1e6 / opt_loads, opt_loads);
+	ld10k1_dsp_mgr_free(&dsp_mgr);
+	return 0;
+}
+
+/*
+ * Allocators of ld10k1 before free bitmaps and constant hash, only reserved
+ * lists are passed in one place. They change reserved registers in dsp
+ * manager as they always did, so they run on saved copy.
+ */
+typedef struct {
+	int count;
+	int idx[MAX_CONST_COUNT];
+} old_res_t;
+
+static unsigned int old_gpr_reserve(ld10k1_dsp_mgr_t *dsp_mgr, old_res_t *res,
+	unsigned int usage, unsigned int val)
+{
+	int i, j;
+	if (res->count >= MAX_GPR_COUNT)
+		return 0;
+
+	for (i = 0; i < dsp_mgr->regs_max_count; i++) {
+		if (!dsp_mgr->regs[i].used) {
+			/* check in reserved */
+			for (j = 0; j < res->count; j++) {
+				if (res->idx[j] == i)
+					break;
+			}
+
+			if (j >= res->count) {
+				res->idx[res->count++] = i;
+				dsp_mgr->regs[i].gpr_usage = usage;
+				dsp_mgr->regs[i].val = val;
+				return EMU10K1_REG_NORMAL(i);
+			}
+		}
+	}
+	return 0;
+}
+
+static unsigned int old_gpr_dyn_reserve(ld10k1_dsp_mgr_t *dsp_mgr, old_res_t *res)
+{
+	int i, j;
+	if (res->count >= MAX_GPR_COUNT)
+		return 0;
+
+	/* try find other dyn not reserved */
+	for (i = 0; i < dsp_mgr->regs_max_count; i++) {
+		if (dsp_mgr->regs[i].used && dsp_mgr->regs[i].gpr_usage == GPR_USAGE_DYNAMIC) {
+			/* check in reserved */
+			for (j = 0; j < res->count; j++) {
+				if (res->idx[j] == i)
+					break;
+			}
+
+			if (j >= res->count) {
+				res->idx[res->count++] = i;
+				dsp_mgr->regs[i].gpr_usage = GPR_USAGE_DYNAMIC;
+				dsp_mgr->regs[i].val = 0;
+				return EMU10K1_REG_NORMAL(i);
+			}
+		}
+	}
+
+	/* not found - try normal */
+	return old_gpr_reserve(dsp_mgr, res, GPR_USAGE_DYNAMIC, 0);
+}
+
+static unsigned int old_const_reserve(ld10k1_dsp_mgr_t *dsp_mgr, old_res_t *res_const,
+	old_res_t *res, int const_val)
+{
+	int i, j;
+	int free_gpr;
+
+	if (res_const->count >= MAX_CONST_COUNT)
+		return 0;
+
+	/* check in reserved */
+	for (i = 0; i < res_const->count; i++) {
+		if (dsp_mgr->consts[res_const->idx[i]].const_val == const_val)
+			return EMU10K1_REG_CONST(res_const->idx[i]);
+	}
+
+	/* check in all constants */
+	for (i = 0; i < dsp_mgr->consts_max_count; i++)
+		if (dsp_mgr->consts[i].used && dsp_mgr->consts[i].const_val == const_val) {
+			/* add to reserved */
+			res_const->idx[res_const->count++] = i;
+			return EMU10K1_REG_CONST(i);
+		}
+
+	for (i = 0; i < dsp_mgr->consts_max_count; i++) {
+		if (!dsp_mgr->consts[i].used) {
+			/* there is free room */
+			/* if in reserved continue */
+			for (j = 0; j < res_const->count; j++) {
+				if (res_const->idx[j] == i)
+					break;
+			}
+			if (j < res_const->count)
+				continue;
+
+			free_gpr = old_gpr_reserve(dsp_mgr, res, GPR_USAGE_CONST, const_val);
+			if (!free_gpr)
+				return 0;
+			res_const->idx[res_const->count++] = i;
+			dsp_mgr->consts[i].gpr_idx = free_gpr;
+			dsp_mgr->consts[i].const_val = const_val;
+			dsp_mgr->consts[i].hw = 0;
+			return EMU10K1_REG_CONST(i);
+		}
+	}
+
+	return 0;
+}
+
+/* registers old code picks for patch, in order of ld10k1_dsp_mgr_patch_load */
+typedef struct {
+	unsigned int sta[256];
+	unsigned int cnst[256];
+	unsigned int dyn[256];
+	unsigned int ctl[256];
+} old_pick_t;
+
+static int old_patch_reserve(ld10k1_dsp_mgr_t *saved, ld10k1_patch_t *patch,
+	unsigned int dyn_gpr_count, old_pick_t *pick)
+{
+	old_res_t res;
+	old_res_t const_res;
+	unsigned int i, j, k;
+
+	res.count = 0;
+	const_res.count = 0;
+
+	for (i = 0; i < patch->sta_count; i++)
+		if (!(pick->sta[i] = old_gpr_reserve(saved, &res, GPR_USAGE_NORMAL, patch->stas[i].const_val)))
+			return LD10K1_ERR_NOT_FREE_REG;
+	for (i = 0; i < patch->const_count; i++)
+		if (!(pick->cnst[i] = old_const_reserve(saved, &const_res, &res, patch->consts[i].const_val)))
+			return LD10K1_ERR_NOT_FREE_REG;
+	for (i = 0; i < dyn_gpr_count; i++)
+		if (!(pick->dyn[i] = old_gpr_dyn_reserve(saved, &res)))
+			return LD10K1_ERR_NOT_FREE_REG;
+	for (i = 0, k = 0; i < patch->ctl_count; i++)
+		for (j = 0; j < patch->ctl[i].count; j++, k++)
+			if (!(pick->ctl[k] = old_gpr_reserve(saved, &res, GPR_USAGE_NORMAL, patch->ctl[i].value[j])))
+				return LD10K1_ERR_NOT_FREE_REG;
+	return 0;
+}
+
+/* returns count of registers picked differently */
+static int check_patch(ld10k1_dsp_mgr_t *saved, ld10k1_patch_t *patch, old_pick_t *pick)
+{
+	unsigned int i, j, k;
+	int diff = 0;
+
+	for (i = 0; i < patch->sta_count; i++)
+		if (patch->stas[i].gpr_idx != pick->sta[i])
+			diff++;
+	for (i = 0; i < patch->const_count; i++) {
+		if (patch->consts[i].gpr_idx != pick->cnst[i])
+			diff++;
+		else if (dsp_mgr.consts[pick->cnst[i] & ~EMU10K1_REG_TYPE_MASK].gpr_idx !=
+			saved->consts[pick->cnst[i] & ~EMU10K1_REG_TYPE_MASK].gpr_idx)
+			diff++;
+	}
+	/* dyns go to gprs by color, compare the sets */
+	for (i = 0; i < patch->dyn_count; i++) {
+		for (j = 0; j < patch->dyn_gpr_count; j++)
+			if (patch->dyns[i].gpr_idx == pick->dyn[j])
+				break;
+		if (j == patch->dyn_gpr_count)
+			diff++;
+	}
+	for (i = 0, k = 0; i < patch->ctl_count; i++)
+		for (j = 0; j < patch->ctl[i].count; j++, k++)
+			if (patch->ctl[i].gpr_idx[j] != pick->ctl[k])
+				diff++;
+	return diff;
+}
+
+static int bench_check(void)
+{
+	bench_shape_t shape;
+	ld10k1_patch_t *patch;
+	ld10k1_dsp_mgr_t *saved;
+	old_pick_t pick;
+	char name[MAX_NAME_LEN];
+	int loaded[2];
+	int i, err, old_err, diff;
+	int loads = 0, full = 0, unloads = 0, mismatches = 0;
+
+	if (bench_init())
+		return 1;
+	srand(opt_seed);
+
+	for (i = 0; i < opt_loads; i++) {
+		/* unload more often on full dsp */
+		if (dsp_mgr.patch_count > 0 && rand() % (dsp_mgr.instr_free < 64 ? 2 : 4) == 0) {
+			err = bench_unload(dsp_mgr.patch_order[rand() % dsp_mgr.patch_count]);
+			if (err < 0) {
+				error("unload failed (ld10k1 error:%d)", err);
+				return 1;
+			}
+			unloads++;
+			continue;
+		}
+
+		shape.sta_count = 1 + rand() % 8;
+		shape.const_count = 1 + rand() % 12;
+		shape.dyn_count = 1 + rand() % 12;
+		shape.ctl_count = 1 + rand() % 3;
+		shape.ctl_gpr_count = 1 + rand() % 4;
+		snprintf(name, sizeof(name), "check %d", i);
+		if (!(patch = bench_patch(name, &shape, rand() % 64)) ||
+			!(saved = ld10k1_dsp_mgr_save(&dsp_mgr))) {
+			error("no memory");
+			return 1;
+		}
+
+		/* patch is freed on failed load, but its registers are wanted */
+		err = ld10k1_patch_fnc_check_patch(&dsp_mgr, patch);
+		if (err >= 0)
+			err = ld10k1_dsp_mgr_patch_load(&dsp_mgr, patch, rand() % (dsp_mgr.patch_count + 1), loaded);
+
+		/* every dyn is live across whole patch, one gpr for each */
+		old_err = old_patch_reserve(saved, patch, err < 0 ? patch->dyn_count : patch->dyn_gpr_count, &pick);
+		if (err >= 0) {
+			loads++;
+			if (old_err < 0) {
+				printf("%s: loaded, old allocators have no room\n", name);
+				mismatches++;
+			} else if ((diff = check_patch(saved, patch, &pick)) > 0) {
+				printf("%s: %d registers differ\n", name, diff);
+				mismatches++;
+			}
+		} else {
+			if (err == LD10K1_ERR_NOT_FREE_REG) {
+				full++;
+				if (old_err >= 0) {
+					printf("%s: refused, old allocators have room\n", name);
+					mismatches++;
+				}
+			} else if (!bench_full(err)) {
+				error("load of %s failed (ld10k1 error:%d)", name, err);
+				return 1;
+			}
+			ld10k1_dsp_mgr_patch_free(patch);
+		}
+		ld10k1_dsp_mgr_discard(saved);
+	}
+	bench_usage();
+	printf("check:     %d loads, %d refused for registers, %d unloads, %d mismatches\n",
+		loads, full, unloads, mismatches);
+	ld10k1_dsp_mgr_free(&dsp_mgr);
+	return mismatches > 0;
+}
+
+/* loads opt_patches patches, at start or at end of order, and unloads them */
+static int order_round(int reverse, double *time, unsigned long *rewritten)
+{
+	bench_shape_t shape = {2, 4, 8, 1, 2};
+	ld10k1_patch_t *patch;
+	char name[MAX_NAME_LEN];
+	double start;
+	int loaded[2];
+	int i, err;
+
+	for (i = 0; i < opt_patches; i++) {
+		snprintf(name, sizeof(name), "order %d", i);
+		if (!(patch = bench_patch(name, &shape, i))) {
+			error("no memory");
+			return 1;
+		}
+		start = now();
+		err = bench_load(patch, reverse ? 0 : dsp_mgr.patch_count, loaded);
+		*time += now() - start;
+		if (err < 0) {
+			error("load of %s failed (ld10k1 error:%d)", name, err);
+			return 1;
+		}
+		/* DEBUG_DRIVER drops the ioctl, this is what it would carry */
+		*rewritten += dsp_mgr.instr_window_last;
+	}
+	while (dsp_mgr.patch_count > 0)
+		if ((err = bench_unload(dsp_mgr.patch_order[dsp_mgr.patch_count - 1])) < 0) {
+			error("unload failed (ld10k1 error:%d)", err);
+			return 1;
+		}
+	return 0;
+}
+
+static int bench_reverse(void)
+{
+	double time[2] = {0, 0};
+	unsigned long rewritten[2] = {0, 0};
+	int i, reverse;
+
+	if (bench_init())
+		return 1;
+
+	for (i = 0; i < opt_rounds; i++)
+		for (reverse = 0; reverse < 2; reverse++)
+			if (order_round(reverse, &time[reverse], &rewritten[reverse]))
+				return 1;
+
+	printf("patches:   %d loads per round, %d rounds\n", opt_patches, opt_rounds);
+	for (reverse = 0; reverse < 2; reverse++)
+		printf("%s   %.3f ms total, %.1f us per load, %lu instructions rewritten\n",
+			reverse ? "reverse:" : "append: ",
+			time[reverse] * 1e3 / opt_rounds,
+			time[reverse] * 1e6 / opt_rounds / opt_patches,
+			rewritten[reverse] / opt_rounds);
+	ld10k1_dsp_mgr_free(&dsp_mgr);
+	return 0;
+}
+
+/* names of patches loaded by lookup, by load order */
+static char lookup_names[EMU10K1_PATCH_MAX][MAX_NAME_LEN];
+
+/* random loaded patch, control and point for each lookup, then times them */
+static int lookup_size(int *slots, int *points, int count, int *pick)
+{
+	ld10k1_patch_t *patch;
+	ld10k1_ctl_t *ctl;
+	double start, t[3];
+	int i, found = 0;
+
+	for (i = 0; i < opt_lookups; i++)
+		pick[i] = rand() % count;
+
+	start = now();
+	for (i = 0; i < opt_lookups; i++)
+		if (ld10k1_patch_find(&dsp_mgr, lookup_names[pick[i]]) == slots[pick[i]])
+			found++;
+	t[0] = now() - start;
+
+	start = now();
+	for (i = 0; i < opt_lookups; i++) {
+		patch = dsp_mgr.patch_ptr[slots[pick[i]]];
+		ctl = &(patch->ctl[i % patch->ctl_count]);
+		if (ld10k1_look_control_from_list(&(dsp_mgr.ctl_list), ctl))
+			found++;
+	}
+	t[1] = now() - start;
+
+	/* one point less than patches */
+	start = now();
+	for (i = 0; i < opt_lookups; i++)
+		if (ld10k1_conn_point_find(&dsp_mgr, points[pick[i] % (count - 1)]))
+			found++;
+	t[2] = now() - start;
+
+	printf("%7d %9d %7d %10.1f ns %7.1f ns %8.1f ns\n",
+		count, dsp_mgr.ctl_list.count, count - 1,
+		t[0] * 1e9 / opt_lookups, t[1] * 1e9 / opt_lookups, t[2] * 1e9 / opt_lookups);
+	if (found != 3 * opt_lookups) {
+		error("%d lookups missed", 3 * opt_lookups - found);
+		return 1;
+	}
+	return 0;
+}
+
+static int bench_lookup(void)
+{
+	bench_shape_t shape = {1, 1, 2, 2, 1};
+	ld10k1_patch_t *patch;
+	ld10k1_fnc_connection_t conn;
+	int slots[EMU10K1_PATCH_MAX];
+	int points[EMU10K1_PATCH_MAX];
+	int *pick;
+	int loaded[2];
+	int count, next = 8, err, res = 1;
+
+	if (bench_init())
+		return 1;
+	if (!(pick = malloc(opt_lookups * sizeof(int)))) {
+		error("no memory");
+		return 1;
+	}
+	srand(opt_seed);
+
+	printf("patches  controls  points  patch find    ctl find  point find\n");
+	for (count = 0; count < EMU10K1_PATCH_MAX; count++) {
+		snprintf(lookup_names[count], MAX_NAME_LEN, "lookup %d", count);
+		if (!(patch = bench_patch(lookup_names[count], &shape, count))) {
+			error("no memory");
+			goto end;
+		}
+		err = bench_load(patch, dsp_mgr.patch_count, loaded);
+		if (bench_full(err))
+			break;
+		if (err < 0) {
+			error("load of %s failed (ld10k1 error:%d)", lookup_names[count], err);
+			goto end;
+		}
+		slots[count] = loaded[0];
+		if (count == 0)
+			continue;
+
+		memset(&conn, 0, sizeof(conn));
+		conn.what = FNC_CONNECTION_ADD;
+		conn.from_type = CON_IO_POUT;
+		conn.from_patch = slots[count - 1];
+		conn.from_io = 0;
+		conn.to_type = CON_IO_PIN;
+		conn.to_patch = slots[count];
+		conn.to_io = 0;
+		err = ld10k1_connection_fnc(&dsp_mgr, &conn, &points[count - 1]);
+		/* connection needs gpr too, drop unconnected patch */
+		if (bench_full(err)) {
+			if ((err = bench_unload(slots[count])) < 0) {
+				error("unload failed (ld10k1 error:%d)", err);
+				goto end;
+			}
+			break;
+		}
+		if (err < 0) {
+			error("connection failed (ld10k1 error:%d)", err);
+			goto end;
+		}
+
+		if (count + 1 == next) {
+			if (lookup_size(slots, points, count + 1, pick))
+				goto end;
+			next *= 2;
+		}
+	}
+	/* last size, unless it was just printed */
+	if (count * 2 != next && count > 1 && lookup_size(slots, points, count, pick))
+		goto end;
+	bench_usage();
+	res = 0;
+end:
+	free(pick);
+	ld10k1_dsp_mgr_free(&dsp_mgr);
+	return res;
+}
+
+static void help(char *command)
+{
+	printf("\n"
+		"dspbench - ld10k1 dsp manager benchmark\n"
+		"(c) 2026 by the ALSA project\n\n"
+		"Usage: %s [parameters] test\n\n"
+		"Tests:\n"
+		"  fill                 patch load and unload on full dsp\n"
+		"  check                compare registers picked with old allocators\n"
+		"  reverse              patches loaded in front of loaded ones and appended\n"
+		"  lookup               patch, control and point lookups as patch chain grows\n\n"
+		"Parameters:\n"
+		"  -h, --help           this help\n"
+		"  -l, --live           SB Live dsp, default is Audigy\n"
+		"  -n, --loads          loads to time or check (%d)\n"
+		"  -s, --seed           random seed for check and lookup (%d)\n"
+		"  -c, --patches        patches loaded in one round of reverse (%d)\n"
+		"  -r, --rounds         rounds of reverse (%d)\n"
+		"  -k, --lookups        lookups of each kind timed for every size (%d)\n",
+		command, BENCH_LOADS, BENCH_SEED, BENCH_PATCHES, BENCH_ROUNDS, BENCH_LOOKUPS);
+}
+
+int main(int argc, char *argv[])
+{
+	int c;
+	int opt_help = 0;
+	char *test;
+
+	static struct option long_options[] = {
+				   {"help", 0, 0, 'h'},
+				   {"live", 0, 0, 'l'},
+				   {"loads", 1, 0, 'n'},
+				   {"seed", 1, 0, 's'},
+				   {"patches", 1, 0, 'c'},
+				   {"rounds", 1, 0, 'r'},
+				   {"lookups", 1, 0, 'k'},
+				   {0, 0, 0, 0}
+               };
+
+	int option_index = 0;
+	while ((c = getopt_long(argc, argv, "hln:s:c:r:k:",
+	        long_options, &option_index)) != EOF) {
+		switch (c) {
+		case 'h':
+			opt_help = 1;
+			break;
+		case 'l':
+			opt_live = 1;
+			break;
+		case 'n':
+			opt_loads = atoi(optarg);
+			break;
+		case 's':
+			opt_seed = atoi(optarg);
+			break;
+		case 'c':
+			opt_patches = atoi(optarg);
+			break;
+		case 'r':
+			opt_rounds = atoi(optarg);
+			break;
+		case 'k':
+			opt_lookups = atoi(optarg);
+			break;
+		default:
+			opt_help = 1;
+			break;
+		}
+	}
+
+	if (opt_help || optind != argc - 1 || opt_loads < 1 || opt_patches < 1 || opt_rounds < 1 ||
+		opt_lookups < 1) {
+		help(argv[0]);
+		return opt_help ? 0 : 1;
+	}
+	test = argv[optind];
+
+	if (!strcmp(test, "fill"))
+		return bench_fill();
+	if (!strcmp(test, "check"))
+		return bench_check();
+	if (!strcmp(test, "reverse"))
+		return bench_reverse();
+	if (!strcmp(test, "lookup"))
+		return bench_lookup();
+	error("unknown test %s", test);
+	return 1;
+}
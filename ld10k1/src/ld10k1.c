@@ -34,13 +34,16 @@
 #include <unistd.h>
 #include <signal.h>
 #include <time.h>
+#include <pthread.h>
 
 #include "ld10k1.h"
 #include "ld10k1_fnc.h"
 #include "ld10k1_fnc1.h"
+#include "ld10k1_repo.h"
+#include "ld10k1_dump_file.h"
+#include "ld10k1_dump_load.h"
 
-int card = 0;
-snd_hwdep_t *handle;
+LD10K1_CARD_STATE snd_hwdep_t *handle;
 char comm_pipe[256];
 FILE *comm;
 char pidpath[256];
@@ -92,7 +95,7 @@ static void help(char *command)
 		"Usage: %s [-options]\n"
 		"\nAvailable options:\n"
 		"  -h, --help        this help\n"
-		"  -c, --card        select card number, default = 0\n"
+		"  -c, --card        select card number, default = 0, can be used more times\n"
 		"  -p, --pipe_name   connect to this, default = /tmp/.ld10k1_port\n"
 		"  -n, --network     listen on port\n"
 		"      --port        port number, default = 20480\n"
@@ -109,6 +112,9 @@ static void help(char *command)
 		"		6 -  512 KB\n"
 		"		7 - 1024 KB\n"
 		"		8 - 2048 KB\n"
+		"  -S, --staged      load new code beside running one and switch to it\n"
+		"  -r, --repository  keep uploaded patches in this directory\n"
+		"  -D, --dump        start with DSP code from this dump\n"
 		, command);
 }
 
@@ -126,19 +132,28 @@ static void term_handler(int i)
 
 int tram_size_table[] = {0, 8192, 16384, 32768, 65536, 131072, 262144, 524288, 1048576};
 
-int main(int argc, char *argv[])
+#define LD10K1_MAX_CARDS 32
+
+/* one served card, with more cards each one runs in own thread */
+typedef struct {
+	int card;
+	char pipe_name[sizeof(comm_pipe) + 4];
+	comm_param params;
+	int tram_size;
+	int staged;
+	ld10k1_dump_parts_t *dump;
+	pthread_t thread;
+	int started;
+	int err;
+} ld10k1_card_t;
+
+static int card_run(ld10k1_card_t *lcard)
 {
 	int dev;
-	int c;
 	int err;
 	int audigy;
-
-	int opt_help = 0;
-	int tram_size = 0;
-	int opt_daemon = 0;
-	unsigned short opt_port = 20480;
-	int uses_pipe = 1;
-	char logpath[255];
+	int card = lcard->card;
+	ld10k1_dump_parts_t *dump = lcard->dump;
 
 	char card_id[32];
 	const char *card_proc_id;
@@ -149,8 +164,120 @@ int main(int argc, char *argv[])
 	
 	char name[16];
 
-	comm_param params;
-	
+	snd_ctl_card_info_alloca(&card_info);
+	snd_hwdep_info_alloca(&hwdep_info);
+
+	/* Get control handle for selected card */
+	sprintf(card_id, "hw:%i", card);
+	if ((err = snd_ctl_open(&ctl_handle, card_id, 0)) < 0) {
+		error("control open (%s): %s", card_id, snd_strerror(err));
+		return 1;
+	}
+
+	/* Read control hardware info from card */
+	if ((err = snd_ctl_card_info(ctl_handle, card_info)) < 0) {
+		error("control hardware info (%s): %s", card_id, snd_strerror(err));
+		goto err;
+	}
+
+	if (!(card_proc_id = snd_ctl_card_info_get_id (card_info))) {
+		error("card id (%s): %s", card_id, snd_strerror(err));
+		goto err;
+	}
+
+
+	/* EMU10k1/EMU10k2 chip is present only on SB Live, Audigy, Audigy 2, E-mu APS cards */
+	if (strcmp(snd_ctl_card_info_get_driver(card_info), "EMU10K1") != 0 &&
+	    strcmp(snd_ctl_card_info_get_driver(card_info), "Audigy") != 0 &&
+		strcmp(snd_ctl_card_info_get_driver(card_info), "Audigy2") != 0 &&
+		strcmp(snd_ctl_card_info_get_driver(card_info), "E-mu APS") != 0) {
+		error("not a EMU10K1/EMU10K2 based card (%s)", card_id);
+		goto err;
+	}
+
+	if (strcmp(snd_ctl_card_info_get_driver(card_info), "Audigy") == 0 ||
+		strcmp(snd_ctl_card_info_get_driver(card_info), "Audigy2") == 0)
+		audigy = 1;
+	else
+		audigy = 0;
+		
+	/* find EMU10k1 hardware dependant device and execute command */
+	dev = -1;
+	err = 1;
+	while (1) {
+		if (snd_ctl_hwdep_next_device(ctl_handle, &dev) < 0)
+			error("hwdep next device (%s): %s", card_id, snd_strerror(err));
+		if (dev < 0)
+			break;
+		snd_hwdep_info_set_device(hwdep_info, dev);
+		if (snd_ctl_hwdep_info(ctl_handle, hwdep_info) < 0) {
+			if (err != -ENOENT)
+				error("control hwdep info (%s): %s", card_id, snd_strerror(err));
+			continue;
+		}
+		if (snd_hwdep_info_get_iface(hwdep_info) == SND_HWDEP_IFACE_EMU10K1) {
+			sprintf(name, "hw:%i,%i", card, dev);
+
+			/* open EMU10k1 hwdep device */
+			if ((err = snd_hwdep_open(&handle, name, O_WRONLY)) < 0) {
+				error("EMU10k1 open (%i-%i): %s", card, dev, snd_strerror(err));
+				goto err;
+			}
+
+			while (1) {
+				if (main_loop(&lcard->params, audigy, card_proc_id, lcard->tram_size, lcard->staged, dump, ctl_handle)) {
+					error("error in main loop (%s)", card_id);
+					break;
+				}
+				/* dump is used only for first start */
+				dump = NULL;
+			}
+			
+			snd_hwdep_close(handle);
+
+			break;
+		}
+	}
+
+	snd_ctl_close(ctl_handle);
+	return 0;
+err:
+	snd_ctl_close(ctl_handle);
+	return 1;
+}
+
+static void *card_thread(void *arg)
+{
+	ld10k1_card_t *lcard = (ld10k1_card_t *)arg;
+
+	lcard->err = card_run(lcard);
+	return NULL;
+}
+
+int main(int argc, char *argv[])
+{
+	int c;
+	int err;
+	int i;
+
+	int opt_help = 0;
+	int tram_size = 0;
+	int opt_daemon = 0;
+	int opt_staged = 0;
+	char *opt_repo = NULL;
+	char *opt_dump = NULL;
+	void *dump_data = NULL;
+	ld10k1_dump_parts_t dump_parts;
+	ld10k1_dump_parts_t *dump = NULL;
+	unsigned short opt_port = 20480;
+	int uses_pipe = 1;
+	char logpath[255];
+
+	int card;
+	int cards[LD10K1_MAX_CARDS];
+	int card_count = 0;
+	ld10k1_card_t *lcards;
+
 	int option_index;
 	
 	static struct option long_options[] = {
@@ -163,18 +290,18 @@ int main(int argc, char *argv[])
 				   {"tram_size", 1, 0, 't'},
 				   {"pidfile", 1, 0, 'i'},
 				   {"logfile", 1, 0, 'l'},
+				   {"staged", 0, 0, 'S'},
+				   {"repository", 1, 0, 'r'},
+				   {"dump", 1, 0, 'D'},
                    {0, 0, 0, 0}
                };
 
-	snd_ctl_card_info_alloca(&card_info);
-	snd_hwdep_info_alloca(&hwdep_info);
-
 	strcpy(comm_pipe,"/tmp/.ld10k1_port");
 	strcpy(pidpath, "/var/run/ld10k1.pid");
 	memset(logpath, 0, sizeof(logpath));
 
 	option_index = 0;
-	while ((c = getopt_long(argc, argv, "hc:p:t:ndl:i:",
+	while ((c = getopt_long(argc, argv, "hc:p:t:ndl:i:Sr:D:",
 	        long_options, &option_index)) != EOF) {
 		switch (c) {
 		case 0:
@@ -191,6 +318,11 @@ int main(int argc, char *argv[])
 				error ("wrong -c argument '%s'\n", optarg);
 				return 1;
 			}
+			for (i = 0; i < card_count; i++)
+				if (cards[i] == card)
+					break;
+			if (i == card_count)
+				cards[card_count++] = card;
 			break;
 		case 'p':
 			uses_pipe = 1;
@@ -219,6 +351,15 @@ int main(int argc, char *argv[])
 			strncpy(logpath, optarg, sizeof(logpath) - 1);
 			logpath[sizeof(logpath) - 1] = '\0';
 			break;
+		case 'S':
+			opt_staged = 1;
+			break;
+		case 'r':
+			opt_repo = optarg;
+			break;
+		case 'D':
+			opt_dump = optarg;
+			break;
 		default:
 			return 1;
 		}
@@ -229,6 +370,14 @@ int main(int argc, char *argv[])
 		return 0;
 	}
 	
+	if (!card_count)
+		cards[card_count++] = 0;
+
+	if (opt_dump && card_count > 1) {
+		error("dump can be used only with one card");
+		return 1;
+	}
+
 	if (getuid() != 0 ) {
 		error("You are not running ld10k1 as root.");
 		return 1;
@@ -237,6 +386,17 @@ int main(int argc, char *argv[])
 	if (logpath[0])
 		logfile = fopen(logpath, "at");
 
+	if (ld10k1_repo_init(opt_repo) < 0)
+		return 1;
+
+	if (opt_dump) {
+		if ((err = ld10k1_dump_read(opt_dump, &dump_data, &dump_parts)) < 0) {
+			error("dump %s: %s", opt_dump, ld10k1_dump_error_str(err));
+			return 1;
+		}
+		dump = &dump_parts;
+	}
+
 	if (opt_daemon) {
 		FILE *pidfile;
 
@@ -266,82 +426,54 @@ int main(int argc, char *argv[])
 		alog("Starting daemon");
 	}
 
-	params.type = uses_pipe ? COMM_TYPE_LOCAL : COMM_TYPE_IP;
-	params.name = comm_pipe;
-	params.server = 1;
-	params.port = opt_port;
-	params.wfc = 0;
-
-	/* Get control handle for selected card */
-	sprintf(card_id, "hw:%i", card);
-	if ((err = snd_ctl_open(&ctl_handle, card_id, 0)) < 0) {
-		error("control open (%s): %s", card_id, snd_strerror(err));
+	lcards = (ld10k1_card_t *)calloc(card_count, sizeof(ld10k1_card_t));
+	if (!lcards) {
+		error("no mem");
 		return 1;
 	}
 
-	/* Read control hardware info from card */
-	if ((err = snd_ctl_card_info(ctl_handle, card_info)) < 0) {
-		error("control hardware info (%s): %s", card_id, snd_strerror(err));
-		exit(1);
-	}
-
-	if (!(card_proc_id = snd_ctl_card_info_get_id (card_info))) {
-		error("card id (%s): %s", card_id, snd_strerror(err));
-		exit(1);
-	}
-
-
-	/* EMU10k1/EMU10k2 chip is present only on SB Live, Audigy, Audigy 2, E-mu APS cards */
-	if (strcmp(snd_ctl_card_info_get_driver(card_info), "EMU10K1") != 0 &&
-	    strcmp(snd_ctl_card_info_get_driver(card_info), "Audigy") != 0 &&
-		strcmp(snd_ctl_card_info_get_driver(card_info), "Audigy2") != 0 &&
-		strcmp(snd_ctl_card_info_get_driver(card_info), "E-mu APS") != 0) {
-		error("not a EMU10K1/EMU10K2 based card");
-		exit(1);
-	}
-
-	if (strcmp(snd_ctl_card_info_get_driver(card_info), "Audigy") == 0 ||
-		strcmp(snd_ctl_card_info_get_driver(card_info), "Audigy2") == 0)
-		audigy = 1;
-	else
-		audigy = 0;
-		
-	/* find EMU10k1 hardware dependant device and execute command */
-	dev = -1;
-	err = 1;
-	while (1) {
-		if (snd_ctl_hwdep_next_device(ctl_handle, &dev) < 0)
-			error("hwdep next device (%s): %s", card_id, snd_strerror(err));
-		if (dev < 0)
-			break;
-		snd_hwdep_info_set_device(hwdep_info, dev);
-		if (snd_ctl_hwdep_info(ctl_handle, hwdep_info) < 0) {
-			if (err != -ENOENT)
-				error("control hwdep info (%s): %s", card_id, snd_strerror(err));
-			continue;
+	/* more cards - every card has its own socket, named or numbered by card */
+	for (i = 0; i < card_count; i++) {
+		lcards[i].card = cards[i];
+		lcards[i].tram_size = tram_size;
+		lcards[i].staged = opt_staged;
+		lcards[i].dump = dump;
+		if (card_count > 1) {
+			snprintf(lcards[i].pipe_name, sizeof(lcards[i].pipe_name), "%s.%i", comm_pipe, cards[i]);
+			lcards[i].params.port = opt_port + cards[i];
+		} else {
+			strcpy(lcards[i].pipe_name, comm_pipe);
+			lcards[i].params.port = opt_port;
 		}
-		if (snd_hwdep_info_get_iface(hwdep_info) == SND_HWDEP_IFACE_EMU10K1) {
-			sprintf(name, "hw:%i,%i", card, dev);
-
-			/* open EMU10k1 hwdep device */
-			if ((err = snd_hwdep_open(&handle, name, O_WRONLY)) < 0) {
-				error("EMU10k1 open (%i-%i): %s", card, dev, snd_strerror(err));
-				exit(1);
-			}
-
-			while (1)
-				if (main_loop(&params, audigy, card_proc_id, tram_size, ctl_handle)) {
-					error("error in main loop");
-					break;
-				}
-			
-			snd_hwdep_close(handle);
+		lcards[i].params.type = uses_pipe ? COMM_TYPE_LOCAL : COMM_TYPE_IP;
+		lcards[i].params.name = lcards[i].pipe_name;
+		lcards[i].params.server = 1;
+		lcards[i].params.wfc = 0;
+	}
 
-			break;
+	err = 0;
+	if (card_count == 1)
+		err = card_run(&lcards[0]);
+	else {
+		/* main_loop of each card sets and restores it, keep it same for all */
+		signal(SIGPIPE, SIG_IGN);
+		for (i = 0; i < card_count; i++)
+			if (pthread_create(&lcards[i].thread, NULL, card_thread, &lcards[i])) {
+				error("unable to start thread for card %i", cards[i]);
+				lcards[i].err = 1;
+			} else
+				lcards[i].started = 1;
+		for (i = 0; i < card_count; i++) {
+			if (lcards[i].started)
+				pthread_join(lcards[i].thread, NULL);
+			err |= lcards[i].err;
 		}
 	}
 
-	snd_ctl_close(ctl_handle);
+	free(lcards);
+	ld10k1_repo_free();
+	if (dump_data)
+		free(dump_data);
 
-	return 0;
+	return err;
 }
@@ -25,11 +25,20 @@
 #define MAX_CONST_COUNT 0x220
 #define MAX_GPR_COUNT 0x200
 #define MAX_TRAM_COUNT 0x100
+#define MAX_INSTR_COUNT 1024
+/* itram + etram hw accessors */
+#define MAX_TRAM_HWACC_COUNT 0x100
+
+/* state of one card, every card is served by its own thread */
+#define LD10K1_CARD_STATE __thread
+
+#define LD10K1_BITMAP_LONGS(bits) (((bits) + sizeof(unsigned long) * 8 - 1) / (sizeof(unsigned long) * 8))
 
 /* instructions */
 typedef struct {
 	unsigned int used: 1,
-		modified: 1;
+		modified: 1,
+		dead: 1;	/* skipped, but still loaded in DSP */
 	unsigned int op_code;
 	unsigned int arg[4];
 } ld10k1_instr_t;
@@ -50,8 +59,7 @@ typedef struct {
 #define TRAM_OP_WRITE 2
 
 typedef struct {
-	unsigned int used: 1,
-		modified: 1;
+	unsigned int used: 1;
 	unsigned int op;
 	unsigned int addr_val;
 	unsigned int data_val;
@@ -65,11 +73,22 @@ typedef struct {
 	unsigned int grp;
 } ld10k1_tram_acc_t;
 
+/* free tram space */
+typedef struct {
+	unsigned int offset;
+	unsigned int size;
+} ld10k1_tram_extent_t;
+
 typedef struct {
 	unsigned int size;
 	unsigned int max_hwacc;
 	ld10k1_tram_hwacc_t *hwacc;
 	unsigned int used_hwacc;
+	/* free extents sorted by offset, neighbours are always coalesced */
+	unsigned int free_count;
+	ld10k1_tram_extent_t free_ext[MAX_TRAM_COUNT + 1];
+	/* how many times groups were moved to close holes */
+	unsigned int compact_count;
 } ld10k1_tram_t;
 
 #define MAX_CONN_PER_POINT 15
@@ -81,6 +100,8 @@ typedef struct {
 typedef struct ld10k1_conn_point_tag
 {
 	struct ld10k1_conn_point_tag *next;
+	/* next point with same id hash */
+	struct ld10k1_conn_point_tag *hash_next;
 
 	int id;
 	int con_count; /* count of io connected to this point */
@@ -100,6 +121,8 @@ typedef struct ld10k1_conn_point_tag
 
 	unsigned int out_instr_offset;
 	ld10k1_instr_t out_instr[MAX_INSTR_PER_POINT];
+	/* out_instr with physical registers, valid where out_instr is not modified */
+	ld10k1_instr_t out_phys_instr[MAX_INSTR_PER_POINT];
 } ld10k1_conn_point_t;
 
 typedef struct {
@@ -150,11 +173,26 @@ typedef struct {
 
 typedef struct ld10k1_ctl_list_item_tag {
 	struct ld10k1_ctl_list_item_tag *next;
+	struct ld10k1_ctl_list_item_tag *prev;
+	/* next control with same name hash */
+	struct ld10k1_ctl_list_item_tag *hash_next;
 	ld10k1_ctl_t ctl;
 } ld10k1_ctl_list_item_t;
 
+#define LD10K1_NAME_HASH_BITS 8
+#define LD10K1_NAME_HASH_SIZE (1 << LD10K1_NAME_HASH_BITS)
+
+/* control list with index by name */
+typedef struct {
+	ld10k1_ctl_list_item_t *first;
+	int count;
+	ld10k1_ctl_list_item_t *hash[LD10K1_NAME_HASH_SIZE];
+} ld10k1_ctl_list_t;
+
 typedef struct ld10k1_patch_tag {
 	char *patch_name;
+	/* next patch with same name hash, -1 at end */
+	int name_hash_next;
 	int order;
 	int id;
 
@@ -172,6 +210,8 @@ typedef struct ld10k1_patch_tag {
 
 	unsigned int dyn_count;
 	ld10k1_p_dyn_t *dyns;
+	/* gprs really used for dyns, not overlapping ones share gpr */
+	unsigned int dyn_gpr_count;
 
 	unsigned int hw_count;
 	ld10k1_p_hw_t *hws;
@@ -188,6 +228,10 @@ typedef struct ld10k1_patch_tag {
 	unsigned int instr_count;
 	unsigned int instr_offset;
 	ld10k1_instr_t *instr;
+	/* instr with physical registers, valid where instr is not modified */
+	ld10k1_instr_t *phys_instr;
+	/* dropped by optimizer at load */
+	unsigned int instr_removed;
 } ld10k1_patch_t;
 
 #define EMU10K1_PATCH_MAX 128
@@ -197,9 +241,15 @@ typedef struct {
 	unsigned int const_val;
 	unsigned int hw;
 	unsigned int ref;
-	unsigned int used: 1;
+	unsigned int used: 1,
+		hashed: 1;
+	/* next constant with same value hash, -1 at end */
+	int hash_next;
 } ld10k1_dsp_const_t;
 
+#define LD10K1_CONST_HASH_BITS 8
+#define LD10K1_CONST_HASH_SIZE (1 << LD10K1_CONST_HASH_BITS)
+
 #define GPR_USAGE_NONE 0
 #define GPR_USAGE_NORMAL 1
 #define GPR_USAGE_CONST 2
@@ -209,10 +259,16 @@ typedef struct {
 	unsigned int gpr_usage;
 	unsigned int val;
 	unsigned int ref;
-	unsigned int modified: 1,
-		used: 1;
+	unsigned int used: 1;
 } ld10k1_dsp_gpr_t;
 
+/* registers or constants picked for a patch before they are allocated */
+typedef struct {
+	int count;
+	int idx[MAX_CONST_COUNT];
+	unsigned long map[LD10K1_BITMAP_LONGS(MAX_CONST_COUNT)];
+} ld10k1_reg_res_t;
+
 /* reserved ctls - for example AC97 */
 
 typedef struct {
@@ -241,16 +297,42 @@ typedef struct {
 
 	unsigned int consts_max_count;
 	ld10k1_dsp_const_t consts[MAX_CONST_COUNT];
+	/* bit set for unused constant slot */
+	unsigned long const_free[LD10K1_BITMAP_LONGS(MAX_CONST_COUNT)];
+	/* used constants by value */
+	int const_hash[LD10K1_CONST_HASH_SIZE];
 
 	unsigned int regs_max_count;
 	ld10k1_dsp_gpr_t regs[MAX_GPR_COUNT];
+	/* bit set for unused register */
+	unsigned long gpr_free[LD10K1_BITMAP_LONGS(MAX_GPR_COUNT)];
+	/* bit set for used dynamic register */
+	unsigned long gpr_dyn[LD10K1_BITMAP_LONGS(MAX_GPR_COUNT)];
 
 	/* instructions */
 	unsigned int instr_count;
-	ld10k1_instr_t instr[1024];
+	ld10k1_instr_t instr[MAX_INSTR_COUNT];
 
 	unsigned int instr_free;
 
+	/*
+	 * Staged program swap: slot 0 skips to the running program, which
+	 * ends with a skip to stage_limit.  New program is written outside
+	 * of it and started by one write of stage_sel_gpr.
+	 */
+	int staged;
+	unsigned int stage_limit;
+	unsigned int stage_base;
+	unsigned int stage_len;
+	unsigned int stage_bank;
+	unsigned int stage_sel_gpr;
+	unsigned int stage_end_gpr[2];
+	unsigned int stage_swaps;
+	unsigned int stage_in_place;
+	/* running instructions rewritten by one update - glitch window */
+	unsigned int instr_window_last;
+	unsigned int instr_window_max;
+
 	/* internal tram */
 	ld10k1_tram_t i_tram;
 
@@ -271,21 +353,29 @@ typedef struct {
 	unsigned int patch_count;
 	ld10k1_patch_t *patch_ptr[EMU10K1_PATCH_MAX];
 	unsigned int patch_order[EMU10K1_PATCH_MAX];
+	/* loaded patches by name */
+	int patch_name_hash[LD10K1_NAME_HASH_SIZE];
 
 	unsigned short patch_id_gens[EMU10K1_PATCH_MAX];
 
-	ld10k1_ctl_list_item_t *add_ctl_list;
-	int add_list_count;
-
-	ld10k1_ctl_list_item_t *del_ctl_list;
-	int del_list_count;
-
-	ld10k1_ctl_list_item_t *ctl_list;
-	int ctl_list_count;
+	ld10k1_ctl_list_t add_ctl_list;
+	ld10k1_ctl_list_t del_ctl_list;
+	ld10k1_ctl_list_t ctl_list;
 	
 	ld10k1_reserved_ctl_list_item_t *reserved_ctl_list;
 
 	ld10k1_conn_point_t *point_list;
+	/* points with id by id */
+	ld10k1_conn_point_t *point_hash[LD10K1_NAME_HASH_SIZE];
+
+	/* driver is updated at commit only */
+	int transaction;
+
+	/* state changed since last driver update, indexes are the driver ones */
+	int dirty;
+	unsigned long gpr_dirty[LD10K1_BITMAP_LONGS(MAX_GPR_COUNT)];
+	unsigned long tram_dirty[LD10K1_BITMAP_LONGS(MAX_TRAM_HWACC_COUNT)];
+	unsigned long instr_dirty[LD10K1_BITMAP_LONGS(MAX_INSTR_COUNT)];
 } ld10k1_dsp_mgr_t;
 
 void error(const char *fmt,...);
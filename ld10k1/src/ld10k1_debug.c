@@ -26,6 +26,7 @@
 #include "ld10k1_debug.h"
 #include "ld10k1_error.h"
 #include "ld10k1_tram.h"
+#include "bitops.h"
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
@@ -37,10 +38,10 @@ static char *usage_str[] = {
 	"DYNAMIC"
 };
 
-char debug_line[1000];
+static LD10K1_CARD_STATE char debug_line[1000];
 int send_debug_line(int data_conn)
 {
-	return send_response(data_conn, FNC_CONTINUE, 0, debug_line, strlen(debug_line) + 1);
+	return client_response(data_conn, FNC_CONTINUE, 0, debug_line, strlen(debug_line) + 1);
 }
 
 int ld10k1_debug_new_gpr_read_one(int data_conn, ld10k1_dsp_mgr_t *dsp_mgr, unsigned int idx)
@@ -50,7 +51,7 @@ int ld10k1_debug_new_gpr_read_one(int data_conn, ld10k1_dsp_mgr_t *dsp_mgr, unsi
 	int ref_count;
 	int modified;
 
-	modified = dsp_mgr->regs[idx].modified;
+	modified = test_bit(idx, dsp_mgr->gpr_dirty);
 	usage = dsp_mgr->regs[idx].gpr_usage;
 	value = dsp_mgr->regs[idx].val;
 	ref_count = dsp_mgr->regs[idx].ref;
@@ -236,7 +237,7 @@ static void ld10k1_debug_decode_preg_idx(char *type, unsigned int reg)
 	}
 }
 
-int ld10k1_debug_new_code_read_one(int data_conn, int preg, ld10k1_instr_t *instr, unsigned int idx)
+int ld10k1_debug_new_code_read_one(int data_conn, int preg, int modified, ld10k1_instr_t *instr, unsigned int idx)
 {
 	char type1[100];
 	char type2[100];
@@ -251,7 +252,7 @@ int ld10k1_debug_new_code_read_one(int data_conn, int preg, ld10k1_instr_t *inst
 			ld10k1_debug_decode_preg_idx(type4, instr->arg[3]);
 
 			sprintf(debug_line, "%c 0x%03x : %-10s %s, %s, %s, %s\n",
-				instr->modified ? '*' : ' ',
+				modified ? '*' : ' ',
 				idx,
 				instr_name[instr->op_code],
 				type1,
@@ -260,7 +261,7 @@ int ld10k1_debug_new_code_read_one(int data_conn, int preg, ld10k1_instr_t *inst
 				type4);
 		} else {
 			sprintf(debug_line, "%c 0x%03x : %-10s 0x%03x, 0x%03x, 0x%03x, 0x%03x\n",
-				instr->modified ? '*' : ' ',
+				modified ? '*' : ' ',
 				idx,
 				instr_name[instr->op_code],
 				instr->arg[0],
@@ -272,7 +273,7 @@ int ld10k1_debug_new_code_read_one(int data_conn, int preg, ld10k1_instr_t *inst
 		return send_debug_line(data_conn);
 	} else {
 		sprintf(debug_line, "%c 0x%03x : NOT USED\n",
-			instr->modified ? '*' : ' ',
+			modified ? '*' : ' ',
 			idx);
 		return send_debug_line(data_conn);
 	}
@@ -291,6 +292,17 @@ static int ld10k1_debug_new_code_read(int data_conn, ld10k1_dsp_mgr_t *dsp_mgr)
 	ld10k1_instr_t *instr;
 
 	sprintf(debug_line, "FX8010 Code\n");
+	if ((err = send_debug_line(data_conn)) < 0)
+		return err;
+	if (dsp_mgr->staged) {
+		sprintf(debug_line, "Staged: running 0x%03x - 0x%03x  limit: 0x%03x  swaps: %d  in place: %d\n",
+			dsp_mgr->stage_base, dsp_mgr->stage_base + dsp_mgr->stage_len, dsp_mgr->stage_limit,
+			dsp_mgr->stage_swaps, dsp_mgr->stage_in_place);
+		if ((err = send_debug_line(data_conn)) < 0)
+			return err;
+	}
+	sprintf(debug_line, "Running instructions rewritten: last %d  max %d\n",
+		dsp_mgr->instr_window_last, dsp_mgr->instr_window_max);
 	if ((err = send_debug_line(data_conn)) < 0)
 		return err;
 	if ((err = ld10k1_debug_new_code_read_hdr(data_conn)) < 0)
@@ -298,7 +310,7 @@ static int ld10k1_debug_new_code_read(int data_conn, ld10k1_dsp_mgr_t *dsp_mgr)
 	for (i = 0; i < dsp_mgr->instr_count; i++) {
   		instr = &(dsp_mgr->instr[i]);
 		if (instr->used)
-			if ((err = ld10k1_debug_new_code_read_one(data_conn, 0, instr, i)) < 0)
+			if ((err = ld10k1_debug_new_code_read_one(data_conn, 0, test_bit(i, dsp_mgr->instr_dirty), instr, i)) < 0)
 				return err;
 	}
 	return 0;
@@ -315,8 +327,7 @@ static int ld10k1_debug_new_tram_info_read(int data_conn, ld10k1_dsp_mgr_t *dsp_
 	ld10k1_tram_acc_t *tram_acc;
 	unsigned int data, addr;
 
-	int ifree = dsp_mgr->i_tram.size;
-	int efree = dsp_mgr->e_tram.size;
+	unsigned int free_size, largest;
 
 	sprintf(debug_line, "TRAM\n\n");
 	if ((err = send_debug_line(data_conn)) < 0)
@@ -329,6 +340,22 @@ static int ld10k1_debug_new_tram_info_read(int data_conn, ld10k1_dsp_mgr_t *dsp_
 	if ((err = send_debug_line(data_conn)) < 0)
 		return err;
 
+	/* fragmentation - part of free space not usable for biggest possible group */
+	ld10k1_tram_space_info(&(dsp_mgr->i_tram), &free_size, &largest);
+	sprintf(debug_line, "Internal tram free: 0x%08x  largest: 0x%08x  holes: %d  fragmentation: %d%%  compactions: %d\n",
+		free_size, largest, dsp_mgr->i_tram.free_count,
+		free_size ? 100 - (int)((unsigned long long)largest * 100 / free_size) : 0,
+		dsp_mgr->i_tram.compact_count);
+	if ((err = send_debug_line(data_conn)) < 0)
+		return err;
+	ld10k1_tram_space_info(&(dsp_mgr->e_tram), &free_size, &largest);
+	sprintf(debug_line, "External tram free: 0x%08x  largest: 0x%08x  holes: %d  fragmentation: %d%%  compactions: %d\n",
+		free_size, largest, dsp_mgr->e_tram.free_count,
+		free_size ? 100 - (int)((unsigned long long)largest * 100 / free_size) : 0,
+		dsp_mgr->e_tram.compact_count);
+	if ((err = send_debug_line(data_conn)) < 0)
+		return err;
+
 	sprintf(debug_line, "\nTram groups:\n");
 	if ((err = send_debug_line(data_conn)) < 0)
 		return err;
@@ -348,13 +375,10 @@ static int ld10k1_debug_new_tram_info_read(int data_conn, ld10k1_dsp_mgr_t *dsp_
 				req_pos_str = "EXTERNAL";
 
 			pos_str = "NONE";
-			if (dsp_mgr->tram_grp[i].pos == TRAM_POS_INTERNAL) {
+			if (dsp_mgr->tram_grp[i].pos == TRAM_POS_INTERNAL)
 				pos_str = "INTERNAL";
-				ifree -= dsp_mgr->tram_grp[i].size;
-			} else if (dsp_mgr->tram_grp[i].pos == TRAM_POS_EXTERNAL) {
+			else if (dsp_mgr->tram_grp[i].pos == TRAM_POS_EXTERNAL)
 				pos_str = "EXTERNAL";
-				efree -= dsp_mgr->tram_grp[i].size;
-			}
 
 			sprintf(debug_line, "%10s  %10s   %08x  %08x  %03d\n", req_pos_str, pos_str,
 				dsp_mgr->tram_grp[i].size, dsp_mgr->tram_grp[i].offset, dsp_mgr->tram_grp[i].acc_count);
@@ -452,6 +476,17 @@ int ld10k1_debug_new_patch_read1(int data_conn, ld10k1_dsp_mgr_t *dsp_mgr, ld10k
 			return err;
 	}
 
+	/* dyn list */
+	sprintf(debug_line, "DYN registers: %d in %d gprs\n", patch->dyn_count, patch->dyn_gpr_count);
+	if ((err = send_debug_line(data_conn)) < 0)
+		return err;
+	for (i = 0; i < patch->dyn_count; i++) {
+		sprintf(debug_line, "%03d   0x%08x\n", i,
+			patch->dyns[i].gpr_idx);
+		if ((err = send_debug_line(data_conn)) < 0)
+			return err;
+	}
+
 	/* hw list */
 	sprintf(debug_line, "HW registers:\n");
 	if ((err = send_debug_line(data_conn)) < 0)
@@ -523,7 +558,8 @@ int ld10k1_debug_new_patch_read1(int data_conn, ld10k1_dsp_mgr_t *dsp_mgr, ld10k
 	}
 
 	/* instruction list */
-	sprintf(debug_line, "\nCode:\n");
+	sprintf(debug_line, "\nCode: %d instructions, %d removed by optimizer\n",
+		patch->instr_count, patch->instr_removed);
 	if ((err = send_debug_line(data_conn)) < 0)
 		return err;
 
@@ -533,7 +569,7 @@ int ld10k1_debug_new_patch_read1(int data_conn, ld10k1_dsp_mgr_t *dsp_mgr, ld10k
 		ld10k1_instr_t *instr;
 
 		instr = &(patch->instr[i]);
-		if ((err = ld10k1_debug_new_code_read_one(data_conn, 1, instr, i)) < 0)
+		if ((err = ld10k1_debug_new_code_read_one(data_conn, 1, instr->modified, instr, i)) < 0)
 			return err;
 	}
 	return 0;
@@ -599,7 +635,7 @@ int ld10k1_fnc_debug(int data_conn, int op, int size)
 	if (size != sizeof(ld10k1_fnc_debug_t))
 		return LD10K1_ERR_PROTOCOL;
 
-	if ((err = receive_msg_data(data_conn, &debug_info, sizeof(ld10k1_fnc_debug_t))))
+	if ((err = client_receive(data_conn, &debug_info, sizeof(ld10k1_fnc_debug_t))))
 		return err;
 
 	if (debug_info.what >= 100 && debug_info.what <= 100 + EMU10K1_PATCH_MAX) {
@@ -34,14 +34,17 @@
 
 #include "bitops.h"
 #include "ld10k1.h"
+#include "ld10k1_dump_file.h"
+#include "ld10k1_dump_load.h"
 #include "ld10k1_driver.h"
 #include "ld10k1_error.h"
 #include "ld10k1_fnc.h"
 #include "ld10k1_fnc_int.h"
+#include "ld10k1_tram.h"
 
 //#define DEBUG_DRIVER 1
 
-extern snd_hwdep_t *handle;
+extern LD10K1_CARD_STATE snd_hwdep_t *handle;
 
 void ld10k1_syntetize_instr(int audigy, int op, int arg1, int arg2, int arg3, int arg4, unsigned int *out)
 {
@@ -59,7 +62,7 @@ void ld10k1_set_must_init_output(ld10k1_dsp_mgr_t *dsp_mgr, int reg);
 void ld10k1_check_must_init_output(ld10k1_dsp_mgr_t *dsp_mgr, emu10k1_fx8010_code_t *code);
 
 /* outputs what must be initialized on audigy */
-static int audigy_must_init_output[] = {
+static LD10K1_CARD_STATE int audigy_must_init_output[] = {
 	0x68, 0,
 	0x69, 0,
 	0x6a, 0,
@@ -116,210 +119,187 @@ err:
 	return LD10K1_ERR_NO_MEM;
 }
 
+/* kept between updates, only entries marked dirty are filled */
+static LD10K1_CARD_STATE emu10k1_fx8010_code_t update_code;
+static LD10K1_CARD_STATE int update_code_ready = 0;
+static LD10K1_CARD_STATE emu10k1_fx8010_control_gpr_t *update_add_ctrl = NULL;
+static LD10K1_CARD_STATE int update_add_max = 0;
+static LD10K1_CARD_STATE emu10k1_ctl_elem_id_t *update_del_ids = NULL;
+static LD10K1_CARD_STATE int update_del_max = 0;
+
 int ld10k1_update_driver(ld10k1_dsp_mgr_t *dsp_mgr)
 {
-	emu10k1_fx8010_code_t code;
-	emu10k1_fx8010_control_gpr_t *add_ctrl;
-	emu10k1_ctl_elem_id_t *del_ids;
+	emu10k1_fx8010_code_t *code = &update_code;
+	void *tmp;
 
 	ld10k1_ctl_list_item_t *item;
+	ld10k1_tram_hwacc_t *hwacc;
 	unsigned int i, j;
-	int max;
-	int modified;
-	unsigned int addr;
 	unsigned int vaddr;
-	unsigned int op;
-	unsigned int idx_offset;
 	unsigned int *iptr;
-	ld10k1_ctl_t gctl;
+	int instr_changed;
 	
 	int err;
-	
-	if ((err = ld10k1_alloc_code_struct(&code)) < 0)
-    		return err;
-	
-	/* new name */
-	strcpy(code.name, LD10K1_SIGNATURE);
 
-	for (i = 0; i < sizeof(code.gpr_valid) / sizeof(unsigned long); i++)
-		code.gpr_valid[i] = 0;
-	for (i = 0; i < sizeof(code.tram_valid) / sizeof(unsigned long); i++)
-		code.tram_valid[i] = 0;
-	for (i = 0; i < sizeof(code.code_valid) / sizeof(unsigned long); i++)
-		code.code_valid[i] = 0;
+	if (!dsp_mgr->dirty && dsp_mgr->add_ctl_list.count <= 0 && dsp_mgr->del_ctl_list.count <= 0)
+		return 0;
+
+	if (!update_code_ready) {
+		if ((err = ld10k1_alloc_code_struct(code)) < 0)
+			return err;
+		/* new name */
+		strcpy(code->name, LD10K1_SIGNATURE);
+		update_code_ready = 1;
+	}
+
+	memcpy(code->gpr_valid, dsp_mgr->gpr_dirty, sizeof(code->gpr_valid));
+	memcpy(code->tram_valid, dsp_mgr->tram_dirty, sizeof(code->tram_valid));
+	memcpy(code->code_valid, dsp_mgr->instr_dirty, sizeof(code->code_valid));
 
 	/* registers */
-	for (i = 0; i < dsp_mgr->regs_max_count; i++)
-		if (dsp_mgr->regs[i].modified) {
-			set_bit(i, code.gpr_valid);
-			code.gpr_map[i] = dsp_mgr->regs[i].val;
-		}
+	for (i = find_next_bit(dsp_mgr->gpr_dirty, MAX_GPR_COUNT, 0); i < MAX_GPR_COUNT;
+	     i = find_next_bit(dsp_mgr->gpr_dirty, MAX_GPR_COUNT, i + 1))
+		code->gpr_map[i] = dsp_mgr->regs[i].val;
 
 	/* tram addr + data */
-	for (j = 0; j < 2; j++) {
-		max = (j == 0 ? dsp_mgr->max_itram_hwacc : dsp_mgr->max_etram_hwacc);
-		for (i = 0; i < max; i++) {
-			modified = (j == 0 ? dsp_mgr->itram_hwacc[i].modified : dsp_mgr->etram_hwacc[i].modified);
-			if (modified) {
-				addr = (j == 0 ? dsp_mgr->itram_hwacc[i].addr_val : dsp_mgr->etram_hwacc[i].addr_val);
-				vaddr = addr & 0xFFFFF;
-				idx_offset = (j == 0 ? 0 : dsp_mgr->max_itram_hwacc);
-				op = (j == 0 ? dsp_mgr->itram_hwacc[i].op : dsp_mgr->etram_hwacc[i].op);
-
-				set_bit(i + idx_offset, code.tram_valid);
-				switch(op) {
-					case TRAM_OP_READ:
-						if (dsp_mgr->audigy)
-							vaddr = vaddr | 0x2 << 20;
-						else
-							vaddr = vaddr | TANKMEMADDRREG_READ | TANKMEMADDRREG_ALIGN;
-						break;
-					case TRAM_OP_WRITE:
-						if (dsp_mgr->audigy)
-							vaddr = vaddr | 0x6 << 20;
-						else
-							vaddr = vaddr | TANKMEMADDRREG_WRITE | TANKMEMADDRREG_ALIGN;
-						break;
-					case TRAM_OP_NULL:
-					default:
-						vaddr = 0;
-						break;
-				}
-
-				code.tram_addr_map[i + idx_offset] = vaddr;
-				code.tram_data_map[i + idx_offset] = (j == 0 ? dsp_mgr->itram_hwacc[i].data_val : dsp_mgr->etram_hwacc[i].data_val);
-			}
+	for (i = find_next_bit(dsp_mgr->tram_dirty, MAX_TRAM_HWACC_COUNT, 0); i < MAX_TRAM_HWACC_COUNT;
+	     i = find_next_bit(dsp_mgr->tram_dirty, MAX_TRAM_HWACC_COUNT, i + 1)) {
+		if (i < dsp_mgr->max_itram_hwacc)
+			hwacc = &(dsp_mgr->itram_hwacc[i]);
+		else
+			hwacc = &(dsp_mgr->etram_hwacc[i - dsp_mgr->max_itram_hwacc]);
+
+		vaddr = hwacc->addr_val & 0xFFFFF;
+		switch(hwacc->op) {
+			case TRAM_OP_READ:
+				if (dsp_mgr->audigy)
+					vaddr = vaddr | 0x2 << 20;
+				else
+					vaddr = vaddr | TANKMEMADDRREG_READ | TANKMEMADDRREG_ALIGN;
+				break;
+			case TRAM_OP_WRITE:
+				if (dsp_mgr->audigy)
+					vaddr = vaddr | 0x6 << 20;
+				else
+					vaddr = vaddr | TANKMEMADDRREG_WRITE | TANKMEMADDRREG_ALIGN;
+				break;
+			case TRAM_OP_NULL:
+			default:
+				vaddr = 0;
+				break;
 		}
+
+		code->tram_addr_map[i] = vaddr;
+		code->tram_data_map[i] = hwacc->data_val;
 	}
 
 	/* controls to add */
-	if (dsp_mgr->add_list_count > 0) {
-		add_ctrl = calloc(dsp_mgr->add_list_count,
-				  sizeof(emu10k1_fx8010_control_gpr_t));
-		if (!add_ctrl)
+	if (dsp_mgr->add_ctl_list.count > update_add_max) {
+		tmp = realloc(update_add_ctrl, dsp_mgr->add_ctl_list.count * sizeof(emu10k1_fx8010_control_gpr_t));
+		if (!tmp)
 			return LD10K1_ERR_NO_MEM;
-		for (i = 0, item = dsp_mgr->add_ctl_list; item != NULL; item = item->next, i++) {
-			strcpy((char *)add_ctrl[i].id.name, item->ctl.name);
-			add_ctrl[i].id.iface = EMU10K1_CTL_ELEM_IFACE_MIXER;
-			add_ctrl[i].id.index = item->ctl.index;
-			add_ctrl[i].vcount = item->ctl.vcount;
-			add_ctrl[i].count = item->ctl.count;
-			for (j = 0; j < 32; j++) {
-				add_ctrl[i].gpr[j] = item->ctl.gpr_idx[j];
-				add_ctrl[i].value[j] = item->ctl.value[j];
-			}
-			add_ctrl[i].min = item->ctl.min;
-			add_ctrl[i].max = item->ctl.max;
-			add_ctrl[i].translation = item->ctl.translation;
+		update_add_ctrl = tmp;
+		update_add_max = dsp_mgr->add_ctl_list.count;
+	}
+	for (i = 0, item = dsp_mgr->add_ctl_list.first; item != NULL; item = item->next, i++) {
+		memset(&update_add_ctrl[i], 0, sizeof(emu10k1_fx8010_control_gpr_t));
+		strcpy((char *)update_add_ctrl[i].id.name, item->ctl.name);
+		update_add_ctrl[i].id.iface = EMU10K1_CTL_ELEM_IFACE_MIXER;
+		update_add_ctrl[i].id.index = item->ctl.index;
+		update_add_ctrl[i].vcount = item->ctl.vcount;
+		update_add_ctrl[i].count = item->ctl.count;
+		for (j = 0; j < 32; j++) {
+			update_add_ctrl[i].gpr[j] = item->ctl.gpr_idx[j];
+			update_add_ctrl[i].value[j] = item->ctl.value[j];
 		}
-	} else
-		add_ctrl = NULL;
+		update_add_ctrl[i].min = item->ctl.min;
+		update_add_ctrl[i].max = item->ctl.max;
+		update_add_ctrl[i].translation = item->ctl.translation;
+	}
 
-	code.gpr_add_control_count = dsp_mgr->add_list_count;
-	code.gpr_add_controls = add_ctrl;
+	code->gpr_add_control_count = dsp_mgr->add_ctl_list.count;
+	code->gpr_add_controls = dsp_mgr->add_ctl_list.count > 0 ? update_add_ctrl : NULL;
 
 	/* controls to del */
-	if (dsp_mgr->del_list_count > 0) {
-		del_ids = calloc(dsp_mgr->del_list_count,
-				 sizeof(emu10k1_ctl_elem_id_t));
-		if (!del_ids)
+	if (dsp_mgr->del_ctl_list.count > update_del_max) {
+		tmp = realloc(update_del_ids, dsp_mgr->del_ctl_list.count * sizeof(emu10k1_ctl_elem_id_t));
+		if (!tmp)
 			return LD10K1_ERR_NO_MEM;
-		for (i = 0, item = dsp_mgr->del_ctl_list; item != NULL; item = item->next, i++) {
-			strcpy((char *)del_ids[i].name, item->ctl.name);
-			del_ids[i].iface = EMU10K1_CTL_ELEM_IFACE_MIXER;
-			del_ids[i].index = item->ctl.index;
-		}
-	} else
-		del_ids = NULL;
+		update_del_ids = tmp;
+		update_del_max = dsp_mgr->del_ctl_list.count;
+	}
+	for (i = 0, item = dsp_mgr->del_ctl_list.first; item != NULL; item = item->next, i++) {
+		memset(&update_del_ids[i], 0, sizeof(emu10k1_ctl_elem_id_t));
+		strcpy((char *)update_del_ids[i].name, item->ctl.name);
+		update_del_ids[i].iface = EMU10K1_CTL_ELEM_IFACE_MIXER;
+		update_del_ids[i].index = item->ctl.index;
+	}
 		
-	code.gpr_del_control_count = dsp_mgr->del_list_count;
-	code.gpr_del_controls = del_ids;
-
-	code.gpr_list_control_count = 0;
-
-	for (iptr = code.code, i = 0; i < dsp_mgr->instr_count; i++, iptr += 2) {
-		if (dsp_mgr->instr[i].modified) {
-			set_bit(i, code.code_valid);
-			if (dsp_mgr->instr[i].used) {
-				if (dsp_mgr->audigy) {
+	code->gpr_del_control_count = dsp_mgr->del_ctl_list.count;
+	code->gpr_del_controls = dsp_mgr->del_ctl_list.count > 0 ? update_del_ids : NULL;
+
+	code->gpr_list_control_count = 0;
+
+	instr_changed = 0;
+	for (i = find_next_bit(dsp_mgr->instr_dirty, dsp_mgr->instr_count, 0); i < dsp_mgr->instr_count;
+	     i = find_next_bit(dsp_mgr->instr_dirty, dsp_mgr->instr_count, i + 1)) {
+		instr_changed = 1;
+		iptr = code->code + i * 2;
+		if (dsp_mgr->instr[i].used) {
+			if (dsp_mgr->audigy) {
+				ld10k1_syntetize_instr(dsp_mgr->audigy,
+					dsp_mgr->instr[i].op_code,
+					dsp_mgr->instr[i].arg[0], dsp_mgr->instr[i].arg[1], dsp_mgr->instr[i].arg[2], dsp_mgr->instr[i].arg[3], iptr);
+			} else {
+				if (i < 0x200) {
 					ld10k1_syntetize_instr(dsp_mgr->audigy,
 						dsp_mgr->instr[i].op_code,
 						dsp_mgr->instr[i].arg[0], dsp_mgr->instr[i].arg[1], dsp_mgr->instr[i].arg[2], dsp_mgr->instr[i].arg[3], iptr);
-				} else {
-					if (i < 0x200) {
-						ld10k1_syntetize_instr(dsp_mgr->audigy,
-							dsp_mgr->instr[i].op_code,
-							dsp_mgr->instr[i].arg[0], dsp_mgr->instr[i].arg[1], dsp_mgr->instr[i].arg[2], dsp_mgr->instr[i].arg[3], iptr);
-					}
 				}
+			}
+		} else {
+			if (dsp_mgr->audigy) {
+				ld10k1_syntetize_instr(dsp_mgr->audigy,
+					0x0f,
+					0xc0, 0xc0, 0xcf, 0xc0, iptr);
 			} else {
-				if (dsp_mgr->audigy) {
+				if (i < 0x200) {
 					ld10k1_syntetize_instr(dsp_mgr->audigy,
-						0x0f,
-						0xc0, 0xc0, 0xcf, 0xc0, iptr);
-				} else {
-					if (i < 0x200) {
-						ld10k1_syntetize_instr(dsp_mgr->audigy,
-							0x06,
-							0x40, 0x40, 0x40, 0x40, iptr);
-					}
+						0x06,
+						0x40, 0x40, 0x40, 0x40, iptr);
 				}
 			}
 		}
 	}
 	
-	/* check initialization of i2s outputs on audigy */
-	if (dsp_mgr->audigy)
-		ld10k1_check_must_init_output(dsp_mgr, &code);
+	/* check initialization of i2s outputs on audigy - only code change can unset them */
+	if (dsp_mgr->audigy && instr_changed)
+		ld10k1_check_must_init_output(dsp_mgr, code);
 
 
 #ifndef DEBUG_DRIVER
-	if (snd_hwdep_ioctl(handle, SNDRV_EMU10K1_IOCTL_CODE_POKE, &code) < 0) {
+	if (snd_hwdep_ioctl(handle, SNDRV_EMU10K1_IOCTL_CODE_POKE, code) < 0) {
 		error("unable to poke code");
-		ld10k1_free_code_struct(&code);
-		if (add_ctrl)
-			free(add_ctrl);
-		if (del_ids)
-			free(del_ids);
+		/* dirty state is kept, next update sends it again */
 		return LD10K1_ERR_DRIVER_CODE_POKE;
 	}
 #endif
 
-	/* update state */
-	for (item = dsp_mgr->del_ctl_list; item != NULL; item = item->next) {
-		strcpy(gctl.name, item->ctl.name);
-		ld10k1_del_control_from_list(&(dsp_mgr->ctl_list), &(dsp_mgr->ctl_list_count), &gctl);
-	}
-
-	ld10k1_del_all_controls_from_list(&(dsp_mgr->del_ctl_list), &dsp_mgr->del_list_count);
+	/* update state, controls go by name and index */
+	for (item = dsp_mgr->del_ctl_list.first; item != NULL; item = item->next)
+		ld10k1_del_control_from_list(&(dsp_mgr->ctl_list), &(item->ctl));
 
-	for (item = dsp_mgr->add_ctl_list; item != NULL; item = item->next)
-		ld10k1_add_control_to_list(&(dsp_mgr->ctl_list), &(dsp_mgr->ctl_list_count), &(item->ctl));
+	ld10k1_del_all_controls_from_list(&(dsp_mgr->del_ctl_list));
 
-	ld10k1_del_all_controls_from_list(&(dsp_mgr->add_ctl_list), &dsp_mgr->add_list_count);
+	for (item = dsp_mgr->add_ctl_list.first; item != NULL; item = item->next)
+		ld10k1_add_control_to_list(&(dsp_mgr->ctl_list), &(item->ctl));
 
-	for (i = 0; i < dsp_mgr->regs_max_count; i++)
-		dsp_mgr->regs[i].modified = 0;
-
-	for (i = 0; i < dsp_mgr->instr_count; i++)
-		dsp_mgr->instr[i].modified = 0;
-
-	for (j = 0; j < 2; j++) {
-		max = (j == 0 ? dsp_mgr->max_itram_hwacc : dsp_mgr->max_etram_hwacc);
-		for (i = 0; i < max; i++) {
-			if (j == 0)
-				dsp_mgr->itram_hwacc[i].modified = 0;
-			else
-				dsp_mgr->etram_hwacc[i].modified = 0;
-		}
-	}
-	
-	ld10k1_free_code_struct(&code);
+	ld10k1_del_all_controls_from_list(&(dsp_mgr->add_ctl_list));
 
-	if (add_ctrl)
-		free(add_ctrl);
-	if (del_ids)
-		free(del_ids);
+	memset(dsp_mgr->gpr_dirty, 0, sizeof(dsp_mgr->gpr_dirty));
+	memset(dsp_mgr->tram_dirty, 0, sizeof(dsp_mgr->tram_dirty));
+	memset(dsp_mgr->instr_dirty, 0, sizeof(dsp_mgr->instr_dirty));
+	dsp_mgr->dirty = 0;
 	return 0;
 }
 
@@ -363,6 +343,8 @@ int ld10k1_init_driver(ld10k1_dsp_mgr_t *dsp_mgr, int tram_size)
 		dsp_mgr->i_tram.size = info.internal_tram_size;
 		dsp_mgr->e_tram.size = info.external_tram_size;
 	}
+	ld10k1_tram_init_space(&(dsp_mgr->i_tram));
+	ld10k1_tram_init_space(&(dsp_mgr->e_tram));
 	
 	/* get count of controls */
 	code.gpr_list_control_count = 0;
@@ -484,6 +466,54 @@ int ld10k1_init_driver(ld10k1_dsp_mgr_t *dsp_mgr, int tram_size)
 	}
 	
 	ld10k1_free_code_struct(&code);
+
+	/* staged code starts with its skips */
+	if (dsp_mgr->staged)
+		return ld10k1_update_driver(dsp_mgr);
+	return 0;
+}
+
+/*
+ * DSP starts with code from dump, only what differs from running code
+ * is uploaded.  Manager itself starts empty, so its first update replaces
+ * whole dump and deletes controls from it.
+ */
+int ld10k1_init_driver_dump(ld10k1_dsp_mgr_t *dsp_mgr, ld10k1_dump_parts_t *dump)
+{
+	emu10k1_fx8010_info_t info;
+	ld10k1_ctl_t ctl;
+	int i;
+	int err;
+
+	if (snd_hwdep_ioctl(handle, SNDRV_EMU10K1_IOCTL_PVERSION, &i) < 0) {
+		error("Cannot get emu10k1 driver version, likely an old driver is running.");
+		return LD10K1_ERR_DRIVER_INFO;
+	}
+
+#ifndef DEBUG_DRIVER
+	if ((err = ld10k1_dump_upload(handle, dump, dsp_mgr->audigy, LD10K1_SIGNATURE, 0)) < 0) {
+		error("unable to load dump (%s)", ld10k1_dump_error_str(err));
+		return err;
+	}
+#endif
+
+	if (snd_hwdep_ioctl(handle, SNDRV_EMU10K1_IOCTL_INFO, &info) < 0) {
+		error("unable to get info ");
+		return LD10K1_ERR_DRIVER_INFO;
+	}
+
+	dsp_mgr->i_tram.size = info.internal_tram_size;
+	dsp_mgr->e_tram.size = info.external_tram_size;
+	ld10k1_tram_init_space(&(dsp_mgr->i_tram));
+	ld10k1_tram_init_space(&(dsp_mgr->e_tram));
+
+	for (i = 0; i < dump->header->ctl_count; i++) {
+		memset(&ctl, 0, sizeof(ctl));
+		strcpy(ctl.name, dump->ctl[i].name);
+		ctl.index = dump->ctl[i].index;
+		if ((err = ld10k1_add_control_to_list(&(dsp_mgr->del_ctl_list), &ctl)) < 0)
+			return err;
+	}
 	return 0;
 }
 
@@ -22,7 +22,10 @@
 #ifndef __LD10K1_DRIVER_H
 #define __LD10K1_DRIVER_H
 
+struct ld10k1_dump_parts_tag;
+
 int ld10k1_update_driver(ld10k1_dsp_mgr_t *dsp_mgr);
 int ld10k1_init_driver(ld10k1_dsp_mgr_t *dsp_mgr, int tram_size);
+int ld10k1_init_driver_dump(ld10k1_dsp_mgr_t *dsp_mgr, struct ld10k1_dump_parts_tag *dump);
 
 #endif /* __LD10K1_DRIVER_H */
@@ -28,6 +28,7 @@
 #include "ld10k1.h"
 #include "ld10k1_dump_file.h"
 #include "ld10k1_dump.h"
+#include "ld10k1_dump_load.h"
 #include "ld10k1_error.h"
 
 int ld10k1_make_dump(ld10k1_dsp_mgr_t *dsp_mgr, void **dump, int *size)
@@ -44,25 +45,25 @@ int ld10k1_make_dump(ld10k1_dsp_mgr_t *dsp_mgr, void **dump, int *size)
 	ld10k1_instr_dump_t *instr = NULL;
 
 	dump_size += sizeof(ld10k1_dump_t);
-	dump_size += sizeof(ld10k1_ctl_dump_t) * dsp_mgr->ctl_list_count;
+	dump_size += sizeof(ld10k1_ctl_dump_t) * dsp_mgr->ctl_list.count;
 	dump_size += sizeof(unsigned int) * dsp_mgr->regs_max_count;
 	dump_size += sizeof(ld10k1_tram_dump_t) * (dsp_mgr->max_itram_hwacc + dsp_mgr->max_etram_hwacc);
 	dump_size += sizeof(ld10k1_instr_dump_t) * dsp_mgr->instr_count;
 
-	dump_file = malloc(dump_size);
+	dump_file = calloc(1, dump_size);
 	if (!dump_file)
 		return LD10K1_ERR_NO_MEM;
 
 	ptr = dump_file;
 	header = (ld10k1_dump_t *)ptr;
-	strcpy(header->signature, "LD10K1 DUMP 001");
+	strcpy(header->signature, LD10K1_DUMP_SIGNATURE);
 	if (!dsp_mgr->audigy)
 		header->dump_type = DUMP_TYPE_LIVE;
 	else
 		header->dump_type = DUMP_TYPE_AUDIGY;
 	
 	header->tram_size = dsp_mgr->e_tram.size;
-	header->ctl_count = dsp_mgr->ctl_list_count;
+	header->ctl_count = dsp_mgr->ctl_list.count;
 	header->gpr_count = dsp_mgr->regs_max_count;
 	header->tram_count = dsp_mgr->max_itram_hwacc + dsp_mgr->max_etram_hwacc;
 	header->instr_count = dsp_mgr->instr_count;
@@ -76,7 +77,7 @@ int ld10k1_make_dump(ld10k1_dsp_mgr_t *dsp_mgr, void **dump, int *size)
 
 	ptr += sizeof(ld10k1_dump_t);
 	/* ctls */
-	for (item = dsp_mgr->ctl_list; item != NULL; item = item->next) {
+	for (item = dsp_mgr->ctl_list.first; item != NULL; item = item->next) {
 		ctl = (ld10k1_ctl_dump_t *)ptr;
 		strcpy(ctl->name, item->ctl.name);
 		ctl->index = item->ctl.index;
@@ -146,6 +147,9 @@ int ld10k1_make_dump(ld10k1_dsp_mgr_t *dsp_mgr, void **dump, int *size)
 		ptr += sizeof(ld10k1_instr_dump_t);
 	}
 
+	header->size = dump_size;
+	header->checksum = ld10k1_dump_checksum(dump_file + sizeof(ld10k1_dump_t), dump_size - sizeof(ld10k1_dump_t));
+
 	*dump = dump_file;
 	*size = dump_size;
 
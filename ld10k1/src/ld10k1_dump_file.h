@@ -26,16 +26,26 @@
 #define DUMP_TYPE_AUDIGY_OLD 1
 #define DUMP_TYPE_AUDIGY 2
 
+#define LD10K1_DUMP_SIGNATURE_001 "LD10K1 DUMP 001"
+#define LD10K1_DUMP_SIGNATURE "LD10K1 DUMP 002"
+
+/* header is followed by ctls, gprs, tram and instr */
 typedef struct {
-	char signature[16]; /* LD10K1 DUMP 001 */
+	char signature[16]; /* LD10K1 DUMP 002 */
 	int dump_type;
 	int tram_size;
 	int ctl_count;
 	int gpr_count;
 	int tram_count;
 	int instr_count;
+	/* 002 */
+	unsigned int size;		/* whole dump with header */
+	unsigned int checksum;	/* of everything after header */
 } ld10k1_dump_t;
 
+/* 001 header ends before size */
+#define LD10K1_DUMP_HEADER_SIZE_001 offsetof(ld10k1_dump_t, size)
+
 #define DUMP_TRAM_NULL 0
 #define DUMP_TRAM_READ 1
 #define DUMP_TRAM_WRITE 2
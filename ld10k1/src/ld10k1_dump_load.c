@@ -0,0 +1,522 @@
+/*
+ *  EMU10k1 loader
+ *
+ *  Copyright (c) 2003,2004 by Peter Zubaj
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation;  either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+/*
+ * Dump loading shared by ld10k1, dl10k1 and sim10k1.  Upload compares
+ * dump with what driver has and pokes only entries which differ.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/stat.h>
+#include <sys/ioctl.h>
+#include <alsa/asoundlib.h>
+#include <alsa/sound/emu10k1.h>
+
+#include "bitops.h"
+#include "ld10k1_dump_file.h"
+#include "ld10k1_dump_load.h"
+#include "ld10k1_error.h"
+
+#define DUMP_GPR_MAX 0x200
+#define DUMP_TRAM_MAX 0x100
+#define DUMP_INSTR_MAX 1024
+
+#define DUMP_BITMAP_LONGS(bits) (((bits) + sizeof(unsigned long) * 8 - 1) / (sizeof(unsigned long) * 8))
+
+/* FNV-1a */
+unsigned int ld10k1_dump_checksum(const void *data, unsigned int size)
+{
+	const unsigned char *d = (const unsigned char *)data;
+	unsigned int h = 0x811c9dc5;
+
+	while (size-- > 0) {
+		h ^= *d++;
+		h *= 0x01000193;
+	}
+	return h;
+}
+
+char *ld10k1_dump_error_str(int err)
+{
+	switch (err) {
+		case LD10K1_ERR_DUMP_OPEN:
+			return "unable to open file";
+		case LD10K1_ERR_DUMP_READ:
+			return "unable to read data from file";
+		case LD10K1_ERR_DUMP_SIGNATURE:
+			return "wrong signature";
+		case LD10K1_ERR_DUMP_SIZE:
+			return "wrong file size";
+		case LD10K1_ERR_DUMP_CHECKSUM:
+			return "wrong checksum";
+		case LD10K1_ERR_DUMP_TYPE:
+			return "dump is for other card type";
+		case LD10K1_ERR_NO_MEM:
+			return "no mem";
+		case LD10K1_ERR_DRIVER_INFO:
+			return "unable to get info";
+		case LD10K1_ERR_DRIVER_TRAM_SETUP:
+			return "unable to setup tram";
+		case LD10K1_ERR_DRIVER_CODE_PEEK:
+			return "unable to peek code";
+		case LD10K1_ERR_DRIVER_CODE_POKE:
+			return "unable to poke code";
+		case LD10K1_ERR_DRIVER_PCM_POKE:
+			return "unable to poke pcm";
+		default:
+			return "unknown error";
+	}
+}
+
+/* 001 dumps have no checksum */
+int ld10k1_dump_check(void *data, unsigned int size, ld10k1_dump_parts_t *dump)
+{
+	ld10k1_dump_t *header = (ld10k1_dump_t *)data;
+	unsigned int header_size;
+	unsigned long long parts_size;
+	ld10k1_ctl_dump_t *ctl;
+	void *ptr;
+	int i;
+
+	if (size < LD10K1_DUMP_HEADER_SIZE_001)
+		return LD10K1_ERR_DUMP_SIZE;
+
+	if (strncmp(header->signature, LD10K1_DUMP_SIGNATURE, 16) == 0) {
+		if (size < sizeof(ld10k1_dump_t))
+			return LD10K1_ERR_DUMP_SIZE;
+		header_size = sizeof(ld10k1_dump_t);
+	} else if (strncmp(header->signature, LD10K1_DUMP_SIGNATURE_001, 16) == 0)
+		header_size = LD10K1_DUMP_HEADER_SIZE_001;
+	else
+		return LD10K1_ERR_DUMP_SIGNATURE;
+
+	if (header->ctl_count < 0 ||
+		header->gpr_count < 0 || header->gpr_count > DUMP_GPR_MAX ||
+		header->tram_count < 0 || header->tram_count > DUMP_TRAM_MAX ||
+		header->instr_count < 0 || header->instr_count > DUMP_INSTR_MAX)
+		return LD10K1_ERR_DUMP_SIZE;
+
+	parts_size = header_size +
+		(unsigned long long)header->ctl_count * sizeof(ld10k1_ctl_dump_t) +
+		header->gpr_count * sizeof(unsigned int) +
+		header->tram_count * sizeof(ld10k1_tram_dump_t) +
+		header->instr_count * sizeof(ld10k1_instr_dump_t);
+	if (parts_size != size)
+		return LD10K1_ERR_DUMP_SIZE;
+
+	if (header_size == sizeof(ld10k1_dump_t)) {
+		if (header->size != size)
+			return LD10K1_ERR_DUMP_SIZE;
+		if (header->checksum != ld10k1_dump_checksum((char *)data + header_size, size - header_size))
+			return LD10K1_ERR_DUMP_CHECKSUM;
+	}
+
+	ptr = (char *)data + header_size;
+	dump->header = header;
+	dump->ctl = (ld10k1_ctl_dump_t *)ptr;
+	ptr += sizeof(ld10k1_ctl_dump_t) * header->ctl_count;
+	dump->gpr = (unsigned int *)ptr;
+	ptr += sizeof(unsigned int) * header->gpr_count;
+	dump->tram = (ld10k1_tram_dump_t *)ptr;
+	ptr += sizeof(ld10k1_tram_dump_t) * header->tram_count;
+	dump->instr = (ld10k1_instr_dump_t *)ptr;
+
+	for (i = 0; i < header->ctl_count; i++) {
+		ctl = &(dump->ctl[i]);
+		if (!memchr(ctl->name, '\0', sizeof(ctl->name)) ||
+			ctl->count > 32 || ctl->vcount > ctl->count)
+			return LD10K1_ERR_DUMP_SIZE;
+	}
+	return 0;
+}
+
+/* data is allocated, free it when dump is not needed */
+int ld10k1_dump_read(const char *file_name, void **data, ld10k1_dump_parts_t *dump)
+{
+	struct stat dump_stat;
+	FILE *dump_file;
+	void *dump_data;
+	int err;
+
+	if (stat(file_name, &dump_stat))
+		return LD10K1_ERR_DUMP_OPEN;
+
+	/* minimal dump len is size of header */
+	if (dump_stat.st_size < LD10K1_DUMP_HEADER_SIZE_001)
+		return LD10K1_ERR_DUMP_SIZE;
+
+	dump_data = malloc(dump_stat.st_size);
+	if (!dump_data)
+		return LD10K1_ERR_NO_MEM;
+
+	dump_file = fopen(file_name, "r");
+	if (!dump_file) {
+		err = LD10K1_ERR_DUMP_OPEN;
+		goto err;
+	}
+
+	if (fread(dump_data, dump_stat.st_size, 1, dump_file) != 1) {
+		fclose(dump_file);
+		err = LD10K1_ERR_DUMP_READ;
+		goto err;
+	}
+	fclose(dump_file);
+
+	if ((err = ld10k1_dump_check(dump_data, dump_stat.st_size, dump)) < 0)
+		goto err;
+
+	*data = dump_data;
+	return 0;
+err:
+	free(dump_data);
+	return err;
+}
+
+static void dump_free_code(emu10k1_fx8010_code_t *code)
+{
+	free(code->gpr_map);
+	free(code->tram_data_map);
+	free(code->tram_addr_map);
+	free(code->code);
+}
+
+static int dump_alloc_code(emu10k1_fx8010_code_t *code)
+{
+	memset(code, 0, sizeof(*code));
+	code->gpr_map = (uint32_t *)calloc(DUMP_GPR_MAX, sizeof(uint32_t));
+	code->tram_data_map = (uint32_t *)calloc(DUMP_TRAM_MAX, sizeof(uint32_t));
+	code->tram_addr_map = (uint32_t *)calloc(DUMP_TRAM_MAX, sizeof(uint32_t));
+	code->code = (uint32_t *)calloc(DUMP_INSTR_MAX * 2, sizeof(uint32_t));
+	if (!code->gpr_map || !code->tram_data_map || !code->tram_addr_map || !code->code) {
+		dump_free_code(code);
+		return LD10K1_ERR_NO_MEM;
+	}
+	return 0;
+}
+
+/* unused instruction is skip on audigy, nop on live */
+static void dump_instr_code(int audigy, ld10k1_instr_dump_t *instr, uint32_t *out)
+{
+	unsigned int op, arg0, arg1, arg2, arg3;
+
+	if (instr && instr->used) {
+		op = instr->op;
+		arg0 = instr->arg[0];
+		arg1 = instr->arg[1];
+		arg2 = instr->arg[2];
+		arg3 = instr->arg[3];
+	} else if (audigy) {
+		op = 0x0f;
+		arg0 = arg1 = arg3 = 0xc0;
+		arg2 = 0xcf;
+	} else {
+		op = 0x06;
+		arg0 = arg1 = arg2 = arg3 = 0x40;
+	}
+
+	if (audigy) {
+		out[0] = ((arg2 & 0x7ff) << 12) | (arg3 & 0x7ff);
+		out[1] = ((op & 0x0f) << 24) | ((arg0 & 0x7ff) << 12) | (arg1 & 0x7ff);
+	} else {
+		out[0] = ((arg2 & 0x3ff) << 10) | (arg3 & 0x3ff);
+		out[1] = ((op & 0x0f) << 20) | ((arg0 & 0x3ff) << 10) | (arg1 & 0x3ff);
+	}
+}
+
+static unsigned int dump_tram_addr(int audigy, ld10k1_tram_dump_t *tram)
+{
+	unsigned int vaddr = tram->addr & 0xFFFFF;
+
+	switch (tram->type) {
+		case DUMP_TRAM_READ:
+			if (audigy)
+				return vaddr | 0x2 << 20;
+			return vaddr | TANKMEMADDRREG_READ | TANKMEMADDRREG_ALIGN;
+		case DUMP_TRAM_WRITE:
+			if (audigy)
+				return vaddr | 0x6 << 20;
+			return vaddr | TANKMEMADDRREG_WRITE | TANKMEMADDRREG_ALIGN;
+		default:
+			return 0;
+	}
+}
+
+static void dump_ctl(ld10k1_ctl_dump_t *fctrl, emu10k1_fx8010_control_gpr_t *ctrl)
+{
+	int j;
+
+	memset(ctrl, 0, sizeof(*ctrl));
+	strcpy((char *)ctrl->id.name, fctrl->name);
+	ctrl->id.iface = EMU10K1_CTL_ELEM_IFACE_MIXER;
+	ctrl->id.index = fctrl->index;
+	ctrl->vcount = fctrl->vcount;
+	ctrl->count = fctrl->count;
+	for (j = 0; j < 32; j++) {
+		ctrl->gpr[j] = fctrl->gpr_idx[j];
+		ctrl->value[j] = fctrl->value[j];
+	}
+	ctrl->min = fctrl->min;
+	ctrl->max = fctrl->max;
+	ctrl->translation = fctrl->translation;
+}
+
+static int dump_ctl_id_same(emu10k1_ctl_elem_id_t *a, emu10k1_ctl_elem_id_t *b)
+{
+	return a->iface == b->iface && a->index == b->index &&
+		strncmp((char *)a->name, (char *)b->name, sizeof(a->name)) == 0;
+}
+
+static int dump_ctl_same(emu10k1_fx8010_control_gpr_t *a, emu10k1_fx8010_control_gpr_t *b)
+{
+	unsigned int j;
+
+	if (a->vcount != b->vcount || a->count != b->count ||
+		a->min != b->min || a->max != b->max || a->translation != b->translation)
+		return 0;
+	for (j = 0; j < a->count; j++)
+		if (a->gpr[j] != b->gpr[j] || a->value[j] != b->value[j])
+			return 0;
+	return 1;
+}
+
+/*
+ * Driver state is peeked and only entries which differ from dump are poked.
+ * When DSP already runs the same code, registers written by it (and tram
+ * data filled by reads) are live state and are left alone.  With full
+ * everything is reloaded as on empty DSP.  Returns count of changed entries,
+ * 0 means DSP already runs the dump.
+ */
+int ld10k1_dump_upload(snd_hwdep_t *hwdep, ld10k1_dump_parts_t *dump, int audigy, const char *name, int full)
+{
+	ld10k1_dump_t *header = dump->header;
+	emu10k1_fx8010_info_t info;
+	emu10k1_fx8010_code_t peek, code;
+	emu10k1_fx8010_control_gpr_t *peek_ctrl = NULL;
+	emu10k1_fx8010_control_gpr_t *ctrl = NULL;
+	emu10k1_ctl_elem_id_t *ids = NULL;
+	emu10k1_fx8010_pcm_t ipcm;
+	unsigned long gpr_live[DUMP_BITMAP_LONGS(DUMP_GPR_MAX)];
+	unsigned long tram_data_live[DUMP_BITMAP_LONGS(DUMP_TRAM_MAX)];
+	unsigned long tram_addr_live[DUMP_BITMAP_LONGS(DUMP_TRAM_MAX)];
+	unsigned int gpr_max, tram_max, instr_max, gpr_base;
+	unsigned int dst, addr, data;
+	int peek_count, tram_size;
+	int code_changed, changed;
+	int i, j, n;
+	int err;
+
+	if ((header->dump_type == DUMP_TYPE_LIVE && audigy) ||
+		(header->dump_type != DUMP_TYPE_LIVE && !audigy) ||
+		header->dump_type == DUMP_TYPE_AUDIGY_OLD)
+		return LD10K1_ERR_DUMP_TYPE;
+
+	gpr_max = audigy ? 0x200 : 0x100;
+	tram_max = audigy ? 0x100 : 0xa0;
+	instr_max = audigy ? 1024 : 512;
+	gpr_base = audigy ? 0x400 : 0x100;
+
+	if ((err = dump_alloc_code(&peek)) < 0)
+		return err;
+	if ((err = dump_alloc_code(&code)) < 0) {
+		dump_free_code(&peek);
+		return err;
+	}
+
+	changed = 0;
+
+	/* setup tram size */
+	if (snd_hwdep_ioctl(hwdep, SNDRV_EMU10K1_IOCTL_INFO, &info) < 0) {
+		err = LD10K1_ERR_DRIVER_INFO;
+		goto end;
+	}
+	if (full || info.external_tram_size != header->tram_size) {
+		tram_size = header->tram_size;
+		if (snd_hwdep_ioctl(hwdep, SNDRV_EMU10K1_IOCTL_TRAM_SETUP, &tram_size) < 0) {
+			err = LD10K1_ERR_DRIVER_TRAM_SETUP;
+			goto end;
+		}
+		changed++;
+	}
+
+	/* what driver has */
+	peek.gpr_list_control_count = 0;
+	if (snd_hwdep_ioctl(hwdep, SNDRV_EMU10K1_IOCTL_CODE_PEEK, &peek) < 0) {
+		err = LD10K1_ERR_DRIVER_CODE_PEEK;
+		goto end;
+	}
+
+	peek_count = peek.gpr_list_control_total;
+	if (peek_count > 0) {
+		peek_ctrl = (emu10k1_fx8010_control_gpr_t *)calloc(peek_count, sizeof(emu10k1_fx8010_control_gpr_t));
+		if (!peek_ctrl) {
+			err = LD10K1_ERR_NO_MEM;
+			goto end;
+		}
+		peek.gpr_list_control_count = peek_count;
+		peek.gpr_list_controls = peek_ctrl;
+		if (snd_hwdep_ioctl(hwdep, SNDRV_EMU10K1_IOCTL_CODE_PEEK, &peek) < 0) {
+			err = LD10K1_ERR_DRIVER_CODE_PEEK;
+			goto end;
+		}
+		if (peek.gpr_list_control_total < peek_count)
+			peek_count = peek.gpr_list_control_total;
+	}
+
+	/* instructions */
+	code_changed = 0;
+	for (i = 0; i < instr_max; i++) {
+		dump_instr_code(audigy, i < header->instr_count ? &(dump->instr[i]) : NULL, code.code + i * 2);
+		if (full || code.code[i * 2] != peek.code[i * 2] || code.code[i * 2 + 1] != peek.code[i * 2 + 1]) {
+			set_bit(i, code.code_valid);
+			code_changed++;
+		}
+	}
+	changed += code_changed;
+
+	/* same code runs - keep what it computes */
+	memset(gpr_live, 0, sizeof(gpr_live));
+	memset(tram_data_live, 0, sizeof(tram_data_live));
+	memset(tram_addr_live, 0, sizeof(tram_addr_live));
+	if (!code_changed && !full) {
+		for (i = 0; i < header->instr_count && i < instr_max; i++) {
+			if (!dump->instr[i].used)
+				continue;
+			dst = dump->instr[i].arg[0];
+			if (dst >= gpr_base && dst < gpr_base + gpr_max)
+				set_bit(dst - gpr_base, gpr_live);
+			else if (dst >= 0x200 && dst < 0x200 + tram_max)
+				set_bit(dst - 0x200, tram_data_live);
+			else if (dst >= 0x300 && dst < 0x300 + tram_max)
+				set_bit(dst - 0x300, tram_addr_live);
+		}
+		for (i = 0; i < header->tram_count && i < tram_max; i++)
+			if (dump->tram[i].type == DUMP_TRAM_READ)
+				set_bit(i, tram_data_live);
+	}
+
+	/* registers */
+	for (i = 0; i < gpr_max; i++) {
+		code.gpr_map[i] = i < header->gpr_count ? dump->gpr[i] : 0;
+		if (full || (!test_bit(i, gpr_live) && code.gpr_map[i] != peek.gpr_map[i])) {
+			set_bit(i, code.gpr_valid);
+			changed++;
+		}
+	}
+
+	/* tram addr + data */
+	for (i = 0; i < tram_max; i++) {
+		if (i < header->tram_count) {
+			addr = dump_tram_addr(audigy, &(dump->tram[i]));
+			data = dump->tram[i].data;
+		} else
+			addr = data = 0;
+
+		if (!full) {
+			if (test_bit(i, tram_addr_live))
+				addr = peek.tram_addr_map[i];
+			if (test_bit(i, tram_data_live))
+				data = peek.tram_data_map[i];
+			if (addr == peek.tram_addr_map[i] && data == peek.tram_data_map[i])
+				continue;
+		}
+		code.tram_addr_map[i] = addr;
+		code.tram_data_map[i] = data;
+		set_bit(i, code.tram_valid);
+		changed++;
+	}
+
+	/* controls */
+	ctrl = (emu10k1_fx8010_control_gpr_t *)calloc(header->ctl_count + 1, sizeof(emu10k1_fx8010_control_gpr_t));
+	ids = (emu10k1_ctl_elem_id_t *)calloc(peek_count + 1, sizeof(emu10k1_ctl_elem_id_t));
+	if (!ctrl || !ids) {
+		err = LD10K1_ERR_NO_MEM;
+		goto end;
+	}
+	for (i = 0; i < header->ctl_count; i++)
+		dump_ctl(&(dump->ctl[i]), &(ctrl[i]));
+
+	/* not in dump */
+	code.gpr_del_control_count = 0;
+	for (j = 0; j < peek_count; j++) {
+		for (i = 0; !full && i < header->ctl_count; i++)
+			if (dump_ctl_id_same(&(ctrl[i].id), &(peek_ctrl[j].id)))
+				break;
+		if (full || i >= header->ctl_count)
+			memcpy(&(ids[code.gpr_del_control_count++]), &(peek_ctrl[j].id), sizeof(emu10k1_ctl_elem_id_t));
+	}
+
+	/* new or different - existing control is replaced */
+	for (n = 0, i = 0; i < header->ctl_count; i++) {
+		for (j = 0; !full && j < peek_count; j++)
+			if (dump_ctl_id_same(&(ctrl[i].id), &(peek_ctrl[j].id)))
+				break;
+		if (!full && j < peek_count && dump_ctl_same(&(ctrl[i]), &(peek_ctrl[j])))
+			continue;
+		if (n != i)
+			memcpy(&(ctrl[n]), &(ctrl[i]), sizeof(emu10k1_fx8010_control_gpr_t));
+		n++;
+	}
+	code.gpr_add_control_count = n;
+	changed += code.gpr_add_control_count + code.gpr_del_control_count;
+
+	code.gpr_add_controls = ctrl;
+	code.gpr_del_controls = ids;
+	code.gpr_list_control_count = 0;
+	code.gpr_list_controls = NULL;
+
+	if (changed) {
+		strncpy(code.name, name, sizeof(code.name) - 1);
+		if (snd_hwdep_ioctl(hwdep, SNDRV_EMU10K1_IOCTL_CODE_POKE, &code) < 0) {
+			err = LD10K1_ERR_DRIVER_CODE_POKE;
+			goto end;
+		}
+	}
+
+	/* delete tram pcm dsp part */
+	if (!audigy && code_changed) {
+		for (i = 0; i < EMU10K1_FX8010_PCM_COUNT; i++) {
+			memset(&ipcm, 0, sizeof(ipcm));
+			ipcm.substream = i;
+			ipcm.channels = 0;
+			if (snd_hwdep_ioctl(hwdep, SNDRV_EMU10K1_IOCTL_PCM_POKE, &ipcm) < 0) {
+				err = LD10K1_ERR_DRIVER_PCM_POKE;
+				goto end;
+			}
+		}
+	}
+
+	err = changed;
+end:
+	dump_free_code(&peek);
+	dump_free_code(&code);
+	free(peek_ctrl);
+	free(ctrl);
+	free(ids);
+	return err;
+}
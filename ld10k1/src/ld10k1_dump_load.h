@@ -0,0 +1,40 @@
+/*
+ *  EMU10k1 loader
+ *
+ *  Copyright (c) 2003,2004 by Peter Zubaj
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation;  either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef __LD10K1_DUMP_LOAD_H
+#define __LD10K1_DUMP_LOAD_H
+
+/* checked dump split to parts */
+typedef struct ld10k1_dump_parts_tag {
+	ld10k1_dump_t *header;
+	ld10k1_ctl_dump_t *ctl;
+	unsigned int *gpr;
+	ld10k1_tram_dump_t *tram;
+	ld10k1_instr_dump_t *instr;
+} ld10k1_dump_parts_t;
+
+unsigned int ld10k1_dump_checksum(const void *data, unsigned int size);
+int ld10k1_dump_check(void *data, unsigned int size, ld10k1_dump_parts_t *dump);
+int ld10k1_dump_read(const char *file_name, void **data, ld10k1_dump_parts_t *dump);
+char *ld10k1_dump_error_str(int err);
+int ld10k1_dump_upload(snd_hwdep_t *hwdep, ld10k1_dump_parts_t *dump, int audigy, const char *name, int full);
+
+#endif /* __LD10K1_DUMP_LOAD_H */
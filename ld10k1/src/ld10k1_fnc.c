@@ -35,19 +35,24 @@
 #include "ld10k1_driver.h"
 #include "ld10k1_tram.h"
 #include "ld10k1_error.h"
+#include "bitops.h"
 
 char *ld10k1_dsp_mgr_name_new(char **where, const char *from);
 int ld10k1_add_control(ld10k1_dsp_mgr_t *dsp_mgr, ld10k1_ctl_t *gctl);
 void ld10k1_del_control(ld10k1_dsp_mgr_t *dsp_mgr, ld10k1_ctl_t *gctl);
 int ld10k1_dsp_mgr_patch_unload(ld10k1_dsp_mgr_t *dsp_mgr, ld10k1_patch_t *patch, unsigned int idx);
 int ld10k1_get_used_index_for_control(ld10k1_dsp_mgr_t *dsp_mgr, ld10k1_ctl_t *gctl, int **idxs, int *cnt);
+static void ld10k1_ctl_list_hash_add(ld10k1_ctl_list_t *list, ld10k1_ctl_list_item_t *item);
 
 unsigned int ld10k1_resolve_named_reg(ld10k1_dsp_mgr_t *dsp_mgr, unsigned int reg);
-unsigned int ld10k1_gpr_reserve(ld10k1_dsp_mgr_t *dsp_mgr, int max_res_count, int *res_count, int *res,
+static void ld10k1_reg_res_init(ld10k1_reg_res_t *res);
+unsigned int ld10k1_gpr_reserve(ld10k1_dsp_mgr_t *dsp_mgr, ld10k1_reg_res_t *res,
 	unsigned int usage, unsigned int val);
-unsigned int ld10k1_gpr_dyn_reserve(ld10k1_dsp_mgr_t *dsp_mgr, int max_res_count, int *res_count, int *res);
-unsigned int ld10k1_const_reserve(ld10k1_dsp_mgr_t *dsp_mgr, int max_res_const_count, int *res_const_count, int *res_const,
-	int max_res_count, int *res_count, int *res, int const_val);
+unsigned int ld10k1_gpr_dyn_reserve(ld10k1_dsp_mgr_t *dsp_mgr, ld10k1_reg_res_t *res);
+unsigned int ld10k1_const_reserve(ld10k1_dsp_mgr_t *dsp_mgr, ld10k1_reg_res_t *res_const,
+	ld10k1_reg_res_t *res, int const_val);
+static void ld10k1_const_hash_add(ld10k1_dsp_mgr_t *dsp_mgr, int idx);
+static void ld10k1_dsp_mgr_stage_init(ld10k1_dsp_mgr_t *dsp_mgr);
 
 void ld10k1_const_alloc(ld10k1_dsp_mgr_t *dsp_mgr, int reg);
 void ld10k1_const_free(ld10k1_dsp_mgr_t *dsp_mgr, int reg);
@@ -66,6 +71,8 @@ int ld10k1_conn_point_get_reg(ld10k1_dsp_mgr_t *dsp_mgr, ld10k1_conn_point_t *po
 void ld10k1_conn_point_add_to_list(ld10k1_dsp_mgr_t *dsp_mgr, ld10k1_conn_point_t *point);
 void ld10k1_conn_point_del_from_list(ld10k1_dsp_mgr_t *dsp_mgr, ld10k1_conn_point_t *point);
 int ld10k1_gen_patch_id(ld10k1_dsp_mgr_t *dsp_mgr, int pnum);
+static unsigned int ld10k1_conn_point_hash(int id);
+static void ld10k1_conn_point_hash_add(ld10k1_dsp_mgr_t *dsp_mgr, ld10k1_conn_point_t *point);
 
 /*
  *  Tables
@@ -96,6 +103,26 @@ unsigned int hw_const[22 * 2] =
 	0x00100000, EMU10K1_REG_HW(21)
 };
 
+/* changes are collected here and sent by next ld10k1_update_driver */
+void ld10k1_dsp_mgr_gpr_changed(ld10k1_dsp_mgr_t *dsp_mgr, unsigned int gpr)
+{
+	set_bit(gpr, dsp_mgr->gpr_dirty);
+	dsp_mgr->dirty = 1;
+}
+
+void ld10k1_dsp_mgr_instr_changed(ld10k1_dsp_mgr_t *dsp_mgr, unsigned int instr)
+{
+	set_bit(instr, dsp_mgr->instr_dirty);
+	dsp_mgr->dirty = 1;
+}
+
+/* acc is itram index or max_itram_hwacc + etram index */
+void ld10k1_dsp_mgr_tram_changed(ld10k1_dsp_mgr_t *dsp_mgr, unsigned int acc)
+{
+	set_bit(acc, dsp_mgr->tram_dirty);
+	dsp_mgr->dirty = 1;
+}
+
 int ld10k1_dsp_mgr_init(ld10k1_dsp_mgr_t *dsp_mgr)
 {
 	int tmp_gpr_count = 0;
@@ -105,16 +132,12 @@ int ld10k1_dsp_mgr_init(ld10k1_dsp_mgr_t *dsp_mgr)
 	int tmp_op_count = 0;
 	int i, j;
 
-	dsp_mgr->add_ctl_list = NULL;
-	dsp_mgr->add_list_count = 0;
-
-	dsp_mgr->del_ctl_list = NULL;
-	dsp_mgr->del_list_count = 0;
-
-	dsp_mgr->ctl_list = NULL;
-	dsp_mgr->ctl_list_count = 0;
+	ld10k1_ctl_list_init(&(dsp_mgr->add_ctl_list));
+	ld10k1_ctl_list_init(&(dsp_mgr->del_ctl_list));
+	ld10k1_ctl_list_init(&(dsp_mgr->ctl_list));
 	
 	dsp_mgr->point_list = 0;
+	memset(dsp_mgr->point_hash, 0, sizeof(dsp_mgr->point_hash));
 
 	if (dsp_mgr->audigy) {
 		tmp_itram_count = 0xC0;
@@ -133,7 +156,8 @@ int ld10k1_dsp_mgr_init(ld10k1_dsp_mgr_t *dsp_mgr)
 
 	for (i = 0; i < tmp_op_count; i++) {
 		dsp_mgr->instr[i].used = 0;
-		dsp_mgr->instr[i].modified = 1;
+		dsp_mgr->instr[i].modified = 0;
+		dsp_mgr->instr[i].dead = 0;
 		dsp_mgr->instr[i].op_code = 0;
 		for (j = 0; j < 4; j++)
 		    dsp_mgr->instr[i].arg[j] = 0;
@@ -265,13 +289,30 @@ int ld10k1_dsp_mgr_init(ld10k1_dsp_mgr_t *dsp_mgr)
 	dsp_mgr->consts[21].ref = 1;
 	dsp_mgr->consts_max_count = 22 + dsp_mgr->regs_max_count;
 
+	memset(dsp_mgr->const_free, 0, sizeof(dsp_mgr->const_free));
+	for (i = 22; i < MAX_CONST_COUNT; i++) {
+		dsp_mgr->consts[i].used = 0;
+		dsp_mgr->consts[i].ref = 0;
+		if (i < dsp_mgr->consts_max_count)
+			set_bit(i, dsp_mgr->const_free);
+	}
+
+	for (i = 0; i < LD10K1_CONST_HASH_SIZE; i++)
+		dsp_mgr->const_hash[i] = -1;
+	for (i = 0; i < MAX_CONST_COUNT; i++)
+		dsp_mgr->consts[i].hashed = 0;
+	for (i = 0; i < 22; i++)
+		ld10k1_const_hash_add(dsp_mgr, i);
+
 	/* gprs */
+	memset(dsp_mgr->gpr_free, 0, sizeof(dsp_mgr->gpr_free));
+	memset(dsp_mgr->gpr_dyn, 0, sizeof(dsp_mgr->gpr_dyn));
 	for (i = 0; i < dsp_mgr->regs_max_count; i++) {
+		set_bit(i, dsp_mgr->gpr_free);
 		dsp_mgr->regs[i].used = 0;
 		dsp_mgr->regs[i].gpr_usage = GPR_USAGE_NONE;
 		dsp_mgr->regs[i].val = 0;
 		dsp_mgr->regs[i].ref = 0;
-		dsp_mgr->regs[i].modified = 1;
 	}
 
 	dsp_mgr->patch_count = 0;
@@ -294,20 +335,31 @@ int ld10k1_dsp_mgr_init(ld10k1_dsp_mgr_t *dsp_mgr)
 	for (i = 0; i < 0x40; i++) {
 		dsp_mgr->etram_hwacc[i].used = 0;
 		dsp_mgr->etram_hwacc[i].op = 0;
-		dsp_mgr->etram_hwacc[i].modified = 1;
 		dsp_mgr->etram_hwacc[i].data_val = 0;
 		dsp_mgr->etram_hwacc[i].addr_val = 0;
 	}
 
 	for (i = 0; i < 0xC0; i++) {
 		dsp_mgr->itram_hwacc[i].used = 0;
-		dsp_mgr->itram_hwacc[i].modified = 1;
+		dsp_mgr->itram_hwacc[i].op = 0;
 		dsp_mgr->itram_hwacc[i].data_val = 0;
 		dsp_mgr->itram_hwacc[i].addr_val = 0;
 	}
 
 	dsp_mgr->max_tram_grp = dsp_mgr->max_tram_acc = tmp_itram_count + tmp_etram_count;
 	dsp_mgr->max_itram_hwacc = tmp_itram_count;
+
+	/* everything is sent by first update */
+	dsp_mgr->dirty = 1;
+	memset(dsp_mgr->instr_dirty, 0, sizeof(dsp_mgr->instr_dirty));
+	for (i = 0; i < tmp_op_count; i++)
+		set_bit(i, dsp_mgr->instr_dirty);
+	memset(dsp_mgr->gpr_dirty, 0, sizeof(dsp_mgr->gpr_dirty));
+	for (i = 0; i < dsp_mgr->regs_max_count; i++)
+		set_bit(i, dsp_mgr->gpr_dirty);
+	memset(dsp_mgr->tram_dirty, 0, sizeof(dsp_mgr->tram_dirty));
+	for (i = 0; i < tmp_itram_count + tmp_etram_count; i++)
+		set_bit(i, dsp_mgr->tram_dirty);
 	dsp_mgr->max_etram_hwacc = tmp_etram_count;
 
 	dsp_mgr->i_tram.size = 0;
@@ -320,11 +372,21 @@ int ld10k1_dsp_mgr_init(ld10k1_dsp_mgr_t *dsp_mgr)
 	dsp_mgr->e_tram.hwacc = dsp_mgr->etram_hwacc;
 	dsp_mgr->e_tram.used_hwacc = 0;
 
+	ld10k1_tram_init_space(&(dsp_mgr->i_tram));
+	ld10k1_tram_init_space(&(dsp_mgr->e_tram));
+
 	dsp_mgr->patch_count = 0;
 	for (i = 0; i < EMU10K1_PATCH_MAX; i++) {
 		dsp_mgr->patch_ptr[i] = NULL;
 		dsp_mgr->patch_order[i] = 0xFFFFFFFF;
 	}
+	for (i = 0; i < LD10K1_NAME_HASH_SIZE; i++)
+		dsp_mgr->patch_name_hash[i] = -1;
+
+	dsp_mgr->instr_window_last = 0;
+	dsp_mgr->instr_window_max = 0;
+	if (dsp_mgr->staged)
+		ld10k1_dsp_mgr_stage_init(dsp_mgr);
 
 	return 0;
 }
@@ -346,9 +408,9 @@ void ld10k1_dsp_mgr_free(ld10k1_dsp_mgr_t *dsp_mgr)
 		    ld10k1_dsp_mgr_patch_unload(dsp_mgr, dsp_mgr->patch_ptr[i], i);
 	}
 
-	ld10k1_del_all_controls_from_list(&(dsp_mgr->del_ctl_list), &dsp_mgr->del_list_count);
-	ld10k1_del_all_controls_from_list(&(dsp_mgr->add_ctl_list), &dsp_mgr->add_list_count);
-	ld10k1_del_all_controls_from_list(&(dsp_mgr->ctl_list), &dsp_mgr->ctl_list_count);
+	ld10k1_del_all_controls_from_list(&(dsp_mgr->del_ctl_list));
+	ld10k1_del_all_controls_from_list(&(dsp_mgr->add_ctl_list));
+	ld10k1_del_all_controls_from_list(&(dsp_mgr->ctl_list));
 
 	/* FIXME - uvolnovanie point - asi netreba - su uvolnovane pri patch */
 	for (i = 0; i < dsp_mgr->fx_count; i++)
@@ -364,6 +426,321 @@ void ld10k1_dsp_mgr_free(ld10k1_dsp_mgr_t *dsp_mgr)
 			free(dsp_mgr->outs[i].name);
 }
 
+/*
+ * Transactions - the state of the manager is saved at begin and simply
+ * put back on rollback.  Nothing is sent to the driver until commit, so
+ * the driver still holds the program matching the saved state.
+ */
+
+static ld10k1_patch_t *ld10k1_dsp_mgr_patch_dup(ld10k1_patch_t *patch)
+{
+	ld10k1_patch_t *np;
+	unsigned int i;
+
+	np = ld10k1_dsp_mgr_patch_new();
+	if (!np)
+		return NULL;
+
+	np->order = patch->order;
+	np->id = patch->id;
+	/* slots are same in copy, so is name hash */
+	np->name_hash_next = patch->name_hash_next;
+	np->instr_offset = patch->instr_offset;
+	np->instr_removed = patch->instr_removed;
+
+	if (patch->patch_name && !ld10k1_dsp_mgr_name_new(&(np->patch_name), patch->patch_name))
+		goto err;
+
+	/* points are linked again from the copied points */
+	if (patch->in_count) {
+		if (!ld10k1_dsp_mgr_patch_in_new(np, patch->in_count))
+			goto err;
+		for (i = 0; i < patch->in_count; i++)
+			if (patch->ins[i].name && !ld10k1_dsp_mgr_name_new(&(np->ins[i].name), patch->ins[i].name))
+				goto err;
+	}
+
+	if (patch->out_count) {
+		if (!ld10k1_dsp_mgr_patch_out_new(np, patch->out_count))
+			goto err;
+		for (i = 0; i < patch->out_count; i++)
+			if (patch->outs[i].name && !ld10k1_dsp_mgr_name_new(&(np->outs[i].name), patch->outs[i].name))
+				goto err;
+	}
+
+	if (patch->const_count) {
+		if (!ld10k1_dsp_mgr_patch_const_new(np, patch->const_count))
+			goto err;
+		memcpy(np->consts, patch->consts, sizeof(ld10k1_p_const_sta_t) * patch->const_count);
+	}
+
+	if (patch->sta_count) {
+		if (!ld10k1_dsp_mgr_patch_sta_new(np, patch->sta_count))
+			goto err;
+		memcpy(np->stas, patch->stas, sizeof(ld10k1_p_const_sta_t) * patch->sta_count);
+	}
+
+	if (patch->dyn_count) {
+		if (!ld10k1_dsp_mgr_patch_dyn_new(np, patch->dyn_count))
+			goto err;
+		memcpy(np->dyns, patch->dyns, sizeof(ld10k1_p_dyn_t) * patch->dyn_count);
+		np->dyn_gpr_count = patch->dyn_gpr_count;
+	}
+
+	if (patch->hw_count) {
+		if (!ld10k1_dsp_mgr_patch_hw_new(np, patch->hw_count))
+			goto err;
+		memcpy(np->hws, patch->hws, sizeof(ld10k1_p_hw_t) * patch->hw_count);
+	}
+
+	if (patch->tram_count) {
+		if (!ld10k1_dsp_mgr_patch_tram_new(np, patch->tram_count))
+			goto err;
+		memcpy(np->tram_grp, patch->tram_grp, sizeof(ld10k1_p_tram_grp_t) * patch->tram_count);
+	}
+
+	if (patch->tram_acc_count) {
+		if (!ld10k1_dsp_mgr_patch_tram_acc_new(np, patch->tram_acc_count))
+			goto err;
+		memcpy(np->tram_acc, patch->tram_acc, sizeof(ld10k1_p_tram_acc_t) * patch->tram_acc_count);
+	}
+
+	if (patch->ctl_count) {
+		if (!ld10k1_dsp_mgr_patch_ctl_new(np, patch->ctl_count))
+			goto err;
+		memcpy(np->ctl, patch->ctl, sizeof(ld10k1_ctl_t) * patch->ctl_count);
+	}
+
+	if (patch->instr_count) {
+		if (!ld10k1_dsp_mgr_patch_instr_new(np, patch->instr_count))
+			goto err;
+		memcpy(np->instr, patch->instr, sizeof(ld10k1_instr_t) * patch->instr_count);
+		memcpy(np->phys_instr, patch->phys_instr, sizeof(ld10k1_instr_t) * patch->instr_count);
+	}
+
+	return np;
+err:
+	ld10k1_dsp_mgr_patch_free(np);
+	return NULL;
+}
+
+static int ld10k1_dsp_mgr_ctl_list_dup(ld10k1_ctl_list_t *to, ld10k1_ctl_list_t *from)
+{
+	ld10k1_ctl_list_item_t *item;
+	ld10k1_ctl_list_item_t *from_item;
+	ld10k1_ctl_list_item_t *last = NULL;
+
+	for (from_item = from->first; from_item != NULL; from_item = from_item->next) {
+		item = (ld10k1_ctl_list_item_t *)malloc(sizeof(ld10k1_ctl_list_item_t));
+		if (!item)
+			return LD10K1_ERR_NO_MEM;
+		memcpy(&(item->ctl), &(from_item->ctl), sizeof(ld10k1_ctl_t));
+		/* keep order */
+		item->next = NULL;
+		item->prev = last;
+		if (last)
+			last->next = item;
+		else
+			to->first = item;
+		last = item;
+		ld10k1_ctl_list_hash_add(to, item);
+		to->count++;
+	}
+	return 0;
+}
+
+static ld10k1_patch_t *ld10k1_dsp_mgr_patch_map(ld10k1_dsp_mgr_t *to, ld10k1_patch_t *patch)
+{
+	/* copies keep the order of originals */
+	if (!patch)
+		return NULL;
+	return to->patch_ptr[to->patch_order[patch->order]];
+}
+
+static int ld10k1_dsp_mgr_points_dup(ld10k1_dsp_mgr_t *to, ld10k1_dsp_mgr_t *from)
+{
+	ld10k1_conn_point_t *point;
+	ld10k1_conn_point_t *np;
+	ld10k1_conn_point_t **last = &(to->point_list);
+	int i, index;
+
+	for (point = from->point_list; point != NULL; point = point->next) {
+		np = (ld10k1_conn_point_t *)malloc(sizeof(ld10k1_conn_point_t));
+		if (!np)
+			return LD10K1_ERR_NO_MEM;
+		memcpy(np, point, sizeof(ld10k1_conn_point_t));
+		np->next = NULL;
+		*last = np;
+		last = &(np->next);
+		if (np->id > 0)
+			ld10k1_conn_point_hash_add(to, np);
+
+		np->owner = ld10k1_dsp_mgr_patch_map(to, point->owner);
+		for (i = 0; i < MAX_CONN_PER_POINT; i++) {
+			np->patch[i] = ld10k1_dsp_mgr_patch_map(to, point->patch[i]);
+			if (point->type[i] == CON_IO_PIN)
+				np->patch[i]->ins[np->io[i]].point = np;
+			else if (point->type[i] == CON_IO_POUT)
+				np->patch[i]->outs[np->io[i]].point = np;
+		}
+
+		index = np->con_gpr_idx & ~EMU10K1_REG_TYPE_MASK;
+		switch (EMU10K1_REG_TYPE_B(np->con_gpr_idx)) {
+			case EMU10K1_REG_TYPE_FX:
+				to->fxs[index].point = np;
+				break;
+			case EMU10K1_REG_TYPE_INPUT:
+				to->ins[index].point = np;
+				break;
+			case EMU10K1_REG_TYPE_OUTPUT:
+				to->outs[index].point = np;
+				break;
+		}
+	}
+	return 0;
+}
+
+/* frees memory of the manager without touching the driver */
+static void ld10k1_dsp_mgr_release(ld10k1_dsp_mgr_t *dsp_mgr)
+{
+	ld10k1_conn_point_t *point;
+	unsigned int i;
+
+	for (i = 0; i < EMU10K1_PATCH_MAX; i++)
+		if (dsp_mgr->patch_ptr[i]) {
+			ld10k1_dsp_mgr_patch_free(dsp_mgr->patch_ptr[i]);
+			dsp_mgr->patch_ptr[i] = NULL;
+		}
+
+	while ((point = dsp_mgr->point_list) != NULL) {
+		dsp_mgr->point_list = point->next;
+		free(point);
+	}
+	memset(dsp_mgr->point_hash, 0, sizeof(dsp_mgr->point_hash));
+
+	ld10k1_del_all_controls_from_list(&(dsp_mgr->del_ctl_list));
+	ld10k1_del_all_controls_from_list(&(dsp_mgr->add_ctl_list));
+	ld10k1_del_all_controls_from_list(&(dsp_mgr->ctl_list));
+
+	for (i = 0; i < dsp_mgr->fx_count; i++)
+		if (dsp_mgr->fxs[i].name) {
+			free(dsp_mgr->fxs[i].name);
+			dsp_mgr->fxs[i].name = NULL;
+		}
+
+	for (i = 0; i < dsp_mgr->in_count; i++)
+		if (dsp_mgr->ins[i].name) {
+			free(dsp_mgr->ins[i].name);
+			dsp_mgr->ins[i].name = NULL;
+		}
+
+	for (i = 0; i < dsp_mgr->out_count; i++)
+		if (dsp_mgr->outs[i].name) {
+			free(dsp_mgr->outs[i].name);
+			dsp_mgr->outs[i].name = NULL;
+		}
+}
+
+ld10k1_dsp_mgr_t *ld10k1_dsp_mgr_save(ld10k1_dsp_mgr_t *dsp_mgr)
+{
+	ld10k1_dsp_mgr_t *saved;
+	unsigned int i;
+
+	saved = (ld10k1_dsp_mgr_t *)malloc(sizeof(ld10k1_dsp_mgr_t));
+	if (!saved)
+		return NULL;
+
+	/* take everything by value, then replace what is owned */
+	memcpy(saved, dsp_mgr, sizeof(ld10k1_dsp_mgr_t));
+	saved->i_tram.hwacc = saved->itram_hwacc;
+	saved->e_tram.hwacc = saved->etram_hwacc;
+	for (i = 0; i < EMU10K1_PATCH_MAX; i++)
+		saved->patch_ptr[i] = NULL;
+	saved->point_list = NULL;
+	memset(saved->point_hash, 0, sizeof(saved->point_hash));
+	ld10k1_ctl_list_init(&(saved->add_ctl_list));
+	ld10k1_ctl_list_init(&(saved->del_ctl_list));
+	ld10k1_ctl_list_init(&(saved->ctl_list));
+	for (i = 0; i < saved->fx_count; i++) {
+		saved->fxs[i].name = NULL;
+		saved->fxs[i].point = NULL;
+	}
+	for (i = 0; i < saved->in_count; i++) {
+		saved->ins[i].name = NULL;
+		saved->ins[i].point = NULL;
+	}
+	for (i = 0; i < saved->out_count; i++) {
+		saved->outs[i].name = NULL;
+		saved->outs[i].point = NULL;
+	}
+
+	for (i = 0; i < dsp_mgr->fx_count; i++)
+		if (dsp_mgr->fxs[i].name && !ld10k1_dsp_mgr_name_new(&(saved->fxs[i].name), dsp_mgr->fxs[i].name))
+			goto err;
+	for (i = 0; i < dsp_mgr->in_count; i++)
+		if (dsp_mgr->ins[i].name && !ld10k1_dsp_mgr_name_new(&(saved->ins[i].name), dsp_mgr->ins[i].name))
+			goto err;
+	for (i = 0; i < dsp_mgr->out_count; i++)
+		if (dsp_mgr->outs[i].name && !ld10k1_dsp_mgr_name_new(&(saved->outs[i].name), dsp_mgr->outs[i].name))
+			goto err;
+
+	for (i = 0; i < EMU10K1_PATCH_MAX; i++)
+		if (dsp_mgr->patch_ptr[i] && !(saved->patch_ptr[i] = ld10k1_dsp_mgr_patch_dup(dsp_mgr->patch_ptr[i])))
+			goto err;
+
+	if (ld10k1_dsp_mgr_points_dup(saved, dsp_mgr) < 0)
+		goto err;
+
+	if (ld10k1_dsp_mgr_ctl_list_dup(&(saved->add_ctl_list), &(dsp_mgr->add_ctl_list)) < 0)
+		goto err;
+	if (ld10k1_dsp_mgr_ctl_list_dup(&(saved->del_ctl_list), &(dsp_mgr->del_ctl_list)) < 0)
+		goto err;
+	if (ld10k1_dsp_mgr_ctl_list_dup(&(saved->ctl_list), &(dsp_mgr->ctl_list)) < 0)
+		goto err;
+
+	return saved;
+err:
+	ld10k1_dsp_mgr_discard(saved);
+	return NULL;
+}
+
+/* puts saved state back, saved is consumed */
+void ld10k1_dsp_mgr_restore(ld10k1_dsp_mgr_t *dsp_mgr, ld10k1_dsp_mgr_t *saved)
+{
+	ld10k1_dsp_mgr_release(dsp_mgr);
+	memcpy(dsp_mgr, saved, sizeof(ld10k1_dsp_mgr_t));
+	dsp_mgr->i_tram.hwacc = dsp_mgr->itram_hwacc;
+	dsp_mgr->e_tram.hwacc = dsp_mgr->etram_hwacc;
+	free(saved);
+}
+
+void ld10k1_dsp_mgr_discard(ld10k1_dsp_mgr_t *saved)
+{
+	ld10k1_dsp_mgr_release(saved);
+	free(saved);
+}
+
+/* exchanges current and saved state, so saved state can be read */
+void ld10k1_dsp_mgr_swap(ld10k1_dsp_mgr_t *dsp_mgr, ld10k1_dsp_mgr_t *saved)
+{
+	char tmp[4096];
+	char *a = (char *)dsp_mgr;
+	char *b = (char *)saved;
+	size_t left, n;
+
+	/* state is too big for stack, swap it by parts */
+	for (left = sizeof(ld10k1_dsp_mgr_t); left > 0; left -= n, a += n, b += n) {
+		n = left < sizeof(tmp) ? left : sizeof(tmp);
+		memcpy(tmp, a, n);
+		memcpy(a, b, n);
+		memcpy(b, tmp, n);
+	}
+	dsp_mgr->i_tram.hwacc = dsp_mgr->itram_hwacc;
+	dsp_mgr->e_tram.hwacc = dsp_mgr->etram_hwacc;
+	saved->i_tram.hwacc = saved->itram_hwacc;
+	saved->e_tram.hwacc = saved->etram_hwacc;
+}
+
 ld10k1_patch_t *ld10k1_dsp_mgr_patch_new(void)
 {
 	ld10k1_patch_t *np;
@@ -373,6 +750,7 @@ ld10k1_patch_t *ld10k1_dsp_mgr_patch_new(void)
 		return NULL;
 
 	np->patch_name = NULL;
+	np->name_hash_next = -1;
 	np->id = 0;
 
 	np->in_count = 0;
@@ -389,6 +767,8 @@ ld10k1_patch_t *ld10k1_dsp_mgr_patch_new(void)
 
 	np->dyn_count = 0;
 	np->dyns = NULL;
+	np->dyn_gpr_count = 0;
+	np->instr_removed = 0;
 
 	np->hw_count = 0;
 	np->hws = NULL;
@@ -405,6 +785,7 @@ ld10k1_patch_t *ld10k1_dsp_mgr_patch_new(void)
 	np->instr_count = 0;
 	np->instr_offset = 0;
 	np->instr = NULL;
+	np->phys_instr = NULL;
 
 	return np;
 }
@@ -454,6 +835,9 @@ void ld10k1_dsp_mgr_patch_free(ld10k1_patch_t *patch)
 	if (patch->instr)
 		free(patch->instr);
 
+	if (patch->phys_instr)
+		free(patch->phys_instr);
+
 	free(patch);
 }
 
@@ -604,17 +988,28 @@ ld10k1_p_tram_acc_t *ld10k1_dsp_mgr_patch_tram_acc_new(ld10k1_patch_t *patch, un
 ld10k1_instr_t *ld10k1_dsp_mgr_patch_instr_new(ld10k1_patch_t *patch, unsigned int count)
 {
 	ld10k1_instr_t *instr;
+	ld10k1_instr_t *phys_instr;
 	
 	instr = (ld10k1_instr_t *)malloc(sizeof(ld10k1_instr_t) * count);
 	if (!instr)
 		return NULL;
+
+	phys_instr = (ld10k1_instr_t *)malloc(sizeof(ld10k1_instr_t) * count);
+	if (!phys_instr) {
+		free(instr);
+		return NULL;
+	}
 		
 	if (patch->instr)
    		free(patch->instr);
+	if (patch->phys_instr)
+   		free(patch->phys_instr);
 
 	memset(instr, 0, sizeof(ld10k1_instr_t) * count);
+	memset(phys_instr, 0, sizeof(ld10k1_instr_t) * count);
 
 	patch->instr = instr;
+	patch->phys_instr = phys_instr;
 	patch->instr_count = count;
 	return instr;
 }
@@ -834,16 +1229,66 @@ int ld10k1_dsp_mgr_get_phys_reg_for_patch(ld10k1_dsp_mgr_t *dsp_mgr, ld10k1_patc
 	return -1;
 }
 
-int ld10k1_dsp_mgr_actualize_instr(ld10k1_dsp_mgr_t *dsp_mgr)
+static int ld10k1_instr_same(ld10k1_instr_t *instr, ld10k1_instr_t *phys)
+{
+	return instr->op_code == phys->op_code &&
+		instr->arg[0] == phys->arg[0] && instr->arg[1] == phys->arg[1] &&
+		instr->arg[2] == phys->arg[2] && instr->arg[3] == phys->arg[3];
+}
+
+/* place instruction to dsp code, only real change goes to driver */
+static void ld10k1_dsp_mgr_instr_set(ld10k1_dsp_mgr_t *dsp_mgr, unsigned int idx, ld10k1_instr_t *phys)
+{
+	ld10k1_instr_t *instr = &(dsp_mgr->instr[idx]);
+	int k;
+
+	if ((instr->used || instr->dead) && ld10k1_instr_same(instr, phys)) {
+		instr->used = 1;
+		instr->dead = 0;
+		return;
+	}
+
+	instr->used = 1;
+	instr->dead = 0;
+	instr->op_code = phys->op_code;
+	for (k = 0; k < 4; k++)
+		instr->arg[k] = phys->arg[k];
+	ld10k1_dsp_mgr_instr_changed(dsp_mgr, idx);
+}
+
+/* instructions in from .. to - 1 which next update rewrites */
+static unsigned int ld10k1_dsp_mgr_instr_window(ld10k1_dsp_mgr_t *dsp_mgr, unsigned int from, unsigned int to)
+{
+	unsigned int i, count = 0;
+
+	for (i = find_next_bit(dsp_mgr->instr_dirty, to, from); i < to;
+	     i = find_next_bit(dsp_mgr->instr_dirty, to, i + 1))
+		count++;
+	return count;
+}
+
+static void ld10k1_dsp_mgr_instr_window_set(ld10k1_dsp_mgr_t *dsp_mgr, unsigned int window)
+{
+	dsp_mgr->instr_window_last = window;
+	if (window > dsp_mgr->instr_window_max)
+		dsp_mgr->instr_window_max = window;
+}
+
+/*
+ * Physical form of every patch and point instruction is cached. Only
+ * instructions marked modified (their register binding changed) are
+ * resolved again. Whole program goes to image in execution order,
+ * instr_offset of patches and points is index in image.
+ */
+static unsigned int ld10k1_dsp_mgr_build_image(ld10k1_dsp_mgr_t *dsp_mgr, ld10k1_instr_t *image)
 {
 	unsigned int i, j, k, l, m, z;
 	unsigned int instr_offset;
 	ld10k1_patch_t *tmpp;
-	ld10k1_instr_t *instr;
+	ld10k1_instr_t *phys;
 	ld10k1_conn_point_t *tmp_point;
-	int allmodified = 0;
 	int found;
-	
+
 	instr_offset = 0;
 
 	/* intruction actualization */
@@ -855,7 +1300,6 @@ int ld10k1_dsp_mgr_actualize_instr(ld10k1_dsp_mgr_t *dsp_mgr)
 			if (m == 0 || m == 2) {
 				/* get all owned points */
 				for (j = 0; j < (m == 0 ? tmpp->in_count : tmpp->out_count); j++) {
-					allmodified = 0;
 					if (m == 0)
 						tmp_point = tmpp->ins[j].point;
 					else
@@ -875,56 +1319,201 @@ int ld10k1_dsp_mgr_actualize_instr(ld10k1_dsp_mgr_t *dsp_mgr)
 						/* if generated - continue */
 						if (found)
 							continue;
-								
-						if (tmp_point->reserved_instr > 0 && tmp_point->out_instr_offset != instr_offset)
-							allmodified = 1;
 
 						tmp_point->out_instr_offset = instr_offset;
 						/* copy instructions */
-						for (k = 0; k < tmp_point->reserved_instr; k++)
-							if (allmodified || tmp_point->out_instr[k].modified) {
-								instr = &(dsp_mgr->instr[k + tmp_point->out_instr_offset]);
-
-								instr->used = 1;
-								instr->modified = 1;
-								instr->op_code = tmp_point->out_instr[k].op_code;
+						for (k = 0; k < tmp_point->reserved_instr; k++) {
+							phys = &(tmp_point->out_phys_instr[k]);
+							if (tmp_point->out_instr[k].modified) {
+								phys->op_code = tmp_point->out_instr[k].op_code;
 								for (l = 0; l < 4; l++)
-									instr->arg[l] = ld10k1_dsp_mgr_get_phys_reg(dsp_mgr, tmp_point->out_instr[k].arg[l]);
+									phys->arg[l] = ld10k1_dsp_mgr_get_phys_reg(dsp_mgr, tmp_point->out_instr[k].arg[l]);
 								tmp_point->out_instr[k].modified = 0;
 							}
+							image[instr_offset + k] = *phys;
+						}
 						instr_offset += tmp_point->reserved_instr;
 					}
 				}
 			} else {
 				/* patch*/
-				allmodified = 0;
-				if (tmpp->instr_offset != instr_offset)
-					allmodified = 1;
-
 				tmpp->instr_offset = instr_offset;
 
-				for (j = 0; j < tmpp->instr_count; j++)
-					if (allmodified || tmpp->instr[j].modified) {
-						instr = &(dsp_mgr->instr[j + tmpp->instr_offset]);
-
-						instr->used = 1;
-						instr->modified = 1;
-						instr->op_code = tmpp->instr[j].op_code;
+				for (j = 0; j < tmpp->instr_count; j++) {
+					phys = &(tmpp->phys_instr[j]);
+					if (tmpp->instr[j].modified) {
+						phys->op_code = tmpp->instr[j].op_code;
 						for (k = 0; k < 4; k++)
-							instr->arg[k] = ld10k1_dsp_mgr_get_phys_reg_for_patch(dsp_mgr, tmpp, tmpp->instr[j].arg[k]);
+							phys->arg[k] = ld10k1_dsp_mgr_get_phys_reg_for_patch(dsp_mgr, tmpp, tmpp->instr[j].arg[k]);
 						tmpp->instr[j].modified = 0;
 					}
+					image[instr_offset + j] = *phys;
+				}
 				instr_offset += tmpp->instr_count;
 			}
 		}
 	}
+	return instr_offset;
+}
+
+/* unconditional skip of count instructions, count is in gpr */
+static void ld10k1_dsp_mgr_stage_skip(ld10k1_dsp_mgr_t *dsp_mgr, unsigned int idx, unsigned int gpr, unsigned int count)
+{
+	ld10k1_instr_t skip;
+
+	skip.op_code = iSKIP;
+	skip.arg[0] = ld10k1_dsp_mgr_get_phys_reg(dsp_mgr, EMU10K1_REG_HW(0));
+	skip.arg[1] = ld10k1_dsp_mgr_get_phys_reg(dsp_mgr, EMU10K1_REG_HW(0));
+	/* 0x7fffffff - test is always true */
+	skip.arg[2] = ld10k1_dsp_mgr_get_phys_reg(dsp_mgr, EMU10K1_REG_HW(15));
+	skip.arg[3] = ld10k1_dsp_mgr_get_phys_reg(dsp_mgr, EMU10K1_REG_NORMAL(gpr));
+	ld10k1_dsp_mgr_instr_set(dsp_mgr, idx, &skip);
+
+	if (dsp_mgr->regs[gpr].val != count) {
+		dsp_mgr->regs[gpr].val = count;
+		ld10k1_dsp_mgr_gpr_changed(dsp_mgr, gpr);
+	}
+}
+
+static void ld10k1_dsp_mgr_stage_init(ld10k1_dsp_mgr_t *dsp_mgr)
+{
+	unsigned int i, gpr;
+
+	/* last gprs hold skip counts */
+	for (i = 0; i < 3; i++) {
+		gpr = dsp_mgr->regs_max_count - 1 - i;
+		clear_bit(gpr, dsp_mgr->gpr_free);
+		dsp_mgr->regs[gpr].used = 1;
+		dsp_mgr->regs[gpr].ref = 1;
+		dsp_mgr->regs[gpr].gpr_usage = GPR_USAGE_NORMAL;
+		dsp_mgr->regs[gpr].val = 0;
+	}
+	dsp_mgr->stage_sel_gpr = dsp_mgr->regs_max_count - 1;
+	dsp_mgr->stage_end_gpr[0] = dsp_mgr->regs_max_count - 2;
+	dsp_mgr->stage_end_gpr[1] = dsp_mgr->regs_max_count - 3;
+
+	/* audigy outputs, which must be written, are initialized at end of code */
+	dsp_mgr->stage_limit = dsp_mgr->instr_count - (dsp_mgr->audigy ? 6 : 0);
+	/* head skip and end skip */
+	dsp_mgr->instr_free = dsp_mgr->stage_limit - 2;
+
+	/* empty program in 1, its end skip only */
+	dsp_mgr->stage_base = 1;
+	dsp_mgr->stage_len = 0;
+	dsp_mgr->stage_bank = 0;
+	dsp_mgr->stage_swaps = 0;
+	dsp_mgr->stage_in_place = 0;
+	ld10k1_dsp_mgr_stage_skip(dsp_mgr, 0, dsp_mgr->stage_sel_gpr, 0);
+	ld10k1_dsp_mgr_stage_skip(dsp_mgr, 1, dsp_mgr->stage_end_gpr[0], dsp_mgr->stage_limit - 2);
+}
+
+/*
+ * New program is written where the running one is skipped - before it
+ * or after its end skip - and started by changing count of head skip.
+ * DSP never runs mix of old and new code. Only when there is no place
+ * for both programs, the running one is rewritten.
+ */
+static int ld10k1_dsp_mgr_stage_instr(ld10k1_dsp_mgr_t *dsp_mgr, ld10k1_instr_t *image, unsigned int len)
+{
+	unsigned int run_start, run_end, start, bank, j;
+	ld10k1_instr_t *instr;
+	int err;
+
+	run_start = dsp_mgr->stage_base;
+	run_end = run_start + dsp_mgr->stage_len + 1;
+
+	/* same code - only registers and tram changed */
+	if (len == dsp_mgr->stage_len) {
+		for (j = 0; j < len; j++)
+			if (!ld10k1_instr_same(&(dsp_mgr->instr[run_start + j]), &image[j]))
+				break;
+		if (j >= len) {
+			ld10k1_dsp_mgr_instr_window_set(dsp_mgr, 0);
+			return ld10k1_update_driver(dsp_mgr);
+		}
+	}
+
+	if (1 + len + 1 <= run_start)
+		start = 1;
+	else if (run_end + len + 1 <= dsp_mgr->stage_limit)
+		start = run_end;
+	else {
+		start = 1;
+		dsp_mgr->stage_in_place++;
+	}
+	bank = dsp_mgr->stage_bank ^ 1;
+
+	for (j = 0; j < len; j++)
+		ld10k1_dsp_mgr_instr_set(dsp_mgr, start + j, &image[j]);
+	ld10k1_dsp_mgr_stage_skip(dsp_mgr, start + len, dsp_mgr->stage_end_gpr[bank],
+		dsp_mgr->stage_limit - (start + len + 1));
+
+	/* rest is skipped, but running code until switch */
+	for (j = 1; j < dsp_mgr->stage_limit; j++) {
+		if ((j >= start && j <= start + len) || (j >= run_start && j < run_end))
+			continue;
+		instr = &(dsp_mgr->instr[j]);
+		if (instr->used) {
+			instr->used = 0;
+			instr->dead = 1;
+		}
+	}
+	/* audigy output initialization is placed again by driver */
+	for (j = dsp_mgr->stage_limit; j < dsp_mgr->instr_count; j++) {
+		if (dsp_mgr->instr[j].used) {
+			ld10k1_dsp_mgr_instr_changed(dsp_mgr, j);
+			dsp_mgr->instr[j].used = 0;
+		}
+	}
+
+	ld10k1_dsp_mgr_instr_window_set(dsp_mgr, ld10k1_dsp_mgr_instr_window(dsp_mgr, run_start, run_end));
+	if ((err = ld10k1_update_driver(dsp_mgr)) < 0)
+		return err;
+
+	for (j = run_start; j < run_end; j++) {
+		if (j >= start && j <= start + len)
+			continue;
+		instr = &(dsp_mgr->instr[j]);
+		if (instr->used) {
+			instr->used = 0;
+			instr->dead = 1;
+		}
+	}
+	dsp_mgr->stage_base = start;
+	dsp_mgr->stage_len = len;
+	dsp_mgr->stage_bank = bank;
+	dsp_mgr->stage_swaps++;
+
+	/* switch */
+	ld10k1_dsp_mgr_stage_skip(dsp_mgr, 0, dsp_mgr->stage_sel_gpr, start - 1);
+	return ld10k1_update_driver(dsp_mgr);
+}
+
+static LD10K1_CARD_STATE ld10k1_instr_t instr_image[MAX_INSTR_COUNT];
 
-	for (j = instr_offset; j < dsp_mgr->instr_count; j++) {
+int ld10k1_dsp_mgr_actualize_instr(ld10k1_dsp_mgr_t *dsp_mgr)
+{
+	unsigned int j, len;
+
+	/* inside of transaction everything is placed once at commit */
+	if (dsp_mgr->transaction)
+		return 0;
+
+	len = ld10k1_dsp_mgr_build_image(dsp_mgr, instr_image);
+	if (dsp_mgr->staged)
+		return ld10k1_dsp_mgr_stage_instr(dsp_mgr, instr_image, len);
+
+	for (j = 0; j < len; j++)
+		ld10k1_dsp_mgr_instr_set(dsp_mgr, j, &instr_image[j]);
+
+	for (j = len; j < dsp_mgr->instr_count; j++) {
 		if (dsp_mgr->instr[j].used) {
-			dsp_mgr->instr[j].modified = 1;
+			ld10k1_dsp_mgr_instr_changed(dsp_mgr, j);
 			dsp_mgr->instr[j].used = 0;
 		}
 	}
+	/* everything runs, every change is rewritten in place */
+	ld10k1_dsp_mgr_instr_window_set(dsp_mgr, ld10k1_dsp_mgr_instr_window(dsp_mgr, 0, dsp_mgr->instr_count));
 	return ld10k1_update_driver(dsp_mgr);
 }
 
@@ -948,18 +1537,284 @@ void ld10k1_dsp_mgr_actualize_order(ld10k1_dsp_mgr_t *dsp_mgr)
 		dsp_mgr->patch_ptr[dsp_mgr->patch_order[i]]->order = i;
 }
 
+static int ld10k1_patch_reg_is_zero(ld10k1_patch_t *patch, unsigned int arg)
+{
+	switch (EMU10K1_PREG_TYPE_B(arg)) {
+		case EMU10K1_PREG_TYPE_CONST:
+			return patch->consts[arg & 0xFFFFFFF].const_val == 0;
+		case EMU10K1_PREG_TYPE_HW:
+			return patch->hws[arg & 0xFFFFFFF].reg_idx == EMU10K1_NREG_CONST_00000000;
+		default:
+			return 0;
+	}
+}
+
+/*
+ * register which keeps its value inside one pass, if nothing writes it -
+ * not in or out, connection can give both of them the same gpr
+ */
+static int ld10k1_patch_reg_is_stable(unsigned int arg)
+{
+	switch (EMU10K1_PREG_TYPE_B(arg)) {
+		case EMU10K1_PREG_TYPE_CONST:
+		case EMU10K1_PREG_TYPE_STA:
+		case EMU10K1_PREG_TYPE_DYN:
+		case EMU10K1_PREG_TYPE_CTL:
+			return 1;
+		default:
+			return 0;
+	}
+}
+
+static int ld10k1_patch_instr_is_copy(ld10k1_patch_t *patch, ld10k1_instr_t *instr)
+{
+	return instr->op_code == iACC3 &&
+		ld10k1_patch_reg_is_zero(patch, instr->arg[2]) &&
+		ld10k1_patch_reg_is_zero(patch, instr->arg[3]);
+}
+
+static void ld10k1_patch_instr_del(ld10k1_patch_t *patch, unsigned int idx)
+{
+	memmove(&(patch->instr[idx]), &(patch->instr[idx + 1]),
+		sizeof(ld10k1_instr_t) * (patch->instr_count - idx - 1));
+	patch->instr_count--;
+}
+
+/*
+ * Peephole pass over patch code run before load. Multiply by zero is
+ * turned to copy, copy to itself is dropped, copy to dyn register is
+ * forwarded to its readers and results written to dyn registers which are
+ * never read are dropped. Dyns are temporaries, so only they can vanish.
+ * Code using skip, accumulator or ccr is left untouched, because dropped
+ * instruction could change them. Returns count of removed instructions.
+ */
+static unsigned int ld10k1_patch_optimize(ld10k1_patch_t *patch)
+{
+	unsigned int i, j, k, l, last;
+	unsigned int removed = 0;
+	ld10k1_instr_t *instr;
+	unsigned int arg, dst, src;
+	int changed, used;
+
+	for (i = 0; i < patch->instr_count; i++) {
+		instr = &(patch->instr[i]);
+		if (instr->op_code == iSKIP || instr->op_code == iMACMV)
+			return 0;
+		for (k = 0; k < 4; k++) {
+			arg = instr->arg[k];
+			if (EMU10K1_PREG_TYPE_B(arg) == EMU10K1_PREG_TYPE_HW &&
+				(patch->hws[arg & 0xFFFFFFF].reg_idx == EMU10K1_NREG_HW_ACCUM ||
+				patch->hws[arg & 0xFFFFFFF].reg_idx == EMU10K1_NREG_HW_CCR))
+				return 0;
+		}
+	}
+
+	do {
+		changed = 0;
+		for (i = 0; i < patch->instr_count; i++) {
+			instr = &(patch->instr[i]);
+
+			/* R = A + X * Y with zero X or Y */
+			if (instr->op_code <= iMACINT1 &&
+				(ld10k1_patch_reg_is_zero(patch, instr->arg[2]) ||
+				ld10k1_patch_reg_is_zero(patch, instr->arg[3]))) {
+				if (ld10k1_patch_reg_is_zero(patch, instr->arg[2]))
+					instr->arg[3] = instr->arg[2];
+				else
+					instr->arg[2] = instr->arg[3];
+				instr->op_code = iACC3;
+			}
+
+			dst = instr->arg[0];
+			src = instr->arg[1];
+
+			/* R = R */
+			if (ld10k1_patch_instr_is_copy(patch, instr) && dst == src) {
+				ld10k1_patch_instr_del(patch, i);
+				removed++;
+				changed = 1;
+				break;
+			}
+
+			if (EMU10K1_PREG_TYPE_B(dst) != EMU10K1_PREG_TYPE_DYN)
+				continue;
+
+			/* find readers and other writers of dyn */
+			used = 0;
+			last = i;
+			for (j = 0; j < patch->instr_count; j++) {
+				if (j != i && patch->instr[j].arg[0] == dst)
+					break;
+				for (k = 1; k < 4; k++)
+					if (patch->instr[j].arg[k] == dst) {
+						if (j < i)
+							break;
+						used = 1;
+						last = j;
+					}
+				if (k < 4)
+					break;
+			}
+			/* written more times or read before written */
+			if (j < patch->instr_count)
+				continue;
+
+			/* result nobody reads */
+			if (!used) {
+				ld10k1_patch_instr_del(patch, i);
+				removed++;
+				changed = 1;
+				break;
+			}
+
+			/* D = A, forward A when it is not changed before last read */
+			if (!ld10k1_patch_instr_is_copy(patch, instr) || !ld10k1_patch_reg_is_stable(src))
+				continue;
+			for (j = i + 1; j < last; j++)
+				if (patch->instr[j].arg[0] == src)
+					break;
+			if (j < last)
+				continue;
+
+			for (j = i + 1; j <= last; j++)
+				for (l = 1; l < 4; l++)
+					if (patch->instr[j].arg[l] == dst)
+						patch->instr[j].arg[l] = src;
+			ld10k1_patch_instr_del(patch, i);
+			removed++;
+			changed = 1;
+			break;
+		}
+	} while (changed);
+
+	return removed;
+}
+
+/*
+ * Dyn registers are temporaries of one patch, so two of them can use the
+ * same gpr when their live ranges in patch code don't overlap. Instruction
+ * j reads at 2 * j and writes at 2 * j + 1, so a result can go to gpr
+ * of an argument read last time. Ranges are colored greedily in order of
+ * start. Returns number of gprs needed, color holds gpr for every dyn.
+ */
+static unsigned int ld10k1_dyn_color(ld10k1_patch_t *patch, unsigned int *color)
+{
+	int start[256];
+	int end[256];
+	int color_end[256];
+	unsigned int order[256];
+	unsigned int i, j, k, c, count, colors;
+	unsigned int arg;
+	int pos;
+
+	/* skip can jump over a write - keep every dyn in own gpr */
+	for (j = 0; j < patch->instr_count; j++)
+		if (patch->instr[j].op_code == iSKIP) {
+			for (i = 0; i < patch->dyn_count; i++)
+				color[i] = i;
+			return patch->dyn_count;
+		}
+
+	for (i = 0; i < patch->dyn_count; i++) {
+		start[i] = -1;
+		end[i] = -1;
+		color[i] = 0;
+	}
+
+	for (j = 0; j < patch->instr_count; j++)
+		for (k = 0; k < 4; k++) {
+			arg = patch->instr[j].arg[k];
+			if (EMU10K1_PREG_TYPE_B(arg) != EMU10K1_PREG_TYPE_DYN)
+				continue;
+			i = arg & 0xFFFFFFF;
+			pos = 2 * j + (k == 0 ? 1 : 0);
+			if (start[i] < 0 || pos < start[i])
+				start[i] = pos;
+			if (pos > end[i])
+				end[i] = pos;
+		}
+
+	/* used dyns sorted by start */
+	for (i = 0, count = 0; i < patch->dyn_count; i++) {
+		if (start[i] < 0)
+			continue;
+		for (k = count; k > 0 && start[order[k - 1]] > start[i]; k--)
+			order[k] = order[k - 1];
+		order[k] = i;
+		count++;
+	}
+
+	colors = 0;
+	for (k = 0; k < count; k++) {
+		i = order[k];
+		for (c = 0; c < colors; c++)
+			if (color_end[c] < start[i])
+				break;
+		if (c == colors)
+			colors++;
+		color[i] = c;
+		color_end[c] = end[i];
+	}
+
+	/* not used dyns still need some gpr */
+	if (!colors && patch->dyn_count)
+		colors = 1;
+	return colors;
+}
+
+/* patches are chained by slot, names are unique only by convention */
+void ld10k1_patch_name_hash_add(ld10k1_dsp_mgr_t *dsp_mgr, int idx)
+{
+	ld10k1_patch_t *patch = dsp_mgr->patch_ptr[idx];
+	unsigned int h;
+
+	if (!patch->patch_name)
+		return;
+	h = ld10k1_name_hash(patch->patch_name);
+	patch->name_hash_next = dsp_mgr->patch_name_hash[h];
+	dsp_mgr->patch_name_hash[h] = idx;
+}
+
+void ld10k1_patch_name_hash_del(ld10k1_dsp_mgr_t *dsp_mgr, int idx)
+{
+	ld10k1_patch_t *patch = dsp_mgr->patch_ptr[idx];
+	int *hidx;
+
+	if (!patch->patch_name)
+		return;
+	for (hidx = &(dsp_mgr->patch_name_hash[ld10k1_name_hash(patch->patch_name)]); *hidx >= 0;
+		hidx = &(dsp_mgr->patch_ptr[*hidx]->name_hash_next))
+		if (*hidx == idx) {
+			*hidx = patch->name_hash_next;
+			break;
+		}
+	patch->name_hash_next = -1;
+}
+
+/* lowest slot wins, as with linear search */
+int ld10k1_patch_find(ld10k1_dsp_mgr_t *dsp_mgr, const char *name)
+{
+	int i, ret = -1;
+
+	for (i = dsp_mgr->patch_name_hash[ld10k1_name_hash(name)]; i >= 0;
+		i = dsp_mgr->patch_ptr[i]->name_hash_next)
+		if (strcmp(dsp_mgr->patch_ptr[i]->patch_name, name) == 0 &&
+			(ret < 0 || i < ret))
+			ret = i;
+	return ret;
+}
+
 int ld10k1_dsp_mgr_patch_load(ld10k1_dsp_mgr_t *dsp_mgr, ld10k1_patch_t *patch, int before, int *loaded)
 {
 	/* check if i can add patch */
 	int pp, i, j;
 	int err;
 
-	int res[MAX_GPR_COUNT];
-	int res_count = 0;
-	int max_res_count = MAX_GPR_COUNT;
-	int const_res[MAX_CONST_COUNT];
-	int const_res_count = 0;
-	int max_const_res_count = MAX_CONST_COUNT;
+	ld10k1_reg_res_t res;
+	ld10k1_reg_res_t const_res;
+	unsigned int dyn_color[256];
+	unsigned int dyn_gpr[256];
+	unsigned int dyn_gpr_count;
 
 	unsigned int reserved;
 	
@@ -983,9 +1838,14 @@ int ld10k1_dsp_mgr_patch_load(ld10k1_dsp_mgr_t *dsp_mgr, ld10k1_patch_t *patch,
 	if (before > dsp_mgr->patch_count)
 		before =  dsp_mgr->patch_count;
 
+	ld10k1_reg_res_init(&res);
+	ld10k1_reg_res_init(&const_res);
+
+	patch->instr_removed += ld10k1_patch_optimize(patch);
+
 	/* static */
 	for (i = 0; i < patch->sta_count; i++) {
-		reserved = ld10k1_gpr_reserve(dsp_mgr, max_res_count, &res_count, res, GPR_USAGE_NORMAL, patch->stas[i].const_val);
+		reserved = ld10k1_gpr_reserve(dsp_mgr, &res, GPR_USAGE_NORMAL, patch->stas[i].const_val);
 		if (!reserved)
 			return LD10K1_ERR_NOT_FREE_REG;
 		patch->stas[i].gpr_idx = reserved;
@@ -995,20 +1855,23 @@ int ld10k1_dsp_mgr_patch_load(ld10k1_dsp_mgr_t *dsp_mgr, ld10k1_patch_t *patch,
 	for (i = 0; i < patch->const_count; i++) {
 		
 		/* try allocate */
-		reserved = ld10k1_const_reserve(dsp_mgr, max_const_res_count, &const_res_count, const_res,
-			max_res_count, &res_count, res, patch->consts[i].const_val);
+		reserved = ld10k1_const_reserve(dsp_mgr, &const_res, &res, patch->consts[i].const_val);
 		if (reserved == 0)
 			return LD10K1_ERR_NOT_FREE_REG;
 		patch->consts[i].gpr_idx = reserved;
 	}
 
 	/* dynamic */
-	for (i = 0; i < patch->dyn_count; i++) {
-		reserved = ld10k1_gpr_dyn_reserve(dsp_mgr, max_res_count, &res_count, res);
+	dyn_gpr_count = ld10k1_dyn_color(patch, dyn_color);
+	for (i = 0; i < dyn_gpr_count; i++) {
+		reserved = ld10k1_gpr_dyn_reserve(dsp_mgr, &res);
 		if (!reserved)
 			return LD10K1_ERR_NOT_FREE_REG;
-		patch->dyns[i].gpr_idx = reserved;
+		dyn_gpr[i] = reserved;
 	}
+	for (i = 0; i < patch->dyn_count; i++)
+		patch->dyns[i].gpr_idx = dyn_gpr[dyn_color[i]];
+	patch->dyn_gpr_count = dyn_gpr_count;
 
 	/* hw */
 	for (i = 0; i < patch->hw_count; i++)
@@ -1017,8 +1880,7 @@ int ld10k1_dsp_mgr_patch_load(ld10k1_dsp_mgr_t *dsp_mgr, ld10k1_patch_t *patch,
 	/* ctl regs */
 	for (i = 0; i < patch->ctl_count; i++) {
 		for (j = 0; j < patch->ctl[i].count; j++) {
-			reserved = ld10k1_gpr_reserve(dsp_mgr, max_res_count, &res_count, res,
-				GPR_USAGE_NORMAL, patch->ctl[i].value[j]);
+			reserved = ld10k1_gpr_reserve(dsp_mgr, &res, GPR_USAGE_NORMAL, patch->ctl[i].value[j]);
 			if (!reserved)
 				return LD10K1_ERR_NOT_FREE_REG;
 			patch->ctl[i].gpr_idx[j] = reserved;
@@ -1059,17 +1921,18 @@ int ld10k1_dsp_mgr_patch_load(ld10k1_dsp_mgr_t *dsp_mgr, ld10k1_patch_t *patch,
 	dsp_mgr->patch_count++;
 
 	dsp_mgr->patch_ptr[pp] = patch;
+	ld10k1_patch_name_hash_add(dsp_mgr, pp);
 	loaded[0] = pp;
 
 	patch->id = ld10k1_gen_patch_id(dsp_mgr, pp);
 	loaded[1] = patch->id;
 
 	/* allocate registers */
-	for (i = 0; i < const_res_count; i++)
-		ld10k1_const_alloc(dsp_mgr, const_res[i]);
+	for (i = 0; i < const_res.count; i++)
+		ld10k1_const_alloc(dsp_mgr, const_res.idx[i]);
 
-	for (i = 0; i < res_count; i++)
-		ld10k1_gpr_alloc(dsp_mgr, res[i]);
+	for (i = 0; i < res.count; i++)
+		ld10k1_gpr_alloc(dsp_mgr, res.idx[i]);
 
 	/* actualize tram */
 	if (patch->tram_count > 0)
@@ -1099,9 +1962,14 @@ int ld10k1_dsp_mgr_patch_unload(ld10k1_dsp_mgr_t *dsp_mgr, ld10k1_patch_t *patch
 		if (patch->outs[i].point)
 			ld10k1_conn_point_del(dsp_mgr, patch->outs[i].point, CON_IO_POUT, patch, i);
 
-	/* free dyn registers */
-	for (i = 0; i < patch->dyn_count; i++)
-		ld10k1_gpr_free(dsp_mgr, patch->dyns[i].gpr_idx);
+	/* free dyn registers, shared one only once */
+	for (i = 0; i < patch->dyn_count; i++) {
+		for (j = 0; j < i; j++)
+			if (patch->dyns[j].gpr_idx == patch->dyns[i].gpr_idx)
+				break;
+		if (j == i)
+			ld10k1_gpr_free(dsp_mgr, patch->dyns[i].gpr_idx);
+	}
 
 	/* free sta registers */
 	for (i = 0; i < patch->sta_count; i++)
@@ -1129,17 +1997,18 @@ int ld10k1_dsp_mgr_patch_unload(ld10k1_dsp_mgr_t *dsp_mgr, ld10k1_patch_t *patch
 	/* free from registers */
 	for (i = 0; i < dsp_mgr->patch_count; i++)
 		if (dsp_mgr->patch_order[i] == idx)
-			for (;i < dsp_mgr->patch_count; i++)
+			for (;i < dsp_mgr->patch_count - 1; i++)
 				dsp_mgr->patch_order[i] = dsp_mgr->patch_order[i + 1];
+	ld10k1_patch_name_hash_del(dsp_mgr, idx);
 	dsp_mgr->patch_ptr[idx] = NULL;
 
-	/* free from mem */
-	ld10k1_dsp_mgr_patch_free(patch);
-
 	/* decrement patch count */
 	dsp_mgr->patch_count--;
 	dsp_mgr->instr_free += patch->instr_count;
 
+	/* free from mem */
+	ld10k1_dsp_mgr_patch_free(patch);
+
 	ld10k1_dsp_mgr_actualize_order(dsp_mgr);
 	/* actualize instructons */
 	return ld10k1_dsp_mgr_actualize_instr(dsp_mgr);
@@ -1421,8 +2290,10 @@ int ld10k1_connection_fnc(ld10k1_dsp_mgr_t *dsp_mgr, ld10k1_fnc_connection_t *co
 			}
 		}
 
-		if (tmp_point->id <= 0)
+		if (tmp_point->id <= 0) {
 			tmp_point->id = ld10k1_gen_patch_id(dsp_mgr, connection_fnc->from_patch);
+			ld10k1_conn_point_hash_add(dsp_mgr, tmp_point);
+		}
 			
 		*conn_id = tmp_point->id;
 		
@@ -1469,38 +2340,65 @@ int ld10k1_connection_fnc(ld10k1_dsp_mgr_t *dsp_mgr, ld10k1_fnc_connection_t *co
 		return LD10K1_ERR_CONNECTION_FNC;
 }
 
-ld10k1_ctl_list_item_t *ld10k1_look_control_from_list(ld10k1_ctl_list_item_t *list, ld10k1_ctl_t *gctl)
+/* FNV-1a folded to LD10K1_NAME_HASH_BITS */
+unsigned int ld10k1_name_hash(const char *name)
+{
+	unsigned int h = 2166136261U;
+
+	while (*name) {
+		h ^= (unsigned char)*name++;
+		h *= 16777619U;
+	}
+	return (h ^ (h >> LD10K1_NAME_HASH_BITS) ^ (h >> 2 * LD10K1_NAME_HASH_BITS)) & (LD10K1_NAME_HASH_SIZE - 1);
+}
+
+void ld10k1_ctl_list_init(ld10k1_ctl_list_t *list)
+{
+	memset(list, 0, sizeof(*list));
+}
+
+/* controls are hashed by name only, all indexes of one name share chain */
+static void ld10k1_ctl_list_hash_add(ld10k1_ctl_list_t *list, ld10k1_ctl_list_item_t *item)
+{
+	unsigned int h = ld10k1_name_hash(item->ctl.name);
+
+	item->hash_next = list->hash[h];
+	list->hash[h] = item;
+}
+
+ld10k1_ctl_list_item_t *ld10k1_look_control_from_list(ld10k1_ctl_list_t *list, ld10k1_ctl_t *gctl)
 {
 	ld10k1_ctl_list_item_t *item;
 
-	for (item = list; item != NULL; item = item->next)
-		if (strcmp(item->ctl.name, gctl->name) == 0 && item->ctl.index == gctl->index)
+	for (item = list->hash[ld10k1_name_hash(gctl->name)]; item != NULL; item = item->hash_next)
+		if (item->ctl.index == gctl->index && strcmp(item->ctl.name, gctl->name) == 0)
 			return item;
 
 	return NULL;
 }
 
-int ld10k1_add_control_to_list(ld10k1_ctl_list_item_t **list, int *count, ld10k1_ctl_t *gctl)
+int ld10k1_add_control_to_list(ld10k1_ctl_list_t *list, ld10k1_ctl_t *gctl)
 {
 	ld10k1_ctl_list_item_t *item;
 	
-	item = ld10k1_look_control_from_list(*list, gctl);
+	item = ld10k1_look_control_from_list(list, gctl);
 	if (!item) {
 		item = (ld10k1_ctl_list_item_t *)malloc(sizeof(ld10k1_ctl_list_item_t));
 		if (!item)
 			return LD10K1_ERR_NO_MEM;
 
-		item->next = NULL;
+		memcpy(&(item->ctl), gctl, sizeof(*gctl));
 
-		if (!*list)
-			/* empty */
-			*list = item;
-		else {
-			/* add to begining */
-			item->next = *list;
-			*list = item;
-		}
-		(*count)++;
+		/* add to begining */
+		item->prev = NULL;
+		item->next = list->first;
+		if (list->first)
+			list->first->prev = item;
+		list->first = item;
+
+		ld10k1_ctl_list_hash_add(list, item);
+		list->count++;
+		return 0;
 	}
 
 	memcpy(&(item->ctl), gctl, sizeof(*gctl));
@@ -1508,45 +2406,42 @@ int ld10k1_add_control_to_list(ld10k1_ctl_list_item_t **list, int *count, ld10k1
 	return 0;
 }
 
-void ld10k1_del_control_from_list(ld10k1_ctl_list_item_t **list, int *count, ld10k1_ctl_t *gctl)
+void ld10k1_del_control_from_list(ld10k1_ctl_list_t *list, ld10k1_ctl_t *gctl)
 {
 	ld10k1_ctl_list_item_t *item;
-	ld10k1_ctl_list_item_t *item1;
+	ld10k1_ctl_list_item_t **hitem;
 
-	if (!*list)
-		return;
-
-	item = ld10k1_look_control_from_list(*list, gctl);
+	item = ld10k1_look_control_from_list(list, gctl);
 	if (!item)
 		return;
-		
-	if (*list == item) {
-		*list = item->next;
-	} else {
-		for (item1 = *list; item1->next != NULL; item1 = item1->next)
-			if (item1->next == item) {
-				item1->next = item->next;
-				break;
-			}
-	}
+
+	for (hitem = &(list->hash[ld10k1_name_hash(item->ctl.name)]); *hitem != item; hitem = &((*hitem)->hash_next))
+		;
+	*hitem = item->hash_next;
+
+	if (item->prev)
+		item->prev->next = item->next;
+	else
+		list->first = item->next;
+	if (item->next)
+		item->next->prev = item->prev;
 
 	free(item);
-	(*count)--;
+	list->count--;
 }
 
-void ld10k1_del_all_controls_from_list(ld10k1_ctl_list_item_t **list, int *count)
+void ld10k1_del_all_controls_from_list(ld10k1_ctl_list_t *list)
 {
 	ld10k1_ctl_list_item_t *item;
 	ld10k1_ctl_list_item_t *item1;
 	
-	for (item = *list; item != NULL;) {
+	for (item = list->first; item != NULL;) {
 		item1 = item->next;
 		free(item);
 		item = item1;
 	}
 	
-	*count = 0;
-	*list = NULL;
+	ld10k1_ctl_list_init(list);
 }
 
 int ld10k1_get_used_index_for_control(ld10k1_dsp_mgr_t *dsp_mgr, ld10k1_ctl_t *gctl, int **idxs, int *cnt)
@@ -1556,16 +2451,17 @@ int ld10k1_get_used_index_for_control(ld10k1_dsp_mgr_t *dsp_mgr, ld10k1_ctl_t *g
 	ld10k1_reserved_ctl_list_item_t *itemr;
 	int count;
 	int *index_list;
+	unsigned int h = ld10k1_name_hash(gctl->name);
 
 	count = 0;
 	i = 0;
 	
 	/* first get count */
-	for (item = dsp_mgr->ctl_list; item != NULL; item = item->next)
+	for (item = dsp_mgr->ctl_list.hash[h]; item != NULL; item = item->hash_next)
 		if (strcmp(item->ctl.name, gctl->name) == 0)
 			count++;
 			
-	for (item = dsp_mgr->add_ctl_list; item != NULL; item = item->next)
+	for (item = dsp_mgr->add_ctl_list.hash[h]; item != NULL; item = item->hash_next)
 		if (strcmp(item->ctl.name, gctl->name) == 0)
 			count++;
 			
@@ -1584,11 +2480,11 @@ int ld10k1_get_used_index_for_control(ld10k1_dsp_mgr_t *dsp_mgr, ld10k1_ctl_t *g
 	if (!index_list)
 		return LD10K1_ERR_NO_MEM;
 		
-	for (item = dsp_mgr->ctl_list; item != NULL; item = item->next)
+	for (item = dsp_mgr->ctl_list.hash[h]; item != NULL; item = item->hash_next)
 		if (strcmp(item->ctl.name, gctl->name) == 0)
 			index_list[i++] = item->ctl.index;
 	
-	for (item = dsp_mgr->add_ctl_list; item != NULL; item = item->next)
+	for (item = dsp_mgr->add_ctl_list.hash[h]; item != NULL; item = item->hash_next)
 		if (strcmp(item->ctl.name, gctl->name) == 0)
 			index_list[i++] = item->ctl.index;
 	
@@ -1644,32 +2540,33 @@ int ld10k1_add_control(ld10k1_dsp_mgr_t *dsp_mgr, ld10k1_ctl_t *gctl)
 	else
 		gctl->index = gctl->want_index;
 	
-	/* is there control ??? */
-	if (ld10k1_look_control_from_list(dsp_mgr->ctl_list, gctl))
+	/* is there control ??? - one waiting for delete can be added again */
+	if (ld10k1_look_control_from_list(&(dsp_mgr->ctl_list), gctl) &&
+		!ld10k1_look_control_from_list(&(dsp_mgr->del_ctl_list), gctl))
 		return LD10K1_ERR_CTL_EXISTS;
 	/* is for add ??? */
-	if (ld10k1_look_control_from_list(dsp_mgr->add_ctl_list, gctl))
+	if (ld10k1_look_control_from_list(&(dsp_mgr->add_ctl_list), gctl))
 		return 0;
 
 	/* add */
-	return ld10k1_add_control_to_list(&(dsp_mgr->add_ctl_list), &(dsp_mgr->add_list_count), gctl);
+	return ld10k1_add_control_to_list(&(dsp_mgr->add_ctl_list), gctl);
 }
 
 void ld10k1_del_control(ld10k1_dsp_mgr_t *dsp_mgr, ld10k1_ctl_t *gctl)
 {
 	/* is for add ??? */
-	if (ld10k1_look_control_from_list(dsp_mgr->add_ctl_list, gctl)) {
-		ld10k1_del_control_from_list(&(dsp_mgr->add_ctl_list), &(dsp_mgr->add_list_count), gctl);
+	if (ld10k1_look_control_from_list(&(dsp_mgr->add_ctl_list), gctl)) {
+		ld10k1_del_control_from_list(&(dsp_mgr->add_ctl_list), gctl);
 		return;
 	}
 	
 	/* is for del ??? */
-	if (ld10k1_look_control_from_list(dsp_mgr->del_ctl_list, gctl))
+	if (ld10k1_look_control_from_list(&(dsp_mgr->del_ctl_list), gctl))
 		return;
 
 	/* delete ??? */
-	if (ld10k1_look_control_from_list(dsp_mgr->ctl_list, gctl)) {
-		ld10k1_add_control_to_list(&(dsp_mgr->del_ctl_list), &(dsp_mgr->del_list_count), gctl);
+	if (ld10k1_look_control_from_list(&(dsp_mgr->ctl_list), gctl)) {
+		ld10k1_add_control_to_list(&(dsp_mgr->del_ctl_list), gctl);
 		return;
 	}
 	return;
@@ -1798,130 +2695,167 @@ unsigned int ld10k1_resolve_named_reg(ld10k1_dsp_mgr_t *dsp_mgr, unsigned int re
 	return 0;
 }
 
-unsigned int ld10k1_gpr_reserve(ld10k1_dsp_mgr_t *dsp_mgr, int max_res_count, int *res_count, int *res,
-	unsigned int usage, unsigned int val)
+static void ld10k1_reg_res_init(ld10k1_reg_res_t *res)
 {
-	int i, j;
-	if (*res_count >= max_res_count)
-		return 0;
+	res->count = 0;
+	memset(res->map, 0, sizeof(res->map));
+}
 
-	for (i = 0; i < dsp_mgr->regs_max_count; i++) {
-		if (!dsp_mgr->regs[i].used) {
-			/* check in reserved */
-			for (j = 0; j < *res_count; j++) {
-				if (res[j] == i)
-					break;
-			}
+static void ld10k1_reg_res_add(ld10k1_reg_res_t *res, int idx)
+{
+	res->idx[res->count++] = idx;
+	set_bit(idx, res->map);
+}
 
-			if (j >= *res_count) {
-				res[*res_count] = i;
-				(*res_count)++;
-				dsp_mgr->regs[i].gpr_usage = usage;
-				dsp_mgr->regs[i].val = val;
-				return EMU10K1_REG_NORMAL(i);
-			}
+/* first index set in map and not reserved, -1 if there is none */
+static int ld10k1_reg_res_find(ld10k1_reg_res_t *res, unsigned long *map, unsigned int size)
+{
+	unsigned int bits = sizeof(unsigned long) * 8;
+	unsigned long word;
+	unsigned int w, i;
+
+	for (w = 0; w * bits < size; w++) {
+		word = map[w] & ~res->map[w];
+		if (word) {
+			for (i = w * bits; !(word & 1); i++)
+				word >>= 1;
+			return i < size ? (int)i : -1;
 		}
 	}
-	return 0;
+	return -1;
 }
 
-unsigned int ld10k1_gpr_dyn_reserve(ld10k1_dsp_mgr_t *dsp_mgr, int max_res_count, int *res_count, int *res)
+unsigned int ld10k1_gpr_reserve(ld10k1_dsp_mgr_t *dsp_mgr, ld10k1_reg_res_t *res,
+	unsigned int usage, unsigned int val)
 {
-	int i, j;
-	if (*res_count >= max_res_count)
+	int i;
+	if (res->count >= MAX_CONST_COUNT)
 		return 0;
 
-	/* try find other dyn not reserved */
-	for (i = 0; i < dsp_mgr->regs_max_count; i++) {
-		if (dsp_mgr->regs[i].used && dsp_mgr->regs[i].gpr_usage == GPR_USAGE_DYNAMIC) {
-			/* check in reserved */
-			for (j = 0; j < *res_count; j++) {
-				if (res[j] == i)
-					break;
-			}
+	i = ld10k1_reg_res_find(res, dsp_mgr->gpr_free, dsp_mgr->regs_max_count);
+	if (i < 0)
+		return 0;
 
-			if (j >= *res_count) {
-				res[*res_count] = i;
-				(*res_count)++;
-				dsp_mgr->regs[i].gpr_usage = GPR_USAGE_DYNAMIC;
-				dsp_mgr->regs[i].val = 0;
-				return EMU10K1_REG_NORMAL(i);
-			}
-		}
+	ld10k1_reg_res_add(res, i);
+	dsp_mgr->regs[i].gpr_usage = usage;
+	dsp_mgr->regs[i].val = val;
+	return EMU10K1_REG_NORMAL(i);
+}
+
+unsigned int ld10k1_gpr_dyn_reserve(ld10k1_dsp_mgr_t *dsp_mgr, ld10k1_reg_res_t *res)
+{
+	int i;
+	if (res->count >= MAX_CONST_COUNT)
+		return 0;
+
+	/* try find other dyn not reserved */
+	i = ld10k1_reg_res_find(res, dsp_mgr->gpr_dyn, dsp_mgr->regs_max_count);
+	if (i >= 0) {
+		ld10k1_reg_res_add(res, i);
+		dsp_mgr->regs[i].gpr_usage = GPR_USAGE_DYNAMIC;
+		dsp_mgr->regs[i].val = 0;
+		return EMU10K1_REG_NORMAL(i);
 	}
 
 	/* not found - try normal */
-	return ld10k1_gpr_reserve(dsp_mgr, max_res_count, res_count, res, GPR_USAGE_DYNAMIC, 0);
+	return ld10k1_gpr_reserve(dsp_mgr, res, GPR_USAGE_DYNAMIC, 0);
 }
 
 void ld10k1_gpr_alloc(ld10k1_dsp_mgr_t *dsp_mgr, int reg)
 {
 	int i = reg & 0x0FFFFFFF;
 	dsp_mgr->regs[i].ref++;
-	dsp_mgr->regs[i].modified = 1;
+	ld10k1_dsp_mgr_gpr_changed(dsp_mgr, i);
 	dsp_mgr->regs[i].used = 1;
+	clear_bit(i, dsp_mgr->gpr_free);
+	if (dsp_mgr->regs[i].gpr_usage == GPR_USAGE_DYNAMIC)
+		set_bit(i, dsp_mgr->gpr_dyn);
 }
 
 void ld10k1_gpr_free(ld10k1_dsp_mgr_t *dsp_mgr, int reg)
 {
 	int i = reg & 0x0FFFFFFF;
+	/* dynamic gprs are shared between patches */
+	if (dsp_mgr->regs[i].ref > 1) {
+		dsp_mgr->regs[i].ref--;
+		return;
+	}
+	dsp_mgr->regs[i].ref = 0;
 	dsp_mgr->regs[i].gpr_usage = GPR_USAGE_NONE;
 	dsp_mgr->regs[i].val = 0;
-	dsp_mgr->regs[i].ref--;
-	dsp_mgr->regs[i].modified = 1;
+	ld10k1_dsp_mgr_gpr_changed(dsp_mgr, i);
 	dsp_mgr->regs[i].used = 0;
+	set_bit(i, dsp_mgr->gpr_free);
+	clear_bit(i, dsp_mgr->gpr_dyn);
 }
 
-unsigned int ld10k1_const_reserve(ld10k1_dsp_mgr_t *dsp_mgr, int max_res_const_count, int *res_const_count, int *res_const,
-	int max_res_count, int *res_count, int *res, int const_val)
+static unsigned int ld10k1_const_hash(unsigned int const_val)
 {
-	int i, j;
-	int free_gpr;
+	return (const_val * 2654435761U) >> (32 - LD10K1_CONST_HASH_BITS);
+}
 
-	if (*res_const_count >= max_res_const_count)
-		return 0;
+static void ld10k1_const_hash_add(ld10k1_dsp_mgr_t *dsp_mgr, int idx)
+{
+	unsigned int h = ld10k1_const_hash(dsp_mgr->consts[idx].const_val);
 
-	/* check in reserved */
-	for (i = 0; i < *res_const_count; i++) {
-		if (dsp_mgr->consts[res_const[i]].const_val == const_val)
-			return EMU10K1_REG_CONST(res_const[i]);
-	}
+	dsp_mgr->consts[idx].hash_next = dsp_mgr->const_hash[h];
+	dsp_mgr->const_hash[h] = idx;
+	dsp_mgr->consts[idx].hashed = 1;
+}
 
-	/* check in all constants */
-	for (i = 0; i < dsp_mgr->consts_max_count; i++)
-		if (dsp_mgr->consts[i].used && dsp_mgr->consts[i].const_val == const_val) {
-			/* add to reserved */
-			res_const[*res_const_count] = i;
-			(*res_const_count)++;
-			return EMU10K1_REG_CONST(i);
+static void ld10k1_const_hash_del(ld10k1_dsp_mgr_t *dsp_mgr, int idx)
+{
+	int *pos;
+
+	if (!dsp_mgr->consts[idx].hashed)
+		return;
+	pos = &(dsp_mgr->const_hash[ld10k1_const_hash(dsp_mgr->consts[idx].const_val)]);
+	for (; *pos >= 0; pos = &(dsp_mgr->consts[*pos].hash_next))
+		if (*pos == idx) {
+			*pos = dsp_mgr->consts[idx].hash_next;
+			break;
 		}
+	dsp_mgr->consts[idx].hashed = 0;
+}
 
+unsigned int ld10k1_const_reserve(ld10k1_dsp_mgr_t *dsp_mgr, ld10k1_reg_res_t *res_const,
+	ld10k1_reg_res_t *res, int const_val)
+{
+	int i;
+	int free_gpr;
 
-	/* try find other dyn not reserved */
-	for (i = 0; i < dsp_mgr->consts_max_count; i++) {
-		if (!dsp_mgr->consts[i].used) {
-			/* there is free room */
-			/* if in reserved continue */
-			for (j = 0; j < *res_const_count; j++) {
-				if (res_const[j] == i)
-					break;
-			}
-			if (j < *res_const_count)
-				continue;
+	if (res_const->count >= MAX_CONST_COUNT)
+		return 0;
 
-			free_gpr = ld10k1_gpr_reserve(dsp_mgr, max_res_count, res_count, res, GPR_USAGE_CONST, const_val);
-			if (!free_gpr)
-				return 0;
-			res_const[*res_const_count] = i;
-			(*res_const_count)++;
-			dsp_mgr->consts[i].gpr_idx = free_gpr;
-			dsp_mgr->consts[i].const_val = const_val;
-			dsp_mgr->consts[i].hw = 0;
+	/* check in reserved and in all constants */
+	for (i = dsp_mgr->const_hash[ld10k1_const_hash(const_val)]; i >= 0; i = dsp_mgr->consts[i].hash_next) {
+		if (dsp_mgr->consts[i].const_val != (unsigned int)const_val)
+			continue;
+		if (test_bit(i, res_const->map))
+			return EMU10K1_REG_CONST(i);
+		/* unused ones are left from failed loads */
+		if (dsp_mgr->consts[i].used) {
+			/* add to reserved */
+			ld10k1_reg_res_add(res_const, i);
 			return EMU10K1_REG_CONST(i);
 		}
 	}
 
-	return 0;
+	/* there is free room */
+	i = ld10k1_reg_res_find(res_const, dsp_mgr->const_free, dsp_mgr->consts_max_count);
+	if (i < 0)
+		return 0;
+
+	free_gpr = ld10k1_gpr_reserve(dsp_mgr, res, GPR_USAGE_CONST, const_val);
+	if (!free_gpr)
+		return 0;
+	ld10k1_const_hash_del(dsp_mgr, i);
+	ld10k1_reg_res_add(res_const, i);
+	dsp_mgr->consts[i].gpr_idx = free_gpr;
+	dsp_mgr->consts[i].const_val = const_val;
+	dsp_mgr->consts[i].hw = 0;
+	ld10k1_const_hash_add(dsp_mgr, i);
+	return EMU10K1_REG_CONST(i);
 }
 
 void ld10k1_const_alloc(ld10k1_dsp_mgr_t *dsp_mgr, int reg)
@@ -1931,6 +2865,9 @@ void ld10k1_const_alloc(ld10k1_dsp_mgr_t *dsp_mgr, int reg)
 	if (!dsp_mgr->consts[i].used) {
 		/*ld10k1_gpr_free(dsp_mgr, dsp_mgr->consts[i].gpr_idx);*/
 		dsp_mgr->consts[i].used = 1;
+		clear_bit(i, dsp_mgr->const_free);
+		if (!dsp_mgr->consts[i].hashed)
+			ld10k1_const_hash_add(dsp_mgr, i);
 	}
 }
 
@@ -1939,8 +2876,13 @@ void ld10k1_const_free(ld10k1_dsp_mgr_t *dsp_mgr, int reg)
 	int i = reg & 0x0FFFFFFF;
 	dsp_mgr->consts[i].ref--;
 	if (dsp_mgr->consts[i].ref == 0) {
-		if (!dsp_mgr->consts[i].hw)
+		if (!dsp_mgr->consts[i].hw) {
+			/* slot gets new gpr when it is reused */
+			ld10k1_gpr_free(dsp_mgr, dsp_mgr->consts[i].gpr_idx);
 			dsp_mgr->consts[i].used = 0;
+			set_bit(i, dsp_mgr->const_free);
+			ld10k1_const_hash_del(dsp_mgr, i);
+		}
 	}
 }
 
@@ -1956,6 +2898,7 @@ ld10k1_conn_point_t *ld10k1_conn_point_alloc(int simple)
 	tmp->id = 0;
 
 	tmp->next = NULL;
+	tmp->hash_next = NULL;
 	tmp->con_count = 0;
 	tmp->con_gpr_idx = 0;
 
@@ -2086,8 +3029,7 @@ void ld10k1_point_actualize_owner(ld10k1_dsp_mgr_t *dsp_mgr, ld10k1_conn_point_t
 
 int ld10k1_conn_point_set_to(ld10k1_dsp_mgr_t *dsp_mgr, ld10k1_conn_point_t *point, int type, int io)
 {
-	int reserved_tmp;
-	int reserved_tmp_count = 0;
+	ld10k1_reg_res_t reserved_tmp;
 	unsigned int reserved;
 
 	switch (type) {
@@ -2104,7 +3046,8 @@ int ld10k1_conn_point_set_to(ld10k1_dsp_mgr_t *dsp_mgr, ld10k1_conn_point_t *poi
 			point->con_gpr_idx = EMU10K1_REG_OUT(io);
 			break;
 		default:
-			reserved = ld10k1_gpr_reserve(dsp_mgr, 1, &reserved_tmp_count, &reserved_tmp, GPR_USAGE_NORMAL, 0);
+			ld10k1_reg_res_init(&reserved_tmp);
+			reserved = ld10k1_gpr_reserve(dsp_mgr, &reserved_tmp, GPR_USAGE_NORMAL, 0);
 			if (!reserved)
 				return LD10K1_ERR_NOT_FREE_REG;
 			ld10k1_gpr_alloc(dsp_mgr, reserved);
@@ -2152,7 +3095,7 @@ int ld10k1_conn_point_add(ld10k1_dsp_mgr_t *dsp_mgr, ld10k1_conn_point_t *point,
 	int allocgprcount = 0;
 	int allocinstrcount = 0;
 	unsigned int reserved[2];
-	int res[2];
+	ld10k1_reg_res_t res;
 	int reservedcount = 0;
 	int usedreserved = 0;
 
@@ -2182,11 +3125,13 @@ int ld10k1_conn_point_add(ld10k1_dsp_mgr_t *dsp_mgr, ld10k1_conn_point_t *point,
 				return LD10K1_ERR_NOT_FREE_INSTR;
 
 			/* allocate gpr */
+			ld10k1_reg_res_init(&res);
 			for (i = 0; i < allocgprcount; i++) {
-				reserved[i] = ld10k1_gpr_reserve(dsp_mgr, 2, &reservedcount, res, GPR_USAGE_NORMAL, 0);
+				reserved[i] = ld10k1_gpr_reserve(dsp_mgr, &res, GPR_USAGE_NORMAL, 0);
 				if (!reserved[i])
 					return LD10K1_ERR_NOT_FREE_REG;
 			}
+			reservedcount = res.count;
 
 			for (i = 0; i < allocgprcount; i++)
 				ld10k1_gpr_alloc(dsp_mgr, reserved[i]);
@@ -2355,6 +3300,16 @@ void ld10k1_conn_point_add_to_list(ld10k1_dsp_mgr_t *dsp_mgr, ld10k1_conn_point_
 void ld10k1_conn_point_del_from_list(ld10k1_dsp_mgr_t *dsp_mgr, ld10k1_conn_point_t *point)
 {
 	ld10k1_conn_point_t *tmp = dsp_mgr->point_list;
+	ld10k1_conn_point_t **htmp;
+
+	if (point->id > 0) {
+		for (htmp = &(dsp_mgr->point_hash[ld10k1_conn_point_hash(point->id)]); *htmp; htmp = &((*htmp)->hash_next))
+			if (*htmp == point) {
+				*htmp = point->hash_next;
+				break;
+			}
+		point->hash_next = NULL;
+	}
 
 	if (tmp == point) {
 		dsp_mgr->point_list = point->next;
@@ -2371,3 +3326,31 @@ void ld10k1_conn_point_del_from_list(ld10k1_dsp_mgr_t *dsp_mgr, ld10k1_conn_poin
 		tmp = tmp->next;
 	}
 }
+
+/* id is patch slot << 16 | generation, low bits alone are the same for most points */
+static unsigned int ld10k1_conn_point_hash(int id)
+{
+	return (id ^ (id >> 16)) & (LD10K1_NAME_HASH_SIZE - 1);
+}
+
+/* points get id when they are connected first time */
+static void ld10k1_conn_point_hash_add(ld10k1_dsp_mgr_t *dsp_mgr, ld10k1_conn_point_t *point)
+{
+	unsigned int h = ld10k1_conn_point_hash(point->id);
+
+	point->hash_next = dsp_mgr->point_hash[h];
+	dsp_mgr->point_hash[h] = point;
+}
+
+ld10k1_conn_point_t *ld10k1_conn_point_find(ld10k1_dsp_mgr_t *dsp_mgr, int id)
+{
+	ld10k1_conn_point_t *point;
+
+	if (id <= 0)
+		return NULL;
+
+	for (point = dsp_mgr->point_hash[ld10k1_conn_point_hash(id)]; point; point = point->hash_next)
+		if (point->id == id)
+			return point;
+	return NULL;
+}
@@ -25,7 +25,12 @@
 
 #include <alsa/asoundlib.h>
 
+#include <stddef.h>
 #include <signal.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
 #include "ld10k1.h"
 #include "ld10k1_fnc.h"
 #include "ld10k1_fnc_int.h"
@@ -33,6 +38,7 @@
 #include "ld10k1_error.h"
 #include "ld10k1_dump.h"
 #include "ld10k1_driver.h"
+#include "ld10k1_repo.h"
 #include "ld10k1_mixer.h"
 #include "comm.h"
 
@@ -55,8 +61,13 @@ int ld10k1_fnc_version(int data_conn, int op, int size);
 int ld10k1_fnc_get_points_info(int data_conn, int op, int size);
 int ld10k1_fnc_get_point_info(int data_conn, int op, int size);
 int ld10k1_fnc_get_dsp_info(int data_conn, int op, int size);
+int ld10k1_fnc_get_dsp_snapshot(int data_conn, int op, int size);
+int ld10k1_fnc_transaction(int data_conn, int op, int size);
+int ld10k1_fnc_subscribe(int data_conn, int op, int size);
+int ld10k1_fnc_ctl_set(int data_conn, int op, int size);
+int ld10k1_fnc_repo_load(int data_conn, int op, int size);
 
-ld10k1_dsp_mgr_t dsp_mgr;
+LD10K1_CARD_STATE ld10k1_dsp_mgr_t dsp_mgr;
 
 struct fnc_table_t
 {
@@ -103,94 +114,732 @@ struct fnc_table_t fnc_table[] =
 	{FNC_GET_POINTS_INFO, 0, 0, ld10k1_fnc_get_points_info},
 	{FNC_GET_POINT_INFO, sizeof(int), sizeof(int), ld10k1_fnc_get_point_info},
 	{FNC_GET_DSP_INFO, 0, 0, ld10k1_fnc_get_dsp_info},
+	{FNC_GET_DSP_SNAPSHOT, 0, 0, ld10k1_fnc_get_dsp_snapshot},
+	{FNC_TRANSACTION_BEGIN, 0, 0, ld10k1_fnc_transaction},
+	{FNC_TRANSACTION_COMMIT, 0, 0, ld10k1_fnc_transaction},
+	{FNC_TRANSACTION_ABORT, 0, 0, ld10k1_fnc_transaction},
+	{FNC_SUBSCRIBE, sizeof(ld10k1_fnc_subscribe_t), sizeof(ld10k1_fnc_subscribe_t), ld10k1_fnc_subscribe},
+	{FNC_CTL_SET, sizeof(ld10k1_fnc_ctl_value_t), sizeof(ld10k1_fnc_ctl_value_t) * LD10K1_CTL_SET_MAX, ld10k1_fnc_ctl_set},
+	{FNC_REPO_LOAD, sizeof(ld10k1_fnc_repo_load_t), sizeof(ld10k1_fnc_repo_load_t), ld10k1_fnc_repo_load},
+	{FNC_REPO_PATCH_ADD, sizeof(ld10k1_fnc_repo_patch_add_t), sizeof(ld10k1_fnc_repo_patch_add_t), ld10k1_fnc_patch_add},
 	{-1, 0, 0, NULL}
 };
 
-ld10k1_dsp_mgr_t dsp_mgr;
+/*
+ * Every client has its own input and output buffer and is served only
+ * from them, so a client which stalls in the middle of a message or
+ * stops reading its responses never blocks the others.  A request is
+ * dispatched once its header and payload are buffered completely;
+ * handlers read the payload with client_receive() and queue responses
+ * with client_response().  A patch upload (FNC_PATCH_ADD) spans several
+ * exchanges and is continued whenever the next part has arrived.
+ */
+
+#define CLIENT_STATE_REQUEST	0	/* waiting for a request header */
+#define CLIENT_STATE_PATCH_ADD	1	/* waiting for the next patch part */
+#define CLIENT_STATE_CLOSING	2	/* close once the output is flushed */
+
+/* largest amount of not yet processed input a client may queue */
+#define CLIENT_MAX_INPUT	(1024 * 1024)
+#define CLIENT_READ_CHUNK	4096
+
+/* returned by a handler which waits for more input */
+#define FNC_PENDING		1
+
+struct ClientDefTag
+{
+	int used;
+	int socket;
+	int state;
+	unsigned int events;		/* registered epoll events */
+
+	char *in_buf;
+	int in_size;
+	int in_len;
+	int in_pos;			/* next byte for client_receive */
+	int in_end;			/* end of the current request payload */
+
+	char *out_buf;
+	int out_size;
+	int out_len;
+	int out_pos;			/* next byte to send */
+
+	/* FNC_PATCH_ADD in progress */
+	ld10k1_patch_t *add_patch;
+	int add_where;
+	int add_part;
+	/* FNC_REPO_PATCH_ADD - upload for repository */
+	ld10k1_fnc_repo_key_t add_key;
+	char *add_image;
+	int add_image_len;
+
+	/* FNC_SUBSCRIBE */
+	unsigned int event_mask;
+	int event_lost;
+};
+
+typedef struct ClientDefTag ClientDef;
+
+static LD10K1_CARD_STATE ClientDef **clients = NULL;
+static LD10K1_CARD_STATE int clients_alloc = 0;
+static LD10K1_CARD_STATE int clients_count = 0;
+
+/*
+ * One client at a time may group modifications into a transaction.
+ * Modifications of the others are refused until it ends, everything
+ * else is answered from the state before FNC_TRANSACTION_BEGIN.  When a
+ * modification fails, that state is put back at once, next
+ * modifications are refused and the commit returns the failure.
+ */
+static LD10K1_CARD_STATE int transaction_client = -1;
+static LD10K1_CARD_STATE int transaction_err = 0;
+static LD10K1_CARD_STATE ld10k1_dsp_mgr_t *transaction_saved = NULL;
+
+/*
+ * Subscribed clients get every change as an FNC_EVENT message with a
+ * generation number, which grows with each event.  Changes made in a
+ * transaction are held back until the commit and dropped on rollback.
+ * A subscriber which does not read loses its events and gets
+ * LD10K1_EVENT_RESYNC once its output is sent.
+ */
+#define CLIENT_MAX_EVENT_OUTPUT	(256 * 1024)
+
+/* ALSA control events in epoll data */
+#define CTL_EVENTS_ID		0xFFFFFFFF
+
+static LD10K1_CARD_STATE unsigned int event_generation = 0;
+static LD10K1_CARD_STATE int event_subscribers = 0;
+static LD10K1_CARD_STATE ld10k1_fnc_event_t *event_held = NULL;
+static LD10K1_CARD_STATE int event_held_count = 0;
+static LD10K1_CARD_STATE int event_held_alloc = 0;
+/* subscribers have output to send */
+static LD10K1_CARD_STATE int events_queued = 0;
+
+static void event_held_end(int deliver);
+
+/*
+ * FNC_CTL_SET only records new control values, they are written through
+ * ALSA controls once per main loop pass.  Every value of a control has
+ * its own GPR, so a value set again in the same pass replaces the older
+ * one and each GPR is written at most once per pass.  Values set in a
+ * transaction are written after it ends, dropped if their patch is gone.
+ */
+typedef struct {
+	int patch_num;
+	int patch_id;
+	int ctl;
+	unsigned int gpr;		/* GPR of first value */
+	unsigned int mask;		/* values to write */
+	unsigned int value[MAX_CTL_GPR_COUNT];
+} ctl_pending_t;
+
+static LD10K1_CARD_STATE snd_ctl_t *ctl_handle = NULL;
+static LD10K1_CARD_STATE ctl_pending_t *ctl_pending = NULL;
+static LD10K1_CARD_STATE int ctl_pending_count = 0;
+static LD10K1_CARD_STATE int ctl_pending_alloc = 0;
+/* ctl_pending index + 1 by GPR of first control value */
+static LD10K1_CARD_STATE unsigned int ctl_pending_gpr[MAX_GPR_COUNT];
+
+static int fnc_modifies_dsp(int op)
+{
+	switch (op) {
+		case FNC_PATCH_ADD:
+		case FNC_REPO_PATCH_ADD:
+		case FNC_REPO_LOAD:
+		case FNC_PATCH_DEL:
+		case FNC_CONNECTION_ADD:
+		case FNC_CONNECTION_DEL:
+		case FNC_PATCH_RENAME:
+		case FNC_FX_RENAME:
+		case FNC_IN_RENAME:
+		case FNC_OUT_RENAME:
+		case FNC_PATCH_IN_RENAME:
+		case FNC_PATCH_OUT_RENAME:
+			return 1;
+	}
+	return 0;
+}
+
+/* requests of other clients which are refused during a transaction */
+static int fnc_refused_in_transaction(int op)
+{
+	switch (op) {
+		case FNC_DSP_INIT:
+		case FNC_TRANSACTION_BEGIN:
+		case FNC_TRANSACTION_COMMIT:
+		case FNC_TRANSACTION_ABORT:
+			return 1;
+	}
+	return fnc_modifies_dsp(op);
+}
+
+static void transaction_end(int rollback)
+{
+	if (transaction_saved) {
+		if (rollback)
+			ld10k1_dsp_mgr_restore(&dsp_mgr, transaction_saved);
+		else
+			ld10k1_dsp_mgr_discard(transaction_saved);
+	}
+	dsp_mgr.transaction = 0;
+	transaction_saved = NULL;
+	transaction_client = -1;
+	transaction_err = 0;
+	event_held_end(!rollback);
+}
+
+static void transaction_failed(int client, int op, int err)
+{
+	if (client != transaction_client || transaction_err || !fnc_modifies_dsp(op))
+		return;
+	/* repository miss is answer, dsp is untouched and client sends patch next */
+	if (err == LD10K1_ERR_REPO_NOT_FOUND)
+		return;
+	ld10k1_dsp_mgr_restore(&dsp_mgr, transaction_saved);
+	transaction_saved = NULL;
+	transaction_err = err;
+}
+
+static ClientDef *client_get(int client)
+{
+	if (client < 0 || client >= clients_alloc || !clients[client] || !clients[client]->used)
+		return NULL;
+	return clients[client];
+}
+
+static int client_add(int socket)
+{
+	ClientDef **new_clients;
+	int i, new_alloc;
+
+	for (i = 0; i < clients_alloc; i++)
+		if (!clients[i] || !clients[i]->used)
+			break;
+
+	if (i == clients_alloc) {
+		new_alloc = clients_alloc ? clients_alloc * 2 : 16;
+		new_clients = (ClientDef **)realloc(clients, sizeof(ClientDef *) * new_alloc);
+		if (!new_clients)
+			return -1;
+		memset(new_clients + clients_alloc, 0, sizeof(ClientDef *) * (new_alloc - clients_alloc));
+		clients = new_clients;
+		clients_alloc = new_alloc;
+	}
+
+	if (!clients[i] && !(clients[i] = (ClientDef *)malloc(sizeof(ClientDef))))
+		return -1;
+	memset(clients[i], 0, sizeof(ClientDef));
+	clients[i]->used = 1;
+	clients[i]->socket = socket;
+	clients[i]->state = CLIENT_STATE_REQUEST;
+	clients_count++;
+	return i;
+}
+
+static void client_del(int client)
+{
+	ClientDef *c = client_get(client);
+
+	if (!c)
+		return;
+	if (client == transaction_client)
+		transaction_end(1);
+	if (c->event_mask)
+		event_subscribers--;
+	if (c->add_patch)
+		ld10k1_dsp_mgr_patch_free(c->add_patch);
+	free(c->add_image);
+	free(c->in_buf);
+	free(c->out_buf);
+	free_comm(c->socket);
+	memset(c, 0, sizeof(ClientDef));
+	clients_count--;
+}
+
+/* payload of the current request or patch part */
+int client_receive(int client, void *data, int data_size)
+{
+	ClientDef *c = client_get(client);
+
+	if (!c || data_size < 0 || c->in_pos + data_size > c->in_end)
+		return LD10K1_ERR_COMM_READ;
+	memcpy(data, c->in_buf + c->in_pos, data_size);
+	c->in_pos += data_size;
+	return 0;
+}
+
+void *client_receive_malloc(int client, int data_size)
+{
+	void *tmp;
+
+	tmp = malloc(data_size);
+	if (!tmp)
+		return NULL;
+
+	if (client_receive(client, tmp, data_size)) {
+		free(tmp);
+		return NULL;
+	}
+	return tmp;
+}
+
+int client_response(int client, int op, int err, void *data, int data_size)
+{
+	ClientDef *c = client_get(client);
+	struct msg_resp header;
+	char *new_buf;
+	int need, new_size;
+
+	if (!c || data_size < 0)
+		return LD10K1_ERR_COMM_WRITE;
+
+	need = c->out_len + sizeof(header) + data_size;
+	if (need > c->out_size) {
+		new_size = c->out_size ? c->out_size : CLIENT_READ_CHUNK;
+		while (new_size < need)
+			new_size *= 2;
+		new_buf = (char *)realloc(c->out_buf, new_size);
+		if (!new_buf)
+			return LD10K1_ERR_NO_MEM;
+		c->out_buf = new_buf;
+		c->out_size = new_size;
+	}
+
+	header.op = op;
+	header.err = err;
+	header.size = data_size;
+	memcpy(c->out_buf + c->out_len, &header, sizeof(header));
+	c->out_len += sizeof(header);
+	if (data_size > 0) {
+		memcpy(c->out_buf + c->out_len, data, data_size);
+		c->out_len += data_size;
+	}
+	return 0;
+}
 
 int send_response_ok(int conn_num)
 {
-	return send_response(conn_num, FNC_OK, 0, NULL, 0);
+	return client_response(conn_num, FNC_OK, 0, NULL, 0);
 }
 
 int send_response_err(int conn_num, int err)
 {
-	return send_response(conn_num, FNC_ERR, err, NULL, 0);
+	return client_response(conn_num, FNC_ERR, err, NULL, 0);
 }
 
 int send_response_wd(int conn_num, void *data, int data_size)
 {
-	return send_response(conn_num, FNC_OK, 0, data, data_size);
+	return client_response(conn_num, FNC_OK, 0, data, data_size);
 }
 
-struct ClientDefTag
+static void event_init(ld10k1_fnc_event_t *event, int type, int patch_num)
 {
-	int used;
-	int socket;
-};
-
-typedef struct ClientDefTag ClientDef;
+	memset(event, 0, offsetof(ld10k1_fnc_event_t, value));
+	event->type = type;
+	event->patch_num = patch_num;
+	event->patch_id = -1;
+	if (patch_num >= 0 && patch_num < EMU10K1_PATCH_MAX && dsp_mgr.patch_ptr[patch_num])
+		event->patch_id = dsp_mgr.patch_ptr[patch_num]->id;
+	event->io = -1;
+	event->point_id = -1;
+}
 
-#define MAX_CLIENTS 10
-ClientDef clients[MAX_CLIENTS];
-int clients_count = 0;
+static int event_size(ld10k1_fnc_event_t *event)
+{
+	return offsetof(ld10k1_fnc_event_t, value) + event->count * sizeof(unsigned int);
+}
 
-static void client_init()
+static void event_deliver(ld10k1_fnc_event_t *event)
 {
+	ClientDef *c;
 	int i;
-	for (i = 0; i < MAX_CLIENTS; i++)
-		clients[i].used = 0;
 
-	clients_count = 0;
+	event->generation = ++event_generation;
+	if (!event_subscribers)
+		return;
+
+	for (i = 0; i < clients_alloc; i++) {
+		c = client_get(i);
+		if (!c || c->event_lost || !(c->event_mask & LD10K1_EVENT_MASK(event->type)))
+			continue;
+		if (c->out_len > CLIENT_MAX_EVENT_OUTPUT ||
+			client_response(i, FNC_EVENT, 0, event, event_size(event)) < 0)
+			c->event_lost = 1;
+		events_queued = 1;
+	}
+}
+
+/* change of dsp manager state */
+static void event_publish(ld10k1_fnc_event_t *event)
+{
+	ld10k1_fnc_event_t *new_held;
+	int i, new_alloc;
+
+	if (transaction_client < 0) {
+		event_deliver(event);
+		return;
+	}
+
+	if (event_held_count == event_held_alloc) {
+		new_alloc = event_held_alloc ? event_held_alloc * 2 : 16;
+		new_held = (ld10k1_fnc_event_t *)realloc(event_held, sizeof(ld10k1_fnc_event_t) * new_alloc);
+		if (!new_held) {
+			/* subscribers have to reload after commit */
+			for (i = 0; i < clients_alloc; i++)
+				if (client_get(i) && clients[i]->event_mask)
+					clients[i]->event_lost = 1;
+			return;
+		}
+		event_held = new_held;
+		event_held_alloc = new_alloc;
+	}
+	event_held[event_held_count++] = *event;
 }
 
-static int client_add()
+static void event_held_end(int deliver)
 {
 	int i;
 
-	for (i = 0; i < MAX_CLIENTS; i++)
-		if (clients[i].used == 0) {
-			clients[i].used = 1;
-			clients_count++;
-			return i;
+	if (deliver)
+		for (i = 0; i < event_held_count; i++)
+			event_deliver(&event_held[i]);
+	event_held_count = 0;
+}
+
+static void event_resync(int client)
+{
+	ld10k1_fnc_event_t event;
+
+	event_init(&event, LD10K1_EVENT_RESYNC, -1);
+	event.generation = event_generation;
+	if (client_response(client, FNC_EVENT, 0, &event, event_size(&event)) < 0)
+		return;
+	clients[client]->event_lost = 0;
+}
+
+/* control values changed by mixers, not held by transactions */
+static void event_ctl_read(snd_ctl_t *ctlp)
+{
+	snd_ctl_event_t *event;
+	snd_ctl_elem_id_t *id;
+	snd_ctl_elem_value_t *value;
+	ld10k1_fnc_event_t change;
+	ld10k1_patch_t *patch = NULL;
+	const char *name;
+	unsigned int index, mask;
+	int i, j, k;
+
+	snd_ctl_event_alloca(&event);
+	snd_ctl_elem_id_alloca(&id);
+	snd_ctl_elem_value_alloca(&value);
+
+	while (snd_ctl_read(ctlp, event) > 0) {
+		if (!event_subscribers || snd_ctl_event_get_type(event) != SND_CTL_EVENT_ELEM)
+			continue;
+		mask = snd_ctl_event_elem_get_mask(event);
+		if (mask == SND_CTL_EVENT_MASK_REMOVE || !(mask & SND_CTL_EVENT_MASK_VALUE))
+			continue;
+		if (snd_ctl_event_elem_get_interface(event) != SND_CTL_ELEM_IFACE_MIXER)
+			continue;
+
+		name = snd_ctl_event_elem_get_name(event);
+		index = snd_ctl_event_elem_get_index(event);
+
+		for (j = -1, i = 0; i < dsp_mgr.patch_count; i++) {
+			patch = dsp_mgr.patch_ptr[dsp_mgr.patch_order[i]];
+			for (j = 0; j < patch->ctl_count; j++)
+				if (patch->ctl[j].index == index && strcmp(patch->ctl[j].name, name) == 0)
+					break;
+			if (j < patch->ctl_count)
+				break;
 		}
-	return -1;
+		/* not control of any patch */
+		if (i >= dsp_mgr.patch_count)
+			continue;
+
+		snd_ctl_event_elem_get_id(event, id);
+		snd_ctl_elem_value_set_id(value, id);
+		if (snd_ctl_elem_read(ctlp, value) < 0)
+			continue;
+
+		event_init(&change, LD10K1_EVENT_CTL_VALUE, dsp_mgr.patch_order[i]);
+		change.io = j;
+		change.count = patch->ctl[j].vcount;
+		if (change.count > MAX_CTL_GPR_COUNT)
+			change.count = MAX_CTL_GPR_COUNT;
+		for (k = 0; k < change.count; k++)
+			change.value[k] = snd_ctl_elem_value_get_integer(value, k);
+		event_deliver(&change);
+	}
 }
 
-static void client_del(int client)
+static void ctl_pending_flush(void)
 {
-    if (client >= 0 && client < MAX_CLIENTS && clients[client].used == 1) {
-	clients[client].used = 0;
-	clients_count--;
-    }
+	snd_ctl_elem_value_t *value;
+	ctl_pending_t *pend;
+	ld10k1_patch_t *patch;
+	ld10k1_ctl_t *ctl;
+	ld10k1_ctl_list_item_t *item;
+	int i, j;
+
+	snd_ctl_elem_value_alloca(&value);
+
+	for (i = 0; i < ctl_pending_count; i++) {
+		pend = &ctl_pending[i];
+		ctl_pending_gpr[pend->gpr] = 0;
+		patch = dsp_mgr.patch_ptr[pend->patch_num];
+		if (!patch || patch->id != pend->patch_id || pend->ctl >= patch->ctl_count)
+			continue;
+		ctl = &(patch->ctl[pend->ctl]);
+
+		snd_ctl_elem_value_clear(value);
+		snd_ctl_elem_value_set_interface(value, SND_CTL_ELEM_IFACE_MIXER);
+		snd_ctl_elem_value_set_name(value, ctl->name);
+		snd_ctl_elem_value_set_index(value, ctl->index);
+		/* keep values which were not set */
+		if (pend->mask != (1U << ctl->vcount) - 1 &&
+			snd_ctl_elem_read(ctl_handle, value) < 0) {
+			error("unable to read control %s", ctl->name);
+			continue;
+		}
+		for (j = 0; j < ctl->vcount; j++)
+			if (pend->mask & (1U << j))
+				snd_ctl_elem_value_set_integer(value, j, pend->value[j]);
+		if (snd_ctl_elem_write(ctl_handle, value) < 0) {
+			error("unable to write control %s", ctl->name);
+			continue;
+		}
+
+		/* patch info and dump show current values */
+		for (j = 0; j < ctl->vcount; j++)
+			if (pend->mask & (1U << j))
+				ctl->value[j] = pend->value[j];
+		item = ld10k1_look_control_from_list(&(dsp_mgr.ctl_list), ctl);
+		if (item)
+			memcpy(item->ctl.value, ctl->value, sizeof(ctl->value));
+	}
+	ctl_pending_count = 0;
 }
 
-static int client_find_by_socket(int socket)
+static int client_watch(int epoll_fd, int client, unsigned int events)
 {
-	int i;
+	ClientDef *c = clients[client];
+	struct epoll_event ev;
+
+	if (c->events == events)
+		return 0;
+	memset(&ev, 0, sizeof(ev));
+	ev.events = events;
+	ev.data.u32 = client + 1;	/* 0 is the listening socket */
+	if (epoll_ctl(epoll_fd, c->events ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, c->socket, &ev) < 0)
+		return -1;
+	c->events = events;
+	return 0;
+}
+
+/* sends as much of the output as the socket takes, -1 on error */
+static int client_flush(int client)
+{
+	ClientDef *c = clients[client];
+	ssize_t sent;
+
+	while (c->out_pos < c->out_len) {
+		sent = send(c->socket, c->out_buf + c->out_pos, c->out_len - c->out_pos, MSG_NOSIGNAL | MSG_DONTWAIT);
+		if (sent < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				return 0;
+			return -1;
+		}
+		c->out_pos += sent;
+	}
+	c->out_pos = c->out_len = 0;
+	return 0;
+}
+
+/* reads what is available, -1 on error or end of connection */
+static int client_fill(int client)
+{
+	ClientDef *c = clients[client];
+	char *new_buf;
+	ssize_t readed;
+
+	while (1) {
+		if (c->in_size - c->in_len < CLIENT_READ_CHUNK) {
+			if (c->in_size >= CLIENT_MAX_INPUT)
+				return -1;
+			new_buf = (char *)realloc(c->in_buf, c->in_size + CLIENT_READ_CHUNK * 4);
+			if (!new_buf)
+				return -1;
+			c->in_buf = new_buf;
+			c->in_size += CLIENT_READ_CHUNK * 4;
+		}
+		readed = recv(c->socket, c->in_buf + c->in_len, c->in_size - c->in_len, MSG_DONTWAIT);
+		if (readed < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				return 0;
+			return -1;
+		}
+		if (readed == 0)
+			return -1;
+		c->in_len += readed;
+	}
+}
+
+static int fnc_max_request_size(void)
+{
+	static int max_size = -1;
+	int j;
+
+	if (max_size < 0)
+		for (j = 0; fnc_table[j].fnc >= 0; j++)
+			if (fnc_table[j].max_size > max_size)
+				max_size = fnc_table[j].max_size;
+	return max_size;
+}
+
+static int ld10k1_fnc_patch_add_continue(int data_conn);
+
+/*
+ * Runs every complete request in the input buffer.  Stops early while
+ * responses are still queued, so a client which does not read cannot
+ * make the server buffer without limit.  Returns 1 if some input was
+ * consumed, 0 if not and -1 when the client has to be closed.
+ */
+static int client_process(int client)
+{
+	ClientDef *c = clients[client];
+	struct msg_req header;
+	int j, res, found, consumed, other, committed;
+
+	while (c->out_len == 0 && c->state != CLIENT_STATE_CLOSING) {
+		/* transaction of other client is open */
+		other = transaction_client >= 0 && transaction_client != client;
+
+		if (c->state == CLIENT_STATE_PATCH_ADD) {
+			res = ld10k1_fnc_patch_add_continue(client);
+			if (res == FNC_PENDING)
+				break;
+			if (res < 0)
+				transaction_failed(client, FNC_PATCH_ADD, res);
+			if (client_response(client, res ? FNC_ERR : FNC_OK, res, NULL, 0) < 0)
+				return -1;
+			continue;
+		}
+
+		if (c->in_len - c->in_pos < (int)sizeof(header))
+			break;
+		memcpy(&header, c->in_buf + c->in_pos, sizeof(header));
+		if (header.op == FNC_CLOSE_CONN) {
+			c->state = CLIENT_STATE_CLOSING;
+			break;
+		}
+		if (header.size < 0 || header.size > fnc_max_request_size()) {
+			printf("error protocol fnc:%d - %d\n", header.op, header.size);
+			return -1;
+		}
+		if (c->in_len - c->in_pos < (int)sizeof(header) + header.size)
+			break;
+
+		c->in_pos += sizeof(header);
+		c->in_end = c->in_pos + header.size;
+
+		/* search in function table */
+		res = 1;
+		found = 0;
+		/* waiting would block the client for the whole transaction */
+		if (other && fnc_refused_in_transaction(header.op)) {
+			res = LD10K1_ERR_TRANSACTION;
+			found = 1;
+		}
+		if (client == transaction_client && transaction_err && fnc_modifies_dsp(header.op)) {
+			res = LD10K1_ERR_TRANSACTION;
+			found = 1;
+		}
+		/* nothing is changed, other clients see committed state */
+		committed = other && transaction_saved;
+		if (committed)
+			ld10k1_dsp_mgr_swap(&dsp_mgr, transaction_saved);
+		for (j = 0; !found && fnc_table[j].fnc >= 0; j++)	{
+			if ((fnc_table[j].fnc == header.op) &&
+				(header.size >= fnc_table[j].min_size) &&
+				(header.size <= fnc_table[j].max_size)) {
+				res = (*fnc_table[j].fnc_code)(client, header.op, header.size);
+				found = 1;
+				break;
+			}
+		}
+		if (committed)
+			ld10k1_dsp_mgr_swap(&dsp_mgr, transaction_saved);
+		if (!found)
+			printf("error protocol fnc:%d - %d\n", header.op, res);
+		/* drop what the handler did not read */
+		c->in_pos = c->in_end;
+		if (res == FNC_PENDING)
+			continue;
+		if (res < 0)
+			transaction_failed(client, header.op, res);
+		if (client_response(client, res ? FNC_ERR : FNC_OK, res, NULL, 0) < 0)
+			return -1;
+	}
 
-	for (i = 0; i < MAX_CLIENTS; i++)
-		if (clients[i].socket == socket)
-			return i;
-	return -1;
+	/* keep the unprocessed rest at the start of the buffer */
+	consumed = c->in_pos;
+	if (c->in_pos > 0) {
+		memmove(c->in_buf, c->in_buf + c->in_pos, c->in_len - c->in_pos);
+		c->in_len -= c->in_pos;
+		c->in_end -= c->in_pos;
+		c->in_pos = 0;
+	}
+	return consumed > 0;
 }
 
-int main_loop(comm_param *param, int audigy, const char *card_id, int tram_size, snd_ctl_t *ctlp)
+static int client_event(int epoll_fd, int client, unsigned int events)
 {
-	fd_set active_fd_set/*, read_fd_set*/;
-	int i, j, res = 0;
+	ClientDef *c = clients[client];
+	int res;
+
+	if (events & (EPOLLERR | EPOLLHUP) && !(events & EPOLLIN))
+		return -1;
+	if ((events & EPOLLIN) && client_fill(client) < 0)
+		return -1;
+	if (client_flush(client) < 0)
+		return -1;
+	if (c->event_lost && c->out_len == 0)
+		event_resync(client);
+	/* while responses go out at once, the input may hold more requests */
+	do {
+		if ((res = client_process(client)) < 0)
+			return -1;
+		if (client_flush(client) < 0)
+			return -1;
+	} while (res > 0 && c->out_len == 0);
+
+	if (c->state == CLIENT_STATE_CLOSING && c->out_len == 0)
+		return -1;
+	return client_watch(epoll_fd, client, c->out_len ? EPOLLIN | EPOLLOUT : EPOLLIN);
+}
+
+int main_loop(comm_param *param, int audigy, const char *card_id, int tram_size, int staged, struct ld10k1_dump_parts_tag *dump, snd_ctl_t *ctlp)
+{
+	struct epoll_event ev, events[32];
+	struct pollfd ctl_pfd;
+	int i, n, client;
 	sighandler_t old_sig_pipe;
 
-	int main_sock = 0;
+	int main_sock = -1;
 	int data_sock = 0;
-	int new_client = 0;
-	int op = 0;
-	int data_size = 0;
+	int epoll_fd = -1;
 
 	int retval = 0;
 
 	dsp_mgr.audigy = audigy;
 	dsp_mgr.card_id = card_id;
+	dsp_mgr.staged = staged;
+	ctl_handle = ctlp;
 
 	if (ld10k1_dsp_mgr_init(&dsp_mgr))
 		return -1;
@@ -199,7 +848,7 @@ int main_loop(comm_param *param, int audigy, const char *card_id, int tram_size,
 	ld10k1_dsp_mgr_init_id_gen(&dsp_mgr);
 
 
-	if (ld10k1_init_driver(&dsp_mgr, tram_size) < 0) {
+	if ((dump ? ld10k1_init_driver_dump(&dsp_mgr, dump) : ld10k1_init_driver(&dsp_mgr, tram_size)) < 0) {
 		ld10k1_dsp_mgr_free(&dsp_mgr);
 		return -1;
 	}
@@ -218,88 +867,91 @@ int main_loop(comm_param *param, int audigy, const char *card_id, int tram_size,
 	if (listen_comm(main_sock))
 		goto error;
 
-	/* Initialize the set of active sockets. */
-	client_init();
-
-	while (1) {
-		/* Block until input arrives on one or more active sockets. */
-		FD_ZERO (&active_fd_set);
-		FD_SET (main_sock, &active_fd_set);
+	if (fcntl(main_sock, F_SETFL, fcntl(main_sock, F_GETFL) | O_NONBLOCK) < 0)
+		goto error;
 
-		for (i = 0; i < MAX_CLIENTS; i++)
-			if (clients[i].used)
-				FD_SET(clients[i].socket, &active_fd_set);
+	if ((epoll_fd = epoll_create1(EPOLL_CLOEXEC)) < 0)
+		goto error;
 
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN;
+	ev.data.u32 = 0;
+	if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, main_sock, &ev) < 0)
+		goto error;
 
-		if (select(FD_SETSIZE, &active_fd_set, NULL, NULL, NULL) < 0)
+	/* control values changed by mixers are reported to subscribers */
+	if (snd_ctl_nonblock(ctlp, 1) >= 0 && snd_ctl_subscribe_events(ctlp, 1) >= 0 &&
+		snd_ctl_poll_descriptors(ctlp, &ctl_pfd, 1) == 1) {
+		memset(&ev, 0, sizeof(ev));
+		ev.events = EPOLLIN;
+		ev.data.u32 = CTL_EVENTS_ID;
+		if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, ctl_pfd.fd, &ev) < 0)
 			goto error;
+	}
 
+	while (1) {
+		n = epoll_wait(epoll_fd, events, sizeof(events) / sizeof(events[0]), -1);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			goto error;
+		}
 
-		for (i = 0; i < FD_SETSIZE; i++)
-			if (FD_ISSET (i, &active_fd_set))	{
-				if (i == main_sock)	{
-					/* Connection request on original socket. */
-					if ((data_sock = accept_comm(main_sock)) < 0)
-						goto error;
-
-					new_client = client_add();
-					if (new_client < 0)
+		for (i = 0; i < n; i++) {
+			if (events[i].data.u32 == 0) {
+				/* Connection requests on original socket. */
+				while ((data_sock = accept_comm(main_sock)) >= 0) {
+					if (fcntl(data_sock, F_SETFL, fcntl(data_sock, F_GETFL) | O_NONBLOCK) < 0 ||
+						(client = client_add(data_sock)) < 0) {
 						free_comm(data_sock);
-					else
-						clients[new_client].socket = data_sock;
-						/*FD_SET(data_sock, &active_fd_set);*/
-				} else {
-					/* Data arriving on an already-connected socket. */
-					if (receive_request(i, &op, &data_size))
-						/*goto error;*/
-						op = -1; /* probably client closes */
-
-					if (op == FNC_CLOSE_CONN) {
-						/* wait some time */
-						usleep(10000);
-						goto e_close;
-					}
-
-					if (op >= 0) {
-						/* search in function table */
-						res = 1;
-						for (j = 0; fnc_table[j].fnc >= 0; j++)	{
-							if ((fnc_table[j].fnc == op) &&
-								(data_size >= fnc_table[j].min_size) &&
-								(data_size <= fnc_table[j].max_size)) {
-								res = (*fnc_table[j].fnc_code)(i, op, data_size);
-								break;
-							}
-						}
-						if (!res) {
-							if (send_response(i, FNC_OK, 0, NULL, 0) < 0)
-								goto e_close;
-						} else {
-							if (send_response(i, FNC_ERR, res, NULL, 0) < 0)
-								goto e_close;
-						}
-					} else {
-e_close:
-						if (op != FNC_CLOSE_CONN)
-							printf("error protocol fnc:%d - %d\n", op, res);
-						client_del(client_find_by_socket(i));
-						/*FD_CLR (i, &active_fd_set);*/
-
-						/* close connection */
-						if (free_comm(i))
-							data_sock = 0;
+						continue;
 					}
+					if (client_watch(epoll_fd, client, EPOLLIN) < 0)
+						client_del(client);
 				}
+				continue;
+			}
+
+			if (events[i].data.u32 == CTL_EVENTS_ID) {
+				event_ctl_read(ctlp);
+				continue;
 			}
+
+			client = events[i].data.u32 - 1;
+			if (!client_get(client))
+				continue;
+			/* Data arriving on or leaving an already-connected socket. */
+			if (client_event(epoll_fd, client, events[i].events) < 0)
+				client_del(client);
+		}
+
+		/* write control values collected in this pass */
+		if (ctl_pending_count && transaction_client < 0)
+			ctl_pending_flush();
+
+		/* send changes to subscribers */
+		if (events_queued) {
+			events_queued = 0;
+			for (client = 0; client < clients_alloc; client++)
+				if (client_get(client) && clients[client]->out_len &&
+					client_event(epoll_fd, client, 0) < 0)
+					client_del(client);
+		}
 	}
 end:
 	signal(SIGPIPE, old_sig_pipe);
-	for (i = 0; i < MAX_CLIENTS; i++)
-		if (clients[i].used) {
-			client_del(i);
-			free_comm(clients[i].socket);
-		}
-	free_comm(main_sock);
+	snd_ctl_subscribe_events(ctlp, 0);
+	for (i = 0; i < clients_alloc; i++) {
+		client_del(i);
+		free(clients[i]);
+	}
+	free(clients);
+	clients = NULL;
+	clients_alloc = 0;
+	if (epoll_fd >= 0)
+		close(epoll_fd);
+	if (main_sock >= 0)
+		free_comm(main_sock);
 
 	ld10k1_free_reserved_ctls(&dsp_mgr);
 	ld10k1_dsp_mgr_free(&dsp_mgr);
@@ -311,17 +963,9 @@ error:
 	goto end;
 }
 
-int ld10k1_fnc_receive_patch_info(int data_conn, ld10k1_dsp_patch_t *new_patch, int *where)
+static int ld10k1_fnc_check_patch_info(ld10k1_dsp_patch_t *new_patch)
 {
-	ld10k1_fnc_patch_add_t tmp_info;
-
-	if (receive_msg_data(data_conn, &tmp_info, sizeof(ld10k1_fnc_patch_add_t)) < 0)
-		return LD10K1_ERR_PROTOCOL;
-
-	memcpy(new_patch, &(tmp_info.patch), sizeof(ld10k1_dsp_patch_t));
-	*where = tmp_info.where;
-
-	new_patch->patch_name[MAX_NAME_LEN - 1] = '\n';
+	new_patch->patch_name[MAX_NAME_LEN - 1] = '\0';
 	if (new_patch->in_count < 0 || new_patch->in_count > 32)
 		return LD10K1_ERR_PROTOCOL_IN_COUNT;
 	if (new_patch->out_count < 0 || new_patch->out_count > 32)
@@ -342,170 +986,116 @@ int ld10k1_fnc_receive_patch_info(int data_conn, ld10k1_dsp_patch_t *new_patch,
 		return LD10K1_ERR_PROTOCOL_CTL_COUNT;
 	if (new_patch->instr_count < 0 || new_patch->instr_count > 512)
 		return LD10K1_ERR_PROTOCOL_INSTR_COUNT;
-
-	return send_response_ok(data_conn);
+	return 0;
 }
 
-int ld10k1_fnc_receive_patch_in(int data_conn, ld10k1_patch_t *new_patch)
+int ld10k1_fnc_receive_patch_info(int data_conn, int op, ld10k1_dsp_patch_t *new_patch, int *where, ld10k1_fnc_repo_key_t *key)
 {
-	ld10k1_dsp_p_in_out_t *new_in = NULL;
-	int i;
+	ld10k1_fnc_repo_patch_add_t tmp_info;
 	int err;
 
- 	if (!new_patch->in_count)
-		return 0;
-
- 	if (!(new_in = (ld10k1_dsp_p_in_out_t *)receive_msg_data_malloc(data_conn, sizeof(ld10k1_dsp_p_in_out_t) * new_patch->in_count)))
+	memset(&tmp_info, 0, sizeof(tmp_info));
+	if (client_receive(data_conn, &tmp_info, op == FNC_REPO_PATCH_ADD ?
+		sizeof(ld10k1_fnc_repo_patch_add_t) : sizeof(ld10k1_fnc_patch_add_t)) < 0)
 		return LD10K1_ERR_PROTOCOL;
 
-	/* copy values */
-	for (i = 0; i < new_patch->in_count; i++) {
-		if (!ld10k1_dsp_mgr_name_new(&(new_patch->ins[i].name), new_in[i].name)) {
-			err = LD10K1_ERR_NO_MEM;
-			goto error;
-		}
-	}
+	memcpy(new_patch, &(tmp_info.add.patch), sizeof(ld10k1_dsp_patch_t));
+	*where = tmp_info.add.where;
+	memcpy(key, &(tmp_info.key), sizeof(ld10k1_fnc_repo_key_t));
+	key->name[MAX_NAME_LEN - 1] = '\0';
+
+	if ((err = ld10k1_fnc_check_patch_info(new_patch)) < 0)
+		return err;
+	/* stored patch is found by key */
+	if (op == FNC_REPO_PATCH_ADD && !key->hash[0] && !key->hash[1])
+		return LD10K1_ERR_PROTOCOL;
 
 	return send_response_ok(data_conn);
-error:
-	free(new_in);
-	return err;
 }
 
-int ld10k1_fnc_receive_patch_out(int data_conn, ld10k1_patch_t *new_patch)
+static int ld10k1_fnc_patch_copy_in(ld10k1_patch_t *new_patch, void *data)
 {
-	ld10k1_dsp_p_in_out_t *new_out = NULL;
+	ld10k1_dsp_p_in_out_t *new_in = (ld10k1_dsp_p_in_out_t *)data;
 	int i;
-	int err;
-
- 	if (!new_patch->out_count)
-		return 0;
 
- 	if (!(new_out = (ld10k1_dsp_p_in_out_t *)receive_msg_data_malloc(data_conn, sizeof(ld10k1_dsp_p_in_out_t) * new_patch->out_count)))
-		return LD10K1_ERR_PROTOCOL;
-
-	/* copy values */
-	for (i = 0; i < new_patch->out_count; i++) {
-		if (!ld10k1_dsp_mgr_name_new(&(new_patch->outs[i].name), new_out[i].name)) {
-			err = LD10K1_ERR_NO_MEM;
-			goto error;
-		}
-	}
-
-	return send_response_ok(data_conn);
-error:
-	free(new_out);
-	return err;
+	for (i = 0; i < new_patch->in_count; i++)
+		if (!ld10k1_dsp_mgr_name_new(&(new_patch->ins[i].name), new_in[i].name))
+			return LD10K1_ERR_NO_MEM;
+	return 0;
 }
 
-int ld10k1_fnc_receive_patch_const(int data_conn, ld10k1_patch_t *new_patch)
+static int ld10k1_fnc_patch_copy_out(ld10k1_patch_t *new_patch, void *data)
 {
-	ld10k1_dsp_p_const_static_t *new_const = NULL;
+	ld10k1_dsp_p_in_out_t *new_out = (ld10k1_dsp_p_in_out_t *)data;
 	int i;
 
- 	if (!new_patch->const_count)
-		return 0;
+	for (i = 0; i < new_patch->out_count; i++)
+		if (!ld10k1_dsp_mgr_name_new(&(new_patch->outs[i].name), new_out[i].name))
+			return LD10K1_ERR_NO_MEM;
+	return 0;
+}
 
- 	if (!(new_const = (ld10k1_dsp_p_const_static_t *)receive_msg_data_malloc(data_conn, sizeof(ld10k1_dsp_p_const_static_t) * new_patch->const_count)))
-		return LD10K1_ERR_PROTOCOL;
+static int ld10k1_fnc_patch_copy_const(ld10k1_patch_t *new_patch, void *data)
+{
+	ld10k1_dsp_p_const_static_t *new_const = (ld10k1_dsp_p_const_static_t *)data;
+	int i;
 
-	/* copy values */
 	for (i = 0; i < new_patch->const_count; i++)
 		new_patch->consts[i].const_val = new_const[i].const_val;
-
-	return send_response_ok(data_conn);
+	return 0;
 }
 
-int ld10k1_fnc_receive_patch_sta(int data_conn, ld10k1_patch_t *new_patch)
+static int ld10k1_fnc_patch_copy_sta(ld10k1_patch_t *new_patch, void *data)
 {
-	ld10k1_dsp_p_const_static_t *new_sta = NULL;
+	ld10k1_dsp_p_const_static_t *new_sta = (ld10k1_dsp_p_const_static_t *)data;
 	int i;
 
- 	if (!new_patch->sta_count)
-		return 0;
-
- 	if (!(new_sta = (ld10k1_dsp_p_const_static_t *)receive_msg_data_malloc(data_conn, sizeof(ld10k1_dsp_p_const_static_t) * new_patch->sta_count)))
-		return LD10K1_ERR_PROTOCOL;
-
-	/* copy values */
 	for (i = 0; i < new_patch->sta_count; i++)
 		new_patch->stas[i].const_val = new_sta[i].const_val;
-
-	return send_response_ok(data_conn);
+	return 0;
 }
 
-int ld10k1_fnc_receive_patch_hw(int data_conn, ld10k1_patch_t *new_patch)
+static int ld10k1_fnc_patch_copy_hw(ld10k1_patch_t *new_patch, void *data)
 {
-	ld10k1_dsp_p_hw_t *new_hw = NULL;
+	ld10k1_dsp_p_hw_t *new_hw = (ld10k1_dsp_p_hw_t *)data;
 	int i;
 
- 	if (!new_patch->hw_count)
-		return 0;
-
- 	if (!(new_hw = (ld10k1_dsp_p_hw_t *)receive_msg_data_malloc(data_conn, sizeof(ld10k1_dsp_p_hw_t) * new_patch->hw_count)))
-		return LD10K1_ERR_PROTOCOL;
-
-	/* copy values */
 	for (i = 0; i < new_patch->hw_count; i++)
 		new_patch->hws[i].reg_idx = new_hw[i].hw_val;
-
-	return send_response_ok(data_conn);
+	return 0;
 }
 
-int ld10k1_fnc_receive_patch_tram_grp(int data_conn, ld10k1_patch_t *new_patch)
+static int ld10k1_fnc_patch_copy_tram_grp(ld10k1_patch_t *new_patch, void *data)
 {
-	ld10k1_dsp_tram_grp_t *new_tram_grp = NULL;
+	ld10k1_dsp_tram_grp_t *new_tram_grp = (ld10k1_dsp_tram_grp_t *)data;
 	int i;
 
- 	if (!new_patch->tram_count)
-		return 0;
-
- 	if (!(new_tram_grp = (ld10k1_dsp_tram_grp_t *)receive_msg_data_malloc(data_conn, sizeof(ld10k1_dsp_tram_grp_t) * new_patch->tram_count)))
-		return LD10K1_ERR_PROTOCOL;
-
-	/* copy values */
 	for (i = 0; i < new_patch->tram_count; i++) {
 		new_patch->tram_grp[i].grp_type = new_tram_grp[i].grp_type;
 		new_patch->tram_grp[i].grp_size = new_tram_grp[i].grp_size;
 		new_patch->tram_grp[i].grp_pos = new_tram_grp[i].grp_pos;
 	}
-
-	return send_response_ok(data_conn);
+	return 0;
 }
 
-int ld10k1_fnc_receive_patch_tram_acc(int data_conn, ld10k1_patch_t *new_patch)
+static int ld10k1_fnc_patch_copy_tram_acc(ld10k1_patch_t *new_patch, void *data)
 {
-	ld10k1_dsp_tram_acc_t *new_tram_acc = NULL;
+	ld10k1_dsp_tram_acc_t *new_tram_acc = (ld10k1_dsp_tram_acc_t *)data;
 	int i;
 
- 	if (!new_patch->tram_acc_count)
-		return 0;
-
- 	if (!(new_tram_acc = (ld10k1_dsp_tram_acc_t *)receive_msg_data_malloc(data_conn, sizeof(ld10k1_dsp_tram_acc_t) * new_patch->tram_acc_count)))
-		return LD10K1_ERR_PROTOCOL;
-
-	/* copy values */
 	for (i = 0; i < new_patch->tram_acc_count; i++) {
 		new_patch->tram_acc[i].acc_type = new_tram_acc[i].acc_type;
 		new_patch->tram_acc[i].acc_offset = new_tram_acc[i].acc_offset;
 		new_patch->tram_acc[i].grp = new_tram_acc[i].grp;
 	}
-
-	return send_response_ok(data_conn);
+	return 0;
 }
 
-int ld10k1_fnc_receive_patch_ctl(int data_conn, ld10k1_patch_t *new_patch)
+static int ld10k1_fnc_patch_copy_ctl(ld10k1_patch_t *new_patch, void *data)
 {
-	ld10k1_dsp_ctl_t *new_ctl = NULL;
+	ld10k1_dsp_ctl_t *new_ctl = (ld10k1_dsp_ctl_t *)data;
 	int i, j;
 
- 	if (!new_patch->ctl_count)
-		return 0;
-
- 	if (!(new_ctl = (ld10k1_dsp_ctl_t *)receive_msg_data_malloc(data_conn, sizeof(ld10k1_dsp_ctl_t) * new_patch->ctl_count)))
-		return LD10K1_ERR_PROTOCOL;
-
-	/* copy values */
 	for (i = 0; i < new_patch->ctl_count; i++) {
 		strncpy(new_patch->ctl[i].name, new_ctl[i].name, 43);
 		new_patch->ctl[i].name[43] = '\0';
@@ -520,22 +1110,14 @@ int ld10k1_fnc_receive_patch_ctl(int data_conn, ld10k1_patch_t *new_patch)
 		for (j = 0; j < new_patch->ctl[i].count; j++)
 			new_patch->ctl[i].value[j] = new_ctl[i].value[j];
 	}
-
-	return send_response_ok(data_conn);
+	return 0;
 }
 
-int ld10k1_fnc_receive_patch_instr(int data_conn, ld10k1_patch_t *new_patch)
+static int ld10k1_fnc_patch_copy_instr(ld10k1_patch_t *new_patch, void *data)
 {
-	ld10k1_dsp_instr_t *new_instr = NULL;
+	ld10k1_dsp_instr_t *new_instr = (ld10k1_dsp_instr_t *)data;
 	int i, j;
 
- 	if (!new_patch->instr_count)
-		return 0;
-
- 	if (!(new_instr = (ld10k1_dsp_instr_t *)receive_msg_data_malloc(data_conn, sizeof(ld10k1_dsp_instr_t) * new_patch->instr_count)))
-		return LD10K1_ERR_PROTOCOL;
-
-	/* copy values */
 	for (i = 0; i < new_patch->instr_count; i++) {
 		new_patch->instr[i].op_code = new_instr[i].op_code;
 		for (j = 0; j < 4; j++)
@@ -543,172 +1125,350 @@ int ld10k1_fnc_receive_patch_instr(int data_conn, ld10k1_patch_t *new_patch)
 		new_patch->instr[i].used = 1;
 		new_patch->instr[i].modified = 1;
 	}
+	return 0;
+}
 
-	return send_response_ok(data_conn);
+/* parts of a patch upload, in the order the client sends them */
+static struct
+{
+	int (*copy)(ld10k1_patch_t *new_patch, void *data);
+	int size;
+	size_t count_offset;
+} patch_add_parts[] =
+{
+	{ld10k1_fnc_patch_copy_in, sizeof(ld10k1_dsp_p_in_out_t), offsetof(ld10k1_patch_t, in_count)},
+	{ld10k1_fnc_patch_copy_out, sizeof(ld10k1_dsp_p_in_out_t), offsetof(ld10k1_patch_t, out_count)},
+	{ld10k1_fnc_patch_copy_const, sizeof(ld10k1_dsp_p_const_static_t), offsetof(ld10k1_patch_t, const_count)},
+	{ld10k1_fnc_patch_copy_sta, sizeof(ld10k1_dsp_p_const_static_t), offsetof(ld10k1_patch_t, sta_count)},
+	{ld10k1_fnc_patch_copy_hw, sizeof(ld10k1_dsp_p_hw_t), offsetof(ld10k1_patch_t, hw_count)},
+	{ld10k1_fnc_patch_copy_tram_grp, sizeof(ld10k1_dsp_tram_grp_t), offsetof(ld10k1_patch_t, tram_count)},
+	{ld10k1_fnc_patch_copy_tram_acc, sizeof(ld10k1_dsp_tram_acc_t), offsetof(ld10k1_patch_t, tram_acc_count)},
+	{ld10k1_fnc_patch_copy_ctl, sizeof(ld10k1_dsp_ctl_t), offsetof(ld10k1_patch_t, ctl_count)},
+	{ld10k1_fnc_patch_copy_instr, sizeof(ld10k1_dsp_instr_t), offsetof(ld10k1_patch_t, instr_count)},
+};
+
+#define PATCH_ADD_PARTS (int)(sizeof(patch_add_parts) / sizeof(patch_add_parts[0]))
+
+static unsigned int ld10k1_fnc_patch_part_count(ld10k1_patch_t *new_patch, int part)
+{
+	return *(unsigned int *)((char *)new_patch + patch_add_parts[part].count_offset);
 }
 
-int ld10k1_fnc_patch_add(int data_conn, int op, int size)
+/* patch with space for everything what info announces */
+static int ld10k1_fnc_patch_new(ld10k1_dsp_patch_t *new_patch_info, ld10k1_patch_t **patch)
 {
 	int err;
-	int loaded[2];
-	int where;
-
-	ld10k1_dsp_patch_t new_patch_info;
-	/* allocate new patch */
 	ld10k1_patch_t *new_patch = NULL;
 
-	if ((err = ld10k1_fnc_receive_patch_info(data_conn, &new_patch_info, &where)) < 0)
-		goto error;
-
 	if (!(new_patch = ld10k1_dsp_mgr_patch_new())) {
 		err = LD10K1_ERR_NO_MEM;
 		goto error;
 	}
 
 	/* name */
-	if (!ld10k1_dsp_mgr_name_new(&(new_patch->patch_name), new_patch_info.patch_name)) {
+	if (!ld10k1_dsp_mgr_name_new(&(new_patch->patch_name), new_patch_info->patch_name)) {
 		err = LD10K1_ERR_NO_MEM;
 		goto error;
 	}
 
 
 	/* set sizes */
-	if (new_patch_info.in_count)
-		if (!ld10k1_dsp_mgr_patch_in_new(new_patch, new_patch_info.in_count)) {
+	if (new_patch_info->in_count)
+		if (!ld10k1_dsp_mgr_patch_in_new(new_patch, new_patch_info->in_count)) {
+			err = LD10K1_ERR_NO_MEM;
+			goto error;
+		}
+
+	if (new_patch_info->out_count)
+		if (!ld10k1_dsp_mgr_patch_out_new(new_patch, new_patch_info->out_count)) {
+			err = LD10K1_ERR_NO_MEM;
+			goto error;
+		}
+
+	if (new_patch_info->const_count)
+		if (!ld10k1_dsp_mgr_patch_const_new(new_patch, new_patch_info->const_count)) {
+			err = LD10K1_ERR_NO_MEM;
+			goto error;
+		}
+
+	if (new_patch_info->static_count)
+		if (!ld10k1_dsp_mgr_patch_sta_new(new_patch, new_patch_info->static_count)) {
+			err = LD10K1_ERR_NO_MEM;
+			goto error;
+		}
+
+	if (new_patch_info->dynamic_count)
+		if (!ld10k1_dsp_mgr_patch_dyn_new(new_patch, new_patch_info->dynamic_count)) {
+			err = LD10K1_ERR_NO_MEM;
+			goto error;
+		}
+
+	if (new_patch_info->hw_count)
+		if (!ld10k1_dsp_mgr_patch_hw_new(new_patch, new_patch_info->hw_count)) {
+			err = LD10K1_ERR_NO_MEM;
+			goto error;
+		}
+
+	if (new_patch_info->tram_count)
+		if (!ld10k1_dsp_mgr_patch_tram_new(new_patch, new_patch_info->tram_count)) {
+			err = LD10K1_ERR_NO_MEM;
+			goto error;
+		}
+
+	if (new_patch_info->tram_acc_count)
+		if (!ld10k1_dsp_mgr_patch_tram_acc_new(new_patch, new_patch_info->tram_acc_count)) {
+			err = LD10K1_ERR_NO_MEM;
+			goto error;
+		}
+
+	if (new_patch_info->ctl_count)
+		if (!ld10k1_dsp_mgr_patch_ctl_new(new_patch,new_patch_info->ctl_count)) {
 			err = LD10K1_ERR_NO_MEM;
 			goto error;
 		}
 
-	if (new_patch_info.out_count)
-		if (!ld10k1_dsp_mgr_patch_out_new(new_patch, new_patch_info.out_count)) {
-			err = LD10K1_ERR_NO_MEM;
-			goto error;
+	if (!ld10k1_dsp_mgr_patch_instr_new(new_patch, new_patch_info->instr_count)) {
+		err = LD10K1_ERR_NO_MEM;
+		goto error;
+	}
+
+	*patch = new_patch;
+	return 0;
+error:
+	if (new_patch)
+		ld10k1_dsp_mgr_patch_free(new_patch);
+	return err;
+}
+
+int ld10k1_fnc_patch_add(int data_conn, int op, int size)
+{
+	ClientDef *c = clients[data_conn];
+	int err, i;
+	int where;
+	unsigned int image_size;
+
+	ld10k1_dsp_patch_t new_patch_info;
+	ld10k1_fnc_repo_key_t key;
+	/* allocate new patch */
+	ld10k1_patch_t *new_patch = NULL;
+
+	if ((err = ld10k1_fnc_receive_patch_info(data_conn, op, &new_patch_info, &where, &key)) < 0)
+		return err;
+
+	if ((err = ld10k1_fnc_patch_new(&new_patch_info, &new_patch)) < 0)
+		return err;
+
+	/* upload is kept for repository as it comes */
+	if (op == FNC_REPO_PATCH_ADD) {
+		image_size = sizeof(ld10k1_dsp_patch_t);
+		for (i = 0; i < PATCH_ADD_PARTS; i++)
+			image_size += ld10k1_fnc_patch_part_count(new_patch, i) * patch_add_parts[i].size;
+		if (!(c->add_image = (char *)malloc(image_size))) {
+			ld10k1_dsp_mgr_patch_free(new_patch);
+			return LD10K1_ERR_NO_MEM;
+		}
+		memcpy(c->add_image, &new_patch_info, sizeof(ld10k1_dsp_patch_t));
+		c->add_image_len = sizeof(ld10k1_dsp_patch_t);
+		c->add_key = key;
+	}
+
+	/* next parts arrive one by one, see ld10k1_fnc_patch_add_continue */
+	c->add_patch = new_patch;
+	c->add_where = where;
+	c->add_part = 0;
+	c->state = CLIENT_STATE_PATCH_ADD;
+	return FNC_PENDING;
+}
+
+static void ld10k1_fnc_patch_add_end(ClientDef *c)
+{
+	c->add_patch = NULL;
+	free(c->add_image);
+	c->add_image = NULL;
+	c->state = CLIENT_STATE_REQUEST;
+}
+
+static int ld10k1_fnc_patch_add_continue(int data_conn)
+{
+	ClientDef *c = clients[data_conn];
+	ld10k1_patch_t *new_patch = c->add_patch;
+	ld10k1_fnc_event_t event;
+	int err;
+	int loaded[2];
+	unsigned int count = 0;
+	int part_size;
+	void *data;
+
+	/* skip empty parts, client does not send them */
+	while (c->add_part < PATCH_ADD_PARTS) {
+		count = ld10k1_fnc_patch_part_count(new_patch, c->add_part);
+		if (count)
+			break;
+		c->add_part++;
+	}
+
+	if (c->add_part < PATCH_ADD_PARTS) {
+		part_size = count * patch_add_parts[c->add_part].size;
+		if (c->in_len - c->in_pos < part_size)
+			return FNC_PENDING;
+		c->in_end = c->in_pos + part_size;
+		if (!(data = client_receive_malloc(data_conn, part_size)))
+			err = LD10K1_ERR_PROTOCOL;
+		else {
+			err = (*patch_add_parts[c->add_part].copy)(new_patch, data);
+			if (!err && c->add_image) {
+				memcpy(c->add_image + c->add_image_len, data, part_size);
+				c->add_image_len += part_size;
+			}
+			free(data);
 		}
-
-	if (new_patch_info.const_count)
-		if (!ld10k1_dsp_mgr_patch_const_new(new_patch, new_patch_info.const_count)) {
-			err = LD10K1_ERR_NO_MEM;
+		c->in_pos = c->in_end;
+		if (err < 0 || (err = send_response_ok(data_conn)) < 0)
 			goto error;
-		}
+		c->add_part++;
+		return FNC_PENDING;
+	}
 
-	if (new_patch_info.static_count)
-		if (!ld10k1_dsp_mgr_patch_sta_new(new_patch, new_patch_info.static_count)) {
-			err = LD10K1_ERR_NO_MEM;
-			goto error;
-		}
+	/* check patch */
+	if ((err = ld10k1_patch_fnc_check_patch(&dsp_mgr, new_patch)) < 0)
+		goto error;
 
-	if (new_patch_info.dynamic_count)
-		if (!ld10k1_dsp_mgr_patch_dyn_new(new_patch, new_patch_info.dynamic_count)) {
-			err = LD10K1_ERR_NO_MEM;
-			goto error;
-		}
+	/* load patch */
+	if ((err = ld10k1_dsp_mgr_patch_load(&dsp_mgr, new_patch, c->add_where, loaded)) < 0)
+		goto error;
 
-	if (new_patch_info.hw_count)
-		if (!ld10k1_dsp_mgr_patch_hw_new(new_patch, new_patch_info.hw_count)) {
-			err = LD10K1_ERR_NO_MEM;
-			goto error;
-		}
+	/* patch is fine, it can be loaded from repository next time */
+	if (c->add_image && ld10k1_repo_add(c->add_key.hash, c->add_key.name, c->add_image, c->add_image_len) < 0)
+		error("unable to store patch %s in repository", c->add_key.name);
+	ld10k1_fnc_patch_add_end(c);
 
-	if (new_patch_info.tram_count)
-		if (!ld10k1_dsp_mgr_patch_tram_new(new_patch, new_patch_info.tram_count)) {
-			err = LD10K1_ERR_NO_MEM;
-			goto error;
-		}
+	event_init(&event, LD10K1_EVENT_PATCH_ADD, loaded[0]);
+	event_publish(&event);
 
-	if (new_patch_info.tram_acc_count)
-		if (!ld10k1_dsp_mgr_patch_tram_acc_new(new_patch, new_patch_info.tram_acc_count)) {
-			err = LD10K1_ERR_NO_MEM;
-			goto error;
-		}
+	if ((err = send_response_wd(data_conn, loaded, sizeof(loaded))) < 0)
+		return err;
 
-	if (new_patch_info.ctl_count)
-		if (!ld10k1_dsp_mgr_patch_ctl_new(new_patch,new_patch_info.ctl_count)) {
-			err = LD10K1_ERR_NO_MEM;
-			goto error;
-		}
+	return 0;
+error:
+	ld10k1_fnc_patch_add_end(c);
+	ld10k1_dsp_mgr_patch_free(new_patch);
+	return err;
+}
 
-	if (!ld10k1_dsp_mgr_patch_instr_new(new_patch, new_patch_info.instr_count)) {
-		err = LD10K1_ERR_NO_MEM;
-		goto error;
-	}
+/* patch from repository image - ld10k1_dsp_patch_t followed by parts */
+static int ld10k1_fnc_patch_from_image(ld10k1_repo_image_t *image, char *patch_name, ld10k1_patch_t **patch)
+{
+	ld10k1_dsp_patch_t new_patch_info;
+	ld10k1_patch_t *new_patch = NULL;
+	unsigned int pos, part_size;
+	int i, err;
 
-	/* receive next parts */
-	if (new_patch_info.in_count)
-		if ((err = ld10k1_fnc_receive_patch_in(data_conn, new_patch)) < 0)
-			goto error;
+	if (image->size < sizeof(ld10k1_dsp_patch_t))
+		return LD10K1_ERR_REPO_IMAGE;
+	memcpy(&new_patch_info, image->data, sizeof(ld10k1_dsp_patch_t));
+	if (patch_name[0])
+		strcpy(new_patch_info.patch_name, patch_name);
+	if (ld10k1_fnc_check_patch_info(&new_patch_info) < 0)
+		return LD10K1_ERR_REPO_IMAGE;
 
-	if (new_patch_info.out_count)
-		if ((err = ld10k1_fnc_receive_patch_out(data_conn, new_patch)) < 0)
-			goto error;
+	if ((err = ld10k1_fnc_patch_new(&new_patch_info, &new_patch)) < 0)
+		return err;
 
-	if (new_patch_info.const_count)
-		if ((err = ld10k1_fnc_receive_patch_const(data_conn, new_patch)) < 0)
+	pos = sizeof(ld10k1_dsp_patch_t);
+	for (i = 0; i < PATCH_ADD_PARTS; i++) {
+		part_size = ld10k1_fnc_patch_part_count(new_patch, i) * patch_add_parts[i].size;
+		if (!part_size)
+			continue;
+		if (part_size > image->size - pos) {
+			err = LD10K1_ERR_REPO_IMAGE;
 			goto error;
-
-	if (new_patch_info.static_count)
-		if ((err = ld10k1_fnc_receive_patch_sta(data_conn, new_patch)) < 0)
+		}
+		if ((err = (*patch_add_parts[i].copy)(new_patch, (char *)image->data + pos)) < 0)
 			goto error;
+		pos += part_size;
+	}
 
-	if (new_patch_info.hw_count)
-		if ((err = ld10k1_fnc_receive_patch_hw(data_conn, new_patch)) < 0)
-			goto error;
+	*patch = new_patch;
+	return 0;
+error:
+	ld10k1_dsp_mgr_patch_free(new_patch);
+	return err;
+}
 
-	if (new_patch_info.tram_count)
-		if ((err = ld10k1_fnc_receive_patch_tram_grp(data_conn, new_patch)) < 0)
-			goto error;
+int ld10k1_fnc_repo_load(int data_conn, int op, int size)
+{
+	ld10k1_fnc_repo_load_t load_info;
+	ld10k1_repo_image_t *image;
+	ld10k1_patch_t *new_patch;
+	ld10k1_fnc_event_t event;
+	int loaded[2];
+	int err;
 
-	if (new_patch_info.tram_acc_count)
-		if ((err = ld10k1_fnc_receive_patch_tram_acc(data_conn, new_patch)) < 0)
-			goto error;
+	if ((err = client_receive(data_conn, &load_info, sizeof(ld10k1_fnc_repo_load_t))) < 0)
+		return err;
 
-	if (new_patch_info.ctl_count)
-		if ((err = ld10k1_fnc_receive_patch_ctl(data_conn, new_patch)) < 0)
-			goto error;
+	load_info.key.name[MAX_NAME_LEN - 1] = '\0';
+	load_info.patch_name[MAX_NAME_LEN - 1] = '\0';
 
-	if ((err = ld10k1_fnc_receive_patch_instr(data_conn, new_patch)) < 0)
-		goto error;
+	if (!(image = ld10k1_repo_find(load_info.key.hash, load_info.key.name)))
+		return LD10K1_ERR_REPO_NOT_FOUND;
+
+	if ((err = ld10k1_fnc_patch_from_image(image, load_info.patch_name, &new_patch)) < 0)
+		return err;
 
-	/* check patch */
 	if ((err = ld10k1_patch_fnc_check_patch(&dsp_mgr, new_patch)) < 0)
 		goto error;
 
-	/* load patch */
-	if ((err = ld10k1_dsp_mgr_patch_load(&dsp_mgr, new_patch, where, loaded)) < 0)
+	if ((err = ld10k1_dsp_mgr_patch_load(&dsp_mgr, new_patch, load_info.where, loaded)) < 0)
 		goto error;
 
-	if ((err = send_response_wd(data_conn, loaded, sizeof(loaded))) < 0)
-		return err;
+	event_init(&event, LD10K1_EVENT_PATCH_ADD, loaded[0]);
+	event_publish(&event);
 
-	return 0;
+	return send_response_wd(data_conn, loaded, sizeof(loaded));
 error:
-	if (new_patch)
-		ld10k1_dsp_mgr_patch_free(new_patch);
+	ld10k1_dsp_mgr_patch_free(new_patch);
 	return err;
 }
 
 int ld10k1_fnc_patch_del(int data_conn, int op, int size)
 {
 	ld10k1_fnc_patch_del_t patch_info;
+	ld10k1_fnc_event_t event;
 	int err;
 
-	if ((err = receive_msg_data(data_conn, &patch_info, sizeof(ld10k1_fnc_patch_del_t))) < 0)
+	if ((err = client_receive(data_conn, &patch_info, sizeof(ld10k1_fnc_patch_del_t))) < 0)
+		return err;
+
+	/* id is gone after unload */
+	event_init(&event, LD10K1_EVENT_PATCH_DEL, patch_info.where);
+	if ((err = ld10k1_patch_fnc_del(&dsp_mgr, &patch_info)) < 0)
 		return err;
 
-	return ld10k1_patch_fnc_del(&dsp_mgr, &patch_info);
+	event_publish(&event);
+	return 0;
 }
 
 int ld10k1_fnc_patch_conn(int data_conn, int op, int size)
 {
 	ld10k1_fnc_connection_t connection_info;
+	ld10k1_fnc_event_t event;
 	int err;
 	int conn_id;
 
-	if ((err = receive_msg_data(data_conn, &connection_info, sizeof(ld10k1_fnc_connection_t))) < 0)
+	if ((err = client_receive(data_conn, &connection_info, sizeof(ld10k1_fnc_connection_t))) < 0)
 		return err;
 
 	if ((err = ld10k1_connection_fnc(&dsp_mgr, &connection_info, &conn_id)) < 0)
 		return err;
-		
+
+	event_init(&event, op == FNC_CONNECTION_ADD ? LD10K1_EVENT_CONNECTION_ADD : LD10K1_EVENT_CONNECTION_DEL,
+		connection_info.from_patch);
+	event.io_type = connection_info.from_type;
+	event.io = connection_info.from_io;
+	event.point_id = conn_id;
+	event_publish(&event);
+
 	return send_response_wd(data_conn, &conn_id, sizeof(conn_id));
 }
 
@@ -716,25 +1476,20 @@ int ld10k1_fnc_name_find(int data_conn, int op, int size)
 {
 	ld10k1_fnc_name_t name_info;
 	int i;
-	static int ret;
+	static LD10K1_CARD_STATE int ret;
 	int err;
 	ld10k1_patch_t *patch;
 
 	ret = -1;
 
-	if ((err = receive_msg_data(data_conn, &name_info, sizeof(ld10k1_fnc_name_t))) < 0)
+	if ((err = client_receive(data_conn, &name_info, sizeof(ld10k1_fnc_name_t))) < 0)
 		return err;
 
 	name_info.name[MAX_NAME_LEN - 1] = '\0';
 
 	switch (op)	{
 		case FNC_PATCH_FIND:
-			for (i = 0; i < EMU10K1_PATCH_MAX ; i++)
-				if (dsp_mgr.patch_ptr[i])
-					if (strcmp(dsp_mgr.patch_ptr[i]->patch_name, name_info.name) == 0) {
-						ret = i;
-						break;
-					}
+			ret = ld10k1_patch_find(&dsp_mgr, name_info.name);
 			break;
 		case FNC_FX_FIND:
 			for (i = 0; i < dsp_mgr.fx_count ; i++)
@@ -792,10 +1547,11 @@ int ld10k1_fnc_name_find(int data_conn, int op, int size)
 int ld10k1_fnc_name_rename(int data_conn, int op, int size)
 {
 	ld10k1_fnc_name_t name_info;
+	ld10k1_fnc_event_t event;
 	int err;
 	ld10k1_patch_t *patch;
 
-	if ((err = receive_msg_data(data_conn, &name_info, sizeof(ld10k1_fnc_name_t))) < 0)
+	if ((err = client_receive(data_conn, &name_info, sizeof(ld10k1_fnc_name_t))) < 0)
 		return err;
 
 	name_info.name[MAX_NAME_LEN - 1] = '\0';
@@ -805,8 +1561,11 @@ int ld10k1_fnc_name_rename(int data_conn, int op, int size)
 			if (name_info.patch_num >= 0 || name_info.patch_num < EMU10K1_PATCH_MAX) {
 				patch = dsp_mgr.patch_ptr[name_info.patch_num];
 				if (patch) {
-					if (!ld10k1_dsp_mgr_name_new(&(patch->patch_name), name_info.name))
-						return LD10K1_ERR_PATCH_RENAME;
+					ld10k1_patch_name_hash_del(&dsp_mgr, name_info.patch_num);
+					err = ld10k1_dsp_mgr_name_new(&(patch->patch_name), name_info.name) ? 0 : LD10K1_ERR_PATCH_RENAME;
+					ld10k1_patch_name_hash_add(&dsp_mgr, name_info.patch_num);
+					if (err < 0)
+						return err;
 				} else
 					return LD10K1_ERR_UNKNOWN_PATCH_NUM;
 			} else
@@ -857,18 +1616,50 @@ int ld10k1_fnc_name_rename(int data_conn, int op, int size)
 				return LD10K1_ERR_UNKNOWN_PATCH_NUM;
 			break;
 	}
+
+	if (op == FNC_PATCH_RENAME) {
+		event_init(&event, LD10K1_EVENT_PATCH_RENAME, name_info.patch_num);
+	} else {
+		event_init(&event, LD10K1_EVENT_IO_RENAME, -1);
+		switch (op) {
+			case FNC_FX_RENAME:
+				event.io_type = CON_IO_FX;
+				break;
+			case FNC_IN_RENAME:
+				event.io_type = CON_IO_IN;
+				break;
+			case FNC_OUT_RENAME:
+				event.io_type = CON_IO_OUT;
+				break;
+			case FNC_PATCH_IN_RENAME:
+				event_init(&event, LD10K1_EVENT_IO_RENAME, name_info.patch_num);
+				event.io_type = CON_IO_PIN;
+				break;
+			case FNC_PATCH_OUT_RENAME:
+				event_init(&event, LD10K1_EVENT_IO_RENAME, name_info.patch_num);
+				event.io_type = CON_IO_POUT;
+				break;
+		}
+		event.io = name_info.gpr;
+	}
+	event_publish(&event);
 	return 0;
 }
 
 int ld10k1_fnc_dsp_init(int data_conn, int op, int size)
 {
-	int audigy;
+	int audigy, staged;
 	int err, i;
 	
 	ld10k1_reserved_ctl_list_item_t *rlist;
 	int save_ids[EMU10K1_PATCH_MAX];
+	ld10k1_fnc_event_t event;
+
+	if (transaction_client >= 0)
+		return LD10K1_ERR_TRANSACTION;
 
 	audigy = dsp_mgr.audigy;
+	staged = dsp_mgr.staged;
 
 	rlist = dsp_mgr.reserved_ctl_list; /* FIXME - hack to save reserved ctls and ids */
 	for (i = 0; i < EMU10K1_PATCH_MAX; i++)
@@ -878,6 +1669,7 @@ int ld10k1_fnc_dsp_init(int data_conn, int op, int size)
 	memset(&dsp_mgr, 0, sizeof(dsp_mgr));
 
 	dsp_mgr.audigy = audigy;
+	dsp_mgr.staged = staged;
 
 	if ((err = ld10k1_dsp_mgr_init(&dsp_mgr)) < 0)
 		return err;
@@ -887,7 +1679,12 @@ int ld10k1_fnc_dsp_init(int data_conn, int op, int size)
 	for (i = 0; i < EMU10K1_PATCH_MAX; i++)
 		dsp_mgr.patch_id_gens[i] = save_ids[i];
 
-	return ld10k1_init_driver(&dsp_mgr, -1);
+	if ((err = ld10k1_init_driver(&dsp_mgr, -1)) < 0)
+		return err;
+
+	event_init(&event, LD10K1_EVENT_DSP_INIT, -1);
+	event_publish(&event);
+	return 0;
 }
 
 int ld10k1_fnc_get_io_count(int data_conn, int op, int size)
@@ -917,7 +1714,7 @@ int ld10k1_fnc_get_io(int data_conn, int op, int size)
 	int reg_num;
 	ld10k1_fnc_get_io_t io;
 
-	if ((err = receive_msg_data(data_conn, &reg_num, sizeof(int))) < 0)
+	if ((err = client_receive(data_conn, &reg_num, sizeof(int))) < 0)
 		return err;
 
 	if (op == FNC_GET_FX)
@@ -961,7 +1758,7 @@ int ld10k1_fnc_get_pio_count(int data_conn, int op, int size)
 	int reg_count;
 	ld10k1_patch_t *patch;
 
-	if ((err = receive_msg_data(data_conn, &patch_num, sizeof(int))) < 0)
+	if ((err = client_receive(data_conn, &patch_num, sizeof(int))) < 0)
 		return err;
 
 	reg_count = 0;
@@ -995,7 +1792,7 @@ int ld10k1_fnc_get_pio(int data_conn, int op, int size)
 	ld10k1_fnc_get_io_t io;
 	ld10k1_patch_t *patch;
 
-	if ((err = receive_msg_data(data_conn, tmp_num, sizeof(int) * 2)) < 0)
+	if ((err = client_receive(data_conn, tmp_num, sizeof(int) * 2)) < 0)
 		return err;
 	
 	patch_num = tmp_num[0];
@@ -1097,7 +1894,7 @@ int ld10k1_fnc_send_patch_in(int data_conn, ld10k1_patch_t *patch)
 				ins[i].name[0] = '\0';
 		}
 
-		if ((err = send_response(data_conn, FNC_CONTINUE, 0, ins, sizeof(ld10k1_dsp_p_in_out_t) * patch->in_count)) < 0) {
+		if ((err = client_response(data_conn, FNC_CONTINUE, 0, ins, sizeof(ld10k1_dsp_p_in_out_t) * patch->in_count)) < 0) {
 			free(ins);
 			return err;
 		}
@@ -1125,7 +1922,7 @@ int ld10k1_fnc_send_patch_out(int data_conn, ld10k1_patch_t *patch)
 				outs[i].name[0] = '\0';
 		}
 
-		if ((err = send_response(data_conn, FNC_CONTINUE, 0, outs, sizeof(ld10k1_dsp_p_in_out_t) * patch->out_count)) < 0) {
+		if ((err = client_response(data_conn, FNC_CONTINUE, 0, outs, sizeof(ld10k1_dsp_p_in_out_t) * patch->out_count)) < 0) {
 			free(outs);
 			return err;
 		}
@@ -1148,7 +1945,7 @@ int ld10k1_fnc_send_patch_const(int data_conn, ld10k1_patch_t *patch)
 		for (i = 0; i < patch->const_count; i++)
 			consts[i].const_val = patch->consts[i].const_val;
 
-		if ((err = send_response(data_conn, FNC_CONTINUE, 0, consts, sizeof(ld10k1_dsp_p_const_static_t) * patch->const_count)) < 0) {
+		if ((err = client_response(data_conn, FNC_CONTINUE, 0, consts, sizeof(ld10k1_dsp_p_const_static_t) * patch->const_count)) < 0) {
 			free(consts);
 			return err;
 		}
@@ -1171,7 +1968,7 @@ int ld10k1_fnc_send_patch_sta(int data_conn, ld10k1_patch_t *patch)
 		for (i = 0; i < patch->sta_count; i++)
 			stas[i].const_val = patch->stas[i].const_val;
 
-		if ((err = send_response(data_conn, FNC_CONTINUE, 0, stas, sizeof(ld10k1_dsp_p_const_static_t) * patch->sta_count)) < 0) {
+		if ((err = client_response(data_conn, FNC_CONTINUE, 0, stas, sizeof(ld10k1_dsp_p_const_static_t) * patch->sta_count)) < 0) {
 			free(stas);
 			return err;
 		}
@@ -1194,7 +1991,7 @@ int ld10k1_fnc_send_patch_hw(int data_conn, ld10k1_patch_t *patch)
 		for (i = 0; i < patch->hw_count; i++)
 			hws[i].hw_val = patch->hws[i].reg_idx;
 
-		if ((err = send_response(data_conn, FNC_CONTINUE, 0, hws, sizeof(ld10k1_dsp_p_hw_t) * patch->hw_count)) < 0) {
+		if ((err = client_response(data_conn, FNC_CONTINUE, 0, hws, sizeof(ld10k1_dsp_p_hw_t) * patch->hw_count)) < 0) {
 			free(hws);
 			return err;
 		}
@@ -1220,7 +2017,7 @@ int ld10k1_fnc_send_patch_tram_grp(int data_conn, ld10k1_patch_t *patch)
 			grps[i].grp_pos = patch->tram_grp[i].grp_pos;
 		}
 
-		if ((err = send_response(data_conn, FNC_CONTINUE, 0, grps, sizeof(ld10k1_dsp_tram_grp_t) * patch->tram_count)) < 0) {
+		if ((err = client_response(data_conn, FNC_CONTINUE, 0, grps, sizeof(ld10k1_dsp_tram_grp_t) * patch->tram_count)) < 0) {
 			free(grps);
 			return err;
 		}
@@ -1246,7 +2043,7 @@ int ld10k1_fnc_send_patch_tram_acc(int data_conn, ld10k1_patch_t *patch)
 			accs[i].grp = patch->tram_acc[i].grp;
 		}
 
-		if ((err = send_response(data_conn, FNC_CONTINUE, 0, accs, sizeof(ld10k1_dsp_tram_acc_t) * patch->tram_acc_count)) < 0) {
+		if ((err = client_response(data_conn, FNC_CONTINUE, 0, accs, sizeof(ld10k1_dsp_tram_acc_t) * patch->tram_acc_count)) < 0) {
 			free(accs);
 			return err;
 		}
@@ -1281,7 +2078,7 @@ int ld10k1_fnc_send_patch_ctl(int data_conn, ld10k1_patch_t *patch)
 				ctls[i].value[j] = patch->ctl[i].value[j];
 		}
 
-		if ((err = send_response(data_conn, FNC_CONTINUE, 0, ctls, sizeof(ld10k1_dsp_ctl_t) * patch->ctl_count)) < 0) {
+		if ((err = client_response(data_conn, FNC_CONTINUE, 0, ctls, sizeof(ld10k1_dsp_ctl_t) * patch->ctl_count)) < 0) {
 			free(ctls);
 			return err;
 		}
@@ -1307,7 +2104,7 @@ int ld10k1_fnc_send_patch_instr(int data_conn, ld10k1_patch_t *patch)
 				instrs[i].arg[j] = patch->instr[i].arg[j];
 		}
 
-		if ((err = send_response(data_conn, FNC_CONTINUE, 0, instrs, sizeof(ld10k1_dsp_instr_t) * patch->instr_count)) < 0) {
+		if ((err = client_response(data_conn, FNC_CONTINUE, 0, instrs, sizeof(ld10k1_dsp_instr_t) * patch->instr_count)) < 0) {
 			free(instrs);
 			return err;
 		}
@@ -1318,67 +2115,78 @@ int ld10k1_fnc_send_patch_instr(int data_conn, ld10k1_patch_t *patch)
 }
 
 
-int ld10k1_fnc_get_patch(int data_conn, int op, int size)
+/* sends the patch header and all its parts as FNC_CONTINUE messages */
+static int ld10k1_fnc_send_patch(int data_conn, ld10k1_patch_t *patch)
 {
 	int err;
-
 	ld10k1_dsp_patch_t patch_info;
-	int patch_num = -1;
-	ld10k1_patch_t *patch;
 
-	if ((err = receive_msg_data(data_conn, &patch_num, sizeof(patch_num))) < 0)
+	strcpy(patch_info.patch_name, patch->patch_name);
+	patch_info.id = patch->id;
+	patch_info.in_count = patch->in_count;
+	patch_info.out_count = patch->out_count;
+	patch_info.const_count = patch->const_count;
+	patch_info.static_count = patch->sta_count;
+	patch_info.dynamic_count = patch->dyn_count;
+	patch_info.hw_count = patch->hw_count;
+	patch_info.tram_count = patch->tram_count;
+	patch_info.tram_acc_count = patch->tram_acc_count;
+	patch_info.ctl_count = patch->ctl_count;
+	patch_info.instr_count = patch->instr_count;
+
+	if ((err = client_response(data_conn, FNC_CONTINUE, 0, &patch_info, sizeof(ld10k1_dsp_patch_t))) < 0)
 		return err;
 
-	if (dsp_mgr.patch_count >= 0) {
+	/* send next parts */
+	if ((err = ld10k1_fnc_send_patch_in(data_conn, patch)) < 0)
+		return err;
 
-		if (patch_num > EMU10K1_PATCH_MAX)
-			return LD10K1_ERR_UNKNOWN_PATCH_NUM;
-		patch = dsp_mgr.patch_ptr[patch_num];
-		if (!patch)
-			return LD10K1_ERR_UNKNOWN_PATCH_NUM;
+	if ((err = ld10k1_fnc_send_patch_out(data_conn, patch)) < 0)
+		return err;
 
-		strcpy(patch_info.patch_name, patch->patch_name);
-		patch_info.id = patch->id;
-		patch_info.in_count = patch->in_count;
-		patch_info.out_count = patch->out_count;
-		patch_info.const_count = patch->const_count;
-		patch_info.static_count = patch->sta_count;
-		patch_info.dynamic_count = patch->dyn_count;
-		patch_info.hw_count = patch->hw_count;
-		patch_info.tram_count = patch->tram_count;
-		patch_info.tram_acc_count = patch->tram_acc_count;
-		patch_info.ctl_count = patch->ctl_count;
-		patch_info.instr_count = patch->instr_count;
-
-		if ((err = send_response(data_conn, FNC_CONTINUE, 0, &patch_info, sizeof(ld10k1_dsp_patch_t))) < 0)
-			return err;
+	if ((err = ld10k1_fnc_send_patch_const(data_conn, patch)) < 0)
+		return err;
 
-  		/* send next parts */
-		if ((err = ld10k1_fnc_send_patch_in(data_conn, patch)) < 0)
-			return err;
+	if ((err = ld10k1_fnc_send_patch_sta(data_conn, patch)) < 0)
+		return err;
 
-		if ((err = ld10k1_fnc_send_patch_out(data_conn, patch)) < 0)
-			return err;
+	if ((err = ld10k1_fnc_send_patch_hw(data_conn, patch)) < 0)
+		return err;
 
-		if ((err = ld10k1_fnc_send_patch_const(data_conn, patch)) < 0)
-			return err;
+	if ((err = ld10k1_fnc_send_patch_tram_grp(data_conn, patch)) < 0)
+		return err;
 
-		if ((err = ld10k1_fnc_send_patch_sta(data_conn, patch)) < 0)
-			return err;
+	if ((err = ld10k1_fnc_send_patch_tram_acc(data_conn, patch)) < 0)
+		return err;
 
-		if ((err = ld10k1_fnc_send_patch_hw(data_conn, patch)) < 0)
-			return err;
+	if ((err = ld10k1_fnc_send_patch_ctl(data_conn, patch)) < 0)
+		return err;
 
-		if ((err = ld10k1_fnc_send_patch_tram_grp(data_conn, patch)) < 0)
-			return err;
+	if ((err = ld10k1_fnc_send_patch_instr(data_conn, patch)) < 0)
+		return err;
 
-		if ((err = ld10k1_fnc_send_patch_tram_acc(data_conn, patch)) < 0)
-			return err;
+	return 0;
+}
 
-		if ((err = ld10k1_fnc_send_patch_ctl(data_conn, patch)) < 0)
-			return err;
+int ld10k1_fnc_get_patch(int data_conn, int op, int size)
+{
+	int err;
+
+	int patch_num = -1;
+	ld10k1_patch_t *patch;
+
+	if ((err = client_receive(data_conn, &patch_num, sizeof(patch_num))) < 0)
+		return err;
+
+	if (dsp_mgr.patch_count >= 0) {
+
+		if (patch_num > EMU10K1_PATCH_MAX)
+			return LD10K1_ERR_UNKNOWN_PATCH_NUM;
+		patch = dsp_mgr.patch_ptr[patch_num];
+		if (!patch)
+			return LD10K1_ERR_UNKNOWN_PATCH_NUM;
 
-		if ((err = ld10k1_fnc_send_patch_instr(data_conn, patch)) < 0)
+		if ((err = ld10k1_fnc_send_patch(data_conn, patch)) < 0)
 			return err;
 	}
 
@@ -1395,7 +2203,7 @@ int ld10k1_fnc_dump(int data_conn, int op, int size)
 	if ((err = ld10k1_make_dump(&dsp_mgr, &dump, &dump_size)) < 0)
 		return err;
 
-	if ((err = send_response(data_conn, FNC_CONTINUE, 0, dump, dump_size)) < 0)
+	if ((err = client_response(data_conn, FNC_CONTINUE, 0, dump, dump_size)) < 0)
 		return err;
 
 	free(dump);
@@ -1433,62 +2241,63 @@ int ld10k1_fnc_get_points_info(int data_conn, int op, int size)
 	return send_response_wd(data_conn, info, sizeof(int) * point_count);
 }
 
+/*
+ * Fills the client view of a connection point.  Connected patches are
+ * identified by their id or, with by_order, by their position in the
+ * patch order as used by the snapshot.
+ */
+static void ld10k1_fnc_point_info(ld10k1_conn_point_t *point, ld10k1_dsp_point_t *info, int by_order)
+{
+	int k, l;
+
+	memset(info, 0, sizeof(ld10k1_dsp_point_t));
+	info->id = point->id;
+
+	if (EMU10K1_REG_TYPE_B(point->con_gpr_idx) == EMU10K1_REG_TYPE_NORMAL)
+		info->type = CON_IO_NORMAL;
+	else if (EMU10K1_REG_TYPE_B(point->con_gpr_idx) == EMU10K1_REG_TYPE_INPUT)
+		info->type = CON_IO_IN;
+	else if (EMU10K1_REG_TYPE_B(point->con_gpr_idx) == EMU10K1_REG_TYPE_OUTPUT)
+		info->type = CON_IO_OUT;
+	else if (EMU10K1_REG_TYPE_B(point->con_gpr_idx) == EMU10K1_REG_TYPE_FX)
+		info->type = CON_IO_FX;
+	info->io_idx = point->con_gpr_idx & ~EMU10K1_REG_TYPE_MASK;
+	info->simple = point->simple;
+	info->conn_count = point->con_count;
+	if (info->conn_count > 2 && info->type == CON_IO_NORMAL)
+		info->multi = 1;
+	else if (info->conn_count > 1 && info->type != CON_IO_NORMAL)
+		info->multi = 1;
+	else
+		info->multi = 0;
+	for (k = 0, l = 0; k < POINT_MAX_CONN_PER_POINT; k++) {
+		if (point->type[k]) {
+			info->io_type[l] = point->type[k] == CON_IO_PIN ? 0 : 1;
+			info->patch[l] = point->patch[k] ? (by_order ? point->patch[k]->order : point->patch[k]->id) : -1;
+			info->io[l] = point->io[k];
+			l++;
+		}
+	}
+}
+
 int ld10k1_fnc_get_point_info(int data_conn, int op, int size)
 {
 	int err;
 
-	int k, l;
 	ld10k1_dsp_point_t info;
-	ld10k1_conn_point_t *point;
 	ld10k1_conn_point_t *found_point;
 	int what_point_id;
 
 	/*info = NULL;*/
 
-	if ((err = receive_msg_data(data_conn, &what_point_id, sizeof(int))) < 0)
+	if ((err = client_receive(data_conn, &what_point_id, sizeof(int))) < 0)
 		return err;
 
-	found_point = NULL;
-	
-	point = dsp_mgr.point_list;
-	while (point) {
-		if (point->id == what_point_id) {
-			found_point = point;
-			break;
-		}
-		point = point->next;
-	}
-	
+	found_point = ld10k1_conn_point_find(&dsp_mgr, what_point_id);
 	if (!found_point)
 		return LD10K1_ERR_UNKNOWN_POINT;
 	
-	info.id = point->id;
-			
-	if (EMU10K1_REG_TYPE_B(point->con_gpr_idx) == EMU10K1_REG_TYPE_NORMAL)
-		info.type = CON_IO_NORMAL;
-	else if (EMU10K1_REG_TYPE_B(point->con_gpr_idx) == EMU10K1_REG_TYPE_INPUT)
-		info.type = CON_IO_IN;
-	else if (EMU10K1_REG_TYPE_B(point->con_gpr_idx) == EMU10K1_REG_TYPE_OUTPUT)
-		info.type = CON_IO_OUT;
-	else if (EMU10K1_REG_TYPE_B(point->con_gpr_idx) == EMU10K1_REG_TYPE_FX)
-		info.type = CON_IO_FX;
-	info.io_idx = point->con_gpr_idx & ~EMU10K1_REG_TYPE_MASK;
-	info.simple = point->simple;
-	info.conn_count = point->con_count;
-	if (info.conn_count > 2 && info.type == CON_IO_NORMAL)
-		info.multi = 1;
-	else if (info.conn_count > 1 && info.type != CON_IO_NORMAL)
-		info.multi = 1;
-	else
-		info.multi = 0;
-	for (k = 0, l = 0; k < POINT_MAX_CONN_PER_POINT; k++) {
-		if (point->type[k]) {
-			info.io_type[l] = point->type[k] == CON_IO_PIN ? 0 : 1;
-			info.patch[l] = point->patch[k] ? point->patch[k]->id : -1;
-			info.io[l] = point->io[k];
-			l++;
-		}
-	}
+	ld10k1_fnc_point_info(found_point, &info, 0);
 
 	return send_response_wd(data_conn, &info, sizeof(ld10k1_dsp_point_t));
 }
@@ -1501,3 +2310,227 @@ int ld10k1_fnc_get_dsp_info(int data_conn, int op, int size)
 	
 	return send_response_wd(data_conn, &info, sizeof(ld10k1_fnc_dsp_info_t));
 }
+
+static int ld10k1_fnc_send_io_names(int data_conn, ld10k1_p_in_out_t *regs, int count)
+{
+	int i, err;
+	ld10k1_fnc_get_io_t *io;
+
+	if (!count)
+		return 0;
+
+	io = (ld10k1_fnc_get_io_t *)malloc(sizeof(ld10k1_fnc_get_io_t) * count);
+	if (!io)
+		return LD10K1_ERR_NO_MEM;
+	memset(io, 0, sizeof(ld10k1_fnc_get_io_t) * count);
+
+	for (i = 0; i < count; i++)
+		if (regs[i].name)
+			strcpy(io[i].name, regs[i].name);
+
+	err = client_response(data_conn, FNC_CONTINUE, 0, io, sizeof(ld10k1_fnc_get_io_t) * count);
+	free(io);
+	return err;
+}
+
+/*
+ * Whole DSP configuration in answer to a single request:
+ *   ld10k1_fnc_dsp_snapshot_t
+ *   fx, in and out names (ld10k1_fnc_get_io_t[], each only if not empty)
+ *   every patch in patch order, framed as for FNC_GET_PATCH
+ *   ld10k1_dsp_point_t[] (only if not empty)
+ * all as FNC_CONTINUE messages.  Points refer to patches by their index
+ * in this snapshot, so the client does not have to map ids.
+ */
+int ld10k1_fnc_get_dsp_snapshot(int data_conn, int op, int size)
+{
+	int i, err;
+	ld10k1_fnc_dsp_snapshot_t snap;
+	ld10k1_patch_t *patch;
+	ld10k1_conn_point_t *point;
+	ld10k1_dsp_point_t *points;
+
+	memset(&snap, 0, sizeof(snap));
+	snap.chip_type = dsp_mgr.audigy;
+	snap.fx_count = dsp_mgr.fx_count;
+	snap.in_count = dsp_mgr.in_count;
+	snap.out_count = dsp_mgr.out_count;
+	snap.patch_count = dsp_mgr.patch_count;
+	snap.generation = event_generation;
+	for (point = dsp_mgr.point_list; point; point = point->next)
+		snap.point_count++;
+
+	if ((err = client_response(data_conn, FNC_CONTINUE, 0, &snap, sizeof(snap))) < 0)
+		return err;
+
+	if ((err = ld10k1_fnc_send_io_names(data_conn, dsp_mgr.fxs, snap.fx_count)) < 0)
+		return err;
+	if ((err = ld10k1_fnc_send_io_names(data_conn, dsp_mgr.ins, snap.in_count)) < 0)
+		return err;
+	if ((err = ld10k1_fnc_send_io_names(data_conn, dsp_mgr.outs, snap.out_count)) < 0)
+		return err;
+
+	for (i = 0; i < dsp_mgr.patch_count; i++) {
+		patch = dsp_mgr.patch_ptr[dsp_mgr.patch_order[i]];
+		if ((err = ld10k1_fnc_send_patch(data_conn, patch)) < 0)
+			return err;
+	}
+
+	if (!snap.point_count)
+		return 0;
+
+	points = (ld10k1_dsp_point_t *)malloc(sizeof(ld10k1_dsp_point_t) * snap.point_count);
+	if (!points)
+		return LD10K1_ERR_NO_MEM;
+
+	for (i = 0, point = dsp_mgr.point_list; point; point = point->next)
+		ld10k1_fnc_point_info(point, &points[i++], 1);
+
+	err = client_response(data_conn, FNC_CONTINUE, 0, points, sizeof(ld10k1_dsp_point_t) * snap.point_count);
+	free(points);
+	return err;
+}
+
+int ld10k1_fnc_transaction(int data_conn, int op, int size)
+{
+	int i, err;
+
+	if (op == FNC_TRANSACTION_BEGIN) {
+		if (transaction_client >= 0)
+			return LD10K1_ERR_TRANSACTION;
+		/* patch upload of other client would end in transaction */
+		for (i = 0; i < clients_alloc; i++)
+			if (i != data_conn && client_get(i) && clients[i]->state == CLIENT_STATE_PATCH_ADD)
+				return LD10K1_ERR_TRANSACTION;
+		transaction_saved = ld10k1_dsp_mgr_save(&dsp_mgr);
+		if (!transaction_saved)
+			return LD10K1_ERR_NO_MEM;
+		dsp_mgr.transaction = 1;
+		transaction_client = data_conn;
+		transaction_err = 0;
+		return 0;
+	}
+
+	if (transaction_client != data_conn)
+		return LD10K1_ERR_TRANSACTION;
+
+	if (op == FNC_TRANSACTION_ABORT) {
+		transaction_end(1);
+		return 0;
+	}
+
+	/* commit - one instruction placement and one code poke for everything */
+	err = transaction_err;
+	if (!err) {
+		dsp_mgr.transaction = 0;
+		err = ld10k1_dsp_mgr_actualize_instr(&dsp_mgr);
+	}
+	transaction_end(err < 0);
+	return err;
+}
+
+/*
+ * After FNC_SUBSCRIBE, FNC_EVENT messages for the selected events may
+ * come before any response, so clients use a separate connection for
+ * them.  Mask 0 ends the subscription.
+ */
+int ld10k1_fnc_subscribe(int data_conn, int op, int size)
+{
+	ld10k1_fnc_subscribe_t subscribe;
+	ClientDef *c = clients[data_conn];
+	int err;
+
+	if ((err = client_receive(data_conn, &subscribe, sizeof(ld10k1_fnc_subscribe_t))) < 0)
+		return err;
+
+	if (!c->event_mask && subscribe.mask)
+		event_subscribers++;
+	else if (c->event_mask && !subscribe.mask)
+		event_subscribers--;
+	c->event_mask = subscribe.mask;
+	c->event_lost = 0;
+
+	return send_response_wd(data_conn, &event_generation, sizeof(event_generation));
+}
+
+/*
+ * Values from FNC_CTL_SET are checked at once but written by
+ * ctl_pending_flush(), so only wrong values are reported to the client.
+ * The whole request is refused if any of its values is wrong.
+ */
+int ld10k1_fnc_ctl_set(int data_conn, int op, int size)
+{
+	ld10k1_fnc_ctl_value_t *values, *val;
+	ld10k1_patch_t *patch;
+	ld10k1_ctl_t *ctl;
+	ctl_pending_t *pend, *new_pending;
+	unsigned int gpr;
+	int i, count, new_alloc;
+	int err = 0;
+
+	if (size % sizeof(ld10k1_fnc_ctl_value_t))
+		return LD10K1_ERR_PROTOCOL;
+	count = size / sizeof(ld10k1_fnc_ctl_value_t);
+
+	if (!(values = (ld10k1_fnc_ctl_value_t *)client_receive_malloc(data_conn, size)))
+		return LD10K1_ERR_PROTOCOL;
+
+	for (i = 0; i < count; i++) {
+		val = &values[i];
+		if (val->patch_num < 0 || val->patch_num >= EMU10K1_PATCH_MAX || !dsp_mgr.patch_ptr[val->patch_num]) {
+			err = LD10K1_ERR_UNKNOWN_PATCH_NUM;
+			goto end;
+		}
+		patch = dsp_mgr.patch_ptr[val->patch_num];
+		if (val->ctl < 0 || val->ctl >= patch->ctl_count || val->idx >= patch->ctl[val->ctl].vcount) {
+			err = LD10K1_ERR_UNKNOWN_CTL;
+			goto end;
+		}
+		ctl = &(patch->ctl[val->ctl]);
+		if (val->value < ctl->min || val->value > ctl->max) {
+			err = LD10K1_ERR_CTL_VALUE;
+			goto end;
+		}
+	}
+
+	/*
+	 * Queue is written only from main loop, it can grow long while
+	 * transaction is open or GPRs are reused by other patches.
+	 */
+	if (ctl_pending_count + count > ctl_pending_alloc) {
+		new_alloc = ctl_pending_alloc ? ctl_pending_alloc * 2 : 64;
+		if (new_alloc < ctl_pending_count + count)
+			new_alloc = ctl_pending_count + count;
+		new_pending = (ctl_pending_t *)realloc(ctl_pending, sizeof(ctl_pending_t) * new_alloc);
+		if (!new_pending) {
+			err = LD10K1_ERR_NO_MEM;
+			goto end;
+		}
+		ctl_pending = new_pending;
+		ctl_pending_alloc = new_alloc;
+	}
+
+	for (i = 0; i < count; i++) {
+		val = &values[i];
+		patch = dsp_mgr.patch_ptr[val->patch_num];
+		ctl = &(patch->ctl[val->ctl]);
+		gpr = ctl->gpr_idx[0] & ~EMU10K1_REG_TYPE_MASK;
+
+		pend = ctl_pending_gpr[gpr] ? &ctl_pending[ctl_pending_gpr[gpr] - 1] : NULL;
+		/* GPR could be freed and reused by other patch in this pass */
+		if (!pend || pend->patch_num != val->patch_num || pend->patch_id != patch->id || pend->ctl != val->ctl) {
+			pend = &ctl_pending[ctl_pending_count++];
+			pend->patch_num = val->patch_num;
+			pend->patch_id = patch->id;
+			pend->ctl = val->ctl;
+			pend->gpr = gpr;
+			pend->mask = 0;
+			ctl_pending_gpr[gpr] = ctl_pending_count;
+		}
+		pend->mask |= 1U << val->idx;
+		pend->value[val->idx] = val->value;
+	}
+end:
+	free(values);
+	return err;
+}
@@ -24,9 +24,15 @@
 
 #include "comm.h"
 
-extern ld10k1_dsp_mgr_t dsp_mgr;
+extern LD10K1_CARD_STATE ld10k1_dsp_mgr_t dsp_mgr;
 
-int main_loop(comm_param *param, int audigy, const char *card_id, int tram_size, snd_ctl_t *ctlp);
+struct ld10k1_dump_parts_tag;
+
+int main_loop(comm_param *param, int audigy, const char *card_id, int tram_size, int staged, struct ld10k1_dump_parts_tag *dump, snd_ctl_t *ctlp);
+
+int client_receive(int client, void *data, int data_size);
+void *client_receive_malloc(int client, int data_size);
+int client_response(int client, int op, int err, void *data, int data_size);
 
 int send_response_ok(int conn_num);
 int send_response_err(int conn_num, int err);
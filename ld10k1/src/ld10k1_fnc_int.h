@@ -25,6 +25,13 @@
 int ld10k1_dsp_mgr_init(ld10k1_dsp_mgr_t *dsp_mgr);
 void ld10k1_dsp_mgr_init_id_gen(ld10k1_dsp_mgr_t *dsp_mgr);
 void ld10k1_dsp_mgr_free(ld10k1_dsp_mgr_t *dsp_mgr);
+ld10k1_dsp_mgr_t *ld10k1_dsp_mgr_save(ld10k1_dsp_mgr_t *dsp_mgr);
+void ld10k1_dsp_mgr_restore(ld10k1_dsp_mgr_t *dsp_mgr, ld10k1_dsp_mgr_t *saved);
+void ld10k1_dsp_mgr_discard(ld10k1_dsp_mgr_t *saved);
+void ld10k1_dsp_mgr_swap(ld10k1_dsp_mgr_t *dsp_mgr, ld10k1_dsp_mgr_t *saved);
+void ld10k1_dsp_mgr_gpr_changed(ld10k1_dsp_mgr_t *dsp_mgr, unsigned int gpr);
+void ld10k1_dsp_mgr_instr_changed(ld10k1_dsp_mgr_t *dsp_mgr, unsigned int instr);
+void ld10k1_dsp_mgr_tram_changed(ld10k1_dsp_mgr_t *dsp_mgr, unsigned int acc);
 
 ld10k1_patch_t *ld10k1_dsp_mgr_patch_new(void);
 void ld10k1_dsp_mgr_patch_free(ld10k1_patch_t *patch);
@@ -44,9 +51,20 @@ int ld10k1_dsp_mgr_patch_load(ld10k1_dsp_mgr_t *dsp_mgr, ld10k1_patch_t *patch,
 int ld10k1_patch_fnc_check_patch(ld10k1_dsp_mgr_t *dsp_mgr, ld10k1_patch_t *new_patch);
 int ld10k1_patch_fnc_del(ld10k1_dsp_mgr_t *dsp_mgr, ld10k1_fnc_patch_del_t *patch_fnc);
 int ld10k1_connection_fnc(ld10k1_dsp_mgr_t *dsp_mgr, ld10k1_fnc_connection_t *connection_fnc, int *conn_id);
+int ld10k1_dsp_mgr_actualize_instr(ld10k1_dsp_mgr_t *dsp_mgr);
+int ld10k1_dsp_mgr_actualize_instr_for_reg(ld10k1_dsp_mgr_t *dsp_mgr, ld10k1_patch_t *patch, unsigned int reg);
 
-void ld10k1_del_control_from_list(ld10k1_ctl_list_item_t **list, int *count, ld10k1_ctl_t *gctl);
-void ld10k1_del_all_controls_from_list(ld10k1_ctl_list_item_t **list, int *count);
-int ld10k1_add_control_to_list(ld10k1_ctl_list_item_t **list, int *count, ld10k1_ctl_t *gctl);
+unsigned int ld10k1_name_hash(const char *name);
+
+void ld10k1_ctl_list_init(ld10k1_ctl_list_t *list);
+ld10k1_ctl_list_item_t *ld10k1_look_control_from_list(ld10k1_ctl_list_t *list, ld10k1_ctl_t *gctl);
+void ld10k1_del_control_from_list(ld10k1_ctl_list_t *list, ld10k1_ctl_t *gctl);
+void ld10k1_del_all_controls_from_list(ld10k1_ctl_list_t *list);
+int ld10k1_add_control_to_list(ld10k1_ctl_list_t *list, ld10k1_ctl_t *gctl);
+
+ld10k1_conn_point_t *ld10k1_conn_point_find(ld10k1_dsp_mgr_t *dsp_mgr, int id);
+void ld10k1_patch_name_hash_add(ld10k1_dsp_mgr_t *dsp_mgr, int idx);
+void ld10k1_patch_name_hash_del(ld10k1_dsp_mgr_t *dsp_mgr, int idx);
+int ld10k1_patch_find(ld10k1_dsp_mgr_t *dsp_mgr, const char *name);
 
 #endif /* __LD10K1_FNC_INT_H */
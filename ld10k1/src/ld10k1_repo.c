@@ -0,0 +1,417 @@
+/*
+ *  EMU10k1 loader
+ *
+ *  Copyright (c) 2003,2004 by Peter Zubaj
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <pthread.h>
+
+#include "ld10k1.h"
+#include "ld10k1_fnc.h"
+#include "ld10k1_error.h"
+#include "ld10k1_repo.h"
+
+/*
+ * Repository directory has one file for every stored patch, named by its
+ * key, and index of them sorted by key.  Index is mapped and searched in
+ * place.  New entry is added by writing new index, which replaces old
+ * one by rename, so index on disk is never half written.  Patches used
+ * since start are kept in memory.  Without directory, repository lives
+ * only in memory.
+ *
+ * Repository is shared by all cards.  Images are never freed until
+ * ld10k1_repo_free(), so an image found under the lock stays valid.
+ */
+
+#define LD10K1_REPO_SIGNATURE "LD10K1 REPO 001"
+#define LD10K1_REPO_INDEX "index"
+
+typedef struct {
+	char signature[16];
+	unsigned int count;
+	unsigned int entry_size;
+} ld10k1_repo_index_t;
+
+typedef struct {
+	unsigned int hash[2];
+	unsigned int size;
+	unsigned int reserved;
+	char name[MAX_NAME_LEN];
+} ld10k1_repo_entry_t;
+
+static char *repo_dir = NULL;
+static void *repo_map = NULL;
+static size_t repo_map_size = 0;
+static unsigned int repo_count = 0;
+static ld10k1_repo_entry_t *repo_entries = NULL;
+static ld10k1_repo_image_t *repo_images = NULL;
+static pthread_mutex_t repo_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void ld10k1_repo_path(char *path, int size, const char *file)
+{
+	snprintf(path, size, "%s/%s", repo_dir, file);
+}
+
+static void ld10k1_repo_image_path(char *path, int size, unsigned int *hash)
+{
+	snprintf(path, size, "%s/%08x%08x", repo_dir, hash[0], hash[1]);
+}
+
+static int ld10k1_repo_hash_cmp(unsigned int *a, unsigned int *b)
+{
+	if (a[0] != b[0])
+		return a[0] < b[0] ? -1 : 1;
+	if (a[1] != b[1])
+		return a[1] < b[1] ? -1 : 1;
+	return 0;
+}
+
+static void ld10k1_repo_unmap(void)
+{
+	if (repo_map)
+		munmap(repo_map, repo_map_size);
+	repo_map = NULL;
+	repo_map_size = 0;
+	repo_count = 0;
+	repo_entries = NULL;
+}
+
+static int ld10k1_repo_map(void)
+{
+	char path[MAX_NAME_LEN];
+	ld10k1_repo_index_t *index;
+	struct stat st;
+	int fd;
+
+	ld10k1_repo_unmap();
+
+	ld10k1_repo_path(path, sizeof(path), LD10K1_REPO_INDEX);
+	if ((fd = open(path, O_RDONLY)) < 0) {
+		/* empty repository */
+		if (errno == ENOENT)
+			return 0;
+		error("unable to open repository index %s", path);
+		return LD10K1_ERR_REPO_IMAGE;
+	}
+
+	if (fstat(fd, &st) < 0 || st.st_size < (off_t)sizeof(ld10k1_repo_index_t))
+		goto err;
+
+	repo_map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	if (repo_map == MAP_FAILED) {
+		repo_map = NULL;
+		goto err;
+	}
+	repo_map_size = st.st_size;
+	close(fd);
+
+	index = (ld10k1_repo_index_t *)repo_map;
+	if (strncmp(index->signature, LD10K1_REPO_SIGNATURE, sizeof(index->signature)) != 0 ||
+		index->entry_size != sizeof(ld10k1_repo_entry_t) ||
+		index->count > (repo_map_size - sizeof(ld10k1_repo_index_t)) / sizeof(ld10k1_repo_entry_t)) {
+		error("repository index %s is damaged", path);
+		ld10k1_repo_unmap();
+		return LD10K1_ERR_REPO_IMAGE;
+	}
+
+	repo_count = index->count;
+	repo_entries = (ld10k1_repo_entry_t *)(index + 1);
+	return 0;
+err:
+	error("unable to map repository index %s", path);
+	close(fd);
+	return LD10K1_ERR_REPO_IMAGE;
+}
+
+static ld10k1_repo_entry_t *ld10k1_repo_entry_find(unsigned int *hash, const char *name)
+{
+	int l, r, m, c;
+	unsigned int i;
+
+	if (hash[0] || hash[1]) {
+		l = 0;
+		r = (int)repo_count - 1;
+		while (l <= r) {
+			m = (l + r) / 2;
+			c = ld10k1_repo_hash_cmp(hash, repo_entries[m].hash);
+			if (!c)
+				return &(repo_entries[m]);
+			if (c < 0)
+				r = m - 1;
+			else
+				l = m + 1;
+		}
+		return NULL;
+	}
+
+	for (i = 0; i < repo_count; i++)
+		if (strncmp(repo_entries[i].name, name, MAX_NAME_LEN) == 0)
+			return &(repo_entries[i]);
+	return NULL;
+}
+
+static ld10k1_repo_image_t *ld10k1_repo_image_new(unsigned int *hash, const char *name, void *data, unsigned int size)
+{
+	ld10k1_repo_image_t *image;
+	ld10k1_repo_image_t *item;
+
+	if (!(image = (ld10k1_repo_image_t *)malloc(sizeof(ld10k1_repo_image_t))))
+		return NULL;
+	image->hash[0] = hash[0];
+	image->hash[1] = hash[1];
+	strncpy(image->name, name, MAX_NAME_LEN - 1);
+	image->name[MAX_NAME_LEN - 1] = '\0';
+	image->size = size;
+	image->data = data;
+
+	/* name belongs to newest patch */
+	for (item = repo_images; item; item = item->next)
+		if (strcmp(item->name, image->name) == 0)
+			item->name[0] = '\0';
+
+	image->next = repo_images;
+	repo_images = image;
+	return image;
+}
+
+static void *ld10k1_repo_read_image(ld10k1_repo_entry_t *entry)
+{
+	char path[MAX_NAME_LEN];
+	void *data;
+	ssize_t len;
+	int fd;
+
+	ld10k1_repo_image_path(path, sizeof(path), entry->hash);
+	if ((fd = open(path, O_RDONLY)) < 0) {
+		error("unable to open repository patch %s", path);
+		return NULL;
+	}
+
+	if (!(data = malloc(entry->size))) {
+		close(fd);
+		return NULL;
+	}
+
+	len = read(fd, data, entry->size);
+	close(fd);
+	if (len != (ssize_t)entry->size) {
+		error("unable to read repository patch %s", path);
+		free(data);
+		return NULL;
+	}
+	return data;
+}
+
+static ld10k1_repo_image_t *ld10k1_repo_find_locked(unsigned int *hash, const char *name)
+{
+	ld10k1_repo_image_t *image;
+	ld10k1_repo_entry_t *entry;
+	void *data;
+
+	for (image = repo_images; image; image = image->next) {
+		if (hash[0] || hash[1]) {
+			if (!ld10k1_repo_hash_cmp(hash, image->hash))
+				return image;
+		} else if (image->name[0] && strcmp(image->name, name) == 0)
+			return image;
+	}
+
+	if (!repo_dir || !(entry = ld10k1_repo_entry_find(hash, name)))
+		return NULL;
+	/* found by name, but already read */
+	for (image = repo_images; image; image = image->next)
+		if (!ld10k1_repo_hash_cmp(entry->hash, image->hash))
+			return image;
+
+	if (!(data = ld10k1_repo_read_image(entry)))
+		return NULL;
+	if (!(image = ld10k1_repo_image_new(entry->hash, entry->name, data, entry->size))) {
+		free(data);
+		return NULL;
+	}
+	return image;
+}
+
+static int ld10k1_repo_write_file(const char *path, void *data1, size_t size1, void *data2, size_t size2)
+{
+	char tmp_path[MAX_NAME_LEN + 4];
+	int fd;
+
+	snprintf(tmp_path, sizeof(tmp_path), "%s.new", path);
+	if ((fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644)) < 0)
+		return LD10K1_ERR_REPO_WRITE;
+
+	if (write(fd, data1, size1) != (ssize_t)size1 ||
+		(size2 && write(fd, data2, size2) != (ssize_t)size2) ||
+		fsync(fd) < 0) {
+		close(fd);
+		unlink(tmp_path);
+		return LD10K1_ERR_REPO_WRITE;
+	}
+	close(fd);
+
+	if (rename(tmp_path, path) < 0) {
+		unlink(tmp_path);
+		return LD10K1_ERR_REPO_WRITE;
+	}
+	return 0;
+}
+
+/* new index with entry placed by key */
+static int ld10k1_repo_write_index(unsigned int *hash, const char *name, unsigned int size)
+{
+	char path[MAX_NAME_LEN];
+	ld10k1_repo_index_t index;
+	ld10k1_repo_entry_t *entries;
+	unsigned int i, pos;
+	int err;
+
+	if (!(entries = (ld10k1_repo_entry_t *)malloc(sizeof(ld10k1_repo_entry_t) * (repo_count + 1))))
+		return LD10K1_ERR_NO_MEM;
+
+	for (pos = 0; pos < repo_count; pos++)
+		if (ld10k1_repo_hash_cmp(hash, repo_entries[pos].hash) < 0)
+			break;
+	memcpy(entries, repo_entries, sizeof(ld10k1_repo_entry_t) * pos);
+	memcpy(entries + pos + 1, repo_entries + pos, sizeof(ld10k1_repo_entry_t) * (repo_count - pos));
+
+	memset(&(entries[pos]), 0, sizeof(ld10k1_repo_entry_t));
+	entries[pos].hash[0] = hash[0];
+	entries[pos].hash[1] = hash[1];
+	entries[pos].size = size;
+	strncpy(entries[pos].name, name, MAX_NAME_LEN - 1);
+
+	/* name belongs to newest patch */
+	for (i = 0; i <= repo_count; i++)
+		if (i != pos && strcmp(entries[i].name, entries[pos].name) == 0)
+			entries[i].name[0] = '\0';
+
+	memset(&index, 0, sizeof(index));
+	strcpy(index.signature, LD10K1_REPO_SIGNATURE);
+	index.count = repo_count + 1;
+	index.entry_size = sizeof(ld10k1_repo_entry_t);
+
+	ld10k1_repo_path(path, sizeof(path), LD10K1_REPO_INDEX);
+	err = ld10k1_repo_write_file(path, &index, sizeof(index),
+		entries, sizeof(ld10k1_repo_entry_t) * index.count);
+	free(entries);
+	if (err < 0)
+		return err;
+
+	return ld10k1_repo_map();
+}
+
+ld10k1_repo_image_t *ld10k1_repo_find(unsigned int *hash, const char *name)
+{
+	ld10k1_repo_image_t *image;
+
+	pthread_mutex_lock(&repo_lock);
+	image = ld10k1_repo_find_locked(hash, name);
+	pthread_mutex_unlock(&repo_lock);
+	return image;
+}
+
+static int ld10k1_repo_add_locked(unsigned int *hash, const char *name, void *data, unsigned int size)
+{
+	char path[MAX_NAME_LEN];
+	ld10k1_repo_image_t *image;
+	void *copy;
+	int err;
+
+	for (image = repo_images; image; image = image->next)
+		if (!ld10k1_repo_hash_cmp(hash, image->hash))
+			return 0;
+
+	if (!(copy = malloc(size)))
+		return LD10K1_ERR_NO_MEM;
+	memcpy(copy, data, size);
+	if (!ld10k1_repo_image_new(hash, name, copy, size)) {
+		free(copy);
+		return LD10K1_ERR_NO_MEM;
+	}
+
+	if (!repo_dir || ld10k1_repo_entry_find(hash, name))
+		return 0;
+
+	ld10k1_repo_image_path(path, sizeof(path), hash);
+	if ((err = ld10k1_repo_write_file(path, data, size, NULL, 0)) < 0) {
+		error("unable to write repository patch %s", path);
+		return err;
+	}
+	if ((err = ld10k1_repo_write_index(hash, name, size)) < 0) {
+		error("unable to write repository index in %s", repo_dir);
+		return err;
+	}
+	return 0;
+}
+
+int ld10k1_repo_add(unsigned int *hash, const char *name, void *data, unsigned int size)
+{
+	int err;
+
+	pthread_mutex_lock(&repo_lock);
+	err = ld10k1_repo_add_locked(hash, name, data, size);
+	pthread_mutex_unlock(&repo_lock);
+	return err;
+}
+
+int ld10k1_repo_init(const char *dir)
+{
+	if (!dir)
+		return 0;
+	if (mkdir(dir, 0755) < 0 && errno != EEXIST) {
+		error("unable to create repository %s", dir);
+		return LD10K1_ERR_REPO_WRITE;
+	}
+	/* daemon changes working directory */
+	if (!(repo_dir = realpath(dir, NULL))) {
+		error("unable to open repository %s", dir);
+		return LD10K1_ERR_REPO_WRITE;
+	}
+	/* damaged index is written again with next patch */
+	ld10k1_repo_map();
+	return 0;
+}
+
+void ld10k1_repo_free(void)
+{
+	ld10k1_repo_image_t *image;
+
+	while (repo_images) {
+		image = repo_images->next;
+		free(repo_images->data);
+		free(repo_images);
+		repo_images = image;
+	}
+	ld10k1_repo_unmap();
+	free(repo_dir);
+	repo_dir = NULL;
+}
@@ -0,0 +1,39 @@
+/*
+ *  EMU10k1 loader
+ *
+ *  Copyright (c) 2003,2004 by Peter Zubaj
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef __LD10K1_REPO_H
+#define __LD10K1_REPO_H
+
+/* stored patch - ld10k1_dsp_patch_t followed by parts as FNC_PATCH_ADD sends them */
+typedef struct ld10k1_repo_image_tag {
+	struct ld10k1_repo_image_tag *next;
+	unsigned int hash[2];
+	char name[MAX_NAME_LEN];
+	unsigned int size;
+	void *data;
+} ld10k1_repo_image_t;
+
+int ld10k1_repo_init(const char *dir);
+void ld10k1_repo_free(void);
+ld10k1_repo_image_t *ld10k1_repo_find(unsigned int *hash, const char *name);
+int ld10k1_repo_add(unsigned int *hash, const char *name, void *data, unsigned int size);
+
+#endif /* __LD10K1_REPO_H */
@@ -22,11 +22,13 @@
 #include "ld10k1.h"
 #include "ld10k1_fnc.h"
 #include "ld10k1_tram.h"
+#include "ld10k1_fnc_int.h"
 #include "ld10k1_error.h"
 #include <stdlib.h>
+#include <string.h>
 
 int ld10k1_tram_res_alloc_hwacc(ld10k1_dsp_mgr_t *dsp_mgr, ld10k1_dsp_tram_resolve_t *res);
-int ld10k1_tram_realloc_space(ld10k1_dsp_mgr_t *dsp_mgr, ld10k1_dsp_tram_resolve_t *res);
+int ld10k1_tram_realloc_space(ld10k1_dsp_mgr_t *dsp_mgr, ld10k1_patch_t *patch, ld10k1_dsp_tram_resolve_t *res);
 
 void ld10k1_tram_init_res(ld10k1_dsp_mgr_t *dsp_mgr, ld10k1_dsp_tram_resolve_t *res)
 {
@@ -42,6 +44,7 @@ void ld10k1_tram_init_res(ld10k1_dsp_mgr_t *dsp_mgr, ld10k1_dsp_tram_resolve_t *
 
 	res->grp_free = res->iacc_free_count + res->eacc_free_count;
 
+	res->relocate = 0;
 	res->item_count = 0;
 }
 
@@ -53,6 +56,9 @@ void ld10k1_tram_init_res_from_dsp_mgr(ld10k1_dsp_mgr_t *dsp_mgr, ld10k1_dsp_tra
 		if (dsp_mgr->tram_grp[i].used) {
 			/* get position */
 			res->grp_free--;
+			/* group without accessors takes no space */
+			if (dsp_mgr->tram_grp[i].pos == TRAM_POS_NONE)
+				continue;
 			switch (dsp_mgr->tram_grp[i].req_pos) {
 				case TRAM_POS_NONE:
 				case TRAM_POS_AUTO:
@@ -78,6 +84,24 @@ void ld10k1_tram_init_res_from_dsp_mgr(ld10k1_dsp_mgr_t *dsp_mgr, ld10k1_dsp_tra
 	}
 }
 
+void ld10k1_tram_init_res_from_dsp_mgr_fixed(ld10k1_dsp_mgr_t *dsp_mgr, ld10k1_dsp_tram_resolve_t *res)
+{
+	/* loaded groups stay where they are */
+	int i;
+	for (i = 0; i < dsp_mgr->max_tram_grp; i++) {
+		if (dsp_mgr->tram_grp[i].used) {
+			res->grp_free--;
+			if (dsp_mgr->tram_grp[i].pos == TRAM_POS_INTERNAL) {
+				res->ifree -= dsp_mgr->tram_grp[i].size;
+				res->iacc_free_count -= dsp_mgr->tram_grp[i].acc_count;
+			} else if (dsp_mgr->tram_grp[i].pos == TRAM_POS_EXTERNAL) {
+				res->efree -= dsp_mgr->tram_grp[i].size;
+				res->eacc_free_count -= dsp_mgr->tram_grp[i].acc_count;
+			}
+		}
+	}
+}
+
 int ld10k1_tram_acc_count_from_patch(ld10k1_patch_t *patch, int grp)
 {
 	int i, count;
@@ -250,8 +274,24 @@ int ld10k1_tram_reserve_for_patch(ld10k1_dsp_mgr_t *dsp_mgr, ld10k1_patch_t *pat
 {
 	int err;
 
+	/* first try to place only new groups, loaded ones are not moved */
+	ld10k1_tram_init_res(dsp_mgr, res);
+	ld10k1_tram_init_res_from_dsp_mgr_fixed(dsp_mgr, res);
+
+	if (ld10k1_tram_init_res_from_patch(dsp_mgr, res, patch) >= 0) {
+		ld10k1_tram_calc_res_value(res);
+		ld10k1_tram_sort_res(res);
+
+		if (ld10k1_tram_resolve_res(res) >= 0) {
+			ld10k1_tram_init_res_from_patch_copy(dsp_mgr, res, patch);
+			return 0;
+		}
+	}
+
+	/* does not fit - place all auto groups again */
 	ld10k1_tram_init_res(dsp_mgr, res);
 	ld10k1_tram_init_res_from_dsp_mgr(dsp_mgr, res);
+	res->relocate = 1;
 
 	if ((err = ld10k1_tram_init_res_from_patch(dsp_mgr, res, patch)) < 0)
 		return err;
@@ -279,6 +319,10 @@ int ld10k1_tram_alloc_for_patch(ld10k1_dsp_mgr_t *dsp_mgr, ld10k1_patch_t *patch
 		patch->tram_grp[i].grp_idx = grp;
 		dsp_mgr->tram_grp[grp].type = patch->tram_grp[i].grp_type;
 		dsp_mgr->tram_grp[grp].size = patch->tram_grp[i].grp_size;
+		dsp_mgr->tram_grp[grp].req_pos = patch->tram_grp[i].grp_pos;
+		dsp_mgr->tram_grp[grp].pos = TRAM_POS_NONE;
+		dsp_mgr->tram_grp[grp].offset = 0;
+		dsp_mgr->tram_grp[grp].acc_count = 0;
 	}
 
 	for (i = 0; i < res->item_count; i++) {
@@ -298,7 +342,7 @@ int ld10k1_tram_alloc_for_patch(ld10k1_dsp_mgr_t *dsp_mgr, ld10k1_patch_t *patch
 	}
 
 	ld10k1_tram_res_alloc_hwacc(dsp_mgr, res);
-	ld10k1_tram_realloc_space(dsp_mgr, res);
+	ld10k1_tram_realloc_space(dsp_mgr, patch, res);
 	return 0;
 }
 
@@ -332,7 +376,7 @@ void ld10k1_tram_hwacc_free(ld10k1_dsp_mgr_t *dsp_mgr, int acc)
 		dsp_mgr->itram_hwacc[acc].used = 0;
 		dsp_mgr->itram_hwacc[acc].addr_val = 0;
 		dsp_mgr->itram_hwacc[acc].data_val = 0;
-		dsp_mgr->itram_hwacc[acc].modified = 1;
+		ld10k1_dsp_mgr_tram_changed(dsp_mgr, acc);
 		dsp_mgr->i_tram.used_hwacc--;
 	} else {
 		int nacc = acc - dsp_mgr->max_itram_hwacc;
@@ -340,25 +384,28 @@ void ld10k1_tram_hwacc_free(ld10k1_dsp_mgr_t *dsp_mgr, int acc)
 		dsp_mgr->etram_hwacc[nacc].used = 0;
 		dsp_mgr->etram_hwacc[nacc].addr_val = 0;
 		dsp_mgr->etram_hwacc[nacc].data_val = 0;
-		dsp_mgr->etram_hwacc[nacc].modified = 1;
+		ld10k1_dsp_mgr_tram_changed(dsp_mgr, acc);
 		dsp_mgr->e_tram.used_hwacc--;
 	}
 }
 
 void ld10k1_tram_actualize_hwacc(ld10k1_dsp_mgr_t *dsp_mgr, int acc, unsigned int op, unsigned int addr, unsigned int data)
 {
-	if (acc < dsp_mgr->max_itram_hwacc) {
-		dsp_mgr->itram_hwacc[acc].op = op;
-		dsp_mgr->itram_hwacc[acc].addr_val = addr;
-		dsp_mgr->itram_hwacc[acc].data_val = data;
-		dsp_mgr->itram_hwacc[acc].modified = 1;
-	} else {
-		int nacc = acc - dsp_mgr->max_itram_hwacc;
-		dsp_mgr->etram_hwacc[nacc].op = op;
-		dsp_mgr->etram_hwacc[nacc].addr_val = addr;
-		dsp_mgr->etram_hwacc[nacc].data_val = data;
-		dsp_mgr->etram_hwacc[nacc].modified = 1;
-	}
+	ld10k1_tram_hwacc_t *hwacc;
+
+	if (acc < dsp_mgr->max_itram_hwacc)
+		hwacc = &(dsp_mgr->itram_hwacc[acc]);
+	else
+		hwacc = &(dsp_mgr->etram_hwacc[acc - dsp_mgr->max_itram_hwacc]);
+
+	/* delay line was not moved - nothing to send */
+	if (hwacc->op == op && hwacc->addr_val == addr && hwacc->data_val == data)
+		return;
+
+	hwacc->op = op;
+	hwacc->addr_val = addr;
+	hwacc->data_val = data;
+	ld10k1_dsp_mgr_tram_changed(dsp_mgr, acc);
 }
 
 void ld10k1_tram_get_hwacc(ld10k1_dsp_mgr_t *dsp_mgr, int acc, unsigned int *addr, unsigned int *data)
@@ -411,24 +458,202 @@ int ld10k1_tram_res_alloc_hwacc(ld10k1_dsp_mgr_t *dsp_mgr, ld10k1_dsp_tram_resol
 	return 0;
 }
 
-int ld10k1_tram_realloc_space(ld10k1_dsp_mgr_t *dsp_mgr, ld10k1_dsp_tram_resolve_t *res)
+void ld10k1_tram_init_space(ld10k1_tram_t *tram)
+{
+	tram->free_count = 0;
+	tram->compact_count = 0;
+	if (tram->size > 0) {
+		tram->free_ext[0].offset = 0;
+		tram->free_ext[0].size = tram->size;
+		tram->free_count = 1;
+	}
+}
+
+void ld10k1_tram_space_info(ld10k1_tram_t *tram, unsigned int *free_size, unsigned int *largest)
 {
-	int itram_size = res->isize;
-	int etram_size = res->esize;
 	int i;
 
-	/* allocate from end */
-	for (i = 0; i < dsp_mgr->max_tram_grp; i++)
-		if (dsp_mgr->tram_grp[i].used) {
-			if (dsp_mgr->tram_grp[i].pos == TRAM_POS_INTERNAL) {
-				itram_size -= dsp_mgr->tram_grp[i].size;
-				dsp_mgr->tram_grp[i].offset = itram_size;
-			} else if (dsp_mgr->tram_grp[i].pos == TRAM_POS_EXTERNAL) {
-				etram_size -= dsp_mgr->tram_grp[i].size;
-				dsp_mgr->tram_grp[i].offset = etram_size;
-			}
+	*free_size = 0;
+	*largest = 0;
+	for (i = 0; i < tram->free_count; i++) {
+		*free_size += tram->free_ext[i].size;
+		if (tram->free_ext[i].size > *largest)
+			*largest = tram->free_ext[i].size;
+	}
+}
+
+static int ld10k1_tram_space_alloc(ld10k1_tram_t *tram, unsigned int size, unsigned int *offset)
+{
+	int i, best;
+
+	if (!size) {
+		*offset = 0;
+		return 0;
+	}
+
+	/* best fit - smallest extent big enough */
+	for (best = -1, i = 0; i < tram->free_count; i++)
+		if (tram->free_ext[i].size >= size &&
+			(best < 0 || tram->free_ext[i].size < tram->free_ext[best].size))
+			best = i;
+
+	if (best < 0)
+		return LD10K1_ERR_TRAM_FULL;
+
+	/* take it from end, same as whole tram is filled */
+	tram->free_ext[best].size -= size;
+	*offset = tram->free_ext[best].offset + tram->free_ext[best].size;
+
+	if (!tram->free_ext[best].size) {
+		for (i = best; i < tram->free_count - 1; i++)
+			tram->free_ext[i] = tram->free_ext[i + 1];
+		tram->free_count--;
+	}
+	return 0;
+}
+
+static void ld10k1_tram_space_free(ld10k1_tram_t *tram, unsigned int offset, unsigned int size)
+{
+	int i, j;
+
+	if (!size)
+		return;
+
+	for (i = 0; i < tram->free_count; i++)
+		if (tram->free_ext[i].offset > offset)
+			break;
+
+	/* join with previous */
+	if (i > 0 && tram->free_ext[i - 1].offset + tram->free_ext[i - 1].size == offset) {
+		tram->free_ext[i - 1].size += size;
+		/* and next */
+		if (i < tram->free_count && offset + size == tram->free_ext[i].offset) {
+			tram->free_ext[i - 1].size += tram->free_ext[i].size;
+			for (j = i; j < tram->free_count - 1; j++)
+				tram->free_ext[j] = tram->free_ext[j + 1];
+			tram->free_count--;
 		}
-	
+		return;
+	}
+
+	/* join with next */
+	if (i < tram->free_count && offset + size == tram->free_ext[i].offset) {
+		tram->free_ext[i].offset = offset;
+		tram->free_ext[i].size += size;
+		return;
+	}
+
+	for (j = tram->free_count; j > i; j--)
+		tram->free_ext[j] = tram->free_ext[j - 1];
+	tram->free_ext[i].offset = offset;
+	tram->free_ext[i].size = size;
+	tram->free_count++;
+}
+
+static int ld10k1_tram_grp_in_patch(ld10k1_patch_t *patch, int grp)
+{
+	int i;
+
+	for (i = 0; i < patch->tram_count; i++)
+		if (patch->tram_grp[i].grp_idx == grp)
+			return 1;
+	return 0;
+}
+
+static void ld10k1_tram_compact(ld10k1_dsp_mgr_t *dsp_mgr, ld10k1_patch_t *patch, int pos)
+{
+	ld10k1_tram_t *tram;
+	ld10k1_tram_grp_t *grp;
+	int order[MAX_TRAM_COUNT];
+	int count, new_start;
+	int i, j;
+	int moved;
+	unsigned int end;
+
+	tram = pos == TRAM_POS_INTERNAL ? &(dsp_mgr->i_tram) : &(dsp_mgr->e_tram);
+
+	/* loaded groups keep their order and slide to end of tram */
+	count = 0;
+	for (i = 0; i < dsp_mgr->max_tram_grp; i++) {
+		if (!dsp_mgr->tram_grp[i].used || dsp_mgr->tram_grp[i].pos != pos ||
+			ld10k1_tram_grp_in_patch(patch, i))
+			continue;
+		for (j = count; j > 0 && dsp_mgr->tram_grp[order[j - 1]].offset < dsp_mgr->tram_grp[i].offset; j--)
+			order[j] = order[j - 1];
+		order[j] = i;
+		count++;
+	}
+
+	/* new groups after them */
+	new_start = count;
+	for (i = 0; i < patch->tram_count; i++)
+		if (dsp_mgr->tram_grp[patch->tram_grp[i].grp_idx].pos == pos)
+			order[count++] = patch->tram_grp[i].grp_idx;
+
+	moved = 0;
+	end = tram->size;
+	for (i = 0; i < count; i++) {
+		grp = &(dsp_mgr->tram_grp[order[i]]);
+		end -= grp->size;
+		if (i < new_start && grp->offset != end)
+			moved = 1;
+		grp->offset = end;
+	}
+
+	/* one hole left at start */
+	tram->free_count = 0;
+	if (end > 0) {
+		tram->free_ext[0].offset = 0;
+		tram->free_ext[0].size = end;
+		tram->free_count = 1;
+	}
+
+	if (moved)
+		tram->compact_count++;
+}
+
+static void ld10k1_tram_place_for_patch(ld10k1_dsp_mgr_t *dsp_mgr, ld10k1_patch_t *patch, int pos)
+{
+	ld10k1_tram_t *tram;
+	ld10k1_tram_grp_t *grp;
+	char placed[MAX_TRAM_COUNT];
+	int i, biggest;
+
+	tram = pos == TRAM_POS_INTERNAL ? &(dsp_mgr->i_tram) : &(dsp_mgr->e_tram);
+	memset(placed, 0, sizeof(placed));
+
+	for (;;) {
+		/* biggest group first */
+		for (biggest = -1, i = 0; i < patch->tram_count; i++) {
+			grp = &(dsp_mgr->tram_grp[patch->tram_grp[i].grp_idx]);
+			if (placed[i] || grp->pos != pos)
+				continue;
+			if (biggest < 0 || grp->size > dsp_mgr->tram_grp[patch->tram_grp[biggest].grp_idx].size)
+				biggest = i;
+		}
+		if (biggest < 0)
+			return;
+
+		placed[biggest] = 1;
+		grp = &(dsp_mgr->tram_grp[patch->tram_grp[biggest].grp_idx]);
+		if (ld10k1_tram_space_alloc(tram, grp->size, &(grp->offset)) < 0) {
+			/* there is enough free space, but not in one piece */
+			ld10k1_tram_compact(dsp_mgr, patch, pos);
+			return;
+		}
+	}
+}
+
+int ld10k1_tram_realloc_space(ld10k1_dsp_mgr_t *dsp_mgr, ld10k1_patch_t *patch, ld10k1_dsp_tram_resolve_t *res)
+{
+	if (res->relocate) {
+		/* groups could change tram - pack all */
+		ld10k1_tram_compact(dsp_mgr, patch, TRAM_POS_INTERNAL);
+		ld10k1_tram_compact(dsp_mgr, patch, TRAM_POS_EXTERNAL);
+	} else {
+		ld10k1_tram_place_for_patch(dsp_mgr, patch, TRAM_POS_INTERNAL);
+		ld10k1_tram_place_for_patch(dsp_mgr, patch, TRAM_POS_EXTERNAL);
+	}
 	return 0;
 }
 
@@ -453,6 +678,9 @@ int ld10k1_tram_actualize_tram_for_patch(ld10k1_dsp_mgr_t *dsp_mgr, ld10k1_patch
 
 		ld10k1_tram_actualize_hwacc(dsp_mgr, dsp_mgr->tram_acc[acc_idx].hwacc,
 			tram_op, dsp_mgr->tram_grp[grp_idx].offset + patch->tram_acc[i].acc_offset, 0);
+		/* hw accessor could be moved - resolve instructions again */
+		ld10k1_dsp_mgr_actualize_instr_for_reg(dsp_mgr, patch, EMU10K1_PREG_TRAM_DATA(i));
+		ld10k1_dsp_mgr_actualize_instr_for_reg(dsp_mgr, patch, EMU10K1_PREG_TRAM_ADDR(i));
 	}
 	return 0;
 }
@@ -473,6 +701,11 @@ int ld10k1_tram_free_tram_for_patch(ld10k1_dsp_mgr_t *dsp_mgr, ld10k1_patch_t *p
 	/* free all patch grps */
 	for (i = 0; i < patch->tram_count; i++) {
 		grp_idx = patch->tram_grp[i].grp_idx;
+		if (dsp_mgr->tram_grp[grp_idx].pos == TRAM_POS_INTERNAL)
+			ld10k1_tram_space_free(&(dsp_mgr->i_tram), dsp_mgr->tram_grp[grp_idx].offset, dsp_mgr->tram_grp[grp_idx].size);
+		else if (dsp_mgr->tram_grp[grp_idx].pos == TRAM_POS_EXTERNAL)
+			ld10k1_tram_space_free(&(dsp_mgr->e_tram), dsp_mgr->tram_grp[grp_idx].offset, dsp_mgr->tram_grp[grp_idx].size);
+		dsp_mgr->tram_grp[grp_idx].pos = TRAM_POS_NONE;
 		ld10k1_tram_grp_free(dsp_mgr, grp_idx);
 	}
 	
@@ -40,6 +40,8 @@ typedef struct {
 	int eacc_count;
 	int eacc_free_count;
 	int grp_free;
+	/* placement of loaded groups changes, all space is packed again */
+	int relocate;
 	int item_count;
 	ld10k1_dsp_tram_resolve_item_t items[MAX_TRAM_COUNT];
 } ld10k1_dsp_tram_resolve_t;
@@ -49,5 +51,7 @@ int ld10k1_tram_alloc_for_patch(ld10k1_dsp_mgr_t *dsp_mgr, ld10k1_patch_t *patch
 int ld10k1_tram_actualize_tram_for_patch(ld10k1_dsp_mgr_t *dsp_mgr, ld10k1_patch_t *patch);
 void ld10k1_tram_get_hwacc(ld10k1_dsp_mgr_t *dsp_mgr, int acc, unsigned int *addr, unsigned int *data);
 int ld10k1_tram_free_tram_for_patch(ld10k1_dsp_mgr_t *dsp_mgr, ld10k1_patch_t *patch);
+void ld10k1_tram_init_space(ld10k1_tram_t *tram);
+void ld10k1_tram_space_info(ld10k1_tram_t *tram, unsigned int *free_size, unsigned int *largest);
 
 #endif /* __LD10K1_TRAM_H */
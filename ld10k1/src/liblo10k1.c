@@ -21,6 +21,9 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <stddef.h>
+#include <errno.h>
+#include <poll.h>
 #include "comm.h"
 #include "ld10k1_fnc.h"
 #include "ld10k1_error.h"
@@ -345,30 +348,32 @@ void liblo10k1_patch_free(liblo10k1_dsp_patch_t *patch)
 	free(patch);
 }
 
-int liblo10k1_patch_load(liblo10k1_connection_t *conn, liblo10k1_dsp_patch_t *patch, int before, int *loaded, int *loaded_id)
+static void liblo10k1_patch_add_info(ld10k1_fnc_patch_add_t *patch_fnc, liblo10k1_dsp_patch_t *patch, int before)
+{
+	strncpy(patch_fnc->patch.patch_name, patch->patch_name, sizeof(patch_fnc->patch.patch_name) - 1);
+	patch_fnc->patch.patch_name[sizeof(patch_fnc->patch.patch_name) - 1] = '\0';
+
+	patch_fnc->patch.in_count = patch->in_count;
+	patch_fnc->patch.out_count = patch->out_count;
+	patch_fnc->patch.const_count = patch->const_count;
+	patch_fnc->patch.static_count = patch->sta_count;
+	patch_fnc->patch.dynamic_count = patch->dyn_count;
+	patch_fnc->patch.hw_count = patch->hw_count;
+	patch_fnc->patch.tram_count = patch->tram_count;
+	patch_fnc->patch.tram_acc_count = patch->tram_acc_count;
+	patch_fnc->patch.ctl_count = patch->ctl_count;
+	patch_fnc->patch.instr_count = patch->instr_count;
+	patch_fnc->where = before;
+}
+
+static int liblo10k1_patch_send(liblo10k1_connection_t *conn, int op, void *req, int req_size, liblo10k1_dsp_patch_t *patch, int *loaded, int *loaded_id)
 {
 	int err;
-	ld10k1_fnc_patch_add_t patch_fnc;
 	int tmpres[2];
 
-	strncpy(patch_fnc.patch.patch_name, patch->patch_name, sizeof(patch_fnc.patch.patch_name) - 1);
-	patch_fnc.patch.patch_name[sizeof(patch_fnc.patch.patch_name) - 1] = '\0';
-	
-	patch_fnc.patch.in_count = patch->in_count;
-	patch_fnc.patch.out_count = patch->out_count;
-	patch_fnc.patch.const_count = patch->const_count;
-	patch_fnc.patch.static_count = patch->sta_count;
-	patch_fnc.patch.dynamic_count = patch->dyn_count;
-	patch_fnc.patch.hw_count = patch->hw_count;
-	patch_fnc.patch.tram_count = patch->tram_count;
-	patch_fnc.patch.tram_acc_count = patch->tram_acc_count;
-	patch_fnc.patch.ctl_count = patch->ctl_count;
-	patch_fnc.patch.instr_count = patch->instr_count;
-
 	/* patch */
 	/* add */
-	patch_fnc.where = before;
-	if ((err = send_request_check(*conn, FNC_PATCH_ADD, &patch_fnc, sizeof(ld10k1_fnc_patch_add_t))) < 0)
+	if ((err = send_request_check(*conn, op, req, req_size)) < 0)
 		return err;
 
 	/* in */
@@ -426,6 +431,88 @@ int liblo10k1_patch_load(liblo10k1_connection_t *conn, liblo10k1_dsp_patch_t *pa
 	return 0;
 }
 
+int liblo10k1_patch_load(liblo10k1_connection_t *conn, liblo10k1_dsp_patch_t *patch, int before, int *loaded, int *loaded_id)
+{
+	ld10k1_fnc_patch_add_t patch_fnc;
+
+	liblo10k1_patch_add_info(&patch_fnc, patch, before);
+	return liblo10k1_patch_send(conn, FNC_PATCH_ADD, &patch_fnc, sizeof(patch_fnc), patch, loaded, loaded_id);
+}
+
+/* key is FNV-1a hash of everything the loaded patch depends on */
+void liblo10k1_repo_key_init(liblo10k1_repo_key_t *key, const char *name)
+{
+	memset(key, 0, sizeof(*key));
+	key->hash[0] = 0xcbf29ce4;
+	key->hash[1] = 0x84222325;
+	if (name)
+		strncpy(key->name, name, sizeof(key->name) - 1);
+}
+
+void liblo10k1_repo_key_add(liblo10k1_repo_key_t *key, const void *data, int size)
+{
+	const unsigned char *d = (const unsigned char *)data;
+	unsigned long long h;
+
+	h = ((unsigned long long)key->hash[0] << 32) | key->hash[1];
+	while (size-- > 0) {
+		h ^= *d++;
+		h *= 0x100000001b3ULL;
+	}
+	key->hash[0] = (unsigned int)(h >> 32);
+	key->hash[1] = (unsigned int)h;
+}
+
+/* same as liblo10k1_patch_load, ld10k1 keeps the patch in repository under key */
+int liblo10k1_repo_patch_load(liblo10k1_connection_t *conn, liblo10k1_dsp_patch_t *patch, liblo10k1_repo_key_t *key, int before, int *loaded, int *loaded_id)
+{
+	ld10k1_fnc_repo_patch_add_t patch_fnc;
+
+	liblo10k1_patch_add_info(&patch_fnc.add, patch, before);
+	patch_fnc.key = *key;
+	return liblo10k1_patch_send(conn, FNC_REPO_PATCH_ADD, &patch_fnc, sizeof(patch_fnc), patch, loaded, loaded_id);
+}
+
+/*
+ * Loads patch stored in repository - by key hash or by key name when hash is 0.
+ * Returns LD10K1_ERR_REPO_NOT_FOUND if ld10k1 doesn't have it.
+ */
+int liblo10k1_repo_load(liblo10k1_connection_t *conn, liblo10k1_repo_key_t *key, char *patch_name, int before, int *loaded, int *loaded_id)
+{
+	int err, opr, sizer;
+	ld10k1_fnc_repo_load_t load;
+	int tmpres[2];
+
+	memset(&load, 0, sizeof(load));
+	load.key = *key;
+	if (patch_name)
+		strncpy(load.patch_name, patch_name, sizeof(load.patch_name) - 1);
+	load.where = before;
+
+	if ((err = send_request(*conn, FNC_REPO_LOAD, &load, sizeof(load))) < 0)
+		return err;
+	if ((err = receive_response(*conn, &opr, &sizer)) < 0)
+		return err;
+
+	/* older ld10k1 refuses unknown requests without error code */
+	if (opr == FNC_ERR)
+		return LD10K1_ERR_UNKNOWN_OP;
+	if (sizer != sizeof(tmpres))
+		return LD10K1_ERR_PROTOCOL;
+	if ((err = receive_msg_data(*conn, tmpres, sizeof(tmpres))) < 0)
+		return err;
+	/* receive check */
+	if ((err = receive_response(*conn, &opr, &sizer)) < 0)
+		return err;
+
+	if (loaded)
+		*loaded = tmpres[0];
+	if (loaded_id)
+		*loaded_id = tmpres[1];
+
+	return 0;
+}
+
 int liblo10k1_debug(liblo10k1_connection_t *conn, int deb, void (*prn_fnc)(char *))
 {
 	int err;
@@ -472,6 +559,43 @@ int liblo10k1_dsp_init(liblo10k1_connection_t *conn)
 	return send_request_check(*conn, FNC_DSP_INIT, NULL, 0);
 }
 
+static int liblo10k1_transaction(liblo10k1_connection_t *conn, int op)
+{
+	int opr, sizer;
+	int err;
+
+	if ((err = send_request(*conn, op, NULL, 0)) < 0)
+		return err;
+
+	if ((err = receive_response(*conn, &opr, &sizer)) < 0)
+		return err;
+
+	/* older ld10k1 refuses unknown requests without error code */
+	if (opr == FNC_ERR)
+		return LD10K1_ERR_UNKNOWN_OP;
+	return 0;
+}
+
+/*
+ * Modifications up to the commit are sent to the driver at once.  If one
+ * of them fails, the whole transaction is rolled back and the commit
+ * returns the error.
+ */
+int liblo10k1_transaction_begin(liblo10k1_connection_t *conn)
+{
+	return liblo10k1_transaction(conn, FNC_TRANSACTION_BEGIN);
+}
+
+int liblo10k1_transaction_commit(liblo10k1_connection_t *conn)
+{
+	return liblo10k1_transaction(conn, FNC_TRANSACTION_COMMIT);
+}
+
+int liblo10k1_transaction_abort(liblo10k1_connection_t *conn)
+{
+	return liblo10k1_transaction(conn, FNC_TRANSACTION_ABORT);
+}
+
 static int liblo10k1_find_any(liblo10k1_connection_t *conn, int op, int patch, char *name, int *out)
 {
 	ld10k1_fnc_name_t name_info;
@@ -763,7 +887,11 @@ int liblo10k1_get_patches_info(liblo10k1_connection_t *conn, liblo10k1_patches_i
 	return 0;
 }
 
-int liblo10k1_patch_get(liblo10k1_connection_t *conn, int patch_num, liblo10k1_dsp_patch_t **opatch)
+/*
+ * Receives one patch as sent by FNC_GET_PATCH - the patch header followed
+ * by its parts - but not the final response.
+ */
+int liblo10k1_patch_receive(liblo10k1_connection_t *conn, liblo10k1_dsp_patch_t **opatch)
 {
 	liblo10k1_dsp_patch_t *patch;
 	int err;
@@ -771,14 +899,10 @@ int liblo10k1_patch_get(liblo10k1_connection_t *conn, int patch_num, liblo10k1_d
 	ld10k1_dsp_patch_t tmp_patch;
 	int opr, sizer;
 
-
-	if ((err = send_request(*conn, FNC_GET_PATCH, &patch_num, sizeof(patch_num))) < 0)
-		return err;
-
 	if ((err = receive_response(*conn, &opr, &sizer)) < 0)
 		return err;
 
-	if (opr != FNC_CONTINUE)
+	if (opr != FNC_CONTINUE || (unsigned int)sizer != sizeof(tmp_patch))
 		return LD10K1_ERR_PROTOCOL;
 
 	if ((err = receive_msg_data(*conn, &tmp_patch, sizeof(tmp_patch))) < 0)
@@ -794,7 +918,7 @@ int liblo10k1_patch_get(liblo10k1_connection_t *conn, int patch_num, liblo10k1_d
 	/* ins */
 	if (patch->in_count) {
 		if ((err = receive_response(*conn, &opr, &sizer)) < 0)
-			return err;
+			goto err;
 
 		if (opr != FNC_CONTINUE || (unsigned int)sizer != patch->in_count * sizeof(ld10k1_dsp_p_in_out_t))
 			goto err_protocol;
@@ -807,7 +931,7 @@ int liblo10k1_patch_get(liblo10k1_connection_t *conn, int patch_num, liblo10k1_d
 	/* outs */
 	if (patch->out_count) {
 		if ((err = receive_response(*conn, &opr, &sizer)) < 0)
-			return err;
+			goto err;
 
 		if (opr != FNC_CONTINUE || (unsigned int)sizer != patch->out_count * sizeof(ld10k1_dsp_p_in_out_t))
 			goto err_protocol;
@@ -820,7 +944,7 @@ int liblo10k1_patch_get(liblo10k1_connection_t *conn, int patch_num, liblo10k1_d
 	/* consts */
 	if (patch->const_count) {
 		if ((err = receive_response(*conn, &opr, &sizer)) < 0)
-			return err;
+			goto err;
 
 		if (opr != FNC_CONTINUE || (unsigned int)sizer != patch->const_count * sizeof(ld10k1_dsp_p_const_static_t))
 			goto err_protocol;
@@ -833,7 +957,7 @@ int liblo10k1_patch_get(liblo10k1_connection_t *conn, int patch_num, liblo10k1_d
 	/* stas */
 	if (patch->sta_count) {
 		if ((err = receive_response(*conn, &opr, &sizer)) < 0)
-			return err;
+			goto err;
 
 		if (opr != FNC_CONTINUE || (unsigned int)sizer != patch->sta_count * sizeof(ld10k1_dsp_p_const_static_t))
 			goto err_protocol;
@@ -846,7 +970,7 @@ int liblo10k1_patch_get(liblo10k1_connection_t *conn, int patch_num, liblo10k1_d
 	/* hws */
 	if (patch->hw_count) {
 		if ((err = receive_response(*conn, &opr, &sizer)) < 0)
-			return err;
+			goto err;
 
 		if (opr != FNC_CONTINUE || (unsigned int)sizer != patch->hw_count * sizeof(ld10k1_dsp_p_hw_t))
 			goto err_protocol;
@@ -859,7 +983,7 @@ int liblo10k1_patch_get(liblo10k1_connection_t *conn, int patch_num, liblo10k1_d
 	/* tram grp */
 	if (patch->tram_count) {
 		if ((err = receive_response(*conn, &opr, &sizer)) < 0)
-			return err;
+			goto err;
 
 		if (opr != FNC_CONTINUE || (unsigned int)sizer != patch->tram_count * sizeof(liblo10k1_dsp_tram_grp_t))
 			goto err_protocol;
@@ -872,7 +996,7 @@ int liblo10k1_patch_get(liblo10k1_connection_t *conn, int patch_num, liblo10k1_d
 	/* tram acc */
 	if (patch->tram_acc_count) {
 		if ((err = receive_response(*conn, &opr, &sizer)) < 0)
-			return err;
+			goto err;
 
 		if (opr != FNC_CONTINUE || (unsigned int)sizer != patch->tram_acc_count * sizeof(liblo10k1_dsp_tram_acc_t))
 			goto err_protocol;
@@ -885,7 +1009,7 @@ int liblo10k1_patch_get(liblo10k1_connection_t *conn, int patch_num, liblo10k1_d
 	/* ctls */
 	if (patch->ctl_count) {
 		if ((err = receive_response(*conn, &opr, &sizer)) < 0)
-			return err;
+			goto err;
 
 		if (opr != FNC_CONTINUE || (unsigned int)sizer != patch->ctl_count * sizeof(liblo10k1_dsp_ctl_t))
 			goto err_protocol;
@@ -898,7 +1022,7 @@ int liblo10k1_patch_get(liblo10k1_connection_t *conn, int patch_num, liblo10k1_d
 	/* instr */
 	if (patch->instr_count) {
 		if ((err = receive_response(*conn, &opr, &sizer)) < 0)
-			return err;
+			goto err;
 
 		if (opr != FNC_CONTINUE || (unsigned int)sizer != patch->instr_count * sizeof(liblo10k1_dsp_instr_t))
 			goto err_protocol;
@@ -908,11 +1032,6 @@ int liblo10k1_patch_get(liblo10k1_connection_t *conn, int patch_num, liblo10k1_d
 			goto err_nomem;
 	}
 
- 	if ((err = receive_response(*conn, &opr, &sizer)) < 0) {
-		liblo10k1_patch_free(patch);
-		return err;
-	}
-
 	*opatch = patch;
 	return 0;
 err_nomem:
@@ -922,6 +1041,31 @@ err_nomem:
 err_protocol:
 	liblo10k1_patch_free(patch);
 	return LD10K1_ERR_PROTOCOL;
+
+err:
+	liblo10k1_patch_free(patch);
+	return err;
+}
+
+int liblo10k1_patch_get(liblo10k1_connection_t *conn, int patch_num, liblo10k1_dsp_patch_t **opatch)
+{
+	liblo10k1_dsp_patch_t *patch;
+	int err;
+	int opr, sizer;
+
+	if ((err = send_request(*conn, FNC_GET_PATCH, &patch_num, sizeof(patch_num))) < 0)
+		return err;
+
+	if ((err = liblo10k1_patch_receive(conn, &patch)) < 0)
+		return err;
+
+	if ((err = receive_response(*conn, &opr, &sizer)) < 0) {
+		liblo10k1_patch_free(patch);
+		return err;
+	}
+
+	*opatch = patch;
+	return 0;
 }
 
 int liblo10k1_dump(liblo10k1_connection_t *conn, void **out, int *size)
@@ -1045,6 +1189,96 @@ int liblo10k1_get_dsp_info(liblo10k1_connection_t *conn, liblo10k1_dsp_info_t *i
 	return 0;
 }
 
+/*
+ * Events come on the subscribed connection at any time, so use another
+ * connection for requests.  Mask 0 ends the subscription.  generation
+ * is the number of the last change, the snapshot reports it too.
+ */
+int liblo10k1_subscribe(liblo10k1_connection_t *conn, unsigned int mask, unsigned int *generation)
+{
+	ld10k1_fnc_subscribe_t subscribe;
+	liblo10k1_event_t event;
+	unsigned int gen;
+	int opr, sizer;
+	int err;
+
+	subscribe.mask = mask;
+	if ((err = send_request(*conn, FNC_SUBSCRIBE, &subscribe, sizeof(subscribe))) < 0)
+		return err;
+
+	/* skip events from previous subscription */
+	while (1) {
+		if ((err = receive_response(*conn, &opr, &sizer)) < 0)
+			return err;
+		if (opr != FNC_EVENT)
+			break;
+		if (sizer < 0 || sizer > sizeof(event))
+			return LD10K1_ERR_PROTOCOL;
+		if ((err = receive_msg_data(*conn, &event, sizer)) < 0)
+			return err;
+	}
+
+	/* older ld10k1 refuses unknown requests without error code */
+	if (opr == FNC_ERR)
+		return LD10K1_ERR_UNKNOWN_OP;
+	if (sizer != sizeof(gen))
+		return LD10K1_ERR_PROTOCOL;
+	if ((err = receive_msg_data(*conn, &gen, sizeof(gen))) < 0)
+		return err;
+	if ((err = receive_response(*conn, &opr, &sizer)) < 0)
+		return err;
+
+	if (generation)
+		*generation = gen;
+	return 0;
+}
+
+/*
+ * Waits up to timeout ms (-1 for ever) for the next event.  Returns 1
+ * with the event, 0 if none came.
+ */
+int liblo10k1_event_read(liblo10k1_connection_t *conn, liblo10k1_event_t *event, int timeout)
+{
+	struct pollfd pfd;
+	int opr, sizer;
+	int err, res;
+
+	pfd.fd = *conn;
+	pfd.events = POLLIN;
+	do
+		res = poll(&pfd, 1, timeout);
+	while (res < 0 && errno == EINTR);
+	if (res < 0)
+		return LD10K1_ERR_COMM_READ;
+	if (res == 0)
+		return 0;
+
+	if ((err = receive_response(*conn, &opr, &sizer)) < 0)
+		return err;
+	if (opr != FNC_EVENT || sizer < offsetof(liblo10k1_event_t, value) || sizer > sizeof(*event))
+		return LD10K1_ERR_PROTOCOL;
+
+	memset(event, 0, sizeof(*event));
+	if ((err = receive_msg_data(*conn, event, sizer)) < 0)
+		return err;
+	return 1;
+}
+
+/* ld10k1 writes the values after it answers, last value set wins */
+int liblo10k1_ctl_set(liblo10k1_connection_t *conn, liblo10k1_ctl_value_t *values, int count)
+{
+	int err, part;
+
+	while (count > 0) {
+		part = count > LD10K1_CTL_SET_MAX ? LD10K1_CTL_SET_MAX : count;
+		if ((err = send_request_check(*conn, FNC_CTL_SET, values, sizeof(liblo10k1_ctl_value_t) * part)) < 0)
+			return err;
+		values += part;
+		count -= part;
+	}
+	return 0;
+}
+
 struct errmsg_t
 {
 	int errnum;
@@ -1077,6 +1311,7 @@ struct errmsg_t error_text[] =
 	{LD10K1_ERR_DRIVER_INFO, "Unable to get info"},
 	{LD10K1_ERR_DRIVER_CODE_PEEK, "Unable to peek code"},
 	{LD10K1_ERR_DRIVER_PCM_POKE, "Unable to poke pcm"},
+	{LD10K1_ERR_DRIVER_TRAM_SETUP, "Unable to setup tram"},
 
 /* tram */
 	{LD10K1_ERR_ITRAM_FULL, "Not enought free itram"},
@@ -1131,6 +1366,19 @@ struct errmsg_t error_text[] =
 	{LD10K1_ERR_REG_RENAME, "Couldn't rename register"},
 	{LD10K1_ERR_WRONG_VER, "Wrong ld10k1 version"},
 	{LD10K1_ERR_UNKNOWN_POINT, "Unknown point"},
+	{LD10K1_ERR_UNKNOWN_OP, "Operation not supported by ld10k1"},
+	{LD10K1_ERR_TRANSACTION, "Wrong transaction state"},
+	{LD10K1_ERR_UNKNOWN_CTL, "Wrong parameter - control doesn't exists"},
+	{LD10K1_ERR_CTL_VALUE, "Control value out of range"},
+	{LD10K1_ERR_REPO_NOT_FOUND, "Patch is not in repository"},
+	{LD10K1_ERR_REPO_IMAGE, "Patch in repository is damaged"},
+	{LD10K1_ERR_REPO_WRITE, "Can not write repository"},
+	{LD10K1_ERR_DUMP_OPEN, "Can not open dump file"},
+	{LD10K1_ERR_DUMP_READ, "Can not read dump file"},
+	{LD10K1_ERR_DUMP_SIGNATURE, "Wrong dump file signature"},
+	{LD10K1_ERR_DUMP_SIZE, "Wrong dump file size"},
+	{LD10K1_ERR_DUMP_CHECKSUM, "Wrong dump file checksum"},
+	{LD10K1_ERR_DUMP_TYPE, "Dump is for other card type"},
 	
 	/* errors from liblo10k1ef */
 	{LD10K1_EF_ERR_OPEN, "Can not open file"},
@@ -22,6 +22,10 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
 
 #include "version.h"
 #include "ld10k1.h"
@@ -36,362 +40,212 @@
 #define CREATER_SUBMINOR LD10K1_LIB_SUBMINOR
 
 #define FILE_MAJOR 0
-#define FILE_MINOR 1
+#define FILE_MINOR 2
 #define FILE_SUBMINOR 0
 
 #define READER_MAJOR 0
 #define READER_MINOR 1
-#define READER_SUBMINOR 7
+#define READER_SUBMINOR 8
 
-#define LD10K1_FILE_SIGNATURE "LD10K1 NATIVE EFFECT FILE      "
+#define LF_VERSION(major, minor, subminor) (((major) << 16) | ((minor) << 8) | (subminor))
 
-int liblo10k1lf_save_dsp_setup(liblo10k1_file_dsp_setup_t *c, FILE *file);
+#define LD10K1_FILE_SIGNATURE "LD10K1 NATIVE EFFECT FILE 2    "
+#define LD10K1_FILE_SIGNATURE_OLD "LD10K1 NATIVE EFFECT FILE      "
 
-int liblo10k1lf_save_file_header(FILE *file, unsigned int ft);
-int liblo10k1lf_save_file_info(FILE *file, liblo10k1_file_info_t *fi);
-int liblo10k1lf_save_part(FILE *file, unsigned int part_type, unsigned int part_id, unsigned int part_length, void *data);
-int liblo10k1lf_find_part(FILE *file, unsigned int part_type, unsigned int part_id, unsigned int part_length, liblo10k1_file_part_t *part);
-int liblo10k1lf_find_part_il(FILE *file, unsigned int part_type, unsigned int part_id, unsigned int part_length, int il, liblo10k1_file_part_t *part);
+#define LF_HEADER_SIZE 64
+#define LF_TOC_SIZE 16
+#define LF_ALIGN(x) (((x) + 7) & ~7)
 
-int liblo10k1lf_save_dsp_config(liblo10k1_file_dsp_setup_t *c, char *file_name, liblo10k1_file_info_t *fi)
+/*
+ * Record layouts - positive number is count of 32 bit words, negative
+ * count of chars, 0 ends layout. Structures are stored as they are in
+ * memory, only words are converted to little endian.
+ */
+static const int lf_layout_setup[] = {6, 0};
+static const int lf_layout_io[] = {-MAX_NAME_LEN, 0};
+static const int lf_layout_patch_info[] = {-MAX_NAME_LEN, 10, 0};
+static const int lf_layout_word[] = {1, 0};
+static const int lf_layout_tram[] = {3, 0};
+static const int lf_layout_ctl[] = {-44, 3 + MAX_CTL_GPR_COUNT + 3, 0};
+static const int lf_layout_instr[] = {5, 0};
+static const int lf_layout_point[] = {6 + 3 * POINT_MAX_CONN_PER_POINT, 0};
+
+static unsigned int lf_layout_size(const int *layout)
 {
-	FILE *file = NULL;
-	int err;
-	
-	file = fopen(file_name, "w");
-	if (!file)
-		return LD10K1_LF_ERR_OPEN;
-		
-	if ((err = liblo10k1lf_save_file_header(file, LD10K1_FP_INFO_FILE_TYPE_DSP_SETUP)) < 0)
-		goto err;
-		
-	if ((err = liblo10k1lf_save_file_info(file, fi)) < 0)
-		goto err;
-		
-	if ((err =  liblo10k1lf_save_dsp_setup(c, file)) < 0)
-		goto err;
-		
-	fclose(file);
-	return 0;
-err:
-	fclose(file);
-	return err;
-}
+	unsigned int size = 0;
 
-int liblo10k1lf_save_part(FILE *file, unsigned int part_type, unsigned int part_id, unsigned int part_length, void *data)
-{
-	liblo10k1_file_part_t part;
-	
-	memset(&part, 0, sizeof(part));
-	part.part_type = part_type;
-	part.part_id = part_id;
-	part.part_length = part_length;
-	
-	if (fwrite(&part, sizeof(liblo10k1_file_part_t), 1, file) != 1)
-		return LD10K1_LF_ERR_WRITE;
-		
-	if (part_length > 0)
-		if (fwrite(data, part_length, 1, file) != 1)
-			return LD10K1_LF_ERR_WRITE;
-	return 0;
+	for (; *layout; layout++)
+		size += *layout > 0 ? *layout * 4 : -*layout;
+	return size;
 }
 
-int liblo10k1lf_save_file_header(FILE *file, unsigned int ft)
+static void lf_put_le32(unsigned char *p, unsigned int v)
 {
-	liblo10k1_file_header_t fhdr;
-	liblo10k1_file_part_info_t file_info;
-	int err;
-	
-	strcpy(fhdr.signature, LD10K1_FILE_SIGNATURE);
-	memset(fhdr.reserved, 0, sizeof(fhdr.reserved));
-	
-	if (fwrite(&fhdr, sizeof(liblo10k1_file_header_t), 1, file) != 1)
-		return LD10K1_LF_ERR_WRITE;
-	
-	memset(&file_info, 0, sizeof(file_info));
-	
-	file_info.file_type = ft;
-	
-	file_info.file_version_major = FILE_MAJOR;
-	file_info.file_version_minor = FILE_MINOR;
-	file_info.file_version_subminor = FILE_SUBMINOR; /* file version = 0.0.1 */
-	
-	file_info.minimal_reader_version_major = READER_MAJOR;
-	file_info.minimal_reader_version_minor = READER_MINOR;
-	file_info.minimal_reader_version_subminor = READER_SUBMINOR; /* minimal reader version = 0.1.7 */
-	
-	file_info.creater_version_major = CREATER_MAJOR;
-	file_info.creater_version_minor = CREATER_MINOR;
-	file_info.creater_version_subminor = CREATER_SUBMINOR; /* creater version = 0.1.7 */
-	
-	if ((err = liblo10k1lf_save_part(file, LD10K1_FP_TYPE_NORMAL, LD10K1_FP_INFO, sizeof(file_info), &file_info)) < 0)
-		return err;
-	return 0;
+	p[0] = v;
+	p[1] = v >> 8;
+	p[2] = v >> 16;
+	p[3] = v >> 24;
 }
 
-int liblo10k1lf_save_string_info(FILE *file, int id, char *str)
+static unsigned int lf_get_le32(const unsigned char *p)
 {
-	int str_len;
-	int err;
-	
-	if (str)
-		str_len = strlen(str) + 1;
-	else
-		str_len = 0;
-		
-	if ((err = liblo10k1lf_save_part(file, LD10K1_FP_TYPE_NORMAL, id, str_len, str)) < 0)
-		return err;
-	return 0;
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int)p[3] << 24);
 }
 
-int liblo10k1lf_load_string_info(FILE *file, int id, char **str)
+static void lf_encode(unsigned char *to, const unsigned char *from, const int *layout, unsigned int count)
 {
-	char *tmp;
-	int err;
-	liblo10k1_file_part_t part;
-	
-	if ((err = liblo10k1lf_find_part_il(file, LD10K1_FP_TYPE_NORMAL, id, 0, 1, &part)) < 0)
-		return err;
-	
-	tmp = NULL;
-	if (part.part_length > 0) {
-		tmp = (char *)malloc(part.part_length);
-		if (!tmp)
-			return LD10K1_ERR_NO_MEM;
-			
-		if (fread(tmp, part.part_length, 1, file) != 1) {
-			free(tmp);
-			return LD10K1_LF_ERR_READ;
+	unsigned int i, v;
+	const int *l;
+	int j;
+
+	for (i = 0; i < count; i++)
+		for (l = layout; *l; l++) {
+			if (*l < 0) {
+				memcpy(to, from, -*l);
+				to += -*l;
+				from += -*l;
+			} else {
+				for (j = 0; j < *l; j++) {
+					memcpy(&v, from, 4);
+					lf_put_le32(to, v);
+					to += 4;
+					from += 4;
+				}
+			}
 		}
-	}
-	
-	if (*str)
-		free(*str);
-	*str = tmp;
-	return 0;
 }
 
-int liblo10k1lf_save_file_info(FILE *file, liblo10k1_file_info_t *fi)
+static void lf_decode(unsigned char *to, const unsigned char *from, const int *layout, unsigned int count)
 {
-	int err;
-	
-	if ((err = liblo10k1lf_save_string_info(file, LD10K1_FP_FILE_INFO_NAME, fi->name)) < 0)
-		return err;
-	if ((err = liblo10k1lf_save_string_info(file, LD10K1_FP_FILE_INFO_DESC, fi->desc)) < 0)
-		return err;
-	if ((err = liblo10k1lf_save_string_info(file, LD10K1_FP_FILE_INFO_CREATER, fi->creater)) < 0)
-		return err;
-	if ((err = liblo10k1lf_save_string_info(file, LD10K1_FP_FILE_INFO_AUTHOR, fi->author)) < 0)
-		return err;
-	if ((err = liblo10k1lf_save_string_info(file, LD10K1_FP_FILE_INFO_COPYRIGHT, fi->copyright)) < 0)
-		return err;
-	if ((err = liblo10k1lf_save_string_info(file, LD10K1_FP_FILE_INFO_LICENCE, fi->license)) < 0)
-		return err;
-	return 0;
+	unsigned int i, v;
+	const int *l;
+	int j;
+
+	for (i = 0; i < count; i++)
+		for (l = layout; *l; l++) {
+			if (*l < 0) {
+				memcpy(to, from, -*l);
+				/* names are always terminated */
+				to[-*l - 1] = '\0';
+				to += -*l;
+				from += -*l;
+			} else {
+				for (j = 0; j < *l; j++) {
+					v = lf_get_le32(from);
+					memcpy(to, &v, 4);
+					to += 4;
+					from += 4;
+				}
+			}
+		}
 }
 
-int liblo10k1lf_load_file_info(FILE *file, liblo10k1_file_info_t **fi)
+/* file is built in memory and written at once */
+typedef struct {
+	unsigned char *data;
+	unsigned int size;
+	unsigned int alloc;
+	liblo10k1_file_toc_t *toc;
+	unsigned int toc_count;
+	unsigned int toc_alloc;
+} liblo10k1lf_image_t;
+
+static int liblo10k1lf_image_reserve(liblo10k1lf_image_t *img, unsigned int size)
 {
-	int err;
-	
-	liblo10k1_file_info_t *i = liblo10k1lf_file_info_alloc();
-	
-	if (!i)
+	unsigned char *tmp;
+	unsigned int new_alloc;
+
+	if (img->size + size <= img->alloc)
+		return 0;
+
+	new_alloc = img->alloc ? img->alloc : 4096;
+	while (new_alloc < img->size + size)
+		new_alloc *= 2;
+
+	tmp = (unsigned char *)realloc(img->data, new_alloc);
+	if (!tmp)
 		return LD10K1_ERR_NO_MEM;
-	
-	if ((err = liblo10k1lf_load_string_info(file, LD10K1_FP_FILE_INFO_NAME, &(i->name))) < 0)
-		goto err;
-	if ((err = liblo10k1lf_load_string_info(file, LD10K1_FP_FILE_INFO_DESC, &(i->desc))) < 0)
-		goto err;
-	if ((err = liblo10k1lf_load_string_info(file, LD10K1_FP_FILE_INFO_CREATER, &(i->creater))) < 0)
-		goto err;
-	if ((err = liblo10k1lf_load_string_info(file, LD10K1_FP_FILE_INFO_AUTHOR, &(i->author))) < 0)
-		goto err;
-	if ((err = liblo10k1lf_load_string_info(file, LD10K1_FP_FILE_INFO_COPYRIGHT, &(i->copyright))) < 0)
-		goto err;
-	if ((err = liblo10k1lf_load_string_info(file, LD10K1_FP_FILE_INFO_LICENCE, &(i->license))) < 0)
-		goto err;
-		
-	*fi = i;
+	memset(tmp + img->alloc, 0, new_alloc - img->alloc);
+	img->data = tmp;
+	img->alloc = new_alloc;
 	return 0;
-err:
-	if (i)
-		liblo10k1lf_file_info_free(i);
-	return err;
 }
 
-int liblo10k1lf_save_io(liblo10k1_get_io_t *ios, int count, int ptl, int pt, FILE *file)
+static int liblo10k1lf_image_part(liblo10k1lf_image_t *img, unsigned int part_id, unsigned int index,
+	const int *layout, unsigned int rec_size, unsigned int count, const void *data)
 {
-	int i, err;
-	/* io list start */
-	if ((err = liblo10k1lf_save_part(file, LD10K1_FP_TYPE_START, ptl, 0, NULL)) < 0)
-		return err;
-		
-	for (i = 0; i < count; i++) {
-		if ((err = liblo10k1lf_save_part(file, LD10K1_FP_TYPE_NORMAL, pt, sizeof(liblo10k1_get_io_t), &(ios[i]))) < 0)
-			return err;
-	}
-		
-	if ((err = liblo10k1lf_save_part(file, LD10K1_FP_TYPE_END, ptl, 0, NULL)) < 0)
-		return err;
-	
-	return 0;
-}
+	liblo10k1_file_toc_t *toc;
+	unsigned int length;
+	int err;
 
-int liblo10k1lf_save_pio(liblo10k1_dsp_pio_t *ios, int count, int ptl, int pt, FILE *file)
-{
-	int i, err;
-	/* io list start */
-	if ((err = liblo10k1lf_save_part(file, LD10K1_FP_TYPE_START, ptl, 0, NULL)) < 0)
-		return err;
-		
-	for (i = 0; i < count; i++) {
-		if ((err = liblo10k1lf_save_part(file, LD10K1_FP_TYPE_NORMAL, pt, sizeof(liblo10k1_dsp_pio_t), &(ios[i]))) < 0)
-			return err;
-	}
-		
-	if ((err = liblo10k1lf_save_part(file, LD10K1_FP_TYPE_END, ptl, 0, NULL)) < 0)
-		return err;
-	
-	return 0;
-}
+	if (!count)
+		return 0;
 
-int liblo10k1lf_save_cs(liblo10k1_dsp_cs_t *css, int count, int ptl, int pt, FILE *file)
-{
-	int i, err;
-	/* io list start */
-	if ((err = liblo10k1lf_save_part(file, LD10K1_FP_TYPE_START, ptl, 0, NULL)) < 0)
-		return err;
-		
-	for (i = 0; i < count; i++) {
-		if ((err = liblo10k1lf_save_part(file, LD10K1_FP_TYPE_NORMAL, pt, sizeof(liblo10k1_dsp_cs_t), &(css[i]))) < 0)
-			return err;
-	}
-		
-	if ((err = liblo10k1lf_save_part(file, LD10K1_FP_TYPE_END, ptl, 0, NULL)) < 0)
-		return err;
-		
-	return 0;
-}
+	if (lf_layout_size(layout) != rec_size)
+		return LD10K1_LF_ERR_PART_SIZE;
 
-int liblo10k1lf_save_hw(liblo10k1_dsp_hw_t *hws, int count, FILE *file)
-{
-	int i, err;
-	/* io list start */
-	if ((err = liblo10k1lf_save_part(file, LD10K1_FP_TYPE_START, LD10K1_FP_HW_LIST, 0, NULL)) < 0)
+	length = rec_size * count;
+	img->size = LF_ALIGN(img->size);
+	if ((err = liblo10k1lf_image_reserve(img, length)) < 0)
 		return err;
-		
-	for (i = 0; i < count; i++) {
-		if ((err = liblo10k1lf_save_part(file, LD10K1_FP_TYPE_NORMAL, LD10K1_FP_HW, sizeof(liblo10k1_dsp_hw_t), &(hws[i]))) < 0)
-			return err;
+
+	if (img->toc_count >= img->toc_alloc) {
+		toc = (liblo10k1_file_toc_t *)realloc(img->toc,
+			sizeof(liblo10k1_file_toc_t) * (img->toc_alloc + 32));
+		if (!toc)
+			return LD10K1_ERR_NO_MEM;
+		img->toc = toc;
+		img->toc_alloc += 32;
 	}
-		
-	if ((err = liblo10k1lf_save_part(file, LD10K1_FP_TYPE_END, LD10K1_FP_HW_LIST, 0, NULL)) < 0)
-		return err;
 
-	return 0;
-}
+	toc = &(img->toc[img->toc_count++]);
+	toc->part_id = part_id;
+	toc->index = index;
+	toc->offset = img->size;
+	toc->length = length;
 
-int liblo10k1lf_save_tram(liblo10k1_dsp_tram_grp_t *trams, int count, FILE *file)
-{
-	int i, err;
-	/* io list start */
-	if ((err = liblo10k1lf_save_part(file, LD10K1_FP_TYPE_START, LD10K1_FP_TRAM_LIST, 0, NULL)) < 0)
-		return err;
-		
-	for (i = 0; i < count; i++) {
-		if ((err = liblo10k1lf_save_part(file, LD10K1_FP_TYPE_NORMAL, LD10K1_FP_TRAM, sizeof(liblo10k1_dsp_tram_grp_t), &(trams[i]))) < 0)
-			return err;
-	}
-		
-	if ((err = liblo10k1lf_save_part(file, LD10K1_FP_TYPE_END, LD10K1_FP_TRAM_LIST, 0, NULL)) < 0)
-		return err;
-		
+	lf_encode(img->data + img->size, (const unsigned char *)data, layout, count);
+	img->size += length;
 	return 0;
 }
 
-int liblo10k1lf_save_tram_acc(liblo10k1_dsp_tram_acc_t *tram_accs, int count, FILE *file)
+static int liblo10k1lf_image_string(liblo10k1lf_image_t *img, unsigned int part_id, char *str)
 {
-	int i, err;
-	/* io list start */
-	if ((err = liblo10k1lf_save_part(file, LD10K1_FP_TYPE_START, LD10K1_FP_TRAM_ACC_LIST, 0, NULL)) < 0)
-		return err;
-		
-	for (i = 0; i < count; i++) {
-		if ((err = liblo10k1lf_save_part(file, LD10K1_FP_TYPE_NORMAL, LD10K1_FP_TRAM_ACC, sizeof(liblo10k1_dsp_tram_acc_t), &(tram_accs[i]))) < 0)
-			return err;
-	}
-		
-	if ((err = liblo10k1lf_save_part(file, LD10K1_FP_TYPE_END, LD10K1_FP_TRAM_ACC_LIST, 0, NULL)) < 0)
-		return err;
-		
-	return 0;
+	int layout[2];
+
+	if (!str)
+		return 0;
+
+	layout[0] = -(int)(strlen(str) + 1);
+	layout[1] = 0;
+	return liblo10k1lf_image_part(img, part_id, 0, layout, -layout[0], 1, str);
 }
 
-int liblo10k1lf_save_ctl(liblo10k1_dsp_ctl_t *ctls, int count, FILE *file)
+static int liblo10k1lf_image_file_info(liblo10k1lf_image_t *img, liblo10k1_file_info_t *fi)
 {
-	int i, err;
-	/* io list start */
-	if ((err = liblo10k1lf_save_part(file, LD10K1_FP_TYPE_START, LD10K1_FP_CTL_LIST, 0, NULL)) < 0)
+	int err;
+
+	if ((err = liblo10k1lf_image_string(img, LD10K1_FP_FILE_INFO_NAME, fi->name)) < 0)
 		return err;
-		
-	for (i = 0; i < count; i++) {
-		if ((err = liblo10k1lf_save_part(file, LD10K1_FP_TYPE_NORMAL, LD10K1_FP_CTL, sizeof(liblo10k1_dsp_ctl_t), &(ctls[i]))) < 0)
-			return err;
-	}
-		
-	if ((err = liblo10k1lf_save_part(file, LD10K1_FP_TYPE_END, LD10K1_FP_CTL_LIST, 0, NULL)) < 0)
+	if ((err = liblo10k1lf_image_string(img, LD10K1_FP_FILE_INFO_DESC, fi->desc)) < 0)
 		return err;
-		
-	return 0;
-}
-
-int liblo10k1lf_save_instr(liblo10k1_dsp_instr_t *instrs, int count, FILE *file)
-{
-	int i, err;
-	/* io list start */
-	if ((err = liblo10k1lf_save_part(file, LD10K1_FP_TYPE_START, LD10K1_FP_INSTR_LIST, 0, NULL)) < 0)
+	if ((err = liblo10k1lf_image_string(img, LD10K1_FP_FILE_INFO_CREATER, fi->creater)) < 0)
 		return err;
-		
-	for (i = 0; i < count; i++) {
-		if ((err = liblo10k1lf_save_part(file, LD10K1_FP_TYPE_NORMAL, LD10K1_FP_INSTR, sizeof(liblo10k1_dsp_instr_t), &(instrs[i]))) < 0)
-			return err;
-	}
-		
-	if ((err = liblo10k1lf_save_part(file, LD10K1_FP_TYPE_END, LD10K1_FP_INSTR_LIST, 0, NULL)) < 0)
+	if ((err = liblo10k1lf_image_string(img, LD10K1_FP_FILE_INFO_AUTHOR, fi->author)) < 0)
 		return err;
-		
-	return 0;
-}
-
-int liblo10k1lf_save_points(liblo10k1_point_info_t *points, int count, FILE *file)
-{
-	int i, err;
-	/* io list start */
-	if ((err = liblo10k1lf_save_part(file, LD10K1_FP_TYPE_START, LD10K1_FP_POINT_LIST, 0, NULL)) < 0)
+	if ((err = liblo10k1lf_image_string(img, LD10K1_FP_FILE_INFO_COPYRIGHT, fi->copyright)) < 0)
 		return err;
-		
-	for (i = 0; i < count; i++) {
-		if ((err = liblo10k1lf_save_part(file, LD10K1_FP_TYPE_NORMAL, LD10K1_FP_POINT, sizeof(liblo10k1_point_info_t), &(points[i]))) < 0)
-			return err;
-	}
-		
-	if ((err = liblo10k1lf_save_part(file, LD10K1_FP_TYPE_END, LD10K1_FP_POINT_LIST, 0, NULL)) < 0)
+	if ((err = liblo10k1lf_image_string(img, LD10K1_FP_FILE_INFO_LICENCE, fi->license)) < 0)
 		return err;
-		
 	return 0;
 }
 
-int liblo10k1lf_save_patch(liblo10k1_dsp_patch_t *p, FILE *file)
+static int liblo10k1lf_image_patch(liblo10k1lf_image_t *img, liblo10k1_dsp_patch_t *p, unsigned int index)
 {
-	int err;
 	liblo10k1_file_patch_info_t pinfo;
-	
-	/* io list start */
-	if ((err = liblo10k1lf_save_part(file, LD10K1_FP_TYPE_START, LD10K1_FP_PATCH, 0, NULL)) < 0)
-		return err;
-		
-	/* patch info */
+	int err;
+
+	memset(&pinfo, 0, sizeof(pinfo));
 	strcpy(pinfo.patch_name, p->patch_name);
 	pinfo.in_count = p->in_count;
 	pinfo.out_count = p->out_count;
@@ -404,90 +258,160 @@ int liblo10k1lf_save_patch(liblo10k1_dsp_patch_t *p, FILE *file)
 	pinfo.ctl_count = p->ctl_count;
 	pinfo.instr_count = p->instr_count;
 
-	if ((err = liblo10k1lf_save_part(file, LD10K1_FP_TYPE_NORMAL, LD10K1_FP_PATCH_INFO, sizeof(liblo10k1_file_patch_info_t), &pinfo)) < 0)
-			return err;
-			
-	/* pins */
-	if ((err = liblo10k1lf_save_pio(p->ins, p->in_count, LD10K1_FP_PIN_LIST, LD10K1_FP_PIO, file)) < 0)
+	if ((err = liblo10k1lf_image_part(img, LD10K1_FP_PATCH_INFO, index, lf_layout_patch_info,
+		sizeof(pinfo), 1, &pinfo)) < 0)
 		return err;
-	/* pouts */
-	if ((err = liblo10k1lf_save_pio(p->outs, p->out_count, LD10K1_FP_POUT_LIST, LD10K1_FP_PIO, file)) < 0)
+	if ((err = liblo10k1lf_image_part(img, LD10K1_FP_PIN_LIST, index, lf_layout_io,
+		sizeof(liblo10k1_dsp_pio_t), p->in_count, p->ins)) < 0)
 		return err;
-	/* consts */
-	if ((err = liblo10k1lf_save_cs(p->consts, p->const_count, LD10K1_FP_CONST_LIST, LD10K1_FP_CS, file)) < 0)
+	if ((err = liblo10k1lf_image_part(img, LD10K1_FP_POUT_LIST, index, lf_layout_io,
+		sizeof(liblo10k1_dsp_pio_t), p->out_count, p->outs)) < 0)
 		return err;
-	/* stas */
-	if ((err = liblo10k1lf_save_cs(p->stas, p->sta_count, LD10K1_FP_STA_LIST, LD10K1_FP_CS, file)) < 0)
+	if ((err = liblo10k1lf_image_part(img, LD10K1_FP_CONST_LIST, index, lf_layout_word,
+		sizeof(liblo10k1_dsp_cs_t), p->const_count, p->consts)) < 0)
 		return err;
-	/* hws */
-	if ((err = liblo10k1lf_save_hw(p->hws, p->hw_count, file)) < 0)
+	if ((err = liblo10k1lf_image_part(img, LD10K1_FP_STA_LIST, index, lf_layout_word,
+		sizeof(liblo10k1_dsp_cs_t), p->sta_count, p->stas)) < 0)
 		return err;
-	/* trams */
-	if ((err = liblo10k1lf_save_tram(p->tram, p->tram_count, file)) < 0)
+	if ((err = liblo10k1lf_image_part(img, LD10K1_FP_HW_LIST, index, lf_layout_word,
+		sizeof(liblo10k1_dsp_hw_t), p->hw_count, p->hws)) < 0)
 		return err;
-	/* tram_accs */
-	if ((err = liblo10k1lf_save_tram_acc(p->tram_acc, p->tram_acc_count, file)) < 0)
+	if ((err = liblo10k1lf_image_part(img, LD10K1_FP_TRAM_LIST, index, lf_layout_tram,
+		sizeof(liblo10k1_dsp_tram_grp_t), p->tram_count, p->tram)) < 0)
 		return err;
-	/* ctls */
-	if ((err = liblo10k1lf_save_ctl(p->ctl, p->ctl_count, file)) < 0)
+	if ((err = liblo10k1lf_image_part(img, LD10K1_FP_TRAM_ACC_LIST, index, lf_layout_tram,
+		sizeof(liblo10k1_dsp_tram_acc_t), p->tram_acc_count, p->tram_acc)) < 0)
 		return err;
-	/* instrs */
-	if ((err = liblo10k1lf_save_instr(p->instr, p->instr_count, file)) < 0)
+	if ((err = liblo10k1lf_image_part(img, LD10K1_FP_CTL_LIST, index, lf_layout_ctl,
+		sizeof(liblo10k1_dsp_ctl_t), p->ctl_count, p->ctl)) < 0)
 		return err;
-		
-	if ((err = liblo10k1lf_save_part(file, LD10K1_FP_TYPE_END, LD10K1_FP_PATCH, 0, NULL)) < 0)
+	if ((err = liblo10k1lf_image_part(img, LD10K1_FP_INSTR_LIST, index, lf_layout_instr,
+		sizeof(liblo10k1_dsp_instr_t), p->instr_count, p->instr)) < 0)
 		return err;
-		
 	return 0;
 }
 
-int liblo10k1lf_save_dsp_setup(liblo10k1_file_dsp_setup_t *c, FILE *file)
+static int liblo10k1lf_image_dsp_setup(liblo10k1lf_image_t *img, liblo10k1_file_dsp_setup_t *c)
 {
 	liblo10k1_file_part_dsp_setup_t setup;
 	int err;
 	int i;
-	
+
 	setup.dsp_type = c->dsp_type;
 	setup.fx_count = c->fx_count;
 	setup.in_count = c->in_count;
 	setup.out_count = c->out_count;
 	setup.patch_count = c->patch_count;
 	setup.point_count = c->point_count;
-	
-	if ((err = liblo10k1lf_save_part(file, LD10K1_FP_TYPE_NORMAL, LD10K1_FP_DSP_SETUP, sizeof(setup), &setup)) < 0)
+
+	if ((err = liblo10k1lf_image_part(img, LD10K1_FP_DSP_SETUP, 0, lf_layout_setup,
+		sizeof(setup), 1, &setup)) < 0)
 		return err;
-		
-	/* save fx */
-	if ((err = liblo10k1lf_save_io(c->fxs, c->fx_count, LD10K1_FP_FX_LIST, LD10K1_FP_FX, file)) < 0)
+	if ((err = liblo10k1lf_image_part(img, LD10K1_FP_FX_LIST, 0, lf_layout_io,
+		sizeof(liblo10k1_get_io_t), c->fx_count, c->fxs)) < 0)
 		return err;
-		
-	/* save in */
-	if ((err = liblo10k1lf_save_io(c->ins, c->in_count, LD10K1_FP_IN_LIST, LD10K1_FP_IN, file)) < 0)
+	if ((err = liblo10k1lf_image_part(img, LD10K1_FP_IN_LIST, 0, lf_layout_io,
+		sizeof(liblo10k1_get_io_t), c->in_count, c->ins)) < 0)
 		return err;
-		
-	/* save out */
-	if ((err = liblo10k1lf_save_io(c->outs, c->out_count, LD10K1_FP_OUT_LIST, LD10K1_FP_OUT, file)) < 0)
+	if ((err = liblo10k1lf_image_part(img, LD10K1_FP_OUT_LIST, 0, lf_layout_io,
+		sizeof(liblo10k1_get_io_t), c->out_count, c->outs)) < 0)
 		return err;
-	
-	/* save patches */	
-	if ((err = liblo10k1lf_save_part(file, LD10K1_FP_TYPE_START, LD10K1_FP_PATCH_LIST, 0, NULL)) < 0)
-		return err;
-		
+
 	for (i = 0; i < c->patch_count; i++) {
-		if ((err = liblo10k1lf_save_patch(c->patches[i], file)) < 0)
+		if ((err = liblo10k1lf_image_patch(img, c->patches[i], i)) < 0)
 			return err;
 	}
-	
-	if ((err = liblo10k1lf_save_part(file, LD10K1_FP_TYPE_END, LD10K1_FP_PATCH_LIST, 0, NULL)) < 0)
+
+	if ((err = liblo10k1lf_image_part(img, LD10K1_FP_POINT_LIST, 0, lf_layout_point,
+		sizeof(liblo10k1_point_info_t), c->point_count, c->points)) < 0)
 		return err;
-	
-	/* save points */
-	if ((err = liblo10k1lf_save_points(c->points, c->point_count, file)) < 0)
+	return 0;
+}
+
+/* adds table of contents and header, writes whole image */
+static int liblo10k1lf_image_write(liblo10k1lf_image_t *img, unsigned int ft, char *file_name)
+{
+	unsigned int toc_offset;
+	unsigned char *p;
+	FILE *file;
+	int i, err;
+
+	img->size = LF_ALIGN(img->size);
+	toc_offset = img->size;
+	if ((err = liblo10k1lf_image_reserve(img, img->toc_count * LF_TOC_SIZE)) < 0)
 		return err;
-		
+
+	for (i = 0; i < img->toc_count; i++) {
+		p = img->data + toc_offset + i * LF_TOC_SIZE;
+		lf_put_le32(p, img->toc[i].part_id);
+		lf_put_le32(p + 4, img->toc[i].index);
+		lf_put_le32(p + 8, img->toc[i].offset);
+		lf_put_le32(p + 12, img->toc[i].length);
+	}
+	img->size += img->toc_count * LF_TOC_SIZE;
+
+	p = img->data;
+	memset(p, 0, LF_HEADER_SIZE);
+	strcpy((char *)p, LD10K1_FILE_SIGNATURE);
+	lf_put_le32(p + 32, ft);
+	lf_put_le32(p + 36, LF_VERSION(FILE_MAJOR, FILE_MINOR, FILE_SUBMINOR));
+	lf_put_le32(p + 40, LF_VERSION(READER_MAJOR, READER_MINOR, READER_SUBMINOR));
+	lf_put_le32(p + 44, LF_VERSION(CREATER_MAJOR, CREATER_MINOR, CREATER_SUBMINOR));
+	lf_put_le32(p + 48, img->size);
+	lf_put_le32(p + 52, toc_offset);
+	lf_put_le32(p + 56, img->toc_count);
+
+	file = fopen(file_name, "w");
+	if (!file)
+		return LD10K1_LF_ERR_OPEN;
+
+	if (fwrite(img->data, img->size, 1, file) != 1) {
+		fclose(file);
+		return LD10K1_LF_ERR_WRITE;
+	}
+	if (fclose(file))
+		return LD10K1_LF_ERR_WRITE;
+	return 0;
+}
+
+static void liblo10k1lf_image_free(liblo10k1lf_image_t *img)
+{
+	if (img->data)
+		free(img->data);
+	if (img->toc)
+		free(img->toc);
+}
+
+static int liblo10k1lf_image_init(liblo10k1lf_image_t *img)
+{
+	memset(img, 0, sizeof(*img));
+	/* header */
+	if (liblo10k1lf_image_reserve(img, LF_HEADER_SIZE) < 0)
+		return LD10K1_ERR_NO_MEM;
+	img->size = LF_HEADER_SIZE;
 	return 0;
 }
 
+int liblo10k1lf_save_dsp_config(liblo10k1_file_dsp_setup_t *c, char *file_name, liblo10k1_file_info_t *fi)
+{
+	liblo10k1lf_image_t img;
+	int err;
+
+	if ((err = liblo10k1lf_image_init(&img)) < 0)
+		return err;
+
+	if ((err = liblo10k1lf_image_file_info(&img, fi)) < 0)
+		goto err;
+
+	if ((err = liblo10k1lf_image_dsp_setup(&img, c)) < 0)
+		goto err;
+
+	err = liblo10k1lf_image_write(&img, LD10K1_FP_INFO_FILE_TYPE_DSP_SETUP, file_name);
+err:
+	liblo10k1lf_image_free(&img);
+	return err;
+}
+
 liblo10k1_file_dsp_setup_t *liblo10k1lf_dsp_config_alloc()
 {
 	liblo10k1_file_dsp_setup_t *tmp = (liblo10k1_file_dsp_setup_t *)malloc(sizeof(liblo10k1_file_dsp_setup_t));
@@ -619,6 +543,97 @@ int liblo10k1lf_dsp_config_set_point_count(liblo10k1_file_dsp_setup_t *c, int co
 	return 0;	
 }
 
+static int liblo10k1lf_receive_array(liblo10k1_connection_t *conn, void *data, int size)
+{
+	int err;
+	int opr, sizer;
+
+	if (!size)
+		return 0;
+
+	if ((err = receive_response(*conn, &opr, &sizer)) < 0)
+		return err;
+
+	if (opr != FNC_CONTINUE || sizer != size)
+		return LD10K1_ERR_PROTOCOL;
+
+	return receive_msg_data(*conn, data, size);
+}
+
+/*
+ * Fetches everything with one FNC_GET_DSP_SNAPSHOT request.  Returns
+ * LD10K1_ERR_UNKNOWN_OP when ld10k1 is too old to know it.
+ */
+static int liblo10k1lf_get_dsp_snapshot(liblo10k1_connection_t *conn, liblo10k1_file_dsp_setup_t *s)
+{
+	ld10k1_fnc_dsp_snapshot_t snap;
+	int err;
+	int opr, sizer;
+	int i, j;
+
+	if ((err = send_request(*conn, FNC_GET_DSP_SNAPSHOT, 0, 0)) < 0)
+		return err;
+
+	if ((err = receive_response(*conn, &opr, &sizer)) < 0)
+		return err;
+
+	if (opr == FNC_ERR)
+		return LD10K1_ERR_UNKNOWN_OP;
+
+	if (opr != FNC_CONTINUE || sizer != sizeof(snap))
+		return LD10K1_ERR_PROTOCOL;
+
+	if ((err = receive_msg_data(*conn, &snap, sizeof(snap))) < 0)
+		return err;
+
+	s->dsp_type = LD10K1_FP_INFO_DSP_TYPE_EMU10K1;
+	if (snap.chip_type == CHIP_LIVE)
+		s->dsp_type = LD10K1_FP_INFO_DSP_TYPE_EMU10K1;
+	else if (snap.chip_type == CHIP_AUDIGY)
+		s->dsp_type = LD10K1_FP_INFO_DSP_TYPE_EMU10K2;
+
+	if ((err = liblo10k1lf_dsp_config_set_fx_count(s, snap.fx_count)) < 0)
+		return err;
+	if ((err = liblo10k1lf_receive_array(conn, s->fxs, sizeof(liblo10k1_get_io_t) * s->fx_count)) < 0)
+		return err;
+
+	if ((err = liblo10k1lf_dsp_config_set_in_count(s, snap.in_count)) < 0)
+		return err;
+	if ((err = liblo10k1lf_receive_array(conn, s->ins, sizeof(liblo10k1_get_io_t) * s->in_count)) < 0)
+		return err;
+
+	if ((err = liblo10k1lf_dsp_config_set_out_count(s, snap.out_count)) < 0)
+		return err;
+	if ((err = liblo10k1lf_receive_array(conn, s->outs, sizeof(liblo10k1_get_io_t) * s->out_count)) < 0)
+		return err;
+
+	if ((err = liblo10k1lf_dsp_config_set_patch_count(s, snap.patch_count)) < 0)
+		return err;
+	for (i = 0; i < s->patch_count; i++) {
+		if ((err = liblo10k1_patch_receive(conn, &(s->patches[i]))) < 0)
+			return err;
+	}
+
+	if ((err = liblo10k1lf_dsp_config_set_point_count(s, snap.point_count)) < 0)
+		return err;
+	if ((err = liblo10k1lf_receive_array(conn, s->points, sizeof(liblo10k1_point_info_t) * s->point_count)) < 0)
+		return err;
+
+	/* points already refer to patch indexes, only check them */
+	for (i = 0; i < s->point_count; i++) {
+		if (s->points[i].conn_count > POINT_MAX_CONN_PER_POINT)
+			return LD10K1_ERR_PROTOCOL;
+		for (j = 0; j < s->points[i].conn_count; j++)
+			if (s->points[i].patch[j] >= (int)s->patch_count)
+				return LD10K1_ERR_UNKNOWN_PATCH_NUM;
+	}
+
+	/* final response */
+	if ((err = receive_response(*conn, &opr, &sizer)) < 0)
+		return err;
+	return 0;
+}
+
 int liblo10k1lf_get_dsp_config(liblo10k1_connection_t *conn, liblo10k1_file_dsp_setup_t **setup)
 {
 	liblo10k1_dsp_info_t info;
@@ -637,7 +652,16 @@ int liblo10k1lf_get_dsp_config(liblo10k1_connection_t *conn, liblo10k1_file_dsp_
 	s = liblo10k1lf_dsp_config_alloc();
 	if (!s)
 		return LD10K1_ERR_NO_MEM;
-		
+
+	err = liblo10k1lf_get_dsp_snapshot(conn, s);
+	if (!err) {
+		*setup = s;
+		return 0;
+	}
+	if (err != LD10K1_ERR_UNKNOWN_OP)
+		goto err;
+
+	/* older ld10k1 - ask for every part separately */
 	/* get dsp type */
 	if ((err = liblo10k1_get_dsp_info(conn, &info)) < 0)
 		return err;
@@ -750,7 +774,9 @@ int liblo10k1lf_put_dsp_config(liblo10k1_connection_t *conn, liblo10k1_file_dsp_
 	int tpin, tpout;
 	
 	int pnum;
+	int transaction;
 	
+	trans_nums = NULL;
 	tin_type = 0;
 	tout_type = 0;
 	tin = 0;
@@ -761,28 +787,36 @@ int liblo10k1lf_put_dsp_config(liblo10k1_connection_t *conn, liblo10k1_file_dsp_
 	/* first initialize dsp */
 	if ((err = liblo10k1_dsp_init(conn)) < 0)
 		return err;
-		
+
+	/* everything goes to the driver at once - if ld10k1 knows how */
+	err = liblo10k1_transaction_begin(conn);
+	if (err < 0 && err != LD10K1_ERR_UNKNOWN_OP)
+		return err;
+	transaction = !err;
+
 	for (i = 0; i < setup->fx_count; i++) {
 		if ((err = liblo10k1_rename_fx(conn, i, setup->fxs[i].name)) < 0)
-			return err;
+			goto err;
 	}
 	
 	for (i = 0; i < setup->in_count; i++) {
 		if ((err = liblo10k1_rename_in(conn, i, setup->ins[i].name)) < 0)
-			return err;
+			goto err;
 	}
 	
 	for (i = 0; i < setup->out_count; i++) {
 		if ((err = liblo10k1_rename_out(conn, i, setup->outs[i].name)) < 0)
-			return err;
+			goto err;
 	}
 	
 	if (setup->patch_count <= 0)
-		return 0;
+		goto commit;
 	
 	trans_nums = (int *)malloc(sizeof(int) * setup->patch_count);
-	if (!trans_nums)
-		return LD10K1_ERR_NO_MEM;
+	if (!trans_nums) {
+		err = LD10K1_ERR_NO_MEM;
+		goto err;
+	}
 	
 	memset(trans_nums, 0, sizeof(int) * setup->patch_count);
 	
@@ -850,11 +884,80 @@ int liblo10k1lf_put_dsp_config(liblo10k1_connection_t *conn, liblo10k1_file_dsp_
 			}
 		}
 	}
+
+commit:
+	if (trans_nums)
+		free(trans_nums);
+	if (transaction)
+		return liblo10k1_transaction_commit(conn);
+	return 0;
+err:
+	if (trans_nums)
+		free(trans_nums);
+	if (transaction)
+		liblo10k1_transaction_abort(conn);
+	return err;
+}
+
+/* reader of old files (version 0.1.0) */
+
+int liblo10k1lf_find_part(FILE *file, unsigned int part_type, unsigned int part_id, unsigned int part_length, liblo10k1_file_part_t *part);
+int liblo10k1lf_find_part_il(FILE *file, unsigned int part_type, unsigned int part_id, unsigned int part_length, int il, liblo10k1_file_part_t *part);
+
+int liblo10k1lf_load_string_info(FILE *file, int id, char **str)
+{
+	char *tmp;
+	int err;
+	liblo10k1_file_part_t part;
+	
+	if ((err = liblo10k1lf_find_part_il(file, LD10K1_FP_TYPE_NORMAL, id, 0, 1, &part)) < 0)
+		return err;
+	
+	tmp = NULL;
+	if (part.part_length > 0) {
+		tmp = (char *)malloc(part.part_length);
+		if (!tmp)
+			return LD10K1_ERR_NO_MEM;
+			
+		if (fread(tmp, part.part_length, 1, file) != 1) {
+			free(tmp);
+			return LD10K1_LF_ERR_READ;
+		}
+	}
+	
+	if (*str)
+		free(*str);
+	*str = tmp;
+	return 0;
+}
+
+int liblo10k1lf_load_file_info(FILE *file, liblo10k1_file_info_t **fi)
+{
+	int err;
 	
+	liblo10k1_file_info_t *i = liblo10k1lf_file_info_alloc();
+	
+	if (!i)
+		return LD10K1_ERR_NO_MEM;
+	
+	if ((err = liblo10k1lf_load_string_info(file, LD10K1_FP_FILE_INFO_NAME, &(i->name))) < 0)
+		goto err;
+	if ((err = liblo10k1lf_load_string_info(file, LD10K1_FP_FILE_INFO_DESC, &(i->desc))) < 0)
+		goto err;
+	if ((err = liblo10k1lf_load_string_info(file, LD10K1_FP_FILE_INFO_CREATER, &(i->creater))) < 0)
+		goto err;
+	if ((err = liblo10k1lf_load_string_info(file, LD10K1_FP_FILE_INFO_AUTHOR, &(i->author))) < 0)
+		goto err;
+	if ((err = liblo10k1lf_load_string_info(file, LD10K1_FP_FILE_INFO_COPYRIGHT, &(i->copyright))) < 0)
+		goto err;
+	if ((err = liblo10k1lf_load_string_info(file, LD10K1_FP_FILE_INFO_LICENCE, &(i->license))) < 0)
+		goto err;
+		
+	*fi = i;
 	return 0;
 err:
-	if (trans_nums)
-		free(trans_nums);
+	if (i)
+		liblo10k1lf_file_info_free(i);
 	return err;
 }
 
@@ -963,7 +1066,7 @@ int liblo10k1lf_can_load_file(FILE *file, unsigned int ft)
 		return LD10K1_LF_ERR_READ;
 		
 	/* check signature */
-	if (strcmp(fhdr.signature, LD10K1_FILE_SIGNATURE) != 0)
+	if (strcmp(fhdr.signature, LD10K1_FILE_SIGNATURE_OLD) != 0)
 		return LD10K1_LF_ERR_SIGNATURE;
 	
 	/* now load file info part & check version */
@@ -1278,7 +1381,7 @@ err:
 	return err;
 }
 
-int liblo10k1lf_load_dsp_config(liblo10k1_file_dsp_setup_t **c, char *file_name, liblo10k1_file_info_t **fi)
+static int liblo10k1lf_load_dsp_config_old(liblo10k1_file_dsp_setup_t **c, char *file_name, liblo10k1_file_info_t **fi)
 {
 	FILE *file = NULL;
 	int err;
@@ -1308,6 +1411,36 @@ err:
 	return err;
 }
 
+static int liblo10k1lf_load_dsp_patch_old(liblo10k1_dsp_patch_t **p, char *file_name, liblo10k1_file_info_t **fi)
+{
+	FILE *file = NULL;
+	int err;
+	
+	liblo10k1_file_info_t *i = NULL;
+	
+	file = fopen(file_name, "r");
+	if (!file)
+		return LD10K1_LF_ERR_OPEN;
+		
+	if ((err = liblo10k1lf_can_load_file(file, LD10K1_FP_INFO_FILE_TYPE_PATCH)) < 0)
+		goto err;
+		
+	if ((err =  liblo10k1lf_load_file_info(file, &i)) < 0)
+		goto err;
+		
+	if ((err =  liblo10k1lf_load_patch(p, file)) < 0)
+		goto err;
+		
+	*fi = i;
+	fclose(file);
+	return 0;
+err:
+	if (i)
+		liblo10k1lf_file_info_free(i);
+	fclose(file);
+	return err;
+}
+
 liblo10k1_file_info_t *liblo10k1lf_file_info_alloc()
 {
 	liblo10k1_file_info_t *tmp = (liblo10k1_file_info_t *)malloc(sizeof(liblo10k1_file_info_t));
@@ -1332,57 +1465,348 @@ void liblo10k1lf_file_info_free(liblo10k1_file_info_t *fi)
 		free(fi->license);
 }
 
-int liblo10k1lf_save_dsp_patch(liblo10k1_dsp_patch_t *p, char *file_name, liblo10k1_file_info_t *fi)
+/* reader of files version 0.2.0 - file is mapped and parts are found through table of contents */
+typedef struct {
+	const unsigned char *data;
+	unsigned int size;
+	const unsigned char *toc;
+	unsigned int toc_count;
+} liblo10k1lf_map_t;
+
+static void liblo10k1lf_map_close(liblo10k1lf_map_t *map)
 {
-	FILE *file = NULL;
+	munmap((void *)map->data, map->size);
+}
+
+/* returns 1 for file in old format */
+static int liblo10k1lf_map_open(liblo10k1lf_map_t *map, char *file_name, unsigned int ft)
+{
+	struct stat st;
+	void *data;
+	int fd;
+	unsigned int toc_offset;
 	int err;
-	
-	file = fopen(file_name, "w");
-	if (!file)
+
+	fd = open(file_name, O_RDONLY);
+	if (fd < 0)
 		return LD10K1_LF_ERR_OPEN;
-		
-	if ((err = liblo10k1lf_save_file_header(file, LD10K1_FP_INFO_FILE_TYPE_PATCH)) < 0)
+
+	if (fstat(fd, &st) < 0 || st.st_size < LF_HEADER_SIZE || st.st_size > 0x7fffffff) {
+		close(fd);
+		return LD10K1_LF_ERR_READ;
+	}
+
+	data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED)
+		return LD10K1_LF_ERR_READ;
+
+	map->data = (const unsigned char *)data;
+	map->size = st.st_size;
+
+	if (memcmp(map->data, LD10K1_FILE_SIGNATURE_OLD, sizeof(LD10K1_FILE_SIGNATURE_OLD)) == 0) {
+		err = 1;
 		goto err;
-		
-	if ((err = liblo10k1lf_save_file_info(file, fi)) < 0)
+	}
+
+	/* check signature */
+	if (memcmp(map->data, LD10K1_FILE_SIGNATURE, sizeof(LD10K1_FILE_SIGNATURE)) != 0) {
+		err = LD10K1_LF_ERR_SIGNATURE;
 		goto err;
-		
-	if ((err =  liblo10k1lf_save_patch(p, file)) < 0)
+	}
+
+	if (lf_get_le32(map->data + 40) > LF_VERSION(CREATER_MAJOR, CREATER_MINOR, CREATER_SUBMINOR)) {
+		err = LD10K1_LF_ERR_VERSION;
 		goto err;
-		
-	fclose(file);
+	}
+
+	/* check file type */
+	if (lf_get_le32(map->data + 32) != ft) {
+		err = LD10K1_LF_ERR_FILE_TYPE;
+		goto err;
+	}
+
+	toc_offset = lf_get_le32(map->data + 52);
+	map->toc_count = lf_get_le32(map->data + 56);
+	if (lf_get_le32(map->data + 48) != map->size ||
+		toc_offset < LF_HEADER_SIZE || toc_offset > map->size ||
+		map->toc_count > (map->size - toc_offset) / LF_TOC_SIZE) {
+		err = LD10K1_LF_ERR_PART_SIZE;
+		goto err;
+	}
+	map->toc = map->data + toc_offset;
 	return 0;
 err:
-	fclose(file);
+	liblo10k1lf_map_close(map);
 	return err;
 }
 
-int liblo10k1lf_load_dsp_patch(liblo10k1_dsp_patch_t **p, char *file_name, liblo10k1_file_info_t **fi)
+/* finds part, NULL with *length = 0 if part is not in file */
+static const unsigned char *liblo10k1lf_map_find(liblo10k1lf_map_t *map, unsigned int part_id, unsigned int index, unsigned int *length)
+{
+	const unsigned char *p;
+	unsigned int i, offset;
+
+	*length = 0;
+	for (i = 0; i < map->toc_count; i++) {
+		p = map->toc + i * LF_TOC_SIZE;
+		if (lf_get_le32(p) != part_id || lf_get_le32(p + 4) != index)
+			continue;
+
+		offset = lf_get_le32(p + 8);
+		*length = lf_get_le32(p + 12);
+		if (offset & 7 || offset > map->size || *length > map->size - offset)
+			return NULL;
+		return map->data + offset;
+	}
+	return NULL;
+}
+
+static int liblo10k1lf_map_load(liblo10k1lf_map_t *map, unsigned int part_id, unsigned int index,
+	const int *layout, unsigned int rec_size, unsigned int count, void *where)
+{
+	const unsigned char *data;
+	unsigned int length;
+
+	if (lf_layout_size(layout) != rec_size)
+		return LD10K1_LF_ERR_PART_SIZE;
+
+	data = liblo10k1lf_map_find(map, part_id, index, &length);
+	if (length != rec_size * count || (count && !data))
+		return LD10K1_LF_ERR_PART_SIZE;
+
+	lf_decode((unsigned char *)where, data, layout, count);
+	return 0;
+}
+
+static int liblo10k1lf_map_string(liblo10k1lf_map_t *map, unsigned int part_id, char **str)
+{
+	const unsigned char *data;
+	unsigned int length;
+	char *tmp = NULL;
+
+	data = liblo10k1lf_map_find(map, part_id, 0, &length);
+	if (length) {
+		if (!data || data[length - 1] != '\0')
+			return LD10K1_LF_ERR_PART_SIZE;
+
+		tmp = (char *)malloc(length);
+		if (!tmp)
+			return LD10K1_ERR_NO_MEM;
+		memcpy(tmp, data, length);
+	}
+
+	if (*str)
+		free(*str);
+	*str = tmp;
+	return 0;
+}
+
+static int liblo10k1lf_map_file_info(liblo10k1lf_map_t *map, liblo10k1_file_info_t **fi)
 {
-	FILE *file = NULL;
 	int err;
-	
+
+	liblo10k1_file_info_t *i = liblo10k1lf_file_info_alloc();
+
+	if (!i)
+		return LD10K1_ERR_NO_MEM;
+
+	if ((err = liblo10k1lf_map_string(map, LD10K1_FP_FILE_INFO_NAME, &(i->name))) < 0)
+		goto err;
+	if ((err = liblo10k1lf_map_string(map, LD10K1_FP_FILE_INFO_DESC, &(i->desc))) < 0)
+		goto err;
+	if ((err = liblo10k1lf_map_string(map, LD10K1_FP_FILE_INFO_CREATER, &(i->creater))) < 0)
+		goto err;
+	if ((err = liblo10k1lf_map_string(map, LD10K1_FP_FILE_INFO_AUTHOR, &(i->author))) < 0)
+		goto err;
+	if ((err = liblo10k1lf_map_string(map, LD10K1_FP_FILE_INFO_COPYRIGHT, &(i->copyright))) < 0)
+		goto err;
+	if ((err = liblo10k1lf_map_string(map, LD10K1_FP_FILE_INFO_LICENCE, &(i->license))) < 0)
+		goto err;
+
+	*fi = i;
+	return 0;
+err:
+	liblo10k1lf_file_info_free(i);
+	return err;
+}
+
+static int liblo10k1lf_map_patch(liblo10k1lf_map_t *map, unsigned int index, liblo10k1_dsp_patch_t **p)
+{
+	liblo10k1_file_patch_info_t pinfo;
+	liblo10k1_dsp_patch_t *patch = NULL;
+	int err;
+
+	if ((err = liblo10k1lf_map_load(map, LD10K1_FP_PATCH_INFO, index, lf_layout_patch_info,
+		sizeof(pinfo), 1, &pinfo)) < 0)
+		return err;
+
+	patch = liblo10k1_patch_alloc(pinfo.in_count, pinfo.out_count, pinfo.const_count, pinfo.sta_count, pinfo.dyn_count,
+		pinfo.hw_count, pinfo.tram_count, pinfo.tram_acc_count, pinfo.ctl_count, pinfo.instr_count);
+	if (!patch)
+		return LD10K1_ERR_NO_MEM;
+
+	strcpy(patch->patch_name, pinfo.patch_name);
+
+	if ((err = liblo10k1lf_map_load(map, LD10K1_FP_PIN_LIST, index, lf_layout_io,
+		sizeof(liblo10k1_dsp_pio_t), patch->in_count, patch->ins)) < 0)
+		goto err;
+	if ((err = liblo10k1lf_map_load(map, LD10K1_FP_POUT_LIST, index, lf_layout_io,
+		sizeof(liblo10k1_dsp_pio_t), patch->out_count, patch->outs)) < 0)
+		goto err;
+	if ((err = liblo10k1lf_map_load(map, LD10K1_FP_CONST_LIST, index, lf_layout_word,
+		sizeof(liblo10k1_dsp_cs_t), patch->const_count, patch->consts)) < 0)
+		goto err;
+	if ((err = liblo10k1lf_map_load(map, LD10K1_FP_STA_LIST, index, lf_layout_word,
+		sizeof(liblo10k1_dsp_cs_t), patch->sta_count, patch->stas)) < 0)
+		goto err;
+	if ((err = liblo10k1lf_map_load(map, LD10K1_FP_HW_LIST, index, lf_layout_word,
+		sizeof(liblo10k1_dsp_hw_t), patch->hw_count, patch->hws)) < 0)
+		goto err;
+	if ((err = liblo10k1lf_map_load(map, LD10K1_FP_TRAM_LIST, index, lf_layout_tram,
+		sizeof(liblo10k1_dsp_tram_grp_t), patch->tram_count, patch->tram)) < 0)
+		goto err;
+	if ((err = liblo10k1lf_map_load(map, LD10K1_FP_TRAM_ACC_LIST, index, lf_layout_tram,
+		sizeof(liblo10k1_dsp_tram_acc_t), patch->tram_acc_count, patch->tram_acc)) < 0)
+		goto err;
+	if ((err = liblo10k1lf_map_load(map, LD10K1_FP_CTL_LIST, index, lf_layout_ctl,
+		sizeof(liblo10k1_dsp_ctl_t), patch->ctl_count, patch->ctl)) < 0)
+		goto err;
+	if ((err = liblo10k1lf_map_load(map, LD10K1_FP_INSTR_LIST, index, lf_layout_instr,
+		sizeof(liblo10k1_dsp_instr_t), patch->instr_count, patch->instr)) < 0)
+		goto err;
+
+	*p = patch;
+	return 0;
+err:
+	liblo10k1_patch_free(patch);
+	return err;
+}
+
+static int liblo10k1lf_map_dsp_setup(liblo10k1lf_map_t *map, liblo10k1_file_dsp_setup_t **c)
+{
+	liblo10k1_file_part_dsp_setup_t setup;
+	liblo10k1_file_dsp_setup_t *cfg;
+	int err;
+	int i;
+
+	if ((err = liblo10k1lf_map_load(map, LD10K1_FP_DSP_SETUP, 0, lf_layout_setup,
+		sizeof(setup), 1, &setup)) < 0)
+		return err;
+
+	cfg = liblo10k1lf_dsp_config_alloc();
+	if (!cfg)
+		return LD10K1_ERR_NO_MEM;
+
+	cfg->dsp_type = setup.dsp_type;
+
+	if ((err = liblo10k1lf_dsp_config_set_fx_count(cfg, setup.fx_count)) < 0)
+		goto err;
+	if ((err = liblo10k1lf_dsp_config_set_in_count(cfg, setup.in_count)) < 0)
+		goto err;
+	if ((err = liblo10k1lf_dsp_config_set_out_count(cfg, setup.out_count)) < 0)
+		goto err;
+	if ((err = liblo10k1lf_dsp_config_set_patch_count(cfg, setup.patch_count)) < 0)
+		goto err;
+	if ((err = liblo10k1lf_dsp_config_set_point_count(cfg, setup.point_count)) < 0)
+		goto err;
+
+	if ((err = liblo10k1lf_map_load(map, LD10K1_FP_FX_LIST, 0, lf_layout_io,
+		sizeof(liblo10k1_get_io_t), cfg->fx_count, cfg->fxs)) < 0)
+		goto err;
+	if ((err = liblo10k1lf_map_load(map, LD10K1_FP_IN_LIST, 0, lf_layout_io,
+		sizeof(liblo10k1_get_io_t), cfg->in_count, cfg->ins)) < 0)
+		goto err;
+	if ((err = liblo10k1lf_map_load(map, LD10K1_FP_OUT_LIST, 0, lf_layout_io,
+		sizeof(liblo10k1_get_io_t), cfg->out_count, cfg->outs)) < 0)
+		goto err;
+
+	for (i = 0; i < cfg->patch_count; i++) {
+		if ((err = liblo10k1lf_map_patch(map, i, &(cfg->patches[i]))) < 0)
+			goto err;
+	}
+
+	if ((err = liblo10k1lf_map_load(map, LD10K1_FP_POINT_LIST, 0, lf_layout_point,
+		sizeof(liblo10k1_point_info_t), cfg->point_count, cfg->points)) < 0)
+		goto err;
+
+	*c = cfg;
+	return 0;
+err:
+	liblo10k1lf_dsp_config_free(cfg);
+	return err;
+}
+
+int liblo10k1lf_load_dsp_config(liblo10k1_file_dsp_setup_t **c, char *file_name, liblo10k1_file_info_t **fi)
+{
+	liblo10k1lf_map_t map;
 	liblo10k1_file_info_t *i = NULL;
-	
-	file = fopen(file_name, "r");
-	if (!file)
-		return LD10K1_LF_ERR_OPEN;
-		
-	if ((err = liblo10k1lf_can_load_file(file, LD10K1_FP_INFO_FILE_TYPE_PATCH)) < 0)
+	int err;
+
+	if ((err = liblo10k1lf_map_open(&map, file_name, LD10K1_FP_INFO_FILE_TYPE_DSP_SETUP)) < 0)
+		return err;
+	if (err > 0)
+		return liblo10k1lf_load_dsp_config_old(c, file_name, fi);
+
+	if ((err = liblo10k1lf_map_file_info(&map, &i)) < 0)
 		goto err;
-		
-	if ((err =  liblo10k1lf_load_file_info(file, &i)) < 0)
+
+	if ((err = liblo10k1lf_map_dsp_setup(&map, c)) < 0)
 		goto err;
-		
-	if ((err =  liblo10k1lf_load_patch(p, file)) < 0)
+
+	*fi = i;
+	liblo10k1lf_map_close(&map);
+	return 0;
+err:
+	if (i)
+		liblo10k1lf_file_info_free(i);
+	liblo10k1lf_map_close(&map);
+	return err;
+}
+
+int liblo10k1lf_save_dsp_patch(liblo10k1_dsp_patch_t *p, char *file_name, liblo10k1_file_info_t *fi)
+{
+	liblo10k1lf_image_t img;
+	int err;
+
+	if ((err = liblo10k1lf_image_init(&img)) < 0)
+		return err;
+
+	if ((err = liblo10k1lf_image_file_info(&img, fi)) < 0)
 		goto err;
-		
+
+	if ((err = liblo10k1lf_image_patch(&img, p, 0)) < 0)
+		goto err;
+
+	err = liblo10k1lf_image_write(&img, LD10K1_FP_INFO_FILE_TYPE_PATCH, file_name);
+err:
+	liblo10k1lf_image_free(&img);
+	return err;
+}
+
+int liblo10k1lf_load_dsp_patch(liblo10k1_dsp_patch_t **p, char *file_name, liblo10k1_file_info_t **fi)
+{
+	liblo10k1lf_map_t map;
+	liblo10k1_file_info_t *i = NULL;
+	int err;
+
+	if ((err = liblo10k1lf_map_open(&map, file_name, LD10K1_FP_INFO_FILE_TYPE_PATCH)) < 0)
+		return err;
+	if (err > 0)
+		return liblo10k1lf_load_dsp_patch_old(p, file_name, fi);
+
+	if ((err = liblo10k1lf_map_file_info(&map, &i)) < 0)
+		goto err;
+
+	if ((err = liblo10k1lf_map_patch(&map, 0, p)) < 0)
+		goto err;
+
 	*fi = i;
-	fclose(file);
+	liblo10k1lf_map_close(&map);
 	return 0;
 err:
 	if (i)
 		liblo10k1lf_file_info_free(i);
-	fclose(file);
+	liblo10k1lf_map_close(&map);
 	return err;
 }
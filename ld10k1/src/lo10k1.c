@@ -26,6 +26,7 @@
 #include <ctype.h>
 #include <sys/stat.h>
 #include <unistd.h>
+#include <sys/time.h>
 
 #ifdef HAVE_CONFIG_H
 #include "config.h"
@@ -81,6 +82,12 @@ static void help(char *command)
 		"  -P, --path           include path\n"
 		"      --store          store DSP setup\n"
 		"      --restore        restore DSP setup\n"
+		"      --watch          print DSP changes until ld10k1 ends\n"
+		"      --setctl         set control values of patch specified with --where\n"
+		"      --repo           load patch kept by ld10k1 under this name\n"
+		"  -b, --batch          execute options from file (- is stdin) line by line over one connection\n"
+		"      --transaction    execute whole batch in one transaction\n"
+		"      --card           card served by ld10k1 started with more cards\n"
 		, command);
 }
 
@@ -759,12 +766,82 @@ static int list_patch(char *file_name)
 	return 0;
 }
 
+static int key_file(char *file_name, liblo10k1_repo_key_t *key)
+{
+	FILE *f;
+	char buf[4096];
+	size_t n;
+
+	if (!(f = fopen(file_name, "rb")))
+		return 1;
+	while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+		liblo10k1_repo_key_add(key, buf, n);
+	fclose(f);
+	return 0;
+}
+
+/*
+ * Key of patch in ld10k1 repository - file is searched same way
+ * as open_patch does, options which change loaded patch are part of key.
+ */
+static int patch_key(char *file_name, int udin, char *ctrl_opt, char *opt_patch_name, liblo10k1_repo_key_t *key)
+{
+	path_t *path_info = first_path;
+	char path[256]; /* FIXME */
+	int found;
+
+	liblo10k1_repo_key_init(key, file_name);
+
+	found = !key_file(file_name, key);
+	while (!found && path_info) {
+		memset(path, 0, sizeof(path));
+		snprintf(path, sizeof(path)-1, "%s/%s", 
+			 path_info->path, file_name);
+		if (!key_file(path, key)) {
+			found = 1;
+			break;
+		}
+
+		snprintf(path, sizeof(path)-1, "%s/%s.emu10k1", 
+			 path_info->path, file_name);
+		if (!key_file(path, key)) {
+			found = 1;
+			break;
+		}
+
+		path_info = path_info->next;
+	}
+
+	if (!found)
+		return 1;
+
+	liblo10k1_repo_key_add(key, &udin, sizeof(udin));
+	liblo10k1_repo_key_add(key, ctrl_opt ? ctrl_opt : "", ctrl_opt ? strlen(ctrl_opt) + 1 : 1);
+	liblo10k1_repo_key_add(key, opt_patch_name ? opt_patch_name : "", opt_patch_name ? strlen(opt_patch_name) + 1 : 1);
+	return 0;
+}
+
 static int add_patch(char *file_name, int udin, char *ctrl_opt, char *opt_patch_name, int where)
 {
 	int err;
 	liblo10k1_emu_patch_t *ep;
 	liblo10k1_dsp_patch_t *p;
-	
+	liblo10k1_repo_key_t key;
+	int keyed = 0;
+
+	/* ld10k1 may have this patch already - then nothing is parsed and sent */
+	if (!patch_key(file_name, udin, ctrl_opt, opt_patch_name, &key)) {
+		err = liblo10k1_repo_load(&conn, &key, NULL, where, NULL, NULL);
+		if (!err)
+			return 0;
+		if (err == LD10K1_ERR_REPO_NOT_FOUND)
+			keyed = 1;
+		else if (err != LD10K1_ERR_UNKNOWN_OP) {
+			error("unable to load patch (ld10k1 error:%s)", liblo10k1_error_str(err));
+			return err;
+		}
+	}
+
 	err = load_patch(file_name, &ep);
 	if (err)
 		return err;
@@ -780,7 +857,11 @@ static int add_patch(char *file_name, int udin, char *ctrl_opt, char *opt_patch_
 		p->patch_name[MAX_NAME_LEN - 1] = '\0';
 	}
 		
-	if ((err = liblo10k1_patch_load(&conn, p, where, NULL, NULL)) < 0) {
+	if (keyed)
+		err = liblo10k1_repo_patch_load(&conn, p, &key, where, NULL, NULL);
+	else
+		err = liblo10k1_patch_load(&conn, p, where, NULL, NULL);
+	if (err < 0) {
 		error("unable to load patch (ld10k1 error:%s)", liblo10k1_error_str(err));
 		return err;
 	}
@@ -788,6 +869,21 @@ static int add_patch(char *file_name, int udin, char *ctrl_opt, char *opt_patch_
 	return 0;
 }
 
+static int repo_patch(char *name, char *opt_patch_name, int where)
+{
+	int err;
+	liblo10k1_repo_key_t key;
+
+	liblo10k1_repo_key_init(&key, name);
+	key.hash[0] = key.hash[1] = 0;
+
+	if ((err = liblo10k1_repo_load(&conn, &key, opt_patch_name, where, NULL, NULL)) < 0) {
+		error("unable to load patch %s from repository (ld10k1 error:%s)", name, liblo10k1_error_str(err));
+		return err;
+	}
+	return 0;
+}
+
 static int load_dsp_patch(char *file_name, char *ctrl_opt, char *opt_patch_name, int where)
 {
 	int err;
@@ -795,6 +891,7 @@ static int load_dsp_patch(char *file_name, char *ctrl_opt, char *opt_patch_name,
 	liblo10k1_file_info_t *fi;
 	
 	fi = NULL;
+	p = NULL;
 	
 	if ((err = liblo10k1lf_load_dsp_patch(&p, file_name, &fi)) < 0) {
 		error("unable to load dsp patch (ld10k1 error:%s)", liblo10k1_error_str(err));
@@ -868,6 +965,74 @@ err:
 	return 1;
 }
 
+/* name1:value1#value2#...,name2:... - all values go in one request */
+static int set_ctl(char *ctl_str, int pn)
+{
+	int err, i, j;
+	int count = 0;
+	char *name, *val, *next;
+
+	liblo10k1_dsp_patch_t *p = NULL;
+	liblo10k1_ctl_value_t values[LD10K1_CTL_SET_MAX];
+
+	if (pn < 0) {
+		error("wrong patch num");
+		return 1;
+	}
+
+	if ((err = liblo10k1_patch_get(&conn, pn, &p)) < 0) {
+		error("unable to get dsp patch (ld10k1 error:%s)", liblo10k1_error_str(err));
+		return 1;
+	}
+
+	for (name = ctl_str; name; name = next) {
+		if ((next = strchr(name, ',')))
+			*next++ = '\0';
+		if (!(val = strchr(name, ':'))) {
+			error("wrong parameter - control string");
+			goto err;
+		}
+		*val++ = '\0';
+
+		for (i = 0; i < p->ctl_count; i++)
+			if (strcmp(p->ctl[i].name, name) == 0)
+				break;
+		if (i >= p->ctl_count) {
+			error("unknown control %s", name);
+			goto err;
+		}
+
+		for (j = 0; *val; j++) {
+			if (count >= LD10K1_CTL_SET_MAX) {
+				error("too many values");
+				goto err;
+			}
+			values[count].patch_num = pn;
+			values[count].ctl = i;
+			values[count].idx = j;
+			values[count].value = strtoul(val, &val, 0);
+			count++;
+			if (*val == '#')
+				val++;
+			else if (*val) {
+				error("wrong value for control %s", name);
+				goto err;
+			}
+		}
+	}
+
+	if ((err = liblo10k1_ctl_set(&conn, values, count)) < 0) {
+		error("unable to set controls (ld10k1 error:%s)", liblo10k1_error_str(err));
+		goto err;
+	}
+
+	liblo10k1_patch_free(p);
+	return 0;
+err:
+	liblo10k1_patch_free(p);
+	return 1;
+}
+
 void debug_print(char *str)
 {
 	printf("%s", str);
@@ -1462,42 +1627,81 @@ err:
 		liblo10k1lf_file_info_free(fi);
 	return 1;
 }
-int main(int argc, char *argv[])
+static const char *event_names[] =
 {
-	int  c;
-
-	int opt_list;
-	int opt_setup;
-	int opt_add;
-	int opt_del;
-	int opt_con_add;
-	int opt_con_del;
-	int opt_debug;
-	char *opt_list_patch;
-	int opt_use_default_io_names;
-	char *opt_ctrl;
-	char *opt_patch_name;
-	char *opt_new_name;
-	int opt_where;
-	int option_index = 0;
-	char *opt_dump_name;
-	char *opt_host;
-	char *tmp = NULL;
-	
-	int opt_store;
-	int opt_restore;
-	char *opt_store_restore_file;
-	
-	int opt_load_patch;
-	int opt_save_patch;
-	
-	unsigned int opt_wait_for_conn;
+	"", "patch add", "patch del", "patch rename", "connection add", "connection del",
+	"io rename", "ctl value", "dsp init", "resync"
+};
 
-	liblo10k1_param params;
+static int watch(void)
+{
+	liblo10k1_event_t event;
+	unsigned int generation;
+	int err, i;
 
-	int err = 0;
-	
- 	static struct option long_options[] = {
+	if ((err = liblo10k1_subscribe(&conn, LD10K1_EVENT_MASK_ALL, &generation)) < 0) {
+		error("unable to subscribe (ld10k1 error:%s)", liblo10k1_error_str(err));
+		return err;
+	}
+	printf("generation %u\n", generation);
+
+	while ((err = liblo10k1_event_read(&conn, &event, -1)) > 0) {
+		printf("%u %s", event.generation,
+			event.type > 0 && event.type <= LD10K1_EVENT_RESYNC ? event_names[event.type] : "unknown");
+		if (event.patch_num >= 0)
+			printf(" patch %d id %d", event.patch_num, event.patch_id);
+		if (event.io_type)
+			printf(" io %c(%d)", event.io_type, event.io);
+		else if (event.io >= 0)
+			printf(" ctl %d", event.io);
+		if (event.point_id >= 0)
+			printf(" point %d", event.point_id);
+		for (i = 0; i < event.count; i++)
+			printf(" %u", event.value[i]);
+		printf("\n");
+		fflush(stdout);
+	}
+	/* ld10k1 ended */
+	return 0;
+}
+
+typedef struct {
+	int list;
+	int setup;
+	int add;
+	int del;
+	int con_add;
+	int con_del;
+	int debug;
+	char *list_patch;
+	int use_default_io_names;
+	char *ctrl;
+	char *patch_name;
+	char *new_name;
+	int where;
+	char *dump_name;
+	char *host;
+	char *pipe_name;
+
+	int store;
+	int restore;
+	char *store_restore_file;
+
+	int load_patch;
+	int save_patch;
+	int watch;
+	char *set_ctl;
+	char *repo;
+
+	char *batch;
+	int transaction;
+	int card;
+
+	unsigned int wait_for_conn;
+	int help;
+} opts_t;
+
+static struct option long_options[] = {
 				{"pipe_name", 1, 0, 'p'},
     				{"list", 1, 0, 'l'},
 				{"info", 0, 0, 'i'},
@@ -1520,212 +1724,413 @@ int main(int argc, char *argv[])
 				{"load_patch", 1, 0, 0},
 				{"save_patch", 1, 0, 0},
 				{"wait", 1, 0, 0},
+				{"watch", 0, 0, 0},
+				{"setctl", 1, 0, 0},
+				{"repo", 1, 0, 0},
+				{"batch", 1, 0, 'b'},
+				{"transaction", 0, 0, 0},
+				{"card", 1, 0, 0},
 				{0, 0, 0, 0}
-	};
-
-	opt_list = 0;
-	opt_add = 0;
-	opt_del = 0;
-	opt_list_patch = NULL;
-	opt_con_add = 0;
-	opt_con_del = 0;
-	opt_debug = 0;
-	opt_use_default_io_names = 0;
-	opt_ctrl = NULL;
-	opt_patch_name = NULL;
-	opt_new_name = NULL;
-	opt_where = -1;
-	opt_setup = 0;
-	opt_dump_name = NULL;
-	opt_host = NULL;
-	
-	opt_store = 0;
-	opt_restore = 0;
-	opt_store_restore_file = NULL;
-	
-	opt_load_patch = 0;
-	opt_save_patch = 0;
-	
-	opt_wait_for_conn = 500;
-
-	strcpy(comm_pipe,"/tmp/.ld10k1_port");
+};
 
-	if (argc > 1 && !strcmp(argv[1], "--help")) {
-		help(argv[0]);
-		return 0;
-	}
+/* strict - unknown options are error (batch lines) */
+static int parse_opts(int argc, char *argv[], opts_t *opts, int strict)
+{
+	int c;
+	int option_index = 0;
+	const char *name;
 
-	first_path = NULL;
-#ifdef EFFECTSDIR
-	add_paths(EFFECTSDIR);
-#endif
+	memset(opts, 0, sizeof(*opts));
+	opts->where = -1;
+	opts->wait_for_conn = 500;
+	opts->card = -1;
 
-	while ((c = getopt_long(argc, argv, "hil:p:a:d:q:w:nsh:P:",
+	/* full reinitialization, parsing is done once per batch line */
+	optind = 0;
+	while ((c = getopt_long(argc, argv, "hil:p:a:d:q:w:nsh:P:b:",
 	        long_options, &option_index)) != EOF) {
 		switch (c) {
 		case 0:
-			if (strcmp(long_options[option_index].name, "debug") == 0)
-				opt_debug = atoi(optarg);
-			else if (strcmp(long_options[option_index].name, "ctrl") == 0)
-				opt_ctrl = optarg;
-			else if (strcmp(long_options[option_index].name, "patch_name") == 0)
-				opt_patch_name = optarg;
-			else if (strcmp(long_options[option_index].name, "where") == 0)
-				opt_where = atoi(optarg);
-			else if (strcmp(long_options[option_index].name, "renam") == 0)
-				opt_new_name = optarg;
-			else if (strcmp(long_options[option_index].name, "dump") == 0)
-				opt_dump_name = optarg;
-			else if (strcmp(long_options[option_index].name, "host") == 0)
-				opt_host = optarg;
-			else if (strcmp(long_options[option_index].name, "wait") == 0) {
-				opt_wait_for_conn = atoi(optarg);
-				if (opt_wait_for_conn < 0)
-					opt_wait_for_conn = 0;
-				else if (opt_wait_for_conn > 500)
-					opt_wait_for_conn = 500;
-			}
-			else if (strcmp(long_options[option_index].name, "store") == 0) {
-				opt_store = 1;
-				opt_store_restore_file = optarg;
-			} else if (strcmp(long_options[option_index].name, "restore") == 0) {
-				opt_restore = 1;
-				opt_store_restore_file = optarg;
-			} else if (strcmp(long_options[option_index].name, "load_patch") == 0) {
-				opt_load_patch = 1;
-				opt_store_restore_file = optarg;
-			} else if (strcmp(long_options[option_index].name, "save_patch") == 0) {
-				opt_save_patch = 1;
-				opt_store_restore_file = optarg;
+			name = long_options[option_index].name;
+			if (strcmp(name, "debug") == 0)
+				opts->debug = atoi(optarg);
+			else if (strcmp(name, "ctrl") == 0)
+				opts->ctrl = optarg;
+			else if (strcmp(name, "patch_name") == 0)
+				opts->patch_name = optarg;
+			else if (strcmp(name, "where") == 0)
+				opts->where = atoi(optarg);
+			else if (strcmp(name, "renam") == 0)
+				opts->new_name = optarg;
+			else if (strcmp(name, "dump") == 0)
+				opts->dump_name = optarg;
+			else if (strcmp(name, "host") == 0)
+				opts->host = optarg;
+			else if (strcmp(name, "wait") == 0) {
+				opts->wait_for_conn = atoi(optarg);
+				if (opts->wait_for_conn < 0)
+					opts->wait_for_conn = 0;
+				else if (opts->wait_for_conn > 500)
+					opts->wait_for_conn = 500;
 			}
+			else if (strcmp(name, "store") == 0) {
+				opts->store = 1;
+				opts->store_restore_file = optarg;
+			} else if (strcmp(name, "restore") == 0) {
+				opts->restore = 1;
+				opts->store_restore_file = optarg;
+			} else if (strcmp(name, "load_patch") == 0) {
+				opts->load_patch = 1;
+				opts->store_restore_file = optarg;
+			} else if (strcmp(name, "save_patch") == 0) {
+				opts->save_patch = 1;
+				opts->store_restore_file = optarg;
+			} else if (strcmp(name, "watch") == 0)
+				opts->watch = 1;
+			else if (strcmp(name, "setctl") == 0)
+				opts->set_ctl = optarg;
+			else if (strcmp(name, "repo") == 0)
+				opts->repo = optarg;
+			else if (strcmp(name, "transaction") == 0)
+				opts->transaction = 1;
+			else if (strcmp(name, "card") == 0)
+				opts->card = atoi(optarg);
 			break;
 		case 'h':
-			help(argv[0]);
-			return 0;
+			opts->help = 1;
+			break;
 		case 'l':
-			opt_list = 1;
-			opt_list_patch = optarg;
+			opts->list = 1;
+			opts->list_patch = optarg;
 			break;
 		case 'p':
-			strcpy(comm_pipe, optarg);
+			opts->pipe_name = optarg;
 			break;
 		case 'a':
-			opt_add = 1;
-			opt_list_patch = optarg;
+			opts->add = 1;
+			opts->list_patch = optarg;
 			break;
 		case 'd':
-			opt_del = 1;
-			opt_list_patch = optarg;
+			opts->del = 1;
+			opts->list_patch = optarg;
 			break;
 		case 'i':
 			/* nothing */
 			break;
 		case 'q':
-			opt_con_add = 1;
-			opt_list_patch = optarg;
+			opts->con_add = 1;
+			opts->list_patch = optarg;
 			break;
 		case 'w':
-			opt_con_del = 1;
-			opt_list_patch = optarg;
+			opts->con_del = 1;
+			opts->list_patch = optarg;
 			break;
 		case 'n':
-			opt_use_default_io_names = 1;
+			opts->use_default_io_names = 1;
 			break;
 		case 's':
-			opt_setup = 1;
+			opts->setup = 1;
 			break;
 		case 'P':
 			add_path(optarg);
 			break;
+		case 'b':
+			opts->batch = optarg;
+			break;
 		case '?':
+			if (strict)
+				return 1;
 			break;
 		default:
 			error("unknown option %c", c);
 			return 1;
 		}
 	}
+	return 0;
+}
 
-	params.wfc = opt_wait_for_conn;
-	if (opt_host) {
-		params.type = COMM_TYPE_IP;
-		params.name = strtok(opt_host, ":");
-		if (!params.name)
-			error("wrong hostname");
-		tmp = strtok(NULL, ":");
-		if (!tmp)
-			error("wrong port");
-		params.port = atoi(tmp);
-	} else {
-		params.type = COMM_TYPE_LOCAL;
-		params.name = comm_pipe;
-	}
-
-	params.server = 0;
+/* runs parsed options over open connection */
+static int run_opts(opts_t *opts)
+{
+	int err = 0;
 
 	while (1) {
-		if ((err = liblo10k1_connect(&params, &conn))) {
-			error("unable to connect ld10k1");
-			break;
-		}
-		
-		if ((err = liblo10k1_check_version(&conn))) {
-			error("Wrong ld10k1 version");
-			break;
-		}
-		
-		if (opt_store || opt_restore) {
-			if (opt_store) {
-				if ((err = store_dsp(opt_store_restore_file)))
+		if (opts->store || opts->restore) {
+			if (opts->store) {
+				if ((err = store_dsp(opts->store_restore_file)))
 					break;
 			} else {
-				if ((err = restore_dsp(opt_store_restore_file)))
+				if ((err = restore_dsp(opts->store_restore_file)))
 					break;
 			}
 		} else {
-			if (opt_setup)
+			if (opts->setup)
 				if ((err = setup_dsp()))
 					break;
-			if (opt_list)
-				if ((err = list_patch(opt_list_patch)))
+			if (opts->list)
+				if ((err = list_patch(opts->list_patch)))
 					break;
 	
-			if (opt_add)
-				if ((err = add_patch(opt_list_patch, opt_use_default_io_names, opt_ctrl, opt_patch_name, opt_where)))
+			if (opts->add)
+				if ((err = add_patch(opts->list_patch, opts->use_default_io_names, opts->ctrl, opts->patch_name, opts->where)))
 					break;
 			
-			if (opt_load_patch)
-				if ((err = load_dsp_patch(opt_store_restore_file, opt_ctrl, opt_patch_name, opt_where)))
+			if (opts->repo)
+				if ((err = repo_patch(opts->repo, opts->patch_name, opts->where)))
+					break;
+
+			if (opts->load_patch)
+				if ((err = load_dsp_patch(opts->store_restore_file, opts->ctrl, opts->patch_name, opts->where)))
 					break;
 					
-			if (opt_save_patch)
-				if ((err = save_dsp_patch(opt_store_restore_file, opt_where)))
+			if (opts->save_patch)
+				if ((err = save_dsp_patch(opts->store_restore_file, opts->where)))
 					break;
 	
-			if (opt_del)
-				if ((err = del_patch(opt_list_patch)))
+			if (opts->del)
+				if ((err = del_patch(opts->list_patch)))
 					break;
 	
-			if (opt_con_add)
-				if ((err = con_add(opt_list_patch)))
+			if (opts->con_add)
+				if ((err = con_add(opts->list_patch)))
 					break;
 	
-			if (opt_con_del)
-				if ((err = con_del(opt_list_patch)))
+			if (opts->con_del)
+				if ((err = con_del(opts->list_patch)))
 					break;
 	
-			if (opt_debug)
-				if ((err = debug(opt_debug)))
+			if (opts->debug)
+				if ((err = debug(opts->debug)))
 					break;
 	
-			if (opt_new_name)
-				if ((err = rename_arg(opt_new_name)))
+			if (opts->new_name)
+				if ((err = rename_arg(opts->new_name)))
 					break;
 	
-			if (opt_dump_name)
-				if ((err = dump(opt_dump_name)))
+			if (opts->dump_name)
+				if ((err = dump(opts->dump_name)))
+					break;
+
+			if (opts->set_ctl)
+				if ((err = set_ctl(opts->set_ctl, opts->where)))
+					break;
+
+			if (opts->watch)
+				if ((err = watch()))
 					break;
 		}
 		break;
+	}
+	return err;
+}
+
+#define BATCH_MAX_ARGS 64
+
+/* splits line to words in place, '' and "" quote, # starts comment */
+static int batch_split(char *line, char **args, int max)
+{
+	int count = 0;
+	char *in = line;
+	char *out;
+	char quote;
+
+	while (1) {
+		while (*in && isspace((unsigned char)*in))
+			in++;
+		if (!*in || *in == '#')
+			break;
+		if (count >= max)
+			return -1;
+		args[count++] = out = in;
+		quote = 0;
+		while (*in) {
+			if (quote) {
+				if (*in == quote)
+					quote = 0;
+				else
+					*out++ = *in;
+			} else if (*in == '\'' || *in == '"')
+				quote = *in;
+			else if (isspace((unsigned char)*in))
+				break;
+			else
+				*out++ = *in;
+			in++;
+		}
+		if (quote)
+			return -1;
+		if (*in)
+			in++;
+		*out = '\0';
+	}
+	return count;
+}
+
+static double batch_ms(struct timeval *from, struct timeval *to)
+{
+	return (to->tv_sec - from->tv_sec) * 1000.0 + (to->tv_usec - from->tv_usec) / 1000.0;
+}
+
+/*
+ * Every line of batch file holds options as on command line, all lines
+ * are executed over one connection. Connection options are not allowed
+ * in lines. Execution stops on first error, transaction is aborted then.
+ */
+static int batch(char *file_name, int transaction)
+{
+	FILE *batch_file;
+	char line[4096];
+	char *args[BATCH_MAX_ARGS + 1];
+	int count;
+	int line_num = 0;
+	int executed = 0;
+	int in_transaction = 0;
+	int err = 0;
+	opts_t opts;
+	struct timeval start, from, to;
+
+	if (strcmp(file_name, "-") == 0)
+		batch_file = stdin;
+	else if (!(batch_file = fopen(file_name, "r"))) {
+		error("unable to open batch file %s", file_name);
+		return 1;
+	}
+
+	gettimeofday(&start, NULL);
+
+	if (transaction) {
+		if ((err = liblo10k1_transaction_begin(&conn)) < 0) {
+			error("unable to begin transaction (ld10k1 error:%s)", liblo10k1_error_str(err));
+			goto err;
+		}
+		in_transaction = 1;
+	}
+
+	while (fgets(line, sizeof(line), batch_file)) {
+		line_num++;
+		args[0] = "lo10k1";
+		count = batch_split(line, args + 1, BATCH_MAX_ARGS);
+		if (count < 0) {
+			error("%s:%d: wrong line", file_name, line_num);
+			err = 1;
+			goto err;
+		}
+		if (!count)
+			continue;
+		args[count + 1] = NULL;
+
+		if (parse_opts(count + 1, args, &opts, 1)) {
+			error("%s:%d: wrong option", file_name, line_num);
+			err = 1;
+			goto err;
+		}
+		if (opts.help || opts.pipe_name || opts.host || opts.batch || opts.transaction || opts.watch ||
+			opts.card >= 0) {
+			error("%s:%d: option not allowed in batch", file_name, line_num);
+			err = 1;
+			goto err;
+		}
+
+		gettimeofday(&from, NULL);
+		err = run_opts(&opts);
+		gettimeofday(&to, NULL);
+		fprintf(stderr, "%s:%d: %s %.3f ms\n", file_name, line_num, err ? "failed" : "ok", batch_ms(&from, &to));
+		if (err)
+			goto err;
+		executed++;
+	}
+
+	if (in_transaction) {
+		gettimeofday(&from, NULL);
+		in_transaction = 0;
+		if ((err = liblo10k1_transaction_commit(&conn)) < 0) {
+			error("unable to commit transaction (ld10k1 error:%s)", liblo10k1_error_str(err));
+			goto err;
+		}
+		gettimeofday(&to, NULL);
+		fprintf(stderr, "%s: commit %.3f ms\n", file_name, batch_ms(&from, &to));
+	}
+
+	gettimeofday(&to, NULL);
+	fprintf(stderr, "%s: %d commands %.3f ms\n", file_name, executed, batch_ms(&start, &to));
+
+	if (batch_file != stdin)
+		fclose(batch_file);
+	return 0;
+err:
+	if (in_transaction)
+		liblo10k1_transaction_abort(&conn);
+	if (batch_file != stdin)
+		fclose(batch_file);
+	return err ? err : 1;
+}
+
+int main(int argc, char *argv[])
+{
+	char *tmp = NULL;
+	opts_t opts;
+	liblo10k1_param params;
+
+	int err = 0;
+
+	strcpy(comm_pipe,"/tmp/.ld10k1_port");
+
+	if (argc > 1 && !strcmp(argv[1], "--help")) {
+		help(argv[0]);
+		return 0;
+	}
+
+	first_path = NULL;
+#ifdef EFFECTSDIR
+	add_paths(EFFECTSDIR);
+#endif
+
+	if (parse_opts(argc, argv, &opts, 0))
+		return 1;
+	if (opts.help) {
+		help(argv[0]);
+		return 0;
+	}
+	if (opts.pipe_name)
+		strcpy(comm_pipe, opts.pipe_name);
+
+	params.wfc = opts.wait_for_conn;
+	if (opts.host) {
+		params.type = COMM_TYPE_IP;
+		params.name = strtok(opts.host, ":");
+		if (!params.name)
+			error("wrong hostname");
+		tmp = strtok(NULL, ":");
+		if (!tmp)
+			error("wrong port");
+		params.port = atoi(tmp);
+		if (opts.card >= 0)
+			params.port += opts.card;
+	} else {
+		params.type = COMM_TYPE_LOCAL;
+		if (opts.card >= 0)
+			snprintf(comm_pipe + strlen(comm_pipe), sizeof(comm_pipe) - strlen(comm_pipe), ".%i", opts.card);
+		params.name = comm_pipe;
+	}
+
+	params.server = 0;
+
+	while (1) {
+		if ((err = liblo10k1_connect(&params, &conn))) {
+			error("unable to connect ld10k1");
+			break;
+		}
+		
+		if ((err = liblo10k1_check_version(&conn))) {
+			error("Wrong ld10k1 version");
+			break;
+		}
+
+		if (opts.batch)
+			err = batch(opts.batch, opts.transaction);
+		else
+			err = run_opts(&opts);
+		break;
 	}	
 
 	if (liblo10k1_is_open(&conn)) {
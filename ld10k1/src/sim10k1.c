@@ -0,0 +1,1197 @@
+/*
+ *  EMU10k1 DSP simulator
+ *
+ *  Copyright (c) 2003,2004 by Peter Zubaj
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+/*
+ * Runs DSP program from dump (lo10k1 --dump) on wav file and writes what
+ * appears on DSP outputs, so patches and routing can be checked without
+ * SB Live or Audigy. One pass of program is one sample at 48kHz.
+ *
+ * Program which keeps no state between samples (no register is read
+ * before it is written in pass, no TRAM, skip, ACCUM, CCR or noise) is
+ * run instruction by instruction over whole block of samples. Anything
+ * else runs one sample at a time.
+ */
+
+#include <getopt.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <alsa/asoundlib.h>
+#include <alsa/sound/emu10k1.h>
+
+#include "ld10k1_dump_file.h"
+#include "ld10k1_dump_load.h"
+
+#define SIM_RATE 48000
+#define SIM_BLOCK 64
+#define SIM_MAX_INSTR 1024
+#define SIM_MAX_IO 64
+
+/* registers are addressed by 11 bit, last one takes writes to read only */
+#define SIM_REG_COUNT 0x800
+#define SIM_REG_SINK SIM_REG_COUNT
+
+#define SIM_TRAM_DATA 0x200
+#define SIM_TRAM_ADDR 0x300
+#define SIM_TRAM_MAX_ACC 0x100
+
+/* hw registers - offset from hw_base */
+#define SIM_HW_ACCUM 0x16
+#define SIM_HW_CCR 0x17
+#define SIM_HW_NOISE1 0x18
+#define SIM_HW_NOISE2 0x19
+#define SIM_HW_IRQ 0x1a
+#define SIM_HW_DBAC 0x1b
+#define SIM_HW_DBACE 0x1e
+#define SIM_HW_COUNT 0x20
+
+/* condition code register */
+#define SIM_CC_NORMALIZED 0x01
+#define SIM_CC_BORROW 0x02
+#define SIM_CC_MINUS 0x04
+#define SIM_CC_ZERO 0x08
+#define SIM_CC_SATURATE 0x10
+
+/* op flags */
+#define SIM_F_ACCUM 1	/* A is accumulator */
+#define SIM_F_NOISE 2	/* reads noise */
+
+typedef struct {
+	unsigned int op;
+	unsigned int r, a, x, y;
+	unsigned int flags;
+} sim_op_t;
+
+typedef struct {
+	int audigy;
+
+	unsigned int fx_base, fx_count;
+	unsigned int in_base, in_count;
+	unsigned int out_base, out_count;
+	unsigned int hw_base;
+	unsigned int gpr_base, gpr_count;
+
+	int32_t regs[SIM_REG_COUNT + 1];
+	int64_t acc;
+	uint32_t noise;
+
+	unsigned int op_count;
+	sim_op_t ops[SIM_MAX_INSTR];
+	/* program reads ACCUM or CCR register */
+	int need_flags;
+
+	/* tram - accessors with read or write op only */
+	unsigned int itram_acc_count;
+	unsigned int tram_read_count;
+	unsigned int tram_read[SIM_TRAM_MAX_ACC];
+	unsigned int tram_write_count;
+	unsigned int tram_write[SIM_TRAM_MAX_ACC];
+	unsigned int itram_size, etram_size;
+	unsigned int idbac, edbac;
+	int32_t *itram, *etram;
+
+	/* whole block per instruction */
+	int block;
+	int32_t (*bregs)[SIM_BLOCK];
+} sim_t;
+
+typedef struct {
+	FILE *file;
+	unsigned int channels;
+	unsigned int rate;
+	unsigned int bits;
+	unsigned int frames;
+} sim_wav_t;
+
+static unsigned int hw_const[22] =
+{
+	0x00000000, 0x00000001, 0x00000002, 0x00000003,
+	0x00000004, 0x00000008, 0x00000010, 0x00000020,
+	0x00000100, 0x00010000, 0x00080000, 0x10000000,
+	0x20000000, 0x40000000, 0x80000000, 0x7fffffff,
+	0xffffffff, 0xfffffffe, 0xc0000000, 0x4f1bbcde,
+	0x5a7ef9db, 0x00100000
+};
+
+void error(const char *fmt,...)
+{
+	va_list va;
+
+	va_start(va, fmt);
+	fprintf(stderr, "Error: ");
+	vfprintf(stderr, fmt, va);
+	fprintf(stderr, "\n");
+	va_end(va);
+}
+
+static void help(char *command)
+{
+	fprintf(stderr,
+		"Usage: %s [-options]\n"
+		"\nAvailable options:\n"
+		"  -h, --help        this help\n"
+		"  -d, --dump        file with dump\n"
+		"  -i, --input       input wav file (16 or 32 bit PCM, 48000 Hz)\n"
+		"  -o, --output      output wav file\n"
+		"  -I, --in-regs     DSP registers fed by input channels, default 0x0,0x1 (FX 0, 1)\n"
+		"  -O, --out-regs    DSP registers written to output channels, default front left, right\n"
+		"  -t, --tail        samples to run after end of input, default 0\n"
+		"  -s, --serial      run one sample at a time even if block run is possible\n"
+		"  -v, --verbose     print program info and speed\n"
+		, command);
+}
+
+static inline int32_t sim_sat(int64_t val)
+{
+	if (val > INT32_MAX)
+		return INT32_MAX;
+	if (val < INT32_MIN)
+		return INT32_MIN;
+	return (int32_t)val;
+}
+
+static int sim_reg_writable(sim_t *sim, unsigned int reg)
+{
+	if (reg >= sim->out_base && reg < sim->out_base + sim->out_count)
+		return 1;
+	if (reg >= sim->gpr_base && reg < sim->gpr_base + sim->gpr_count)
+		return 1;
+	if (reg >= SIM_TRAM_DATA && reg < SIM_TRAM_ADDR + SIM_TRAM_MAX_ACC)
+		return 1;
+	/* tram access control */
+	if (sim->audigy && reg >= 0x100 && reg < 0x200)
+		return 1;
+	return 0;
+}
+
+static int sim_reg_is_hw(sim_t *sim, unsigned int reg, unsigned int hw)
+{
+	return reg == sim->hw_base + hw;
+}
+
+static int sim_reg_is_state(sim_t *sim, unsigned int reg)
+{
+	return reg >= sim->hw_base + SIM_HW_ACCUM && reg < sim->hw_base + SIM_HW_COUNT;
+}
+
+static void sim_init(sim_t *sim, int audigy)
+{
+	unsigned int i;
+
+	memset(sim, 0, sizeof(sim_t));
+	sim->audigy = audigy;
+	if (audigy) {
+		sim->fx_base = 0x00;
+		sim->fx_count = 0x40;
+		sim->in_base = 0x40;
+		sim->in_count = 0x20;
+		sim->out_base = 0x60;
+		sim->out_count = 0x20;
+		sim->hw_base = 0xC0;
+		sim->gpr_base = 0x400;
+		sim->gpr_count = 0x200;
+		sim->itram_acc_count = 0xC0;
+		sim->itram_size = 0x4000;
+	} else {
+		sim->fx_base = 0x00;
+		sim->fx_count = 0x10;
+		sim->in_base = 0x10;
+		sim->in_count = 0x10;
+		sim->out_base = 0x20;
+		sim->out_count = 0x20;
+		sim->hw_base = 0x40;
+		sim->gpr_base = 0x100;
+		sim->gpr_count = 0x100;
+		sim->itram_acc_count = 0x80;
+		sim->itram_size = 0x2000;
+	}
+
+	for (i = 0; i < sizeof(hw_const) / sizeof(unsigned int); i++)
+		sim->regs[sim->hw_base + i] = (int32_t)hw_const[i];
+	sim->noise = 0x12345678;
+}
+
+static void sim_free(sim_t *sim)
+{
+	if (sim->itram)
+		free(sim->itram);
+	if (sim->etram)
+		free(sim->etram);
+	if (sim->bregs)
+		free(sim->bregs);
+}
+
+static void sim_decode(sim_t *sim, sim_op_t *op, unsigned int opcode, unsigned int *arg)
+{
+	unsigned int mask = sim->audigy ? 0x7FF : 0x3FF;
+
+	op->op = opcode & 0x0F;
+	op->r = arg[0] & mask;
+	op->a = arg[1] & mask;
+	op->x = arg[2] & mask;
+	op->y = arg[3] & mask;
+	op->flags = 0;
+
+	if (!sim_reg_writable(sim, op->r))
+		op->r = SIM_REG_SINK;
+	if (sim_reg_is_hw(sim, op->a, SIM_HW_ACCUM))
+		op->flags |= SIM_F_ACCUM;
+	if (op->op == iSKIP ||
+		sim_reg_is_hw(sim, op->a, SIM_HW_ACCUM) || sim_reg_is_hw(sim, op->a, SIM_HW_CCR) ||
+		sim_reg_is_hw(sim, op->x, SIM_HW_ACCUM) || sim_reg_is_hw(sim, op->x, SIM_HW_CCR) ||
+		sim_reg_is_hw(sim, op->y, SIM_HW_ACCUM) || sim_reg_is_hw(sim, op->y, SIM_HW_CCR))
+		sim->need_flags = 1;
+	if (sim_reg_is_hw(sim, op->a, SIM_HW_NOISE1) || sim_reg_is_hw(sim, op->a, SIM_HW_NOISE2) ||
+		sim_reg_is_hw(sim, op->x, SIM_HW_NOISE1) || sim_reg_is_hw(sim, op->x, SIM_HW_NOISE2) ||
+		sim_reg_is_hw(sim, op->y, SIM_HW_NOISE1) || sim_reg_is_hw(sim, op->y, SIM_HW_NOISE2))
+		op->flags |= SIM_F_NOISE;
+}
+
+static int sim_load_dump(sim_t *sim, char *file_name)
+{
+	void *dump_data = NULL;
+	ld10k1_dump_parts_t dump;
+	ld10k1_dump_t *header;
+	ld10k1_ctl_dump_t *fctrl;
+	unsigned int *fgpr;
+	ld10k1_tram_dump_t *ftram;
+	ld10k1_instr_dump_t *finstr;
+	unsigned int nop_arg[4];
+	unsigned int nop_op;
+	int i, j, last;
+	int has_skip = 0;
+	unsigned int gpr;
+	int err;
+
+	if ((err = ld10k1_dump_read(file_name, &dump_data, &dump)) < 0) {
+		error("unable to load dump %s (%s)", file_name, ld10k1_dump_error_str(err));
+		return 1;
+	}
+
+	header = dump.header;
+	if (header->tram_count > SIM_TRAM_MAX_ACC ||
+		header->instr_count > SIM_MAX_INSTR)
+		goto err;
+
+	sim_init(sim, header->dump_type != DUMP_TYPE_LIVE);
+
+	fctrl = dump.ctl;
+	fgpr = dump.gpr;
+	ftram = dump.tram;
+	finstr = dump.instr;
+
+	/* gprs, then current values of controls */
+	for (i = 0; i < header->gpr_count && i < sim->gpr_count; i++)
+		sim->regs[sim->gpr_base + i] = (int32_t)fgpr[i];
+
+	for (i = 0; i < header->ctl_count; i++)
+		for (j = 0; j < fctrl[i].count && j < 32; j++) {
+			gpr = fctrl[i].gpr_idx[j];
+			if (gpr < sim->gpr_count)
+				sim->regs[sim->gpr_base + gpr] = (int32_t)fctrl[i].value[j];
+		}
+
+	/* tram */
+	sim->etram_size = header->tram_size > 0 ? header->tram_size : 0;
+	if (!(sim->itram = (int32_t *)calloc(sim->itram_size, sizeof(int32_t))))
+		goto err_mem;
+	if (sim->etram_size && !(sim->etram = (int32_t *)calloc(sim->etram_size, sizeof(int32_t))))
+		goto err_mem;
+
+	for (i = 0; i < header->tram_count; i++) {
+		sim->regs[SIM_TRAM_DATA + i] = (int32_t)ftram[i].data;
+		sim->regs[SIM_TRAM_ADDR + i] = (int32_t)(ftram[i].addr & 0xFFFFF);
+		if (ftram[i].type == DUMP_TRAM_READ)
+			sim->tram_read[sim->tram_read_count++] = i;
+		else if (ftram[i].type == DUMP_TRAM_WRITE)
+			sim->tram_write[sim->tram_write_count++] = i;
+	}
+
+	/* code - unused slots hold same filler as dl10k1 writes */
+	if (sim->audigy) {
+		nop_op = iSKIP;
+		nop_arg[0] = 0xc0;
+		nop_arg[1] = 0xc0;
+		nop_arg[2] = 0xcf;
+		nop_arg[3] = 0xc0;
+	} else {
+		nop_op = iACC3;
+		nop_arg[0] = 0x40;
+		nop_arg[1] = 0x40;
+		nop_arg[2] = 0x40;
+		nop_arg[3] = 0x40;
+	}
+
+	last = -1;
+	for (i = 0; i < header->instr_count; i++)
+		if (finstr[i].used) {
+			last = i;
+			if ((finstr[i].op & 0x0F) == iSKIP)
+				has_skip = 1;
+		}
+
+	for (i = 0; i <= last; i++) {
+		if (finstr[i].used)
+			sim_decode(sim, &(sim->ops[sim->op_count++]), finstr[i].op, finstr[i].arg);
+		else if (has_skip)
+			/* skip counts slots */
+			sim_decode(sim, &(sim->ops[sim->op_count++]), nop_op, nop_arg);
+	}
+
+	free(dump_data);
+	return 0;
+
+err_mem:
+	error("no mem");
+	goto err1;
+err:
+	error("wrong dump file format %s", file_name);
+err1:
+	if (dump_data)
+		free(dump_data);
+	return 1;
+}
+
+/*
+ * Block run is same as sample by sample run, when value of every register
+ * read in pass was written earlier in same pass or is never written.
+ */
+static int sim_can_run_block(sim_t *sim)
+{
+	int first_write[SIM_REG_COUNT + 1];
+	unsigned int i, j, reg;
+	sim_op_t *op;
+
+	for (i = 0; i <= SIM_REG_COUNT; i++)
+		first_write[i] = -1;
+
+	for (i = 0; i < sim->op_count; i++) {
+		op = &(sim->ops[i]);
+		if (op->op == iSKIP || op->flags)
+			return 0;
+		if (op->r >= SIM_TRAM_DATA && op->r < SIM_TRAM_ADDR + SIM_TRAM_MAX_ACC)
+			return 0;
+		if (op->r != SIM_REG_SINK && first_write[op->r] < 0)
+			first_write[op->r] = i;
+	}
+
+	for (i = 0; i < sim->op_count; i++) {
+		op = &(sim->ops[i]);
+		for (j = 0; j < 3; j++) {
+			reg = j == 0 ? op->a : (j == 1 ? op->x : op->y);
+			if (sim_reg_is_state(sim, reg))
+				return 0;
+			if (reg >= SIM_TRAM_DATA && reg < SIM_TRAM_ADDR + SIM_TRAM_MAX_ACC)
+				return 0;
+			if (first_write[reg] >= (int)i)
+				return 0;
+		}
+	}
+	return 1;
+}
+
+static int sim_setup_block(sim_t *sim)
+{
+	unsigned int i, j;
+
+	sim->bregs = (int32_t (*)[SIM_BLOCK])malloc(sizeof(*sim->bregs) * (SIM_REG_COUNT + 1));
+	if (!sim->bregs)
+		return 1;
+	/* registers which are not written keep their value for every sample */
+	for (i = 0; i <= SIM_REG_COUNT; i++)
+		for (j = 0; j < SIM_BLOCK; j++)
+			sim->bregs[i][j] = sim->regs[i];
+	sim->block = 1;
+	return 0;
+}
+
+/* bits needed for exponent 0 - max_exp */
+static unsigned int sim_exp_bits(unsigned int max_exp)
+{
+	unsigned int bits = 1;
+
+	while ((1U << bits) <= max_exp)
+		bits++;
+	return bits;
+}
+
+/* format word: bit 0 - absolute value, bit 1 - negate */
+static int32_t sim_log_sign(int32_t a, int32_t res, int32_t y)
+{
+	if (a < 0 && !(y & 1))
+		res = -res;
+	if (y & 2)
+		res = -res;
+	return res;
+}
+
+static uint32_t sim_abs(int32_t a)
+{
+	if (a == INT32_MIN)
+		return 0x7fffffff;
+	return a < 0 ? -a : a;
+}
+
+/*
+ * Linear to log: exponent (0 - max_exp) goes to top bits, mantissa without
+ * leading one below it, small numbers are denormalized with exponent 0.
+ */
+static int32_t sim_log(int32_t a, int32_t x, int32_t y)
+{
+	unsigned int max_exp = x & 0x1f, ebits, lz, e;
+	uint32_t v, f;
+
+	if (!max_exp)
+		max_exp = 1;
+	ebits = sim_exp_bits(max_exp);
+
+	v = sim_abs(a);
+	if (!v)
+		return 0;
+	for (lz = 0; !(v & (0x40000000 >> lz)); lz++)
+		;
+	if (lz >= max_exp) {
+		e = 0;
+		f = (v << max_exp) & 0x7fffffff;
+	} else {
+		e = max_exp - lz;
+		f = (v << (lz + 1)) & 0x7fffffff;
+	}
+	return sim_log_sign(a, (int32_t)((e << (31 - ebits)) | (f >> ebits)), y);
+}
+
+static int32_t sim_exp(int32_t a, int32_t x, int32_t y)
+{
+	unsigned int max_exp = x & 0x1f, ebits, e;
+	uint32_t v, f, lin;
+
+	if (!max_exp)
+		max_exp = 1;
+	ebits = sim_exp_bits(max_exp);
+
+	v = sim_abs(a);
+	e = v >> (31 - ebits);
+	f = (v << ebits) & 0x7fffffff;
+	if (e > max_exp)
+		e = max_exp;
+	if (!e)
+		lin = f >> max_exp;
+	else
+		lin = (0x80000000 | f) >> (max_exp - e + 1);
+	return sim_log_sign(a, (int32_t)lin, y);
+}
+
+/*
+ * Skip test word holds three terms in bits 0-9, 10-19, 20-29. Term bits
+ * 0-4 ask for set flag, 5-9 for cleared flag, flag asked for both is
+ * ignored. Bits 30-31 combine terms: 0 - 1 and 2 and 3, 1 - 1 or 2 or 3,
+ * 2 - (1 and 2) or 3, 3 - 1 and (2 or 3).
+ */
+static int sim_skip_term(uint32_t ccr, uint32_t term)
+{
+	uint32_t set = term & 0x1f;
+	uint32_t clr = (term >> 5) & 0x1f;
+	uint32_t care = set ^ clr;
+
+	return ((ccr & care & set) | (~ccr & care & clr)) == care;
+}
+
+static int sim_skip_test(uint32_t ccr, uint32_t test)
+{
+	int t1 = sim_skip_term(ccr, test & 0x3ff);
+	int t2 = sim_skip_term(ccr, (test >> 10) & 0x3ff);
+	int t3 = sim_skip_term(ccr, (test >> 20) & 0x3ff);
+
+	switch (test >> 30) {
+		case 0:
+			return t1 && t2 && t3;
+		case 1:
+			return t1 || t2 || t3;
+		case 2:
+			return (t1 && t2) || t3;
+		default:
+			return t1 && (t2 || t3);
+	}
+}
+
+static inline unsigned int sim_ccr(int32_t res, int sat, int borrow)
+{
+	unsigned int ccr = 0;
+
+	if (!res)
+		ccr |= SIM_CC_ZERO;
+	if (res < 0)
+		ccr |= SIM_CC_MINUS;
+	if ((res ^ (res << 1)) & 0x80000000)
+		ccr |= SIM_CC_NORMALIZED;
+	if (sat)
+		ccr |= SIM_CC_SATURATE;
+	if (borrow)
+		ccr |= SIM_CC_BORROW;
+	return ccr;
+}
+
+static void sim_noise(sim_t *sim)
+{
+	uint32_t n = sim->noise;
+
+	n ^= n << 13;
+	n ^= n >> 17;
+	n ^= n << 5;
+	sim->regs[sim->hw_base + SIM_HW_NOISE1] = (int32_t)n;
+	n ^= n << 13;
+	n ^= n >> 17;
+	n ^= n << 5;
+	sim->regs[sim->hw_base + SIM_HW_NOISE2] = (int32_t)n;
+	sim->noise = n;
+}
+
+static void sim_tram_read(sim_t *sim)
+{
+	unsigned int i, acc, addr;
+
+	for (i = 0; i < sim->tram_read_count; i++) {
+		acc = sim->tram_read[i];
+		addr = (uint32_t)sim->regs[SIM_TRAM_ADDR + acc] & 0xFFFFF;
+		if (acc < sim->itram_acc_count)
+			sim->regs[SIM_TRAM_DATA + acc] = sim->itram[(sim->idbac + addr) % sim->itram_size];
+		else if (sim->etram_size)
+			sim->regs[SIM_TRAM_DATA + acc] = sim->etram[(sim->edbac + addr) % sim->etram_size];
+	}
+}
+
+static void sim_tram_write(sim_t *sim)
+{
+	unsigned int i, acc, addr;
+
+	for (i = 0; i < sim->tram_write_count; i++) {
+		acc = sim->tram_write[i];
+		addr = (uint32_t)sim->regs[SIM_TRAM_ADDR + acc] & 0xFFFFF;
+		if (acc < sim->itram_acc_count)
+			sim->itram[(sim->idbac + addr) % sim->itram_size] = sim->regs[SIM_TRAM_DATA + acc];
+		else if (sim->etram_size)
+			sim->etram[(sim->edbac + addr) % sim->etram_size] = sim->regs[SIM_TRAM_DATA + acc];
+	}
+
+	/* delay base counts down, so data written move to higher offsets */
+	sim->idbac = (sim->idbac + sim->itram_size - 1) % sim->itram_size;
+	if (sim->etram_size)
+		sim->edbac = (sim->edbac + sim->etram_size - 1) % sim->etram_size;
+	sim->regs[sim->hw_base + SIM_HW_DBAC] = sim->idbac;
+	sim->regs[sim->hw_base + SIM_HW_DBACE] = sim->edbac;
+}
+
+/* one pass of program */
+static void sim_run_sample(sim_t *sim)
+{
+	int32_t *regs = sim->regs;
+	unsigned int accum_reg = sim->hw_base + SIM_HW_ACCUM;
+	unsigned int ccr_reg = sim->hw_base + SIM_HW_CCR;
+	unsigned int pc;
+	sim_op_t *op;
+	int64_t a, acc = sim->acc, prod;
+	int32_t x, y, res;
+	int sat, borrow;
+
+	sim_tram_read(sim);
+
+	for (pc = 0; pc < sim->op_count; pc++) {
+		op = &(sim->ops[pc]);
+		if (op->flags & SIM_F_NOISE)
+			sim_noise(sim);
+
+		a = regs[op->a];
+		x = regs[op->x];
+		y = regs[op->y];
+		prod = (int64_t)x * y;
+		sat = 0;
+		borrow = 0;
+
+		switch (op->op) {
+			case iMAC0:
+			case iMAC1:
+				if (op->flags & SIM_F_ACCUM)
+					a = acc;
+				acc = a + ((op->op == iMAC0 ? prod : -prod) >> 31);
+				res = sim_sat(acc);
+				sat = res != acc;
+				break;
+			case iMAC2:
+			case iMAC3:
+				if (op->flags & SIM_F_ACCUM)
+					a = acc;
+				acc = a + ((op->op == iMAC2 ? prod : -prod) >> 31);
+				res = (int32_t)acc;
+				borrow = res != acc;
+				break;
+			case iMACINT0:
+				if (op->flags & SIM_F_ACCUM)
+					a = (int32_t)acc;
+				acc = a + prod;
+				res = sim_sat(acc);
+				sat = res != acc;
+				break;
+			case iMACINT1:
+				if (op->flags & SIM_F_ACCUM)
+					a = (int32_t)acc;
+				acc = a + prod;
+				res = (int32_t)(acc & 0x7fffffff);
+				borrow = res != acc;
+				break;
+			case iACC3:
+				acc = a + x + y;
+				res = sim_sat(acc);
+				sat = res != acc;
+				break;
+			case iMACMV:
+				acc += prod >> 31;
+				res = (int32_t)a;
+				break;
+			case iANDXOR:
+				res = ((int32_t)a & x) ^ y;
+				acc = res;
+				break;
+			case iTSTNEG:
+				res = a >= y ? x : ~x;
+				acc = res;
+				break;
+			case iLIMITGE:
+				res = a >= y ? x : y;
+				acc = res;
+				break;
+			case iLIMITLT:
+				res = a < y ? x : y;
+				acc = res;
+				break;
+			case iLOG:
+				res = sim_log((int32_t)a, x, y);
+				acc = res;
+				break;
+			case iEXP:
+				res = sim_exp((int32_t)a, x, y);
+				acc = res;
+				break;
+			case iINTERP:
+				acc = a + (((int64_t)x * (y - a)) >> 31);
+				res = sim_sat(acc);
+				sat = res != acc;
+				break;
+			case iSKIP:
+			default:
+				/* neither result nor flags */
+				if (sim_skip_test((uint32_t)a, (uint32_t)x))
+					pc += (uint32_t)y;
+				continue;
+		}
+
+		regs[op->r] = res;
+		if (sim->need_flags) {
+			regs[accum_reg] = sim_sat(acc);
+			regs[ccr_reg] = sim_ccr(res, sat, borrow);
+		}
+	}
+
+	sim->acc = acc;
+	sim_tram_write(sim);
+}
+
+/* every instruction over n samples */
+static void sim_run_block(sim_t *sim, unsigned int n)
+{
+	int32_t (*bregs)[SIM_BLOCK] = sim->bregs;
+	int32_t *r, *a, *x, *y;
+	unsigned int pc, s;
+	sim_op_t *op;
+
+	for (pc = 0; pc < sim->op_count; pc++) {
+		op = &(sim->ops[pc]);
+		r = bregs[op->r];
+		a = bregs[op->a];
+		x = bregs[op->x];
+		y = bregs[op->y];
+
+		switch (op->op) {
+			case iMAC0:
+				for (s = 0; s < n; s++)
+					r[s] = sim_sat(a[s] + (((int64_t)x[s] * y[s]) >> 31));
+				break;
+			case iMAC1:
+				for (s = 0; s < n; s++)
+					r[s] = sim_sat(a[s] + ((-(int64_t)x[s] * y[s]) >> 31));
+				break;
+			case iMAC2:
+				for (s = 0; s < n; s++)
+					r[s] = (int32_t)(a[s] + (((int64_t)x[s] * y[s]) >> 31));
+				break;
+			case iMAC3:
+				for (s = 0; s < n; s++)
+					r[s] = (int32_t)(a[s] + ((-(int64_t)x[s] * y[s]) >> 31));
+				break;
+			case iMACINT0:
+				for (s = 0; s < n; s++)
+					r[s] = sim_sat(a[s] + (int64_t)x[s] * y[s]);
+				break;
+			case iMACINT1:
+				for (s = 0; s < n; s++)
+					r[s] = (int32_t)((a[s] + (int64_t)x[s] * y[s]) & 0x7fffffff);
+				break;
+			case iACC3:
+				for (s = 0; s < n; s++)
+					r[s] = sim_sat((int64_t)a[s] + x[s] + y[s]);
+				break;
+			case iMACMV:
+				if (r != a)
+					memcpy(r, a, sizeof(int32_t) * n);
+				break;
+			case iANDXOR:
+				for (s = 0; s < n; s++)
+					r[s] = (a[s] & x[s]) ^ y[s];
+				break;
+			case iTSTNEG:
+				for (s = 0; s < n; s++)
+					r[s] = a[s] >= y[s] ? x[s] : ~x[s];
+				break;
+			case iLIMITGE:
+				for (s = 0; s < n; s++)
+					r[s] = a[s] >= y[s] ? x[s] : y[s];
+				break;
+			case iLIMITLT:
+				for (s = 0; s < n; s++)
+					r[s] = a[s] < y[s] ? x[s] : y[s];
+				break;
+			case iLOG:
+				for (s = 0; s < n; s++)
+					r[s] = sim_log(a[s], x[s], y[s]);
+				break;
+			case iEXP:
+				for (s = 0; s < n; s++)
+					r[s] = sim_exp(a[s], x[s], y[s]);
+				break;
+			case iINTERP:
+				for (s = 0; s < n; s++)
+					r[s] = sim_sat(a[s] + (((int64_t)x[s] * ((int64_t)y[s] - a[s])) >> 31));
+				break;
+		}
+	}
+}
+
+/* in - n frames of in_ch samples, out - n frames of out_ch samples */
+static void sim_process(sim_t *sim, int32_t *in, unsigned int *in_regs, unsigned int in_ch,
+	int32_t *out, unsigned int *out_regs, unsigned int out_ch, unsigned int n)
+{
+	unsigned int s, c;
+
+	if (sim->block) {
+		for (s = 0; s < n; s++)
+			for (c = 0; c < in_ch; c++)
+				sim->bregs[in_regs[c]][s] = in[s * in_ch + c];
+		sim_run_block(sim, n);
+		for (s = 0; s < n; s++)
+			for (c = 0; c < out_ch; c++)
+				out[s * out_ch + c] = sim->bregs[out_regs[c]][s];
+		return;
+	}
+
+	for (s = 0; s < n; s++) {
+		for (c = 0; c < in_ch; c++)
+			sim->regs[in_regs[c]] = in[s * in_ch + c];
+		sim_run_sample(sim);
+		for (c = 0; c < out_ch; c++)
+			out[s * out_ch + c] = sim->regs[out_regs[c]];
+	}
+}
+
+static unsigned int sim_get_le(unsigned char *p, int bytes)
+{
+	unsigned int val = 0;
+
+	while (bytes--)
+		val = (val << 8) | p[bytes];
+	return val;
+}
+
+static void sim_put_le(unsigned char *p, unsigned int val, int bytes)
+{
+	while (bytes--) {
+		*p++ = val & 0xff;
+		val >>= 8;
+	}
+}
+
+static int sim_wav_open_read(sim_wav_t *wav, char *file_name)
+{
+	unsigned char hdr[16];
+	unsigned int size;
+	int have_fmt = 0;
+
+	memset(wav, 0, sizeof(sim_wav_t));
+	wav->file = fopen(file_name, "r");
+	if (!wav->file) {
+		error("unable to open file %s", file_name);
+		return 1;
+	}
+
+	if (fread(hdr, 12, 1, wav->file) != 1 ||
+		memcmp(hdr, "RIFF", 4) != 0 || memcmp(hdr + 8, "WAVE", 4) != 0)
+		goto err;
+
+	while (fread(hdr, 8, 1, wav->file) == 1) {
+		size = sim_get_le(hdr + 4, 4);
+		if (memcmp(hdr, "fmt ", 4) == 0) {
+			if (size < 16 || fread(hdr, 16, 1, wav->file) != 1)
+				goto err;
+			if (sim_get_le(hdr, 2) != 1) {
+				error("%s is not PCM wav", file_name);
+				goto err1;
+			}
+			wav->channels = sim_get_le(hdr + 2, 2);
+			wav->rate = sim_get_le(hdr + 4, 4);
+			wav->bits = sim_get_le(hdr + 14, 2);
+			if ((wav->bits != 16 && wav->bits != 32) || !wav->channels) {
+				error("%s - only 16 and 32 bit samples are supported", file_name);
+				goto err1;
+			}
+			have_fmt = 1;
+			size -= 16;
+		} else if (memcmp(hdr, "data", 4) == 0) {
+			if (!have_fmt)
+				goto err;
+			wav->frames = size / (wav->channels * wav->bits / 8);
+			return 0;
+		}
+		if (fseek(wav->file, size + (size & 1), SEEK_CUR))
+			goto err;
+	}
+err:
+	error("wrong wav file %s", file_name);
+err1:
+	fclose(wav->file);
+	wav->file = NULL;
+	return 1;
+}
+
+static void sim_wav_header(unsigned char *hdr, unsigned int channels, unsigned int bits, unsigned int frames)
+{
+	unsigned int data_size = frames * channels * bits / 8;
+
+	memcpy(hdr, "RIFF", 4);
+	sim_put_le(hdr + 4, 36 + data_size, 4);
+	memcpy(hdr + 8, "WAVEfmt ", 8);
+	sim_put_le(hdr + 16, 16, 4);
+	sim_put_le(hdr + 20, 1, 2);
+	sim_put_le(hdr + 22, channels, 2);
+	sim_put_le(hdr + 24, SIM_RATE, 4);
+	sim_put_le(hdr + 28, SIM_RATE * channels * bits / 8, 4);
+	sim_put_le(hdr + 32, channels * bits / 8, 2);
+	sim_put_le(hdr + 34, bits, 2);
+	memcpy(hdr + 36, "data", 4);
+	sim_put_le(hdr + 40, data_size, 4);
+}
+
+static int sim_wav_open_write(sim_wav_t *wav, char *file_name, unsigned int channels, unsigned int bits)
+{
+	unsigned char hdr[44];
+
+	wav->channels = channels;
+	wav->rate = SIM_RATE;
+	wav->bits = bits;
+	wav->frames = 0;
+
+	wav->file = fopen(file_name, "w");
+	if (!wav->file) {
+		error("unable to open file %s", file_name);
+		return 1;
+	}
+	/* sizes are written again at close */
+	sim_wav_header(hdr, channels, bits, 0);
+	if (fwrite(hdr, sizeof(hdr), 1, wav->file) != 1) {
+		error("unable to write to file %s", file_name);
+		fclose(wav->file);
+		return 1;
+	}
+	return 0;
+}
+
+static int sim_wav_close_write(sim_wav_t *wav)
+{
+	unsigned char hdr[44];
+	int err = 0;
+
+	sim_wav_header(hdr, wav->channels, wav->bits, wav->frames);
+	if (fseek(wav->file, 0, SEEK_SET) || fwrite(hdr, sizeof(hdr), 1, wav->file) != 1)
+		err = 1;
+	if (fclose(wav->file))
+		err = 1;
+	return err;
+}
+
+/* samples are in top bits of DSP registers */
+static int sim_wav_read(sim_wav_t *wav, int32_t *buf, unsigned int n)
+{
+	unsigned char raw[SIM_BLOCK * SIM_MAX_IO * 4];
+	unsigned int bytes = wav->bits / 8;
+	unsigned int i, count = n * wav->channels;
+
+	if (fread(raw, bytes * count, 1, wav->file) != 1)
+		return 1;
+	for (i = 0; i < count; i++) {
+		if (bytes == 2)
+			buf[i] = (int32_t)(sim_get_le(raw + i * 2, 2) << 16);
+		else
+			buf[i] = (int32_t)sim_get_le(raw + i * 4, 4);
+	}
+	return 0;
+}
+
+static int sim_wav_write(sim_wav_t *wav, int32_t *buf, unsigned int n)
+{
+	unsigned char raw[SIM_BLOCK * SIM_MAX_IO * 4];
+	unsigned int bytes = wav->bits / 8;
+	unsigned int i, count = n * wav->channels;
+
+	for (i = 0; i < count; i++) {
+		if (bytes == 2)
+			sim_put_le(raw + i * 2, (uint32_t)buf[i] >> 16, 2);
+		else
+			sim_put_le(raw + i * 4, (uint32_t)buf[i], 4);
+	}
+	if (fwrite(raw, bytes * count, 1, wav->file) != 1)
+		return 1;
+	wav->frames += n;
+	return 0;
+}
+
+static int sim_parse_regs(char *list, unsigned int *regs, unsigned int *count)
+{
+	char *end;
+	unsigned long reg;
+
+	*count = 0;
+	while (*list) {
+		reg = strtoul(list, &end, 0);
+		if (end == list || reg >= SIM_REG_COUNT || *count >= SIM_MAX_IO)
+			return 1;
+		regs[(*count)++] = reg;
+		if (*end == ',')
+			end++;
+		else if (*end)
+			return 1;
+		list = end;
+	}
+	return *count == 0;
+}
+
+int main(int argc, char *argv[])
+{
+	int c;
+	int err = 1;
+
+	int opt_help = 0;
+	int opt_serial = 0;
+	int opt_verbose = 0;
+	unsigned long opt_tail = 0;
+	char *opt_dump_file = NULL;
+	char *opt_input = NULL;
+	char *opt_output = NULL;
+	char *opt_in_regs = NULL;
+	char *opt_out_regs = NULL;
+
+	static sim_t sim;
+	sim_wav_t in_wav, out_wav;
+	unsigned int in_regs[SIM_MAX_IO], in_reg_count;
+	unsigned int out_regs[SIM_MAX_IO], out_reg_count;
+	int32_t in_buf[SIM_BLOCK * SIM_MAX_IO];
+	int32_t sim_in[SIM_BLOCK * SIM_MAX_IO];
+	int32_t out_buf[SIM_BLOCK * SIM_MAX_IO];
+	unsigned int in_ch, n, s, i;
+	unsigned long left, total = 0;
+	struct timeval start, stop;
+	double secs;
+
+	static struct option long_options[] = {
+				   {"help", 0, 0, 'h'},
+				   {"dump", 1, 0, 'd'},
+				   {"input", 1, 0, 'i'},
+				   {"output", 1, 0, 'o'},
+				   {"in-regs", 1, 0, 'I'},
+				   {"out-regs", 1, 0, 'O'},
+				   {"tail", 1, 0, 't'},
+				   {"serial", 0, 0, 's'},
+				   {"verbose", 0, 0, 'v'},
+				   {0, 0, 0, 0}
+               };
+
+	int option_index = 0;
+	while ((c = getopt_long(argc, argv, "hd:i:o:I:O:t:sv",
+	        long_options, &option_index)) != EOF) {
+		switch (c) {
+		case 'h':
+			opt_help = 1;
+			break;
+		case 'd':
+			opt_dump_file = optarg;
+			break;
+		case 'i':
+			opt_input = optarg;
+			break;
+		case 'o':
+			opt_output = optarg;
+			break;
+		case 'I':
+			opt_in_regs = optarg;
+			break;
+		case 'O':
+			opt_out_regs = optarg;
+			break;
+		case 't':
+			opt_tail = strtoul(optarg, NULL, 0);
+			break;
+		case 's':
+			opt_serial = 1;
+			break;
+		case 'v':
+			opt_verbose = 1;
+			break;
+		default:
+			return 1;
+		}
+	}
+
+	if (opt_help) {
+		help(argv[0]);
+		return 0;
+	}
+
+	if (!opt_dump_file || !opt_input || !opt_output) {
+		error("dump, input and output file must be specified");
+		return 1;
+	}
+
+	if (sim_load_dump(&sim, opt_dump_file))
+		goto err;
+
+	if (opt_in_regs) {
+		if (sim_parse_regs(opt_in_regs, in_regs, &in_reg_count)) {
+			error("wrong -I argument '%s'", opt_in_regs);
+			goto err;
+		}
+	} else {
+		in_regs[0] = sim.fx_base;
+		in_regs[1] = sim.fx_base + 1;
+		in_reg_count = 2;
+	}
+
+	if (opt_out_regs) {
+		if (sim_parse_regs(opt_out_regs, out_regs, &out_reg_count)) {
+			error("wrong -O argument '%s'", opt_out_regs);
+			goto err;
+		}
+	} else {
+		/* ac97 on live, analog front on audigy */
+		out_regs[0] = sim.out_base + (sim.audigy ? 8 : 0);
+		out_regs[1] = out_regs[0] + 1;
+		out_reg_count = 2;
+	}
+
+	if (!opt_serial && sim_can_run_block(&sim) && sim_setup_block(&sim)) {
+		error("no mem");
+		goto err;
+	}
+
+	if (sim_wav_open_read(&in_wav, opt_input))
+		goto err;
+	if (in_wav.channels > SIM_MAX_IO) {
+		error("too many channels in %s", opt_input);
+		goto err_in;
+	}
+	if (in_wav.rate != SIM_RATE)
+		fprintf(stderr, "Warning: %s has %u Hz, DSP runs at %u Hz\n", opt_input, in_wav.rate, SIM_RATE);
+
+	if (sim_wav_open_write(&out_wav, opt_output, out_reg_count, in_wav.bits))
+		goto err_in;
+
+	if (opt_verbose)
+		printf("%s: %u instructions, %u tram reads, %u tram writes, %s\n",
+			sim.audigy ? "Audigy" : "SB Live", sim.op_count,
+			sim.tram_read_count, sim.tram_write_count,
+			sim.block ? "block run" : "sample by sample run");
+
+	/* channels without register are dropped, registers without channel get 0 */
+	in_ch = in_wav.channels < in_reg_count ? in_wav.channels : in_reg_count;
+	memset(sim_in, 0, sizeof(sim_in));
+
+	gettimeofday(&start, NULL);
+	left = in_wav.frames + opt_tail;
+	while (left) {
+		n = left > SIM_BLOCK ? SIM_BLOCK : left;
+		if (in_wav.frames) {
+			if (n > in_wav.frames)
+				n = in_wav.frames;
+			if (sim_wav_read(&in_wav, in_buf, n)) {
+				error("unable to read data from file %s", opt_input);
+				goto err_out;
+			}
+			in_wav.frames -= n;
+			for (s = 0; s < n; s++)
+				for (i = 0; i < in_reg_count; i++)
+					sim_in[s * in_reg_count + i] = i < in_ch ? in_buf[s * in_wav.channels + i] : 0;
+		} else
+			memset(sim_in, 0, sizeof(int32_t) * n * in_reg_count);
+
+		sim_process(&sim, sim_in, in_regs, in_reg_count, out_buf, out_regs, out_reg_count, n);
+
+		if (sim_wav_write(&out_wav, out_buf, n)) {
+			error("unable to write to file %s", opt_output);
+			goto err_out;
+		}
+		left -= n;
+		total += n;
+	}
+	gettimeofday(&stop, NULL);
+
+	if (opt_verbose) {
+		secs = (stop.tv_sec - start.tv_sec) + (stop.tv_usec - start.tv_usec) / 1000000.0;
+		printf("%lu samples in %.3f s", total, secs);
+		if (secs > 0)
+			printf(", %.1fx real time", (double)total / SIM_RATE / secs);
+		printf("\n");
+	}
+	err = 0;
+err_out:
+	if (sim_wav_close_write(&out_wav)) {
+		error("unable to write to file %s", opt_output);
+		err = 1;
+	}
+err_in:
+	fclose(in_wav.file);
+err:
+	sim_free(&sim);
+	return err;
+}